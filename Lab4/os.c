@@ -253,13 +253,15 @@ void OS_Wait(int32_t *semaPt){
 // Increment semaphore
 // Lab2 spinlock
 // Lab3 wakeup blocked thread if appropriate
+// Safe to call from an ISR: the I bit is restored, not cleared
 // Inputs:  pointer to a counting semaphore
 // Outputs: none
 void OS_Signal(int32_t *semaPt){
 // ****IMPLEMENT THIS****
 // Same as Lab 3
   tcbType *pt;
-  DisableInterrupts();
+  long sr;
+  sr = StartCritical();
   (*semaPt) = (*semaPt) + 1;
   if((*semaPt) <= 0){
     pt = RunPt->next;   // search for a thread blocked on this semaphore
@@ -268,7 +270,7 @@ void OS_Signal(int32_t *semaPt){
     }
     pt->blocked = 0;    // wakeup this one
   }
-  EnableInterrupts();
+  EndCritical(sr);
 }
 
 #define FIFOSIZE 10    // can be any size
@@ -93,6 +93,7 @@ void OS_Wait(int32_t *semaPt);
 // Increment semaphore
 // Lab2 spinlock
 // Lab3 wakeup blocked thread if appropriate
+// Safe to call from an ISR: the I bit is restored, not cleared
 // Inputs:  pointer to a counting semaphore
 // Outputs: none
 void OS_Signal(int32_t *semaPt);
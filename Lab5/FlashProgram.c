@@ -95,8 +95,9 @@ void Flash_Init(uint8_t systemClockFreqMHz){
 // Note: disables interrupts while writing
 int Flash_Write(uint32_t addr, uint32_t data){
   uint32_t flashkey;
+  long sr;
   if(WriteAddrValid(addr)){
-    DisableInterrupts();                            // may be optional step
+    sr = StartCritical();                           // may be optional step
                                                     // wait for hardware idle
     while(FLASH_FMC_R&(FLASH_FMC_WRITE|FLASH_FMC_ERASE|FLASH_FMC_MERASE)){
                  // to do later: return ERROR if this takes too long
@@ -114,7 +115,7 @@ int Flash_Write(uint32_t addr, uint32_t data){
                  // to do later: return ERROR if this takes too long
                  // remember to re-enable interrupts
     };           // wait for completion (~3 to 4 usec)
-    EnableInterrupts();
+    EndCritical(sr);
     return NOERROR;
   }
   return ERROR;
@@ -148,10 +149,11 @@ int Flash_WriteArray(uint32_t *source, uint32_t addr, uint16_t count){
 // Note: disables interrupts while writing
 int Flash_FastWrite(uint32_t *source, uint32_t addr, uint16_t count){
   uint32_t flashkey;
+  long sr;
   uint32_t volatile *FLASH_FWBn_R = (uint32_t volatile*)0x400FD100;
   int writes = 0;
   if(MassWriteAddrValid(addr)){
-    DisableInterrupts();                            // may be optional step
+    sr = StartCritical();                           // may be optional step
     while(FLASH_FMC2_R&FLASH_FMC2_WRBUF){           // wait for hardware idle
                  // to do later: return ERROR if this takes too long
                  // remember to re-enable interrupts
@@ -171,7 +173,7 @@ int Flash_FastWrite(uint32_t *source, uint32_t addr, uint16_t count){
                  // to do later: return ERROR if this takes too long
                  // remember to re-enable interrupts
     };           // wait for completion (~3 to 4 usec)
-    EnableInterrupts();
+    EndCritical(sr);
   }
   return writes;
 }
@@ -183,8 +185,9 @@ int Flash_FastWrite(uint32_t *source, uint32_t addr, uint16_t count){
 // Note: disables interrupts while erasing
 int Flash_Erase(uint32_t addr){
   uint32_t flashkey;
+  long sr;
   if(EraseAddrValid(addr)){
-    DisableInterrupts();                            // may be optional step
+    sr = StartCritical();                           // may be optional step
                                                     // wait for hardware idle
     while(FLASH_FMC_R&(FLASH_FMC_WRITE|FLASH_FMC_ERASE|FLASH_FMC_MERASE)){
                  // to do later: return ERROR if this takes too long
@@ -201,7 +204,7 @@ int Flash_Erase(uint32_t addr){
                  // to do later: return ERROR if this takes too long
                  // remember to re-enable interrupts
     };           // wait for completion (~3 to 4 usec)
-    EnableInterrupts();
+    EndCritical(sr);
     return NOERROR;
   }
   return ERROR;
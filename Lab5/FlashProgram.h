@@ -27,6 +27,21 @@
 #define ERROR                   1           // Value returned if failure
 #define NOERROR                 0           // Value returned if success
 
+//------------FLASH_ADDR------------
+// Convert a flash address into a pointer that can be read.
+// On the TM4C123 the flash is directly addressable, so this
+// is just a cast.  Host builds define FLASH_SIMULATOR and
+// link FlashSim.c instead of FlashProgram.c, in which case
+// the address is translated into the simulator's RAM image.
+// Input: addr flash memory address
+// Output: pointer to the byte stored at that address
+#ifdef FLASH_SIMULATOR
+const uint8_t *Flash_Address(uint32_t addr);
+#define FLASH_ADDR(addr) Flash_Address(addr)
+#else
+#define FLASH_ADDR(addr) ((const uint8_t *)(addr))
+#endif
+
 //------------Flash_Init------------
 // This function was critical to the write and erase
 // operations of the flash memory on the LM3S811
@@ -0,0 +1,178 @@
+// FlashSim.c
+// Runs on a host computer (Linux, Windows, Mac)
+// RAM-backed simulator of the TM4C123 flash bank used by the
+// solid state disk.  It provides the same functions as
+// FlashProgram.c, so eDisk.c, eFile.c and eFileLog.c can be
+// compiled unchanged with FLASH_SIMULATOR defined.
+// Only the eDisk bank, FLASHSIM_ADDR_MIN to
+// FLASHSIM_ADDR_MIN+FLASHSIM_SIZE-1, is simulated; operations
+// on any other address fail the same way an invalid address
+// fails on the real part.
+
+#ifndef FLASH_SIMULATOR
+#define FLASH_SIMULATOR
+#endif
+#include <stdint.h>
+#include "FlashProgram.h"
+#include "FlashSim.h"
+
+uint8_t FlashSim_Memory[FLASHSIM_SIZE];
+uint32_t FlashSim_Writes;
+uint32_t FlashSim_Bursts;
+uint32_t FlashSim_Erases;
+uint32_t FlashSim_EraseCount[FLASHSIM_BLOCKS];
+uint32_t FlashSim_Time;
+uint32_t FlashSim_MaxBusy;
+int32_t PowerLeft = -1;      // operations until power is lost, -1 for never
+
+// Check if address is inside the simulated bank
+static int SimAddrValid(uint32_t addr){
+  return ((addr >= FLASHSIM_ADDR_MIN) && (addr < (FLASHSIM_ADDR_MIN + FLASHSIM_SIZE)));
+}
+
+// Count one write or erase operation against the power
+// budget; returns 0 once the simulated power has been lost
+static int SimPowered(void){
+  if(PowerLeft == 0){
+    return 0;
+  }
+  if(PowerLeft > 0){
+    PowerLeft = PowerLeft - 1;
+  }
+  return 1;
+}
+
+// Charge the modelled duration of one operation
+static void SimBusy(uint32_t us){
+  FlashSim_Time = FlashSim_Time + us;
+  if(us > FlashSim_MaxBusy){
+    FlashSim_MaxBusy = us;
+  }
+}
+
+// Program one little-endian 32-bit word; like NOR flash
+// a write can clear bits but never set them
+static void SimProgram(uint32_t addr, uint32_t data){
+  uint8_t *pt = &FlashSim_Memory[addr - FLASHSIM_ADDR_MIN];
+  pt[0] &= (uint8_t)(data);
+  pt[1] &= (uint8_t)(data >> 8);
+  pt[2] &= (uint8_t)(data >> 16);
+  pt[3] &= (uint8_t)(data >> 24);
+  FlashSim_Writes = FlashSim_Writes + 1;
+}
+
+//------------FlashSim_Reset------------
+// Set the entire simulated flash to the state a new part
+// ships in (all 1's) and clear every counter.
+// Input: none
+// Output: none
+void FlashSim_Reset(void){
+  uint32_t i;
+  for(i=0; i<FLASHSIM_SIZE; i=i+1){
+    FlashSim_Memory[i] = 0xFF;
+  }
+  for(i=0; i<FLASHSIM_BLOCKS; i=i+1){
+    FlashSim_EraseCount[i] = 0;
+  }
+  FlashSim_Writes = 0;
+  FlashSim_Bursts = 0;
+  FlashSim_Erases = 0;
+  FlashSim_Time = 0;
+  FlashSim_MaxBusy = 0;
+  PowerLeft = -1;
+}
+
+//------------FlashSim_PowerFail------------
+// Simulate losing power: after the given number of further
+// write or erase operations, every operation fails without
+// changing the flash, as if the part had been switched off.
+// FlashSim_Reset or a negative count restores power.
+// Input: operations  number of operations that still complete
+// Output: none
+void FlashSim_PowerFail(int32_t operations){
+  if(operations < 0){
+    PowerLeft = -1;
+  } else{
+    PowerLeft = operations;
+  }
+}
+
+//------------Flash_Address------------
+// Translate a flash address into a pointer into the RAM image.
+// Input: addr flash memory address inside the simulated bank
+// Output: pointer to the simulated byte
+const uint8_t *Flash_Address(uint32_t addr){
+  return &FlashSim_Memory[addr - FLASHSIM_ADDR_MIN];
+}
+
+//------------Flash_Init------------
+// Nothing to configure in the simulator.
+// Input: systemClockFreqMHz  system clock frequency (units of MHz)
+// Output: none
+void Flash_Init(uint8_t systemClockFreqMHz){
+}
+
+//------------Flash_Write------------
+// Write 32-bit data to flash at given address.
+// Input: addr 4-byte aligned flash memory address to write
+//        data 32-bit data
+// Output: 'NOERROR' if successful, 'ERROR' if fail (defined in FlashProgram.h)
+int Flash_Write(uint32_t addr, uint32_t data){
+  if(((addr % 4) == 0) && SimAddrValid(addr) && SimPowered()){
+    SimProgram(addr, data);
+    SimBusy(FLASHSIM_WRITEUS);
+    return NOERROR;
+  }
+  return ERROR;
+}
+
+//------------Flash_WriteArray------------
+// Write an array of 32-bit data to flash starting at given address.
+// Input: source pointer to array of 32-bit data
+//        addr   4-byte aligned flash memory address to start writing
+//        count  number of 32-bit writes
+// Output: number of successful writes; return value == count if completely successful
+int Flash_WriteArray(uint32_t *source, uint32_t addr, uint16_t count){
+  uint16_t successfulWrites = 0;
+  while((successfulWrites < count) && (Flash_Write(addr + 4*successfulWrites, source[successfulWrites]) == NOERROR)){
+    successfulWrites = successfulWrites + 1;
+  }
+  return successfulWrites;
+}
+
+//------------Flash_FastWrite------------
+// Write up to 32 words using the (simulated) write buffer.
+// Input: source pointer to array of 32-bit data
+//        addr   128-byte aligned flash memory address to start writing
+//        count  number of 32-bit writes (<=32)
+// Output: number of successful writes; return value == count if completely successful
+int Flash_FastWrite(uint32_t *source, uint32_t addr, uint16_t count){
+  int writes = 0;
+  if(((addr % 128) == 0) && SimAddrValid(addr) && SimPowered()){
+    while((writes < 32) && (writes < count)){
+      SimProgram(addr + 4*writes, source[writes]);
+      writes = writes + 1;
+    }
+    FlashSim_Bursts = FlashSim_Bursts + 1;
+    SimBusy(FLASHSIM_BURSTUS*writes);
+  }
+  return writes;
+}
+
+//------------Flash_Erase------------
+// Erase 1 KB block of flash.
+// Input: addr 1-KB aligned flash memory address to erase
+// Output: 'NOERROR' if successful, 'ERROR' if fail (defined in FlashProgram.h)
+int Flash_Erase(uint32_t addr){
+  uint32_t i;
+  if(((addr % 1024) == 0) && SimAddrValid(addr) && SimPowered()){
+    for(i=0; i<1024; i=i+1){
+      FlashSim_Memory[addr - FLASHSIM_ADDR_MIN + i] = 0xFF;
+    }
+    FlashSim_EraseCount[(addr - FLASHSIM_ADDR_MIN)/1024]++;
+    FlashSim_Erases = FlashSim_Erases + 1;
+    SimBusy(FLASHSIM_ERASEUS);
+    return NOERROR;
+  }
+  return ERROR;
+}
@@ -0,0 +1,57 @@
+// FlashSim.h
+// Runs on a host computer (Linux, Windows, Mac)
+// RAM-backed simulator of the TM4C123 flash bank used by the
+// solid state disk.  Compile the file system with
+// FLASH_SIMULATOR defined and link FlashSim.c in place of
+// FlashProgram.c to run eDisk and eFile code without a board.
+// The simulator follows NOR flash rules: a write can only
+// change 1 bits into 0 bits, and only Flash_Erase can turn
+// a 1 KB block back into all 1's.
+
+// Define these to match EDISK_ADDR_MIN when the disk spans
+// both flash banks, e.g. 0x00010000 and 0x00030000.
+#ifndef FLASHSIM_ADDR_MIN
+#define FLASHSIM_ADDR_MIN   0x00020000  // first simulated address (Flash Bank1)
+#endif
+#ifndef FLASHSIM_SIZE
+#define FLASHSIM_SIZE       0x00020000  // number of simulated bytes (128 KB)
+#endif
+#define FLASHSIM_BLOCKS     (FLASHSIM_SIZE/1024)
+
+// Time model, in usec, of how long each operation keeps the
+// processor waiting with interrupts disabled.  The program
+// times are the 80 MHz figures in FlashProgram.h; the erase
+// time is the TM4C123 page erase time.
+#ifndef FLASHSIM_WRITEUS
+#define FLASHSIM_WRITEUS    68          // one Flash_Write
+#endif
+#ifndef FLASHSIM_BURSTUS
+#define FLASHSIM_BURSTUS    34          // each word of a Flash_FastWrite
+#endif
+#ifndef FLASHSIM_ERASEUS
+#define FLASHSIM_ERASEUS    10000       // one Flash_Erase
+#endif
+
+// operation counters, cleared by FlashSim_Reset
+extern uint32_t FlashSim_Writes;   // number of 32-bit words programmed
+extern uint32_t FlashSim_Bursts;   // number of Flash_FastWrite operations
+extern uint32_t FlashSim_Erases;   // number of 1 KB blocks erased
+extern uint32_t FlashSim_EraseCount[FLASHSIM_BLOCKS]; // lifetime erases per block
+extern uint32_t FlashSim_Time;     // total modelled usec of flash operations
+extern uint32_t FlashSim_MaxBusy;  // longest single operation, usec
+
+//------------FlashSim_PowerFail------------
+// Simulate losing power: after the given number of further
+// write or erase operations, every operation fails without
+// changing the flash, as if the part had been switched off.
+// FlashSim_Reset or a negative count restores power.
+// Input: operations  number of operations that still complete
+// Output: none
+void FlashSim_PowerFail(int32_t operations);
+
+//------------FlashSim_Reset------------
+// Set the entire simulated flash to the state a new part
+// ships in (all 1's) and clear every counter.
+// Input: none
+// Output: none
+void FlashSim_Reset(void);
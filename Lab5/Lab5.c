@@ -98,7 +98,7 @@
 // normally this access would be poor style,
 // but the access to internal data is used here for debugging
 extern uint8_t Buff[512];
-extern uint8_t Directory[256], FAT[256];
+extern sectorType Directory[EFILE_FILES + 1], FAT[EDISK_SECTORS];
 
 // Test function: Copy a NULL-terminated 'inString' into the
 // 'Buff' global variable with a maximum of 512 characters.
@@ -119,8 +119,9 @@ void testbuildbuff(char *inString){
 
 // Test function: Draw a visual representation of the file
 // system to the screen.  It should resemble Figure 5.13.
-// This function reads the contents of the flash memory, so
-// first call OS_File_Flush() to synchronize.
+// This function shows the copy of the directory and FAT in
+// RAM, which is what the next OS_File_Flush() will write to
+// one of the two directory slots on the disk.
 // Inputs:  index  starting index of directory and FAT
 // Outputs: none
 #define COLORSIZE 9
@@ -130,52 +131,64 @@ const uint16_t ColorArray[COLORSIZE] = {LCD_YELLOW, LCD_BLUE, LCD_GREEN, LCD_RED
 // used for debugging
 // Input:  index is starting line number
 // Output: none
-void DisplayDirectory(uint8_t index){
-  uint16_t dirclr[256], fatclr[256];
-  volatile uint8_t *diraddr = (volatile uint8_t *)(EDISK_ADDR_MAX - 511); /* address of directory */
-  volatile uint8_t *fataddr = (volatile uint8_t *)(EDISK_ADDR_MAX - 255); /* address of FAT */
-  int i, j;
+#define ROWS 12                 // lines of the directory and FAT on the screen
+#if (EFILE_FILES + 1) > EDISK_SECTORS
+#define LINES (EFILE_FILES + 1)
+#else
+#define LINES EDISK_SECTORS     // lines of the directory or the FAT
+#endif
+void DisplayDirectory(uint32_t index){
+  uint16_t dirclr[ROWS], fatclr[ROWS]; // colors of the lines shown
+  sectorType *diraddr = Directory; /* address of directory */
+  sectorType *fataddr = FAT;     /* address of FAT */
+  uint32_t i, j, n;
   // set default color to gray
-  for(i=0; i<256; i=i+1){
+  for(i=0; i<ROWS; i=i+1){
     dirclr[i] = LCD_GRAY;
     fatclr[i] = LCD_GRAY;
   }
-  // set color for each active file
-  for(i=0; i<255; i=i+1){
+  // set color for each active file, on the lines shown
+  for(i=0; i<EFILE_FILES; i=i+1){
     j = diraddr[i];
-    if(j != 255){
-      dirclr[i] = ColorArray[i%COLORSIZE];
+    if((j != EFILE_NONE) && (i >= index) && (i < index + ROWS)){
+      dirclr[i-index] = ColorArray[i%COLORSIZE];
     }
-    while(j != 255){
-      fatclr[j] = ColorArray[i%COLORSIZE];
+    n = 0;                      // a broken chain ends after EDISK_SECTORS links
+    while((j != EFILE_NONE) && (j < EDISK_SECTORS) && (n < EDISK_SECTORS)){
+      if((j >= index) && (j < index + ROWS)){
+        fatclr[j-index] = ColorArray[i%COLORSIZE];
+      }
       j = fataddr[j];
+      n = n + 1;
     }
   }
   // clear the screen if necessary (very slow but helps with button bounce)
-  if((index + 11) > 255){
+  if((index + ROWS) > LINES){
     BSP_LCD_FillScreen(LCD_BLACK);
   }
   // print the column headers
-  BSP_LCD_DrawString(5, 0, "DIR", LCD_GRAY);
-  BSP_LCD_DrawString(15, 0, "FAT", LCD_GRAY);
-  // print the cloumns
+  BSP_LCD_DrawString(7, 0, "DIR", LCD_GRAY);
+  BSP_LCD_DrawString(14, 0, "FAT", LCD_GRAY);
+  // print the columns, 5 digits to show EFILE_NONE of 16-bit entries
   i = 0;
-  while((i <= 11) && ((index + i) <= 255)){
+  while((i < ROWS) && ((index + i) < LINES)){
     BSP_LCD_SetCursor(0, i+1);
-    BSP_LCD_OutUDec4((uint32_t)(index + i), LCD_GRAY);
-    BSP_LCD_SetCursor(4, i+1);
-    BSP_LCD_OutUDec4((uint32_t)diraddr[index+i], dirclr[index+i]);
-    BSP_LCD_SetCursor(10, i+1);
-    BSP_LCD_OutUDec4((uint32_t)(index + i), LCD_GRAY);
-    BSP_LCD_SetCursor(14, i+1);
-    BSP_LCD_OutUDec4((uint32_t)fataddr[index+i], fatclr[index+i]);
+    BSP_LCD_OutUDec5(index + i, LCD_GRAY);
+    if((index + i) <= EFILE_FILES){
+      BSP_LCD_SetCursor(7, i+1);
+      BSP_LCD_OutUDec5((uint32_t)diraddr[index+i], dirclr[i]);
+    }
+    if((index + i) < EDISK_SECTORS){
+      BSP_LCD_SetCursor(14, i+1);
+      BSP_LCD_OutUDec5((uint32_t)fataddr[index+i], fatclr[i]);
+    }
     i = i + 1;
   }
 }
 
 int main(void){
   uint8_t m, n, p;              // file numbers
-  uint8_t index = 0;            // row index
+  uint32_t index = 0;           // row index
   volatile int i;
   DisableInterrupts();
   BSP_Clock_InitFastest();
@@ -245,20 +258,20 @@ int main(void){
   i = OS_File_Size(m);          // i = 5
   i = OS_File_Size(p);          // i = 3
   i = OS_File_Size(p+1);        // i = 0
-  OS_File_Flush();              // 0x0003FE00
+  OS_File_Flush();              // 0x0003F800 or 0x0003FC00
   while(1){
     DisplayDirectory(index);
     while((BSP_Button1_Input() != 0) && (BSP_Button2_Input() != 0)){};
     if(BSP_Button1_Input() == 0){
-      if(index > 11){
-        index = index - 11;
+      if(index > ROWS - 1){
+        index = index - (ROWS - 1);
       } else{
         index = 0;
       }
     }
     if(BSP_Button2_Input() == 0){
-      if((index + 11) <= 255){
-        index = index + 11;
+      if((index + ROWS - 1) < LINES){
+        index = index + ROWS - 1;
       }
     }
     while((BSP_Button1_Input() == 0) || (BSP_Button2_Input() == 0)){};
@@ -0,0 +1,88 @@
+// SampleLog.c
+// Runs on either TM4C123 or MSP432
+// Continuous logging of periodic samples into a file of the
+// file system in eFile.h, through a ring of 512-byte buffers.
+// The producer (SampleLog_Put) only changes Filled and the
+// buffer it is filling; the consumer (SampleLog_Write) only
+// changes Written, so no critical section is needed between
+// them.  Buffer k%SAMPLELOG_DEPTH is full for
+// Written <= k < Filled.
+
+#include <stdint.h>
+#include "eDisk.h"
+#include "eFile.h"
+#include "SampleLog.h"
+
+// from the Lab4 kernel; its OS_Signal restores the I bit with
+// EndCritical, so SampleLog_Put can signal from an interrupt
+void OS_Wait(int32_t *semaPt);
+void OS_Signal(int32_t *semaPt);
+
+uint16_t SampleBuf[SAMPLELOG_DEPTH][SAMPLELOG_SAMPLES];
+volatile uint32_t Filled;     // buffers handed to the writer
+volatile uint32_t Written;    // buffers committed to the file
+uint32_t SampleCount;         // samples in the buffer being filled
+int32_t SampleReady;          // counting semaphore, number of full buffers
+sectorType SampleFile;
+uint32_t SampleLog_Overruns;
+uint32_t SampleLog_Sectors;
+uint32_t SampleLog_Errors;
+
+//********SampleLog_Init*************
+// Start logging into a file; sectors are appended after
+// whatever the file already holds
+// Inputs:  num, file number from OS_File_New
+// Outputs: none
+void SampleLog_Init(sectorType num){
+  SampleFile = num;
+  Filled = 0;
+  Written = 0;
+  SampleCount = 0;
+  SampleReady = 0;
+  SampleLog_Overruns = 0;
+  SampleLog_Sectors = 0;
+  SampleLog_Errors = 0;
+}
+
+//********SampleLog_Put*************
+// Add one sample; safe to call from a periodic event thread
+// or an interrupt, as long as there is only one caller.
+// Runs in constant time and never blocks.
+// Inputs:  sample, the data to log
+// Outputs: 0 if successful
+// Errors:  1 if every buffer was full and the sample was dropped
+int SampleLog_Put(uint16_t sample){
+  if((Filled - Written) >= SAMPLELOG_DEPTH){
+    SampleLog_Overruns = SampleLog_Overruns + 1;
+    return 1;                   // the writer has every buffer
+  }
+  SampleBuf[Filled%SAMPLELOG_DEPTH][SampleCount] = sample;
+  SampleCount = SampleCount + 1;
+  if(SampleCount == SAMPLELOG_SAMPLES){
+    SampleCount = 0;
+    Filled = Filled + 1;        // hand the buffer to the writer
+    OS_Signal(&SampleReady);
+  }
+  return 0;
+}
+
+//********SampleLog_Write*************
+// Wait for a full buffer and append it to the file
+// Call it in a loop from one thread that can block.
+// Inputs:  none
+// Outputs: 0 if successful
+// Errors:  255 on disk full or write failure
+uint8_t SampleLog_Write(void){
+  uint8_t status;
+  OS_Wait(&SampleReady);
+  // the Cortex M is little endian, so the buffer is already
+  // the byte order of the sector
+  status = OS_File_Append(SampleFile, (uint8_t *)SampleBuf[Written%SAMPLELOG_DEPTH]);
+  if(status){
+    SampleLog_Errors = SampleLog_Errors + 1;
+  } else{
+    SampleLog_Sectors = SampleLog_Sectors + 1;
+  }
+  Written = Written + 1;        // give the buffer back, even if it was lost
+  return status;
+}
@@ -0,0 +1,56 @@
+// SampleLog.h
+// Runs on either TM4C123 or MSP432
+// Continuous logging of periodic samples into a file of the
+// file system in eFile.h.  Include eDisk.h and eFile.h first.
+// A periodic event thread (or ISR) fills one 512-byte buffer
+// while a writer thread commits a full one with
+// OS_File_Append, so the event never waits for the flash.
+// With SAMPLELOG_DEPTH buffers, the writer can fall behind by
+// SAMPLELOG_DEPTH-1 buffers before samples are lost; each lost
+// sample is counted in SampleLog_Overruns.
+// Use with the Lab4 kernel, for example 1 kHz microphone data:
+//   void Task0(void){              // periodic event, 1 ms
+//     BSP_Microphone_Input(&SoundData);
+//     SampleLog_Put(SoundData);
+//   }
+//   void Writer(void){             // main thread
+//     while(1){
+//       SampleLog_Write();
+//     }
+//   }
+
+#ifndef SAMPLELOG_DEPTH
+#define SAMPLELOG_DEPTH    2       // number of 512-byte buffers, 2 for ping-pong
+#endif
+#define SAMPLELOG_SAMPLES  256     // 16-bit samples per buffer (one sector)
+
+// statistics, cleared by SampleLog_Init
+extern uint32_t SampleLog_Overruns; // samples dropped because every buffer was full
+extern uint32_t SampleLog_Sectors;  // buffers committed to the file
+extern uint32_t SampleLog_Errors;   // buffers lost to disk full or write failure
+
+//********SampleLog_Init*************
+// Start logging into a file; sectors are appended after
+// whatever the file already holds
+// Inputs:  num, file number from OS_File_New
+// Outputs: none
+void SampleLog_Init(sectorType num);
+
+//********SampleLog_Put*************
+// Add one sample; safe to call from a periodic event thread
+// or an interrupt, as long as there is only one caller.  It
+// calls OS_Signal, which in the Lab4 kernel restores the I
+// bit with EndCritical rather than enabling interrupts.
+// Runs in constant time and never blocks.
+// Inputs:  sample, the data to log
+// Outputs: 0 if successful
+// Errors:  1 if every buffer was full and the sample was dropped
+int SampleLog_Put(uint16_t sample);
+
+//********SampleLog_Write*************
+// Wait for a full buffer and append it to the file
+// Call it in a loop from one thread that can block.
+// Inputs:  none
+// Outputs: 0 if successful
+// Errors:  255 on disk full or write failure
+uint8_t SampleLog_Write(void);
@@ -0,0 +1,295 @@
+// SensorLog.c
+// Runs on either TM4C123 or MSP432
+// Compact time-series log of sensor samples on top of the
+// file system in eFile.h, using delta and zig-zag varint
+// encoding.  See SensorLog.h for the block format.
+
+#include <stdint.h>
+#include <string.h>
+#include "eDisk.h"
+#include "eFile.h"
+#include "SensorLog.h"
+
+#ifndef SENSORLOG_MAP
+#define SENSORLOG_MAP 1         // 0 with eFileLog.c, which has no OS_File_Map
+#endif
+
+#define MAXSAMPLEBYTES 10       // two 5-byte varints
+
+struct channel{
+  uint16_t count;    // samples in buf, 0 if empty
+  uint16_t used;     // bytes of buf used, header included
+  uint32_t time;     // time of the last sample
+  int32_t value;     // value of the last sample
+  uint32_t period;   // time between samples, 0 if not fixed
+  uint32_t width;    // bytes of a raw sample
+  uint32_t samples;  // samples in the blocks appended to the file
+  uint32_t blocks;   // blocks appended to the file
+  uint8_t buf[512];  // block being filled
+};
+typedef struct channel channelType;
+channelType Channels[SENSORLOG_CHANNELS];
+sectorType LogFile;
+uint32_t SensorLog_Samples;
+uint32_t SensorLog_Blocks;
+uint32_t SensorLog_Skipped;
+uint32_t SensorLog_Decoded;
+
+// Store a 32-bit little-endian number into a buffer.
+static void put32(uint8_t *pt, uint32_t value){
+  pt[0] = value;
+  pt[1] = value>>8;
+  pt[2] = value>>16;
+  pt[3] = value>>24;
+}
+
+// Read a 32-bit little-endian number from a buffer.
+static uint32_t get32(const uint8_t *pt){
+  return pt[0] + (pt[1]<<8) + (pt[2]<<16) + ((uint32_t)pt[3]<<24);
+}
+
+// Store an unsigned number as a varint, return its length.
+static uint32_t putvarint(uint8_t *pt, uint32_t value){
+  uint32_t n = 0;
+  while(value >= 0x80){
+    pt[n] = (value&0x7F)|0x80;
+    value = value>>7;
+    n = n + 1;
+  }
+  pt[n] = value;
+  return n + 1;
+}
+
+// Read a varint starting at pt[*index], advancing *index;
+// stops at end so a damaged block cannot overrun it.
+static uint32_t getvarint(const uint8_t *pt, uint32_t *index, uint32_t end){
+  uint32_t value = 0;
+  uint32_t shift = 0;
+  while((*index < end) && (shift < 35)){
+    value = value|((uint32_t)(pt[*index]&0x7F)<<shift);
+    *index = *index + 1;
+    if((pt[*index-1]&0x80) == 0){
+      break;
+    }
+    shift = shift + 7;
+  }
+  return value;
+}
+
+// Append a channel's block to the file and empty it.
+static uint8_t seal(uint8_t channel){
+  channelType *pt = &Channels[channel];
+  if(pt->count == 0){
+    return 0;
+  }
+  pt->buf[0] = SENSORLOG_MAGIC;
+  pt->buf[1] = channel;
+  pt->buf[2] = pt->count&0xFF;
+  pt->buf[3] = pt->count>>8;
+  put32(&pt->buf[8], pt->time);
+  put32(&pt->buf[16], pt->period);
+  pt->buf[20] = (pt->used - SENSORLOG_HEADER)&0xFF;
+  pt->buf[21] = (pt->used - SENSORLOG_HEADER)>>8;
+  memset(&pt->buf[pt->used], 0xFF, 512 - pt->used);
+  if(OS_File_Append(LogFile, pt->buf)){
+    return 255;
+  }
+  SensorLog_Blocks = SensorLog_Blocks + 1;
+  pt->samples = pt->samples + pt->count;
+  pt->blocks = pt->blocks + 1;
+  pt->count = 0;
+  return 0;
+}
+
+//********SensorLog_Init*************
+// Start logging into a file; the blocks are appended after
+// whatever the file already holds
+// Inputs:  num, file number from OS_File_New
+// Outputs: none
+void SensorLog_Init(sectorType num){
+  int i;
+  LogFile = num;
+  for(i=0; i<SENSORLOG_CHANNELS; i=i+1){
+    Channels[i].count = 0;
+    Channels[i].period = 0;
+    Channels[i].width = 4;
+    Channels[i].samples = 0;
+    Channels[i].blocks = 0;
+  }
+  SensorLog_Samples = 0;
+  SensorLog_Blocks = 0;
+  SensorLog_Skipped = 0;
+  SensorLog_Decoded = 0;
+}
+
+//********SensorLog_Channel*************
+// Describe a channel, after SensorLog_Init and before its
+// first sample; until then a channel has period 0 and width 4
+// Inputs:  channel, 0 to SENSORLOG_CHANNELS-1
+//          period, time between two samples, in the unit of
+//                  SensorLog_Put, or 0 if the rate is not fixed
+//          width, bytes of one raw sample, e.g. 2 for uint16_t,
+//                 used by SensorLog_Ratio
+// Outputs: 0 if successful
+// Errors:  255 on a bad channel, or a failure writing out the
+//          samples the channel already holds
+uint8_t SensorLog_Channel(uint8_t channel, uint32_t period, uint8_t width){
+  if(channel >= SENSORLOG_CHANNELS){
+    return 255;
+  }
+  if(seal(channel)){            // its blocks each have one period
+    return 255;
+  }
+  Channels[channel].period = period;
+  Channels[channel].width = width;
+  return 0;
+}
+
+//********SensorLog_Put*************
+// Add one sample to a channel
+// A full block is appended to the file.  A time earlier than
+// the previous sample of the channel also starts a new block,
+// because time steps are stored unsigned, and so does a time
+// that is not one period after it on a fixed-rate channel.
+// Inputs:  channel, 0 to SENSORLOG_CHANNELS-1
+//          time, time of the sample, in any unit
+//          value, the sample
+// Outputs: 0 if successful
+// Errors:  255 on a bad channel, disk full, or write failure
+uint8_t SensorLog_Put(uint8_t channel, uint32_t time, int32_t value){
+  channelType *pt;
+  uint32_t delta;
+  if(channel >= SENSORLOG_CHANNELS){
+    return 255;
+  }
+  pt = &Channels[channel];
+  if((pt->count > 0) && ((time < pt->time) || ((pt->used + MAXSAMPLEBYTES) > 512) ||
+     (pt->period && (time - pt->time != pt->period)))){
+    if(seal(channel)){
+      return 255;
+    }
+  }
+  if(pt->count == 0){
+    put32(&pt->buf[4], time);    // the first sample is stored whole
+    put32(&pt->buf[12], value);
+    pt->used = SENSORLOG_HEADER;
+  } else{
+    delta = (uint32_t)value - (uint32_t)pt->value;
+    if(pt->period == 0){         // otherwise the time is one period on
+      pt->used = pt->used + putvarint(&pt->buf[pt->used], time - pt->time);
+    }
+    pt->used = pt->used + putvarint(&pt->buf[pt->used], (delta<<1)^(0 - (delta>>31)));
+  }
+  pt->count = pt->count + 1;
+  pt->time = time;
+  pt->value = value;
+  SensorLog_Samples = SensorLog_Samples + 1;
+  return 0;
+}
+
+//********SensorLog_Sync*************
+// Append every partly filled block to the file, so all
+// samples logged so far can be read back
+// Call OS_File_Flush afterwards before removing power.
+// Inputs:  none
+// Outputs: 0 if successful
+// Errors:  255 on disk full or write failure
+uint8_t SensorLog_Sync(void){
+  uint8_t i;
+  uint8_t status = 0;
+  for(i=0; i<SENSORLOG_CHANNELS; i=i+1){
+    if(seal(i)){
+      status = 255;
+    }
+  }
+  return status;
+}
+
+//********SensorLog_Query*************
+// Read back the samples of one channel in a time range
+// Blocks of other channels, and blocks whose header shows no
+// sample in the range, are skipped without being decoded.
+// Inputs:  num, file number of the log
+//          channel, 0 to SENSORLOG_CHANNELS-1
+//          start, first time of interest
+//          end, last time of interest
+//          sample, function called with each sample in the range,
+//                  in the order the samples were logged
+// Outputs: number of samples passed to sample
+uint32_t SensorLog_Query(sectorType num, uint8_t channel, uint32_t start, uint32_t end,
+                         void(*sample)(uint8_t channel, uint32_t time, int32_t value)){
+  uint8_t buf[512];
+  const uint8_t *pt;
+  sectorType location;
+  uint32_t found = 0;
+  uint32_t count, index, stop, time, period, delta;
+  int32_t value;
+  for(location=0; location<OS_File_Size(num); location=location+1){
+#if SENSORLOG_MAP
+    pt = OS_File_Map(num, location);    // in place if the disk allows it
+#else
+    pt = 0;
+#endif
+    if(pt == 0){
+      if(OS_File_Read(num, location, buf)){
+        break;
+      }
+      pt = buf;
+    }
+    if((pt[0] != SENSORLOG_MAGIC) || (pt[1] != channel) ||
+       (get32(&pt[8]) < start) || (get32(&pt[4]) > end)){
+      SensorLog_Skipped = SensorLog_Skipped + 1;
+      continue;
+    }
+    SensorLog_Decoded = SensorLog_Decoded + 1;
+    count = pt[2] + (pt[3]<<8);
+    time = get32(&pt[4]);
+    value = get32(&pt[12]);
+    period = get32(&pt[16]);
+    index = SENSORLOG_HEADER;
+    stop = SENSORLOG_HEADER + pt[20] + (pt[21]<<8);
+    if(stop > 512){
+      stop = 512;
+    }
+    while(count > 0){
+      if((time >= start) && (time <= end)){
+        sample(channel, time, value);
+        found = found + 1;
+      }
+      count = count - 1;
+      if((count == 0) || (index >= stop)){
+        break;
+      }
+      if(period){
+        time = time + period;
+      } else{
+        time = time + getvarint(pt, &index, stop);
+      }
+      delta = getvarint(pt, &index, stop);
+      value = value + (int32_t)((delta>>1)^(0 - (delta&1)));
+    }
+  }
+  return found;
+}
+
+//********SensorLog_Ratio*************
+// Compression achieved so far on a channel: raw size of its
+// samples (width bytes each, the time implied by the rate)
+// divided by the bytes of disk its blocks use, times 100
+// Inputs:  channel, 0 to SENSORLOG_CHANNELS-1, or
+//          SENSORLOG_CHANNELS for all channels together
+// Outputs: ratio*100, e.g. 400 means 4 to 1; 0 if no blocks yet
+uint32_t SensorLog_Ratio(uint8_t channel){
+  uint64_t raw = 0, blocks = 0;
+  uint8_t i;
+  for(i=0; i<SENSORLOG_CHANNELS; i=i+1){
+    if((channel == i) || (channel == SENSORLOG_CHANNELS)){
+      raw = raw + (uint64_t)Channels[i].samples*Channels[i].width;
+      blocks = blocks + Channels[i].blocks;
+    }
+  }
+  if(blocks == 0){
+    return 0;
+  }
+  return (raw*100)/(blocks*512);
+}
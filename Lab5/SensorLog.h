@@ -0,0 +1,113 @@
+// SensorLog.h
+// Runs on either TM4C123 or MSP432
+// Compact time-series log of sensor samples on top of the
+// file system in eFile.h.  Include eDisk.h and eFile.h first.
+// Samples are kept per channel in a 512-byte block in RAM, and
+// a block is appended to the log file when it is full.  Each
+// block holds one channel and starts with an index header,
+// so a reader can skip blocks outside a time range without
+// decoding them.
+// SensorLog_Query reads blocks in place with OS_File_Map.
+// eFileLog.c does not provide it, so build SensorLog.c with
+// SENSORLOG_MAP defined as 0 to link it with that backend;
+// blocks are then copied with OS_File_Read.
+// A channel sampled at a fixed rate is given its period with
+// SensorLog_Channel; its blocks then hold only the values, and
+// the time of each sample follows from the first time and the
+// period.  A sample off that rate (a gap or jitter) starts a
+// new block.  Other channels store a time step per sample.
+// Block format (little endian):
+//   byte  0     SENSORLOG_MAGIC
+//   byte  1     channel
+//   bytes 2-3   number of samples
+//   bytes 4-7   time of the first sample
+//   bytes 8-11  time of the last sample
+//   bytes 12-15 value of the first sample
+//   bytes 16-19 period, 0 if the time of each sample is stored
+//   bytes 20-21 number of encoded bytes that follow
+//   bytes 22-   every later sample as the zig-zag encoded
+//               change in value, preceded by the time step
+//               as a varint if the period is 0
+// A varint stores 7 bits per byte, low bits first, with bit 7
+// set on every byte but the last.  Zig-zag maps a signed
+// change to 0,-1,1,-2,2,... -> 0,1,2,3,4,... so a change of
+// -64 to 63 takes one byte and one of -8192 to 8191 two.  A
+// slowly changing sample taken at a fixed rate therefore costs
+// about 1 byte, against 2 for a raw uint16_t and 4 for a raw
+// int32_t, and a 10-bit sample such as the microphone's never
+// costs more than 2.
+
+#define SENSORLOG_CHANNELS  4       // maximum number of channels
+#define SENSORLOG_MAGIC     0xB6    // first byte of every block
+#define SENSORLOG_HEADER    22      // bytes of index header per block
+
+// statistics, cleared by SensorLog_Init
+extern uint32_t SensorLog_Samples;   // samples logged
+extern uint32_t SensorLog_Blocks;    // blocks appended to the file
+extern uint32_t SensorLog_Skipped;   // blocks SensorLog_Query did not decode
+extern uint32_t SensorLog_Decoded;   // blocks SensorLog_Query decoded
+
+//********SensorLog_Init*************
+// Start logging into a file; the blocks are appended after
+// whatever the file already holds
+// Inputs:  num, file number from OS_File_New
+// Outputs: none
+void SensorLog_Init(sectorType num);
+
+//********SensorLog_Channel*************
+// Describe a channel, after SensorLog_Init and before its
+// first sample; until then a channel has period 0 and width 4
+// Inputs:  channel, 0 to SENSORLOG_CHANNELS-1
+//          period, time between two samples, in the unit of
+//                  SensorLog_Put, or 0 if the rate is not fixed
+//          width, bytes of one raw sample, e.g. 2 for uint16_t,
+//                 used by SensorLog_Ratio
+// Outputs: 0 if successful
+// Errors:  255 on a bad channel, or a failure writing out the
+//          samples the channel already holds
+uint8_t SensorLog_Channel(uint8_t channel, uint32_t period, uint8_t width);
+
+//********SensorLog_Put*************
+// Add one sample to a channel
+// A full block is appended to the file.  A time earlier than
+// the previous sample of the channel also starts a new block,
+// because time steps are stored unsigned, and so does a time
+// that is not one period after it on a fixed-rate channel.
+// Inputs:  channel, 0 to SENSORLOG_CHANNELS-1
+//          time, time of the sample, in any unit
+//          value, the sample
+// Outputs: 0 if successful
+// Errors:  255 on a bad channel, disk full, or write failure
+uint8_t SensorLog_Put(uint8_t channel, uint32_t time, int32_t value);
+
+//********SensorLog_Sync*************
+// Append every partly filled block to the file, so all
+// samples logged so far can be read back
+// Call OS_File_Flush afterwards before removing power.
+// Inputs:  none
+// Outputs: 0 if successful
+// Errors:  255 on disk full or write failure
+uint8_t SensorLog_Sync(void);
+
+//********SensorLog_Query*************
+// Read back the samples of one channel in a time range
+// Blocks of other channels, and blocks whose header shows no
+// sample in the range, are skipped without being decoded.
+// Inputs:  num, file number of the log
+//          channel, 0 to SENSORLOG_CHANNELS-1
+//          start, first time of interest
+//          end, last time of interest
+//          sample, function called with each sample in the range,
+//                  in the order the samples were logged
+// Outputs: number of samples passed to sample
+uint32_t SensorLog_Query(sectorType num, uint8_t channel, uint32_t start, uint32_t end,
+                         void(*sample)(uint8_t channel, uint32_t time, int32_t value));
+
+//********SensorLog_Ratio*************
+// Compression achieved so far on a channel: raw size of its
+// samples (width bytes each, the time implied by the rate)
+// divided by the bytes of disk its blocks use, times 100
+// Inputs:  channel, 0 to SENSORLOG_CHANNELS-1, or
+//          SENSORLOG_CHANNELS for all channels together
+// Outputs: ratio*100, e.g. 400 means 4 to 1; 0 if no blocks yet
+uint32_t SensorLog_Ratio(uint8_t channel);
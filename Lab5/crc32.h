@@ -0,0 +1,21 @@
+// crc32.h
+// Runs on either TM4C123 or MSP432
+// CRC-32 (IEEE 802.3, reflected polynomial 0xEDB88320), the
+// same checksum used by Ethernet and zip files.
+
+//------------CRC32_Update------------
+// Add bytes to a running CRC-32.
+// Start with crc = 0xFFFFFFFF and complement the final value,
+// or use CRC32 for a single buffer.
+// Input: crc  running value
+//        buf  pointer to the bytes
+//        len  number of bytes
+// Output: updated running value
+uint32_t CRC32_Update(uint32_t crc, const uint8_t *buf, uint32_t len);
+
+//------------CRC32------------
+// Compute the CRC-32 of one buffer.
+// Input: buf  pointer to the bytes
+//        len  number of bytes
+// Output: CRC-32
+uint32_t CRC32(const uint8_t *buf, uint32_t len);
@@ -0,0 +1,188 @@
+// eCache.c
+// Runs on either TM4C123 or MSP432
+// Write-back sector cache that sits between the file system
+// (eFile) and the solid state disk driver (eDisk).
+// Each entry remembers when it was last used; the entry with
+// the oldest stamp is the one replaced on a miss.
+
+#include <stdint.h>
+#include <string.h>
+#include "eDisk.h"
+#include "eCache.h"
+
+struct centry{
+  uint32_t sector;   // disk sector held in data
+  uint8_t valid;     // nonzero if data holds a sector
+  uint8_t dirty;     // nonzero if data has not been written to disk
+  uint32_t used;     // value of Clock when last accessed
+  uint8_t data[512];
+};
+typedef struct centry centryType;
+centryType Cache[ECACHE_WAYS];
+uint32_t Clock;      // incremented on every access, for LRU
+uint32_t eCache_Hits;
+uint32_t eCache_Misses;
+uint32_t eCache_WriteBacks;
+
+// return the entry holding a sector, 0 if it is not cached
+static centryType *lookup(uint32_t sector){
+  int i;
+  for(i=0; i<ECACHE_WAYS; i=i+1){
+    if(Cache[i].valid && (Cache[i].sector == sector)){
+      return &Cache[i];
+    }
+  }
+  return 0;
+}
+
+// write a dirty entry to the disk; it stays dirty if the
+// disk reports an error, so the data is not lost
+static enum DRESULT writeback(centryType *pt){
+  enum DRESULT status = RES_OK;
+  if(pt->valid && pt->dirty){
+    status = eDisk_WriteSector(pt->data, pt->sector);
+    if(status == RES_OK){
+      pt->dirty = 0;
+      eCache_WriteBacks = eCache_WriteBacks + 1;
+    }
+  }
+  return status;
+}
+
+// Choose an entry for a new sector: an empty one if there is
+// one, otherwise the least recently used, written back first.
+// Returns 0, with the cache unchanged, if that write back fails.
+static centryType *victim(void){
+  int i;
+  centryType *pt = &Cache[0];
+  for(i=0; i<ECACHE_WAYS; i=i+1){
+    if(Cache[i].valid == 0){
+      pt = &Cache[i];
+      break;
+    }
+    if(Cache[i].used < pt->used){
+      pt = &Cache[i];
+    }
+  }
+  if(writeback(pt) != RES_OK){
+    return 0;
+  }
+  pt->valid = 0;
+  return pt;
+}
+
+//*************** eCache_ReadSector ***********
+// Read 1 sector of 512 bytes, from RAM if it is cached
+// Inputs: pointer to an empty RAM buffer
+//         sector number of disk to read: 0 to EDISK_SECTORS-1
+// Outputs: result, as eDisk_ReadSector; RES_ERROR if the
+//          sector it would replace cannot be written back
+enum DRESULT eCache_ReadSector(uint8_t *buff, uint32_t sector){
+  centryType *pt = lookup(sector);
+  if(pt){
+    eCache_Hits = eCache_Hits + 1;
+  } else{
+    eCache_Misses = eCache_Misses + 1;
+    pt = victim();
+    if((pt == 0) || (eDisk_ReadSector(pt->data, sector) != RES_OK)){
+      return RES_ERROR;
+    }
+    pt->sector = sector;
+    pt->valid = 1;
+  }
+  Clock = Clock + 1;
+  pt->used = Clock;
+  memcpy(buff, pt->data, 512);
+  return RES_OK;
+}
+
+//*************** eCache_WriteSector ***********
+// Write 1 sector of 512 bytes into the cache and mark it
+// dirty; the disk is written later
+// Inputs: pointer to RAM buffer with information
+//         sector number of disk to write: 0 to EDISK_SECTORS-1
+// Outputs: RES_OK, or RES_ERROR if the sector it would
+//          replace cannot be written back; then nothing has
+//          changed: this sector is not cached and the other
+//          one is still cached and dirty
+enum DRESULT eCache_WriteSector(const uint8_t *buff, uint32_t sector){
+  centryType *pt = lookup(sector);
+  if(pt){
+    eCache_Hits = eCache_Hits + 1;
+  } else{
+    eCache_Misses = eCache_Misses + 1;
+    pt = victim();
+    if(pt == 0){
+      return RES_ERROR;
+    }
+    pt->sector = sector;
+    pt->valid = 1;
+  }
+  Clock = Clock + 1;
+  pt->used = Clock;
+  memcpy(pt->data, buff, 512);
+  pt->dirty = 1;
+  return RES_OK;
+}
+
+//*************** eCache_Clean ***********
+// Write one sector to the disk now if it is dirty, so the
+// disk copy is current; the sector stays cached
+// Inputs: sector number of disk: 0 to EDISK_SECTORS-1
+// Outputs: result, as eDisk_WriteSector; on an error the
+//          sector stays dirty
+enum DRESULT eCache_Clean(uint32_t sector){
+  centryType *pt = lookup(sector);
+  if(pt){
+    return writeback(pt);
+  }
+  return RES_OK;
+}
+
+//*************** eCache_Flush ***********
+// Write every dirty sector to the disk, lowest sector first
+// Each sector is tried once; one that fails stays dirty.
+// Inputs: none
+// Outputs: RES_OK, or the first error reported by eDisk
+enum DRESULT eCache_Flush(void){
+  enum DRESULT status = RES_OK;
+  enum DRESULT result;
+  centryType *pt;
+  uint32_t next = 0;            // sectors below this have been tried
+  int i;
+  do{
+    pt = 0;
+    for(i=0; i<ECACHE_WAYS; i=i+1){
+      if(Cache[i].valid && Cache[i].dirty && (Cache[i].sector >= next) &&
+         ((pt == 0) || (Cache[i].sector < pt->sector))){
+        pt = &Cache[i];
+      }
+    }
+    if(pt){
+      next = pt->sector + 1;
+      result = writeback(pt);
+      if(status == RES_OK){
+        status = result;
+      }
+    }
+  } while(pt);
+  return status;
+}
+
+//*************** eCache_Invalidate ***********
+// Discard every entry, dirty or not, and clear the
+// statistics; used when the disk is formatted
+// Inputs: none
+// Outputs: none
+void eCache_Invalidate(void){
+  int i;
+  for(i=0; i<ECACHE_WAYS; i=i+1){
+    Cache[i].valid = 0;
+    Cache[i].dirty = 0;
+    Cache[i].used = 0;
+  }
+  Clock = 0;
+  eCache_Hits = 0;
+  eCache_Misses = 0;
+  eCache_WriteBacks = 0;
+}
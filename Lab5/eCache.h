@@ -0,0 +1,59 @@
+// eCache.h
+// Runs on either TM4C123 or MSP432
+// Write-back sector cache that sits between the file system
+// (eFile) and the solid state disk driver (eDisk).  The cache
+// is fully associative with ECACHE_WAYS entries of 512 bytes
+// and least-recently-used replacement.  Writes are held in
+// RAM and marked dirty; they reach the disk when the entry is
+// evicted or when eCache_Flush is called, so power must not
+// be removed until eCache_Flush (OS_File_Flush) returns.
+
+#ifndef ECACHE_WAYS
+#define ECACHE_WAYS 4         // number of sectors held in RAM
+#endif
+
+// statistics, cleared by eCache_Invalidate
+extern uint32_t eCache_Hits;       // requests served from RAM
+extern uint32_t eCache_Misses;     // requests that had to read the disk
+extern uint32_t eCache_WriteBacks; // dirty sectors written to the disk
+
+//*************** eCache_ReadSector ***********
+// Read 1 sector of 512 bytes, from RAM if it is cached
+// Inputs: pointer to an empty RAM buffer
+//         sector number of disk to read: 0 to EDISK_SECTORS-1
+// Outputs: result, as eDisk_ReadSector; RES_ERROR if the
+//          sector it would replace cannot be written back
+enum DRESULT eCache_ReadSector(uint8_t *buff, uint32_t sector);
+
+//*************** eCache_WriteSector ***********
+// Write 1 sector of 512 bytes into the cache and mark it
+// dirty; the disk is written later
+// Inputs: pointer to RAM buffer with information
+//         sector number of disk to write: 0 to EDISK_SECTORS-1
+// Outputs: RES_OK, or RES_ERROR if the sector it would
+//          replace cannot be written back; then nothing has
+//          changed: this sector is not cached and the other
+//          one is still cached and dirty
+enum DRESULT eCache_WriteSector(const uint8_t *buff, uint32_t sector);
+
+//*************** eCache_Clean ***********
+// Write one sector to the disk now if it is dirty, so the
+// disk copy is current; the sector stays cached
+// Inputs: sector number of disk: 0 to EDISK_SECTORS-1
+// Outputs: result, as eDisk_WriteSector; on an error the
+//          sector stays dirty
+enum DRESULT eCache_Clean(uint32_t sector);
+
+//*************** eCache_Flush ***********
+// Write every dirty sector to the disk, lowest sector first
+// Each sector is tried once; one that fails stays dirty.
+// Inputs: none
+// Outputs: RES_OK, or the first error reported by eDisk
+enum DRESULT eCache_Flush(void);
+
+//*************** eCache_Invalidate ***********
+// Discard every entry, dirty or not, and clear the
+// statistics; used when the disk is formatted
+// Inputs: none
+// Outputs: none
+void eCache_Invalidate(void);
@@ -33,8 +33,184 @@
  */
 
 #include <stdint.h>
+#include <string.h>
 #include "eDisk.h"
 #include "FlashProgram.h"
+#include "crc32.h"
+
+long StartCritical (void);    // previous I bit, disable interrupts
+void EndCritical(long sr);    // restore I bit to previous value
+
+#if EDISK_VERIFY
+uint32_t eDisk_VerifyErrors;
+#endif
+
+#if EDISK_CRC
+// The CRC table is a journal in one of two 2 KB halves at the
+// top of the flash.  A half starts with CRCMAGIC and a
+// generation number, then a snapshot of the CRC of every
+// sector, one word each (0xFFFFFFFF if not known), then
+// 8-byte entries:
+//   word 0  sector number in bits 15-0, its complement in bits 31-16
+//   word 1  CRC-32 of the 512 bytes of that sector
+// Every write or erase of a sector appends an entry, and the
+// last valid entry for a sector wins over the snapshot.  The
+// CRC word is programmed first, so a torn entry has no valid
+// sector word and is ignored.  When the active half is full,
+// the current CRCs are written as the snapshot of the other
+// half, whose magic number is programmed last; until then the
+// old half stays in effect.  The snapshot has a fixed size, so
+// every compaction leaves ENTRIES free entries, however many
+// sectors hold data.
+#define CRCMAGIC    0x43524365  // "eCRC"
+#define HALFSIZE    2048
+#define SNAPSHOT    8                                 // offset of the snapshot in a half
+#define JOURNAL     ((SNAPSHOT + 4*EDISK_SECTORS + 7)&~7) // offset of the first entry
+#define ENTRIES     ((HALFSIZE - JOURNAL)/8)
+#define CRCBASE     (EDISK_ADDR_MIN + 512*EDISK_SECTORS)
+#if ENTRIES < 32
+#error "EDISK_CRC needs room for 32 journal entries after the snapshot"
+#endif
+uint32_t SectorCrc[EDISK_SECTORS];
+uint32_t CrcKnown[(EDISK_SECTORS + 31)/32]; // bit set if SectorCrc is valid
+uint32_t CrcHalf;            // address of the active half
+uint32_t CrcGen;             // its generation number
+uint32_t CrcNext;            // next unused entry in the active half
+uint32_t ErasedCrc;          // CRC-32 of a sector of all 1's
+uint32_t ScrubNext;          // next sector for eDisk_Scrub
+int32_t CrcLoaded = 0;       // 0 until the journal has been read
+uint32_t eDisk_CrcErrors;
+uint32_t eDisk_BadSector;
+
+// read one little-endian 32-bit word from flash
+static uint32_t readword(uint32_t addr){
+  const uint8_t *pt = FLASH_ADDR(addr);
+  return pt[0] + (pt[1]<<8) + (pt[2]<<16) + ((uint32_t)pt[3]<<24);
+}
+
+// remember the CRC of a sector in RAM
+static void setcrc(uint32_t sector, uint32_t crc){
+  SectorCrc[sector] = crc;
+  CrcKnown[sector/32] |= 1u << (sector%32);
+}
+
+// return 1 if the CRC of a sector is known
+static int knowncrc(uint32_t sector){
+  return (CrcKnown[sector/32] & (1u << (sector%32))) != 0;
+}
+
+// Start a new generation in the other half, with a snapshot
+// of the CRC of every sector and an empty journal
+// Output: 0 if successful, 1 on flash failure
+static int compact(void){
+  uint32_t half, sector;
+  if(CrcHalf == CRCBASE){
+    half = CRCBASE + HALFSIZE;
+  } else{
+    half = CRCBASE;
+  }
+  if((Flash_Erase(half) != NOERROR) || (Flash_Erase(half + 1024) != NOERROR)){
+    return 1;
+  }
+  for(sector=0; sector<EDISK_SECTORS; sector=sector+1){
+    if(knowncrc(sector) && (SectorCrc[sector] != 0xFFFFFFFF) &&
+       (Flash_Write(half + SNAPSHOT + 4*sector, SectorCrc[sector]) != NOERROR)){
+      return 1;
+    }
+  }
+  // magic last, so a valid magic implies a complete copy
+  if((Flash_Write(half + 4, CrcGen + 1) != NOERROR) ||
+     (Flash_Write(half, CRCMAGIC) != NOERROR)){
+    return 1;
+  }
+  CrcHalf = half;
+  CrcGen = CrcGen + 1;
+  CrcNext = 0;
+  return 0;
+}
+
+// Read the CRC table from the newest valid half
+static void loadcrc(void){
+  uint32_t i, entry, word;
+  uint8_t ones = 0xFF;
+  ErasedCrc = 0xFFFFFFFF;
+  for(i=0; i<512; i=i+1){
+    ErasedCrc = CRC32_Update(ErasedCrc, &ones, 1);
+  }
+  ErasedCrc = ~ErasedCrc;
+  for(i=0; i<(EDISK_SECTORS + 31)/32; i=i+1){
+    CrcKnown[i] = 0;
+  }
+  CrcHalf = 0;
+  CrcGen = 0;
+  CrcNext = 0;
+  for(i=0; i<2; i=i+1){
+    if((readword(CRCBASE + HALFSIZE*i) == CRCMAGIC) &&
+       ((CrcHalf == 0) || (readword(CRCBASE + HALFSIZE*i + 4) > CrcGen))){
+      CrcHalf = CRCBASE + HALFSIZE*i;
+      CrcGen = readword(CrcHalf + 4);
+    }
+  }
+  CrcLoaded = 1;
+  if(CrcHalf == 0){
+    CrcHalf = CRCBASE + HALFSIZE; // no table yet, start one in the first half
+    compact();
+    return;
+  }
+  for(i=0; i<EDISK_SECTORS; i=i+1){
+    word = readword(CrcHalf + SNAPSHOT + 4*i);
+    if(word != 0xFFFFFFFF){
+      setcrc(i, word);
+    }
+  }
+  for(i=0; i<ENTRIES; i=i+1){
+    entry = CrcHalf + JOURNAL + 8*i;
+    word = readword(entry);
+    if(word != 0xFFFFFFFF){
+      CrcNext = i + 1;
+      if(((word&0xFFFF) == ((~word)>>16)) && ((word&0xFFFF) < EDISK_SECTORS)){
+        setcrc(word&0xFFFF, readword(entry + 4));
+      }
+    } else if(readword(entry + 4) != 0xFFFFFFFF){
+      CrcNext = i + 1;          // torn entry, skip it
+    }
+  }
+}
+
+// Record the new CRC of a sector in RAM and in the journal
+// Output: 0 if successful, 1 on flash failure
+static int recordcrc(uint32_t sector, uint32_t crc){
+  uint32_t entry;
+  if(CrcLoaded == 0){
+    loadcrc();
+  }
+  setcrc(sector, crc);
+  if(CrcNext >= ENTRIES){
+    return compact();           // the new value is part of the copy
+  }
+  entry = CrcHalf + JOURNAL + 8*CrcNext;
+  CrcNext = CrcNext + 1;
+  if((Flash_Write(entry + 4, crc) != NOERROR) ||
+     (Flash_Write(entry, sector|((~sector)<<16)) != NOERROR)){
+    return 1;
+  }
+  return 0;
+}
+
+// Check a sector in place against its CRC
+// Output: 0 if it matches or its CRC is not known, 1 if bad
+static int badcrc(uint32_t sector, const uint8_t *data){
+  if(CrcLoaded == 0){
+    loadcrc();
+  }
+  if(knowncrc(sector) && (CRC32(data, 512) != SectorCrc[sector])){
+    eDisk_CrcErrors = eDisk_CrcErrors + 1;
+    eDisk_BadSector = sector;
+    return 1;
+  }
+  return 0;
+}
+#endif
 
 //*************** eDisk_Init ***********
 // Initialize the interface between microcontroller and disk
@@ -57,50 +233,70 @@ enum DRESULT eDisk_Init(uint32_t drive){
 //*************** eDisk_ReadSector ***********
 // Read 1 sector of 512 bytes from the disk, data goes to RAM
 // Inputs: pointer to an empty RAM buffer
-//         sector number of disk to read: 0,1,2,...255
+//         sector number of disk to read: 0 to EDISK_SECTORS-1
 // Outputs: result
 //  RES_OK        0: Successful
-//  RES_ERROR     1: R/W Error
+//  RES_ERROR     1: R/W Error, or CRC mismatch (the data is still copied)
 //  RES_WRPRT     2: Write Protected
 //  RES_NOTRDY    3: Not Ready
 //  RES_PARERR    4: Invalid Parameter
 enum DRESULT eDisk_ReadSector(
     uint8_t *buff,     // Pointer to a RAM buffer into which to store
-    uint8_t sector){   // sector number to read from
+    uint32_t sector){  // sector number to read from
 // starting ROM address of the sector is	EDISK_ADDR_MIN + 512*sector
 // return RES_PARERR if EDISK_ADDR_MIN + 512*sector > EDISK_ADDR_MAX
 // copy 512 bytes from ROM (disk) into RAM (buff)
 // **write this function**
 
-    // Step 1: Get address pt
-    volatile uint32_t *read_address_pt;
-    read_address_pt = (volatile uint32_t *) (EDISK_ADDR_MIN + (512 * sector));
+    // Step 1: Get address
+    uint32_t read_address;
+    read_address = (uint32_t) (EDISK_ADDR_MIN + (512 * sector));
     // Test if address is out of bounds
-    if (read_address_pt > (uint32_t *) EDISK_ADDR_MAX) {
+    if ((sector >= EDISK_SECTORS) || (read_address > (uint32_t) EDISK_ADDR_MAX)) {
         return RES_PARERR;
     }
     // Step 2: Read memory contents 8bits (1 byte) at a time
-    uint8_t *read_pt = (uint8_t *)read_address_pt;
+    const uint8_t *read_pt = FLASH_ADDR(read_address);
     for (int i = 0; i < 512; i++) {
         buff[i] = *(read_pt);
         read_pt +=1;
     }
+#if EDISK_CRC
+    if (badcrc(sector, buff)) {
+        return RES_ERROR;
+    }
+#endif
     return RES_OK;
 }
 
+//*************** eDisk_Map ***********
+// Return a pointer through which a sector can be read in
+// place.  The internal flash is directly addressable, so no
+// copy is needed; the contents change only when the sector
+// is written or the disk is formatted.
+// Inputs: sector number of disk: 0 to EDISK_SECTORS-1
+// Outputs: pointer to the first of 512 bytes, 0 if the sector is invalid
+const uint8_t *eDisk_Map(uint32_t sector){
+  uint32_t address = (uint32_t) (EDISK_ADDR_MIN + (512 * sector));
+  if ((sector >= EDISK_SECTORS) || (address > (uint32_t) EDISK_ADDR_MAX)) {
+    return 0;
+  }
+  return FLASH_ADDR(address);
+}
+
 //*************** eDisk_WriteSector ***********
 // Write 1 sector of 512 bytes of data to the disk, data comes from RAM
 // Inputs: pointer to RAM buffer with information
-//         sector number of disk to write: 0,1,2,...,255
+//         sector number of disk to write: 0 to EDISK_SECTORS-1
 // Outputs: result
 //  RES_OK        0: Successful
-//  RES_ERROR     1: R/W Error
+//  RES_ERROR     1: R/W Error, or verify failure
 //  RES_WRPRT     2: Write Protected
 //  RES_NOTRDY    3: Not Ready
 //  RES_PARERR    4: Invalid Parameter
 enum DRESULT eDisk_WriteSector(
     const uint8_t *buff,  // Pointer to the data to be written
-    uint8_t sector){      // sector number
+    uint32_t sector){     // sector number
 // starting ROM address of the sector is	EDISK_ADDR_MIN + 512*sector
 // return RES_PARERR if EDISK_ADDR_MIN + 512*sector > EDISK_ADDR_MAX
 // write 512 bytes from RAM (buff) into ROM (disk)
@@ -111,44 +307,92 @@ enum DRESULT eDisk_WriteSector(
     uint32_t write_address;
     write_address = (uint32_t) (EDISK_ADDR_MIN + (512 * sector));
     // Test if address is out of bounds
-    if (write_address > (uint32_t) EDISK_ADDR_MAX) {
+    if ((sector >= EDISK_SECTORS) || (write_address > (uint32_t) EDISK_ADDR_MAX)) {
         return RES_PARERR;
     }
 
-    // Step 2: Allign 8 bit values to 32bit values to use FLASH_WriteArray()
+    // Step 2: Pack the bytes into 32-bit words; the Cortex M
+    // is little endian, so a copy gives the same words as
+    // assembling each one from four bytes
     uint32_t alligned_32bit_data[128];
-    uint32_t index_32bit = 0;
-    for (int i = 0; i < 512; i = i + 4) {
-        alligned_32bit_data[index_32bit] = 0;
-        // Byte 1
-        alligned_32bit_data[index_32bit] += buff[i+3];
-        alligned_32bit_data[index_32bit] = (alligned_32bit_data[index_32bit] << 8);
-        // Byte 2
-        alligned_32bit_data[index_32bit] += buff[i+2];
-        alligned_32bit_data[index_32bit] = (alligned_32bit_data[index_32bit] << 8);
-        // Byte 3
-        alligned_32bit_data[index_32bit] += buff[i+1];
-        alligned_32bit_data[index_32bit] = (alligned_32bit_data[index_32bit] << 8);
-        // Byte 4
-        alligned_32bit_data[index_32bit] += buff[i];
-        index_32bit++;
-    }
-    
+    memcpy(alligned_32bit_data, buff, 512);
+
     // Step 3: Write to flash
     int status;
+#if EDISK_FASTWRITE
+    // four 32-word bursts through the flash write buffer; the
+    // sector start is 512-byte aligned, so every burst is 128-byte aligned
+    int burst;
+#if EDISK_ATOMICWRITE
+    long sr = StartCritical();
+#endif
+    status = 0;
+    for (burst = 0; burst < 4; burst++) {
+        status += Flash_FastWrite(&alligned_32bit_data[32*burst], write_address + 128*burst, 32);
+    }
+#if EDISK_ATOMICWRITE
+    EndCritical(sr);
+#endif
+#else
     status = Flash_WriteArray(alligned_32bit_data, write_address, 128);
-    // Flash_Write_Array returns number of succesful writes
-    if (status == 128) {
-        return RES_OK;
-    } else {
+#endif
+    // number of succesful writes
+    if (status != 128) {
+        return RES_ERROR;
+    }
+#if EDISK_VERIFY
+    // NOR flash can only clear bits, so a sector that was not
+    // erased, or a weak bit, reads back different
+    if (memcmp(FLASH_ADDR(write_address), buff, 512) != 0) {
+        eDisk_VerifyErrors = eDisk_VerifyErrors + 1;
+        return RES_ERROR;
+    }
+#endif
+#if EDISK_CRC
+    if (recordcrc(sector, CRC32(buff, 512))) {
         return RES_ERROR;
     }
+#endif
+    return RES_OK;
+}
+
+//*************** eDisk_EraseBlock ***********
+// Erase the block of EDISK_BLOCKSECTORS sectors that holds a
+// sector, resetting it to all 1's.  On the internal flash a
+// block is 1 KB, two sectors, so the neighbor sector
+// (sector^1) is erased too.
+// Inputs: sector number of disk: 0 to EDISK_SECTORS-1
+// Outputs: result
+//  RES_OK        0: Successful
+//  RES_ERROR     1: R/W Error
+//  RES_PARERR    4: Invalid Parameter
+enum DRESULT eDisk_EraseBlock(uint32_t sector){
+  uint32_t first = sector - (sector % EDISK_BLOCKSECTORS); // first sector of the block
+  uint32_t erase_address = (uint32_t) (EDISK_ADDR_MIN + (512 * first));
+  uint32_t i;
+  if ((sector >= EDISK_SECTORS) || (erase_address > (uint32_t) EDISK_ADDR_MAX)) {
+    return RES_PARERR;
+  }
+  for (i = 0; i < 512*EDISK_BLOCKSECTORS; i = i + 1024) {  // 1 KB per Flash_Erase
+    if (Flash_Erase(erase_address + i) != NOERROR) {
+      return RES_ERROR;
+    }
+  }
+#if EDISK_CRC
+  for (i = first; i < first + EDISK_BLOCKSECTORS; i = i + 1) {
+    if (recordcrc(i, ErasedCrc)) {
+      return RES_ERROR;
+    }
+  }
+#endif
+  return RES_OK;
 }
 
 //*************** eDisk_Format ***********
 // Erase all files and all data by resetting the flash to all 1's
+// Every block is erased even if an earlier one fails.
 // Inputs: none
-// Outputs: result
+// Outputs: result, the first error if any block failed
 //  RES_OK        0: Successful
 //  RES_ERROR     1: R/W Error
 //  RES_WRPRT     2: Write Protected
@@ -157,15 +401,39 @@ enum DRESULT eDisk_WriteSector(
 enum DRESULT eDisk_Format(void){
 // erase all flash from EDISK_ADDR_MIN to EDISK_ADDR_MAX
 // **write this function**
-  int status;
+  enum DRESULT status = RES_OK;
   uint32_t erase_address = (uint32_t) EDISK_ADDR_MIN; // start of disk
+  // includes the CRC table, which starts again empty
   while(erase_address < (uint32_t) EDISK_ADDR_MAX) {
-    status = Flash_Erase(erase_address); // erase 1k block
+    if (Flash_Erase(erase_address) != NOERROR) { // erase 1k block
+      status = RES_ERROR;       // keep the first failure, but erase the rest
+    }
     erase_address = erase_address + 1024;
   }
-  if (status == RES_OK) {
-    return RES_OK;
-  } else {
-      return RES_ERROR;
+#if EDISK_CRC
+  CrcLoaded = 0;
+#endif
+  return status;
+}
+
+#if EDISK_CRC
+//*************** eDisk_Scrub ***********
+// Check the CRC of the next sectors of the disk in place,
+// continuing where the previous call stopped and wrapping
+// around at the end.  Call it from a low priority periodic
+// thread; count bounds the time taken by each call.
+// Inputs: count, number of sectors to check
+// Outputs: number of those sectors that failed
+uint32_t eDisk_Scrub(uint32_t count){
+  uint32_t bad = 0;
+  while(count > 0){
+    if(ScrubNext >= EDISK_SECTORS){
+      ScrubNext = 0;
+    }
+    bad = bad + badcrc(ScrubNext, eDisk_Map(ScrubNext));
+    ScrubNext = ScrubNext + 1;
+    count = count - 1;
   }
+  return bad;
 }
+#endif
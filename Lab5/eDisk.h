@@ -32,8 +32,71 @@
  http://users.ece.utexas.edu/~valvano/
  */
 
+// The internal flash disk is every 512-byte sector from
+// EDISK_ADDR_MIN to EDISK_ADDR_MAX.  By default it is Flash
+// Bank1; a program that fits in 64 KB can define
+// EDISK_ADDR_MIN as 0x00010000 to span both banks (384
+// sectors).  eDiskImage.c, compiled with EDISK_IMAGE
+// defined, is the same driver over a disk image file (or an
+// external SPI/SD card) of EDISK_SECTORS sectors.
+#ifndef EDISK_ADDR_MIN
 #define EDISK_ADDR_MIN      0x00020000  // Flash Bank1 minimum address
+#endif
+#ifndef EDISK_ADDR_MAX
 #define EDISK_ADDR_MAX      0x0003FFFF  // Flash Bank1 maximum address
+#endif
+
+// Geometry of the disk
+//   EDISK_SECTORS       number of 512-byte sectors, at most 65536
+//   EDISK_BLOCKSECTORS  sectors erased together by eDisk_EraseBlock
+//   EDISK_REWRITE       1 if a sector can be written again
+//                       without erasing it first, 0 for flash
+#ifdef EDISK_IMAGE
+#ifndef EDISK_SECTORS
+#define EDISK_SECTORS       65536
+#endif
+#define EDISK_BLOCKSECTORS  1
+#define EDISK_REWRITE       1
+#else
+#define EDISK_SECTORS       ((EDISK_ADDR_MAX + 1 - EDISK_ADDR_MIN)/512 - EDISK_CRCSECTORS)
+#define EDISK_BLOCKSECTORS  2
+#define EDISK_REWRITE       0
+#endif
+
+// Integrity checks of the internal flash disk
+// With EDISK_CRC 1, the CRC-32 of every sector is kept in a
+// table in the last EDISK_CRCSECTORS sectors of the flash,
+// which the file system cannot use.  eDisk_ReadSector returns
+// RES_ERROR when a sector no longer matches its CRC, and
+// eDisk_Scrub checks sectors in the background.  Sectors
+// written before the table existed are not checked.
+// With EDISK_VERIFY 1, eDisk_WriteSector reads every sector
+// back after programming it and returns RES_ERROR if any bit
+// did not take.
+#ifndef EDISK_CRC
+#define EDISK_CRC           0
+#endif
+#ifndef EDISK_VERIFY
+#define EDISK_VERIFY        0
+#endif
+#if EDISK_CRC
+#define EDISK_CRCSECTORS    8           // two copies of a 2 KB table
+#else
+#define EDISK_CRCSECTORS    0
+#endif
+
+// eDisk_WriteSector programs a sector as four 32-word bursts
+// with Flash_FastWrite when EDISK_FASTWRITE is 1, and as 128
+// single-word Flash_Write operations when it is 0.
+// Interrupts are disabled during each burst and can run
+// between bursts; set EDISK_ATOMICWRITE to 1 to keep them
+// disabled for the whole sector instead.
+#ifndef EDISK_FASTWRITE
+#define EDISK_FASTWRITE     1
+#endif
+#ifndef EDISK_ATOMICWRITE
+#define EDISK_ATOMICWRITE   0
+#endif
 
 enum DRESULT{
   RES_OK = 0,                 // Successful
@@ -54,38 +117,86 @@ enum DRESULT eDisk_Init(uint32_t drive);
 //*************** eDisk_ReadSector ***********
 // Read 1 sector of 512 bytes from the disk, data goes to RAM
 // Inputs: pointer to an empty RAM buffer
-//         sector number of disk to read: 0,1,2,...255
+//         sector number of disk to read: 0 to EDISK_SECTORS-1
 // Outputs: result
 //  RES_OK        0: Successful
-//  RES_ERROR     1: R/W Error
+//  RES_ERROR     1: R/W Error, or CRC mismatch (the data is still copied)
 //  RES_WRPRT     2: Write Protected
 //  RES_NOTRDY    3: Not Ready
 //  RES_PARERR    4: Invalid Parameter
 enum DRESULT eDisk_ReadSector(
     uint8_t *buff,     // Pointer to a RAM buffer into which to store
-    uint8_t sector);   // sector number to read from
+    uint32_t sector);  // sector number to read from
+
+//*************** eDisk_Map ***********
+// Return a pointer through which a sector can be read in
+// place.  The internal flash is directly addressable, so no
+// copy is needed; the contents change only when the sector
+// is written or the disk is formatted.  A disk image cannot
+// be read in place and always returns 0.
+// Inputs: sector number of disk: 0 to EDISK_SECTORS-1
+// Outputs: pointer to the first of 512 bytes, 0 if the sector is invalid
+//          or the disk is not directly addressable
+const uint8_t *eDisk_Map(uint32_t sector);
 
 //*************** eDisk_WriteSector ***********
 // Write 1 sector of 512 bytes of data to the disk, data comes from RAM
 // Inputs: pointer to RAM buffer with information
-//         sector number of disk to write: 0,1,2,...,255
+//         sector number of disk to write: 0 to EDISK_SECTORS-1
 // Outputs: result
 //  RES_OK        0: Successful
-//  RES_ERROR     1: R/W Error
+//  RES_ERROR     1: R/W Error, or verify failure
 //  RES_WRPRT     2: Write Protected
 //  RES_NOTRDY    3: Not Ready
 //  RES_PARERR    4: Invalid Parameter
 enum DRESULT eDisk_WriteSector(
     const uint8_t *buff,  // Pointer to the data to be written
-    uint8_t sector);      // sector number
+    uint32_t sector);     // sector number
+
+//*************** eDisk_EraseBlock ***********
+// Erase the block of EDISK_BLOCKSECTORS sectors that holds a
+// sector, resetting it to all 1's.  On the internal flash a
+// block is 1 KB, two sectors, so the neighbor sector
+// (sector^1) is erased too.
+// Inputs: sector number of disk: 0 to EDISK_SECTORS-1
+// Outputs: result
+//  RES_OK        0: Successful
+//  RES_ERROR     1: R/W Error
+//  RES_PARERR    4: Invalid Parameter
+enum DRESULT eDisk_EraseBlock(uint32_t sector);
 
 //*************** eDisk_Format ***********
 // Erase all files and all data by resetting the flash to all 1's
+// Every block is erased even if an earlier one fails.
 // Inputs: none
-// Outputs: result
+// Outputs: result, the first error if any block failed
 //  RES_OK        0: Successful
 //  RES_ERROR     1: R/W Error
 //  RES_WRPRT     2: Write Protected
 //  RES_NOTRDY    3: Not Ready
 //  RES_PARERR    4: Invalid Parameter
 enum DRESULT eDisk_Format(void);
+
+#if EDISK_VERIFY
+extern uint32_t eDisk_VerifyErrors; // writes that did not read back correctly
+#endif
+
+#if EDISK_CRC
+extern uint32_t eDisk_CrcErrors;    // reads and scrubs that found a CRC mismatch
+extern uint32_t eDisk_BadSector;    // sector of the most recent mismatch
+
+//*************** eDisk_Scrub ***********
+// Check the CRC of the next sectors of the disk in place,
+// continuing where the previous call stopped and wrapping
+// around at the end.  Call it from a low priority periodic
+// thread; count bounds the time taken by each call.
+// Inputs: count, number of sectors to check
+// Outputs: number of those sectors that failed
+uint32_t eDisk_Scrub(uint32_t count);
+#endif
+
+#ifdef EDISK_IMAGE
+// name of the disk image file opened by eDisk_Init; it is
+// created, fully erased, if it does not exist
+extern const char *eDisk_ImageName;
+#endif
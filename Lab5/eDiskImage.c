@@ -0,0 +1,152 @@
+// eDiskImage.c
+// Runs on a host computer (Linux, Windows, Mac)
+// Solid state disk driver that keeps the disk in a file, so
+// the file system can be run and inspected on a computer
+// with disks much larger than the internal flash.  Compile
+// eFile.c and eCache.c with EDISK_IMAGE defined and link this
+// file in place of eDisk.c; the image is EDISK_SECTORS
+// sectors of 512 bytes, and sector n is at byte 512*n.
+// An external SPI or SD card driver fits the same functions:
+// a card rewrites a sector in place, so it also has
+// EDISK_REWRITE 1 and EDISK_BLOCKSECTORS 1.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "eDisk.h"
+
+const char *eDisk_ImageName = "eDisk.img";
+FILE *Image;                  // open image, 0 before eDisk_Init
+
+// Set count sectors starting at sector to all 1's, the state
+// of an erased flash, so a new image looks like a new disk
+static enum DRESULT erasesectors(uint32_t sector, uint32_t count){
+  uint8_t buff[512];
+  memset(buff, 0xFF, 512);
+  if(fseek(Image, 512*(long)sector, SEEK_SET) != 0){
+    return RES_ERROR;
+  }
+  while(count > 0){
+    if(fwrite(buff, 1, 512, Image) != 512){
+      return RES_ERROR;
+    }
+    count = count - 1;
+  }
+  return (fflush(Image) == 0) ? RES_OK : RES_ERROR;
+}
+
+//*************** eDisk_Init ***********
+// Open the disk image named by eDisk_ImageName, creating an
+// erased image if the file does not exist
+// Inputs: drive number (only drive 0 is supported)
+// Outputs: status
+//  RES_OK        0: Successful
+//  RES_ERROR     1: Drive not initialized
+enum DRESULT eDisk_Init(uint32_t drive){
+  if(drive != 0){
+    return RES_ERROR;
+  }
+  if(Image){
+    return RES_OK;
+  }
+  Image = fopen(eDisk_ImageName, "r+b");
+  if(Image == 0){
+    Image = fopen(eDisk_ImageName, "w+b");
+    if((Image == 0) || (erasesectors(0, EDISK_SECTORS) != RES_OK)){
+      return RES_ERROR;
+    }
+  }
+  return RES_OK;
+}
+
+//*************** eDisk_ReadSector ***********
+// Read 1 sector of 512 bytes from the disk, data goes to RAM
+// Inputs: pointer to an empty RAM buffer
+//         sector number of disk to read: 0 to EDISK_SECTORS-1
+// Outputs: result
+//  RES_OK        0: Successful
+//  RES_ERROR     1: R/W Error
+//  RES_NOTRDY    3: Not Ready
+//  RES_PARERR    4: Invalid Parameter
+enum DRESULT eDisk_ReadSector(
+    uint8_t *buff,     // Pointer to a RAM buffer into which to store
+    uint32_t sector){  // sector number to read from
+  if(Image == 0){
+    return RES_NOTRDY;
+  }
+  if(sector >= EDISK_SECTORS){
+    return RES_PARERR;
+  }
+  if((fseek(Image, 512*(long)sector, SEEK_SET) != 0) ||
+     (fread(buff, 1, 512, Image) != 512)){
+    return RES_ERROR;
+  }
+  return RES_OK;
+}
+
+//*************** eDisk_Map ***********
+// A disk image cannot be read in place
+// Inputs: sector number of disk: 0 to EDISK_SECTORS-1
+// Outputs: 0
+const uint8_t *eDisk_Map(uint32_t sector){
+  return 0;
+}
+
+//*************** eDisk_WriteSector ***********
+// Write 1 sector of 512 bytes of data to the disk, data comes from RAM
+// The sector is replaced, whatever it held before.
+// Inputs: pointer to RAM buffer with information
+//         sector number of disk to write: 0 to EDISK_SECTORS-1
+// Outputs: result
+//  RES_OK        0: Successful
+//  RES_ERROR     1: R/W Error
+//  RES_NOTRDY    3: Not Ready
+//  RES_PARERR    4: Invalid Parameter
+enum DRESULT eDisk_WriteSector(
+    const uint8_t *buff,  // Pointer to the data to be written
+    uint32_t sector){     // sector number
+  if(Image == 0){
+    return RES_NOTRDY;
+  }
+  if(sector >= EDISK_SECTORS){
+    return RES_PARERR;
+  }
+  if((fseek(Image, 512*(long)sector, SEEK_SET) != 0) ||
+     (fwrite(buff, 1, 512, Image) != 512) ||
+     (fflush(Image) != 0)){
+    return RES_ERROR;
+  }
+  return RES_OK;
+}
+
+//*************** eDisk_EraseBlock ***********
+// Reset one sector to all 1's
+// Inputs: sector number of disk: 0 to EDISK_SECTORS-1
+// Outputs: result
+//  RES_OK        0: Successful
+//  RES_ERROR     1: R/W Error
+//  RES_NOTRDY    3: Not Ready
+//  RES_PARERR    4: Invalid Parameter
+enum DRESULT eDisk_EraseBlock(uint32_t sector){
+  if(Image == 0){
+    return RES_NOTRDY;
+  }
+  if(sector >= EDISK_SECTORS){
+    return RES_PARERR;
+  }
+  return erasesectors(sector, 1);
+}
+
+//*************** eDisk_Format ***********
+// Erase all files and all data by resetting the image to all 1's
+// Inputs: none
+// Outputs: result
+//  RES_OK        0: Successful
+//  RES_ERROR     1: R/W Error
+//  RES_NOTRDY    3: Not Ready
+enum DRESULT eDisk_Format(void){
+  if(Image == 0){
+    return RES_NOTRDY;
+  }
+  return erasesectors(0, EDISK_SECTORS);
+}
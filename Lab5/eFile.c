@@ -4,40 +4,360 @@
 // Daniel and Jonathan Valvano
 // August 29, 2016
 #include <stdint.h>
+#include <string.h>
 #include "eDisk.h"
+#include "eCache.h"
+#define EFILE_LAYOUT            // the on-disk layout in eFile.h
+#include "eFile.h"
+#include "crc32.h"
+
+#define FREEWORDS   ((EDISK_SECTORS + 31)/32)
 
 uint8_t Buff[512]; // temporary buffer used during file I/O
-uint8_t Directory[256], FAT[256];
+sectorType Directory[EFILE_FILES + 1], FAT[EDISK_SECTORS];
 int32_t bDirectoryLoaded =0; // 0 means disk on ROM is complete, 1 means RAM version active
+int32_t bDirectoryDirty = 0; // 1 means Directory or FAT changed since the last flush
+uint32_t MetaSlot;    // slot holding the newest copy, NOSLOT if neither is valid
+uint32_t MetaSeq;     // sequence number of that copy
+uint32_t FreeMap[FREEWORDS]; // bit n of FreeMap[n/32] is 1 if sector n is erased and unused
+sectorType NextFree;  // where the search for a free sector starts
+// per-file metadata kept in RAM, Directory[num] is the head
+sectorType Tail[EFILE_FILES + 1];   // last sector of each file, EFILE_NONE if empty
+sectorType Length[EFILE_FILES + 1]; // number of sectors in each file
+// sparse skip index: every SKIPSTRIDE-th sector of every
+// file, sorted by file and then location, so the entries of
+// a file are found by binary search and its k-th entry is
+// its sector at location SKIPSTRIDE*k
+#define SKIPSTRIDE 16
+#define SKIPS      (DATASECTORS/SKIPSTRIDE)
+sectorType SkipFile[SKIPS], SkipSector[SKIPS];
+uint32_t Skips;       // number of entries used
+// name table, entries 0 to NameCount-1 are in use, and an
+// open-addressed hash index of it, NAMEBUCKETS a power of 2
+// with at least one bucket always empty, every probe ends
+#define NAMEBUCKETS 64
+#define NOBUCKET    255
+#if EFILE_NAMES >= NAMEBUCKETS
+#error "EFILE_NAMES must be less than NAMEBUCKETS"
+#endif
+char Names[EFILE_NAMES][EFILE_NAMELEN];
+sectorType NameFile[EFILE_NAMES]; // file number of each name
+uint8_t NameHash[NAMEBUCKETS];    // index into Names, NOBUCKET if empty
+uint32_t NameCount;
+uint32_t NamedMap[(EFILE_FILES + 32)/32]; // bit n set if file n has a name
+
+// Mark a sector as allocated in the free-sector bitmap.
+void usesector(uint32_t n){
+    FreeMap[n/32] &= ~(1u << (n%32));
+}
+
+// Return 1 if a sector is still marked free in the bitmap.
+int freesector(uint32_t n){
+    return (FreeMap[n/32] & (1u << (n%32))) != 0;
+}
+
+// Return 1 if the sector has never been written since the
+// last format, i.e. every byte still reads 0xFF.
+int erasedsector(uint32_t n, uint8_t buff[512]){
+    int i;
+    eDisk_ReadSector(buff, n);
+    for (i = 0; i < 512; i++) {
+        if (buff[i] != 0xFF) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Return the index of the first skip entry of a file, or of
+// the next file up if it has none, by binary search.
+uint32_t skipsearch(uint32_t num){
+    uint32_t lo = 0, hi = Skips, mid;
+    while (lo < hi) {
+        mid = (lo + hi)/2;
+        if (SkipFile[mid] < num) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+// Add a sector to the per-file metadata after it has been
+// linked to the end of a file.  A new skip entry goes after
+// the other entries of its file; on a mount the files are
+// added in order, so nothing has to move.
+void addsector(uint32_t num, sectorType sector){
+    uint32_t i;
+    Tail[num] = sector;
+    if ((Length[num] > 0) && ((Length[num] % SKIPSTRIDE) == 0) && (Skips < SKIPS)) {
+        i = skipsearch(num + 1);
+        memmove(&SkipFile[i + 1], &SkipFile[i], (Skips - i)*sizeof(sectorType));
+        memmove(&SkipSector[i + 1], &SkipSector[i], (Skips - i)*sizeof(sectorType));
+        SkipFile[i] = num;
+        SkipSector[i] = sector;
+        Skips++;
+    }
+    Length[num]++;
+}
+
+// Rebuild the free-sector bitmap and the per-file metadata
+// from Directory and FAT, validating every chain.
+// A chain is cut at the first link that points outside the
+// data sectors or at a sector some chain already uses (a
+// cycle or a cross-link).  Every link that is followed marks
+// one more sector used, so the whole walk takes at most
+// DATASECTORS steps however corrupt the FAT is.
+// A sector is free if no file uses it and, on flash, it is
+// still erased; a sector written by an append whose FAT
+// update was never flushed is not in any chain, but flash
+// cannot write it again until the disk is formatted.
+void buildfreemap(uint8_t buff[512]){
+    uint32_t i;
+    sectorType sector, prev;
+    for (i = 0; i < FREEWORDS; i++) {
+        FreeMap[i] = 0xFFFFFFFF;
+    }
+    for (i = DATASECTORS; i < FREEWORDS*32; i++) {
+        usesector(i);           // directory and FAT slots
+    }
+    Skips = 0;
+    for (i = 0; i < EFILE_FILES; i++) {
+        Tail[i] = EFILE_NONE;
+        Length[i] = 0;
+        sector = Directory[i];
+        prev = EFILE_NONE;
+        while (sector != EFILE_NONE) {
+            if ((sector >= DATASECTORS) || (freesector(sector) == 0)) {
+                if (prev == EFILE_NONE) {
+                    Directory[i] = EFILE_NONE;
+                } else {
+                    FAT[prev] = EFILE_NONE;
+                }
+                bDirectoryDirty = 1;
+                break;
+            }
+            usesector(sector);
+            addsector(i, sector);
+            prev = sector;
+            sector = FAT[sector];
+        }
+    }
+#if EDISK_REWRITE == 0
+    for (i = 0; i < DATASECTORS; i++) {
+        if (freesector(i) && (erasedsector(i, buff) == 0)) {
+            usesector(i);
+        }
+    }
+#endif
+    NextFree = 0;
+}
+
+// Read a 32-bit little-endian number from a buffer.
+uint32_t getword(const uint8_t *pt){
+    return pt[0] + (pt[1] << 8) + (pt[2] << 16) + ((uint32_t)pt[3] << 24);
+}
+
+// Store a 32-bit little-endian number into a buffer.
+void putword(uint8_t *pt, uint32_t value){
+    pt[0] = value;
+    pt[1] = value >> 8;
+    pt[2] = value >> 16;
+    pt[3] = value >> 24;
+}
+
+// Return a pointer to entry e of the metadata, which is
+// Directory followed by FAT.
+sectorType *metaentry(uint32_t e){
+    if (e <= EFILE_FILES) {
+        return &Directory[e];
+    }
+    return &FAT[e - (EFILE_FILES + 1)];
+}
+
+// Copy the bytes of metadata sector k of a slot out of the
+// RAM Directory and FAT; bytes past the end read 0xFF.
+void packmeta(uint32_t k, uint8_t buff[512]){
+    int j;
+    uint32_t i;
+    for (j = 0; j < 512; j++) {
+        i = 512*k + j;
+        if (i < METABYTES) {
+            buff[j] = *metaentry(i/ENTRYSIZE) >> (8*(i%ENTRYSIZE));
+        } else {
+            buff[j] = 0xFF;
+        }
+    }
+}
+
+// Copy metadata sector k of a slot into the RAM Directory
+// and FAT.
+void unpackmeta(uint32_t k, const uint8_t buff[512]){
+    int j;
+    uint32_t i, shift;
+    sectorType *pt;
+    for (j = 0; (j < 512) && ((512*k + j) < METABYTES); j++) {
+        i = 512*k + j;
+        pt = metaentry(i/ENTRYSIZE);
+        shift = 8*(i%ENTRYSIZE);
+        *pt = (*pt & ~(0xFF << shift)) | (buff[j] << shift);
+    }
+}
+
+// Check one directory slot.  Returns 1 and its sequence
+// number if the commit record is present, was written for
+// this geometry, and the CRC of the metadata sectors and
+// name table matches, 0 otherwise.
+int readslot(uint32_t slot, uint8_t buff[512], uint32_t *seq){
+    uint32_t crc, run, k;
+    if ((eDisk_ReadSector(buff, slot + METASECTORS) != RES_OK) ||
+        (getword(&buff[0]) != METAMAGIC) ||
+        (getword(&buff[SB_SECTORSIZE]) != 512) ||
+        (getword(&buff[SB_SECTORS]) != EDISK_SECTORS) ||
+        (getword(&buff[SB_ENTRYSIZE]) != ENTRYSIZE) ||
+        (getword(&buff[SB_FILES]) != EFILE_FILES) ||
+        (getword(&buff[SB_METASECTORS]) != METASECTORS) ||
+        (getword(&buff[SB_NAMEGEOMETRY]) != (EFILE_NAMES + 65536*EFILE_NAMELEN))) {
+        return 0;
+    }
+    *seq = getword(&buff[4]);
+    crc = getword(&buff[8]);
+    run = 0xFFFFFFFF;
+    for (k = 0; k < METASECTORS; k++) {
+        if (eDisk_ReadSector(buff, slot + k) != RES_OK) {
+            return 0;
+        }
+        run = CRC32_Update(run, buff, 512);
+    }
+    if (eDisk_ReadSector(buff, slot + METASECTORS) != RES_OK) {
+        return 0;
+    }
+    run = CRC32_Update(run, &buff[SB_NAMES], NAMEBYTES);
+    return ~run == crc;
+}
+
+// FNV-1a hash of a name, reduced to a bucket of NameHash.
+uint32_t namehash(const char *name){
+    uint32_t hash = 2166136261u;
+    while (*name) {
+        hash = (hash ^ (uint8_t)*name) * 16777619u;
+        name++;
+    }
+    return hash & (NAMEBUCKETS - 1);
+}
+
+// Return the index of a name in the name table, probing the
+// hash index from its bucket; EFILE_NAMES if it is absent.
+uint32_t findname(const char *name){
+    uint32_t b = namehash(name);
+    while (NameHash[b] != NOBUCKET) {
+        if (strncmp(Names[NameHash[b]], name, EFILE_NAMELEN) == 0) {
+            return NameHash[b];
+        }
+        b = (b + 1) & (NAMEBUCKETS - 1);
+    }
+    return EFILE_NAMES;
+}
+
+// Add entry i of the name table to the hash index and the
+// map of named files.
+void indexname(uint32_t i){
+    uint32_t b = namehash(Names[i]);
+    while (NameHash[b] != NOBUCKET) {
+        b = (b + 1) & (NAMEBUCKETS - 1);
+    }
+    NameHash[b] = i;
+    NamedMap[NameFile[i]/32] |= 1u << (NameFile[i]%32);
+}
+
+// Return 1 if a file has a name.
+int namedfile(uint32_t num){
+    return (NamedMap[num/32] & (1u << (num%32))) != 0;
+}
+
+// Rebuild the name table and its index from a commit
+// record, or empty them if buff is 0.
+void loadnames(const uint8_t *buff){
+    uint32_t i, k;
+    const uint8_t *pt;
+    for (i = 0; i < NAMEBUCKETS; i++) {
+        NameHash[i] = NOBUCKET;
+    }
+    for (i = 0; i < (EFILE_FILES + 32)/32; i++) {
+        NamedMap[i] = 0;
+    }
+    NameCount = 0;
+    for (i = 0; (buff != 0) && (i < EFILE_NAMES); i++) {
+        pt = &buff[SB_NAMES + NAMEENTRY*i];
+        NameFile[i] = 0;
+        for (k = 0; k < ENTRYSIZE; k++) {
+            NameFile[i] |= pt[k] << (8*k);
+        }
+        if (NameFile[i] >= EFILE_FILES) {
+            break;              // end of the table
+        }
+        memcpy(Names[i], &pt[ENTRYSIZE], EFILE_NAMELEN);
+        Names[i][EFILE_NAMELEN - 1] = 0;
+        indexname(i);
+        NameCount++;
+    }
+}
 
-// Return the larger of two integers.
-int16_t max(int16_t a, int16_t b){
-  if(a > b){
-    return a;
-  }
-  return b;
+// Copy the name table into a commit record; unused entries
+// stay 0xFF.
+void storenames(uint8_t buff[512]){
+    uint32_t i, k;
+    uint8_t *pt;
+    for (i = 0; i < NameCount; i++) {
+        pt = &buff[SB_NAMES + NAMEENTRY*i];
+        for (k = 0; k < ENTRYSIZE; k++) {
+            pt[k] = NameFile[i] >> (8*k);
+        }
+        memcpy(&pt[ENTRYSIZE], Names[i], EFILE_NAMELEN);
+    }
 }
+
 //*****MountDirectory******
 // if directory and FAT are not loaded in RAM,
 // bring it into RAM from disk
 void MountDirectory(void){ 
 // if bDirectoryLoaded is 0, 
-//    read disk sector 255 and populate Directory and FAT
+//    read the newest valid slot and populate Directory and FAT
 //    set bDirectoryLoaded=1
 // if bDirectoryLoaded is 1, simply return
 // **write this function**
-    int i;
+    uint32_t i;
+    uint32_t seq;
     uint8_t buff[512];
     if (bDirectoryLoaded == 0) {
-        eDisk_ReadSector (buff, 255);
-        // Get Directory
-        for (i = 0; i< 256; i++) {
-            Directory[i] = buff[i];
+        // Pick the newest valid copy
+        MetaSlot = NOSLOT;
+        MetaSeq = 0;
+        if (readslot(SLOTA, buff, &seq)) {
+            MetaSlot = SLOTA;
+            MetaSeq = seq;
+        }
+        if (readslot(SLOTB, buff, &seq) && ((MetaSlot == NOSLOT) || (seq > MetaSeq))) {
+            MetaSlot = SLOTB;
+            MetaSeq = seq;
         }
-        // Get FAT
-        for (i = 256; i < 512 ; i++) {
-            FAT[i - 256] = buff[i];
+        // Get Directory and FAT
+        for (i = 0; i < METASECTORS; i++) {
+            if ((MetaSlot == NOSLOT) || (eDisk_ReadSector(buff, MetaSlot + i) != RES_OK)) {
+                memset(buff, 0xFF, 512);  // no valid copy, empty disk
+            }
+            unpackmeta(i, buff);
+        }
+        // Get the names
+        if ((MetaSlot != NOSLOT) && (eDisk_ReadSector(buff, MetaSlot + METASECTORS) == RES_OK)) {
+            loadnames(buff);
+        } else {
+            loadnames(0);
         }
+        bDirectoryDirty = 0;
+        // Find the free sectors once, appends keep it current
+        buildfreemap(buff);
         // Set bDirectoryLoaded
         bDirectoryLoaded = 1;
     }
@@ -45,72 +365,45 @@ void MountDirectory(void){
 }
 
 
-// Return the index of the last sector in the file
-// associated with a given starting sector.
-// Note: This function will loop forever without returning
-// if the file has no end (i.e. the FAT is corrupted).
-uint8_t lastsector(uint8_t start){
-// **write this function**
-    uint8_t index_value;
-    uint8_t current_index;
-    if (start == 255) {
-      return 255;
-    } else {
-      current_index = start;
-      while (1) {
-          index_value = FAT[current_index];
-          if (index_value == 255) {
-              return current_index;
-          } else {
-              current_index = index_value;
-          }
-      }
-    }
-}
-
-// Return the index of the first free sector.
-// Note: This function will loop forever without returning
-// if a file has no end or if (Directory[255] != 255)
-// (i.e. the FAT is corrupted).
-uint8_t findfreesector(void){
-// **write this function**
-    int free_sector = -1;
-    uint8_t index = 0;
-    uint8_t last_sector;
-    while (1) {
-        last_sector = lastsector(Directory[index]);
-        if (last_sector == 255) { // no more files or no files in Directory
-            // free sector is the next one after the greatest last sector
-            return free_sector + 1; 
-        } else {
-            free_sector = max(free_sector, last_sector);
-            index++;
+// Return the index of a free sector, searching the bitmap
+// from NextFree and wrapping around, so the cost is at most
+// FREEWORDS words no matter how many sectors are in use.
+// Returns EFILE_NONE if the disk is full.
+sectorType findfreesector(void){
+    uint32_t i, n, w;
+    uint32_t word;
+    uint32_t start = NextFree / 32;
+    for (i = 0; i <= FREEWORDS; i++) {
+        w = (start + i) % FREEWORDS;
+        word = FreeMap[w];
+        if (i == 0) {
+            word &= 0xFFFFFFFF << (NextFree % 32); // skip below NextFree
+        }
+        if (word != 0) {
+            n = 0;
+            while ((word & 1) == 0) {
+                word >>= 1;
+                n++;
+            }
+            return w * 32 + n;
         }
     }
+    return EFILE_NONE;
 }
 
 // Append a sector index 'n' at the end of file 'num'.
 // This helper function is part of OS_File_Append(), which
 // should have already verified that there is free space,
 // so it always returns 0 (successful).
-// Note: This function will loop forever without returning
-// if the file has no end (i.e. the FAT is corrupted).
-uint8_t appendfat(uint8_t num, uint8_t n){
-// **write this function**
-    uint8_t index;
-    index = Directory[num];
-    if (index == 255){
+// The tail is kept in RAM, so this takes constant time.
+uint8_t appendfat(sectorType num, sectorType n){
+    if (Tail[num] == EFILE_NONE){
         Directory[num] = n; // this is the first sector of a new file
     } else {
-        while (1) {
-            if (FAT[index] == 255) {
-                FAT[index] = n; // append sector number to end
-                return 0;
-            } else {
-                index = FAT[index]; // keep searching for end
-            }
-        }
+        FAT[Tail[num]] = n; // append sector number to end
     }
+    addsector(num, n);
+    bDirectoryDirty = 1;
     return 0; // success
 }
 
@@ -118,91 +411,203 @@ uint8_t appendfat(uint8_t num, uint8_t n){
 // Returns a file number of a new file for writing
 // Inputs: none
 // Outputs: number of a new file
-// Errors: return 255 on failure or disk full
-uint8_t OS_File_New(void){
+// Errors: return EFILE_NONE on failure or disk full
+sectorType OS_File_New(void){
 // **write this function**
-    uint8_t index = 0;
+    sectorType index = 0;
     if (bDirectoryLoaded == 0) {
         MountDirectory();
     }
-    while (index != 255) { // go through Directory and find a free space
-        if (Directory[index] == 255) {
+    while (index < EFILE_FILES) { // go through Directory and find a free space
+        if ((Directory[index] == EFILE_NONE) && (namedfile(index) == 0)) {
             return index;
         } else {
             index++;
         }
     }
-    return 255; // disk is full
+    return EFILE_NONE; // disk is full
+}
+
+//********OS_File_Open*************
+// Returns the file number of a named file, creating an
+// empty file with that name if there is none.  The name is
+// kept on the disk by the next OS_File_Flush.
+// Inputs:  name, 1 to EFILE_NAMELEN-1 characters
+// Outputs: file number, 0 to EFILE_FILES-1
+// Errors:  EFILE_NONE if the name is empty or too long, or if
+//          a new file is needed and the name table or
+//          directory is full
+sectorType OS_File_Open(const char *name){
+    uint32_t i, n;
+    sectorType num;
+    n = strlen(name);
+    if ((n == 0) || (n >= EFILE_NAMELEN)) {
+        return EFILE_NONE;
+    }
+    if (bDirectoryLoaded == 0) {
+        MountDirectory();
+    }
+    i = findname(name);
+    if (i < EFILE_NAMES) {
+        return NameFile[i];
+    }
+    if (NameCount == EFILE_NAMES) {
+        return EFILE_NONE;
+    }
+    num = OS_File_New();
+    if (num == EFILE_NONE) {
+        return EFILE_NONE;
+    }
+    i = NameCount;
+    NameCount++;
+    NameFile[i] = num;
+    memset(Names[i], 0, EFILE_NAMELEN);
+    memcpy(Names[i], name, n);
+    indexname(i);
+    bDirectoryDirty = 1;
+    return num;
 }
 
 //********OS_File_Size*************
 // Check the size of this file
-// Inputs:  num, 8-bit file number, 0 to 254
+// Inputs:  num, file number, 0 to EFILE_FILES-1
 // Outputs: 0 if empty, otherwise the number of sectors
 // Errors:  none
-uint8_t OS_File_Size(uint8_t num){
-// **write this function**
-    uint8_t index;
-    uint8_t size = 0;
-    if (Directory[num] == 255) {
-        return 0; // this is a new file
-    } else {
-        index = Directory[num]; // start of file
-        while (size < 255) {
-            size++;
-            if (FAT[index] == 255) { //eof
-                return size;
-            } else {                 // continue
-                index = FAT[index];
-            }
-        }
+sectorType OS_File_Size(sectorType num){
+    if (bDirectoryLoaded == 0) {
+        MountDirectory();
     }
-    return 255;
+    return Length[num];
 }
 
 //********OS_File_Append*************
 // Save 512 bytes into the file
-// Inputs:  num, 8-bit file number, 0 to 254
+// Inputs:  num, file number, 0 to EFILE_FILES-1
 //          buf, pointer to 512 bytes of data
 // Outputs: 0 if successful
 // Errors:  255 on failure or disk full
-uint8_t OS_File_Append(uint8_t num, uint8_t buf[512]){
+uint8_t OS_File_Append(sectorType num, uint8_t buf[512]){
 // **write this function**
     if (bDirectoryLoaded == 0) {
         MountDirectory();
     }
-    uint8_t sector = findfreesector();
-    if (sector == 255) {
+    sectorType sector = findfreesector();
+    if (sector == EFILE_NONE) {
         return 255;
-    } else {
-        eDisk_WriteSector(buf, sector);
-        appendfat(num, sector);
-        return 0;
     }
+    // the sector is taken only once the cache holds its data;
+    // a failed write leaves it untouched, so it stays free
+    if (eCache_WriteSector(buf, sector) != RES_OK) {
+        return 255;
+    }
+    usesector(sector);
+    NextFree = sector + 1;
+    appendfat(num, sector);
+    return 0;
+}
+
+// Return the disk sector holding a location of a file,
+// EFILE_NONE if the file is not that long.  The nearest skip
+// entry at or before location is found by binary search,
+// then at most SKIPSTRIDE-1 links are followed.
+sectorType findsector(sectorType num, sectorType location){
+    sectorType sector;
+    uint32_t i, k, n;
+    if (bDirectoryLoaded == 0) {
+        MountDirectory();
+    }
+    if (location >= Length[num]){
+        return EFILE_NONE;
+    }
+    sector = Directory[num];
+    k = location / SKIPSTRIDE;
+    i = skipsearch(num);
+    n = skipsearch(num + 1) - i;    // entries of this file
+    if (k > n){
+        k = n;                      // only if the index filled up
+    }
+    if (k > 0){
+        sector = SkipSector[i + k - 1];
+    }
+    for (i = SKIPSTRIDE*k; i < location; i++){
+        sector = FAT[sector];
+    }
+    return sector;
 }
 
 //********OS_File_Read*************
 // Read 512 bytes from the file
-// Inputs:  num, 8-bit file number, 0 to 254
-//          location, logical address, 0 to 254
+// Inputs:  num, file number, 0 to EFILE_FILES-1
+//          location, logical address, 0 to size-1
 //          buf, pointer to 512 empty spaces in RAM
 // Outputs: 0 if successful
 // Errors:  255 on failure because no data
-uint8_t OS_File_Read(uint8_t num, uint8_t location,
+uint8_t OS_File_Read(sectorType num, sectorType location,
                      uint8_t buf[512]){
-// **write this function**
-    uint8_t sector; 
-    sector = Directory[num];
-    if (sector == 255){
+    sectorType sector = findsector(num, location);
+    if (sector == EFILE_NONE){
         return 255;
     }
-    for (int i = 0; i < location; i++){
-        sector = FAT[sector];
-        if(sector == 255){
-            return 255;
-        }
+    return eCache_ReadSector(buf, sector);
+}
+
+// Return a pointer to a sector in place on the disk, after
+// making sure any newer copy in the cache has been written.
+const uint8_t *mapsector(sectorType sector){
+    if (eCache_Clean(sector) != RES_OK){
+        return 0;
     }
-    return eDisk_ReadSector(buf, sector);
+    return eDisk_Map(sector);
+}
+
+//********OS_File_Map*************
+// Read 512 bytes from the file in place, without copying
+// The pointer is into the disk itself and stays valid until
+// the disk is formatted.
+// Inputs:  num, file number, 0 to EFILE_FILES-1
+//          location, logical address, 0 to size-1
+// Outputs: pointer to the 512 bytes of data
+// Errors:  0 on failure because no data, or if the disk
+//          cannot be read in place
+const uint8_t *OS_File_Map(sectorType num, sectorType location){
+    sectorType sector = findsector(num, location);
+    if (sector == EFILE_NONE){
+        return 0;
+    }
+    return mapsector(sector);
+}
+
+//********OS_File_First*************
+// Start an in-place walk over the sectors of a file
+// Inputs:  num, file number, 0 to EFILE_FILES-1
+//          it, iterator to initialize
+// Outputs: pointer to the 512 bytes at location 0
+// Errors:  0 if the file is empty
+const uint8_t *OS_File_First(sectorType num, struct fileiter *it){
+    it->num = num;
+    it->location = 0;
+    it->sector = findsector(num, 0);
+    if (it->sector == EFILE_NONE){
+        return 0;
+    }
+    return mapsector(it->sector);
+}
+
+//********OS_File_Next*************
+// Move an in-place walk to the next sector of the file
+// Each step follows one FAT link, so a whole file is walked
+// in time proportional to its size.
+// Inputs:  it, iterator set up by OS_File_First
+// Outputs: pointer to the 512 bytes at the next location
+// Errors:  0 at the end of the file
+const uint8_t *OS_File_Next(struct fileiter *it){
+    if ((it->sector == EFILE_NONE) || ((it->location + 1) >= Length[it->num])){
+        it->sector = EFILE_NONE;
+        return 0;
+    }
+    it->location++;
+    it->sector = FAT[it->sector];
+    return mapsector(it->sector);
 }
 
 //********OS_File_Flush*************
@@ -213,16 +618,62 @@ uint8_t OS_File_Read(uint8_t num, uint8_t location,
 // Errors:  255 on disk write failure
 uint8_t OS_File_Flush(void){
 // **write this function**
-    int i;
+    uint32_t k;
     int status;
+    uint32_t slot;
+    uint32_t crc;
     uint8_t buff[512];
-    for (i = 0; i < 256; i++) {
-        buff[i] = Directory[i];
+    // data sectors first, so the directory on disk never
+    // points at a sector that is still only in the cache
+    status = eCache_Flush();
+    if ((status != RES_OK) || (bDirectoryDirty == 0)) {
+        return status;
+    }
+    // overwrite the older slot; the newest one stays valid
+    // until the commit record below has been written
+    if (MetaSlot == SLOTA) {
+        slot = SLOTB;
+    } else {
+        slot = SLOTA;
+    }
+#if EDISK_REWRITE == 0
+    for (k = 0; k < SLOTSECTORS; k = k + EDISK_BLOCKSECTORS) {
+        status = eDisk_EraseBlock(slot + k);
+        if (status != RES_OK) {
+            return status;
+        }
+    }
+#endif
+    // on media that rewrite in place the old commit record
+    // stays until the new one replaces it, but the CRC no
+    // longer matches once any metadata sector has changed
+    crc = 0xFFFFFFFF;
+    for (k = 0; k < METASECTORS; k++) {
+        packmeta(k, buff);
+        crc = CRC32_Update(crc, buff, 512);
+        status = eDisk_WriteSector(buff, slot + k);
+        if (status != RES_OK) {
+            return status;
+        }
     }
-    for (i = 256; i < 512; i++) {
-        buff[i] = FAT[i - 256];
+    memset(buff, 0xFF, 512);
+    storenames(buff);
+    crc = CRC32_Update(crc, &buff[SB_NAMES], NAMEBYTES);
+    putword(&buff[0], METAMAGIC);
+    putword(&buff[4], MetaSeq + 1);
+    putword(&buff[8], ~crc);
+    putword(&buff[SB_SECTORSIZE], 512);
+    putword(&buff[SB_SECTORS], EDISK_SECTORS);
+    putword(&buff[SB_ENTRYSIZE], ENTRYSIZE);
+    putword(&buff[SB_FILES], EFILE_FILES);
+    putword(&buff[SB_METASECTORS], METASECTORS);
+    putword(&buff[SB_NAMEGEOMETRY], EFILE_NAMES + 65536*EFILE_NAMELEN);
+    status = eDisk_WriteSector(buff, slot + METASECTORS);
+    if (status == RES_OK) {
+        MetaSlot = slot;
+        MetaSeq = MetaSeq + 1;
+        bDirectoryDirty = 0;
     }
-    status = eDisk_WriteSector(buff, 255);
     return status;
 }
 
@@ -236,6 +687,7 @@ uint8_t OS_File_Format(void){
 // clear bDirectoryLoaded to zero
 // **write this function**
     int status;
+    eCache_Invalidate();
     status = eDisk_Format();
     bDirectoryLoaded = 0;
     return status; // replace this line
@@ -4,39 +4,163 @@
 // Daniel and Jonathan Valvano
 // August 29, 2016
 
+// The width of the on-disk format follows the size of the
+// disk in eDisk.h, which must be included first.  Disks of up
+// to 256 sectors (the 128 KB internal flash) use 8-bit
+// Directory and FAT entries and 255 files; larger disks,
+// such as both flash banks or a disk image, use 16-bit
+// entries for up to 65536 sectors and EFILE_FILES files.
+// EFILE_NONE marks an empty file or the end of a chain.
+#if EDISK_SECTORS > 256
+typedef uint16_t sectorType;
+#define EFILE_NONE   0xFFFF
+#ifndef EFILE_FILES
+#define EFILE_FILES  1023     // file numbers 0 to EFILE_FILES-1
+#endif
+#else
+typedef uint8_t sectorType;
+#define EFILE_NONE   255
+#define EFILE_FILES  255
+#endif
+
+// Up to EFILE_NAMES files can also have a name, kept with the
+// directory on the disk and found through a hash index.
+#ifndef EFILE_NAMES
+#define EFILE_NAMES    32     // most named files
+#endif
+#define EFILE_NAMELEN  12     // bytes per name, including the terminating 0
+
+// The on-disk layout, shared by eFile.c and the host tools that
+// read a disk image; define EFILE_LAYOUT before including
+// eFile.h to get it.
+#ifdef EFILE_LAYOUT
+// The last sectors of the disk hold two copies (slots) of
+// Directory and FAT, each slot in its own flash erase blocks,
+// so one copy can be erased and rewritten while the other
+// stays intact.  A slot is METASECTORS sectors of metadata
+// followed by one commit record:
+//   metadata  Directory[EFILE_FILES+1] then FAT[EDISK_SECTORS],
+//             each entry sizeof(sectorType) bytes, little endian
+//   commit    METAMAGIC, sequence number, CRC-32 of the
+//             metadata sectors and the name table, the
+//             geometry (superblock), then the name table
+// The commit record is written last, and mount uses the valid
+// slot with the highest sequence number, so losing power
+// during OS_File_Flush leaves the previous copy in effect.
+// On the 128 KB internal flash this is one sector of
+// metadata: sectors 252-253 and 254-255 are the slots and
+// sectors 0 to 251 hold file data.
+#if EDISK_SECTORS > 256
+#define ENTRYSIZE   2           // bytes of a sectorType
+#else
+#define ENTRYSIZE   1
+#endif
+#define METABYTES   (ENTRYSIZE*(EFILE_FILES + 1 + EDISK_SECTORS))
+#define METASECTORS ((METABYTES + 511)/512)
+#define SLOTSECTORS (((METASECTORS + EDISK_BLOCKSECTORS)/EDISK_BLOCKSECTORS)*EDISK_BLOCKSECTORS)
+#define SLOTB       (EDISK_SECTORS - SLOTSECTORS)
+#define SLOTA       (SLOTB - SLOTSECTORS)
+#define DATASECTORS SLOTA       // sectors 0 to DATASECTORS-1 hold file data
+#define METAMAGIC   0x54414665  // "eFAT"
+#define NOSLOT      0xFFFFFFFF
+
+// Superblock fields of the commit record, byte offsets.  A
+// slot written for a different geometry is not valid, so a
+// disk image must be formatted before it is used with
+// another configuration.
+#define SB_SECTORSIZE  12     // 512
+#define SB_SECTORS     16     // EDISK_SECTORS
+#define SB_ENTRYSIZE   20     // 1 or 2 bytes per Directory/FAT entry
+#define SB_FILES       24     // EFILE_FILES
+#define SB_METASECTORS 28     // METASECTORS
+#define SB_NAMEGEOMETRY 32    // EFILE_NAMES + 65536*EFILE_NAMELEN
+#define SB_NAMES       36     // name table, EFILE_NAMES entries of
+                              // file number then name
+#define NAMEENTRY      (ENTRYSIZE + EFILE_NAMELEN)
+#define NAMEBYTES      (EFILE_NAMES*NAMEENTRY)
+#if (SB_NAMES + NAMEBYTES) > 512
+#error "the name table must fit in the commit record"
+#endif
+#endif
 
 //********OS_File_New*************
 // Returns a file number of a new file for writing
 // Inputs: none
 // Outputs: number of a new file
-// Errors: return 255 on failure or disk full
-uint8_t OS_File_New(void);
+// Errors: return EFILE_NONE on failure or disk full
+sectorType OS_File_New(void);
+
+//********OS_File_Open*************
+// Returns the file number of a named file, creating an
+// empty file with that name if there is none.  The name is
+// kept on the disk by the next OS_File_Flush.
+// Inputs:  name, 1 to EFILE_NAMELEN-1 characters
+// Outputs: file number, 0 to EFILE_FILES-1
+// Errors:  EFILE_NONE if the name is empty or too long, or if
+//          a new file is needed and the name table or
+//          directory is full
+sectorType OS_File_Open(const char *name);
 
 //********OS_File_Size*************
 // Check the size of this file
-// Inputs:  num, 8-bit file number, 0 to 254
+// Inputs:  num, file number, 0 to EFILE_FILES-1
 // Outputs: 0 if empty, otherwise the number of sectors
 // Errors:  none
-uint8_t OS_File_Size(uint8_t num);
+sectorType OS_File_Size(sectorType num);
 
 //********OS_File_Append*************
 // Save 512 bytes into the file
-// Inputs:  num, 8-bit file number, 0 to 254
+// Inputs:  num, file number, 0 to EFILE_FILES-1
 //          buf, pointer to 512 bytes of data
 // Outputs: 0 if successful
 // Errors:  255 on failure or disk full
-uint8_t OS_File_Append(uint8_t num, uint8_t buf[512]);
+uint8_t OS_File_Append(sectorType num, uint8_t buf[512]);
 
 //********OS_File_Read*************
 // Read 512 bytes from the file
-// Inputs:  num, 8-bit file number, 0 to 254
-//          location, logical address, 0 to 254
+// Inputs:  num, file number, 0 to EFILE_FILES-1
+//          location, logical address, 0 to size-1
 //          buf, pointer to 512 empty spaces in RAM
 // Outputs: 0 if successful
 // Errors:  255 on failure because no data
-uint8_t OS_File_Read(uint8_t num, uint8_t location,
+uint8_t OS_File_Read(sectorType num, sectorType location,
                      uint8_t buf[512]);
 
+//********OS_File_Map*************
+// Read 512 bytes from the file in place, without copying
+// The pointer is into the disk itself and stays valid until
+// the disk is formatted.
+// Inputs:  num, file number, 0 to EFILE_FILES-1
+//          location, logical address, 0 to size-1
+// Outputs: pointer to the 512 bytes of data
+// Errors:  0 on failure because no data, or if the disk
+//          cannot be read in place
+const uint8_t *OS_File_Map(sectorType num, sectorType location);
+
+// Position of an in-place walk over the sectors of a file
+struct fileiter{
+  sectorType num;       // file number
+  sectorType location;  // logical address of the current sector
+  sectorType sector;    // disk sector of the current sector
+};
+
+//********OS_File_First*************
+// Start an in-place walk over the sectors of a file
+// Inputs:  num, file number, 0 to EFILE_FILES-1
+//          it, iterator to initialize
+// Outputs: pointer to the 512 bytes at location 0
+// Errors:  0 if the file is empty
+const uint8_t *OS_File_First(sectorType num, struct fileiter *it);
+
+//********OS_File_Next*************
+// Move an in-place walk to the next sector of the file
+// Each step follows one FAT link, so a whole file is walked
+// in time proportional to its size.
+// Inputs:  it, iterator set up by OS_File_First
+// Outputs: pointer to the 512 bytes at the next location
+// Errors:  0 at the end of the file
+const uint8_t *OS_File_Next(struct fileiter *it);
+
 //********OS_File_Flush*************
 // Update working buffers onto the disk
 // Power can be removed after calling flush
@@ -0,0 +1,797 @@
+// eFileLog.c
+// Runs on either TM4C123 or MSP432
+// Log-structured, wear-levelling implementation of the file
+// system in eFile.h.  Link this file instead of eFile.c.
+//
+// Flash layout: 128 blocks of 1 KB.  Each block starts with
+// a 16-byte header followed by 1008 bytes of log space.
+//   word 0  LOGMAGIC, written after every erase
+//   word 1  number of times this block has been erased
+//   word 2  log sequence number, 0xFFFFFFFF while unused,
+//           0 once the block has been retired from the log
+//   word 3  offset of the first record that starts here
+// Records are appended back to back in sequence order and a
+// record may continue into the next block of the log.
+//   data record    4-byte header, then 512 bytes of data
+//   delete record  4-byte header only
+// The header is programmed after the data, so a record with
+// a valid header is always complete.
+
+#include <stdint.h>
+#include "eDisk.h"
+#include "eFile.h"
+#include "eFileLog.h"
+#include "FlashProgram.h"
+
+#if EDISK_SECTORS != 256
+#error "eFileLog.c needs the 128 KB internal flash disk (256 sectors)"
+#endif
+
+#define BLOCKS       128          // number of 1 KB erase blocks on the disk
+#define BLOCKSIZE    1024         // bytes in one erase block
+#define HEADERSIZE   16           // bytes of block header
+#define DATASIZE     (BLOCKSIZE-HEADERSIZE)  // bytes of log space per block
+#define RECORDSIZE   (4+512)      // bytes in one data record
+#define LOGMAGIC     0x474F4C65   // "eLOG"
+#define ERASED       0xFFFFFFFF   // value of an unprogrammed word
+#define RETIRED      0            // sequence number of a block removed from the log
+#define DATARECORD   0xDA
+#define DELETERECORD 0xDE
+#define GCTHRESHOLD  4            // keep at least this many free blocks
+// most data records the disk will hold; the slack of a few
+// blocks guarantees that collection always finds garbage
+#define MAXRECORDS   (((BLOCKS-GCTHRESHOLD-2)*DATASIZE)/RECORDSIZE)
+
+#define RECORDBLOCKS 2            // most blocks one record can start or continue in
+
+#define FREEBLOCK    0            // erased and holding only the magic and erase count
+#define DIRTYBLOCK   1            // not in the log, needs erasing before reuse
+#define LOGBLOCK     2            // part of the log
+
+uint8_t Buff[512];           // temporary buffer used during file I/O
+// the mapping is kept in RAM the same way eFile.c does it:
+// Directory[file] is the first slot of a file, FAT[slot] is
+// the next slot, and Where[slot] is the flash address of the
+// record that holds the data for that slot
+uint8_t Directory[256], FAT[256];
+uint32_t Where[256];
+uint8_t Size[256];           // number of sectors in each file
+uint8_t Last[256];           // last slot of each file
+uint8_t Location[256];       // sector number within its file of each slot
+uint8_t FreeSlot;            // list of unused slots, linked through FAT
+uint32_t Records;            // number of live data records
+int32_t bDirectoryLoaded = 0; // 0 means the log has not been replayed
+
+uint8_t BlockState[BLOCKS];
+uint32_t EraseCount[BLOCKS];
+uint8_t LogQueue[BLOCKS];    // blocks of the log, oldest first, circular
+uint8_t LogPos[BLOCKS];      // index of each log block in LogQueue
+uint32_t LogTail, LogCount;  // oldest entry and number of entries in LogQueue
+uint32_t FreeBlocks;         // number of FREEBLOCK and DIRTYBLOCK blocks
+uint32_t HeadOffset;         // next free byte in the log space of the head block
+uint32_t NextSeq;            // sequence number for the next head block
+static uint8_t CopyBuff[512]; // data being moved by the garbage collector
+
+// With EFILE_BACKGROUND 1, erasing and garbage collection are
+// done by OS_File_Maintain in a low priority thread, and the
+// functions below share the log through Lab4 kernel
+// semaphores.  With EFILE_BACKGROUND 0 they run inline and
+// no kernel is needed.
+#if EFILE_BACKGROUND
+void OS_Wait(int32_t *semaPt);
+void OS_Signal(int32_t *semaPt);
+#define EFILE_WAIT(semaPt)   OS_Wait(semaPt)
+#define EFILE_SIGNAL(semaPt) OS_Signal(semaPt)
+#else
+#define EFILE_WAIT(semaPt)
+#define EFILE_SIGNAL(semaPt)
+#endif
+int32_t FileLock = 1;        // mutual exclusion over all of the state above
+int32_t FileSpace = 0;       // signaled by maintenance when space may be available
+int32_t FileWork = 0;        // signaled by appends when maintenance has work
+uint32_t Waiters;            // number of threads blocked on FileSpace
+int32_t Stalled;             // 1 if maintenance could not make space
+
+// flash address of the start of a block
+static uint32_t blockaddr(uint8_t b){
+  return EDISK_ADDR_MIN + BLOCKSIZE*b;
+}
+
+// read one little-endian 32-bit word from flash
+static uint32_t readword(uint32_t addr){
+  const uint8_t *pt = FLASH_ADDR(addr);
+  return pt[0] + (pt[1]<<8) + (pt[2]<<16) + ((uint32_t)pt[3]<<24);
+}
+
+// return 1 if every byte in the range is still erased
+static int iserased(uint32_t addr, uint32_t len){
+  const uint8_t *pt = FLASH_ADDR(addr);
+  uint32_t i;
+  for(i=0; i<len; i=i+1){
+    if(pt[i] != 0xFF){
+      return 0;
+    }
+  }
+  return 1;
+}
+
+// build a record header; the check byte catches torn or
+// random words that are neither erased nor a real header
+static uint32_t recordheader(uint8_t type, uint8_t num, uint8_t location){
+  uint8_t check = type^num^location^0x5A;
+  return type + (num<<8) + (location<<16) + ((uint32_t)check<<24);
+}
+
+// return 1 if the word is a well-formed record header
+static int validheader(uint32_t header){
+  uint8_t type = header&0xFF;
+  if((type != DATARECORD) && (type != DELETERECORD)){
+    return 0;
+  }
+  return (recordheader(type, (header>>8)&0xFF, (header>>16)&0xFF) == header);
+}
+
+// program len bytes (a multiple of 4) from RAM into flash
+// Output: 0 if successful, 1 on write failure
+static int writebytes(uint32_t addr, const uint8_t *buf, uint32_t len){
+  uint32_t words[32];
+  uint32_t i, n;
+  while(len > 0){
+    n = len/4;
+    if(n > 32){
+      n = 32;
+    }
+    for(i=0; i<n; i=i+1){
+      words[i] = buf[4*i] + (buf[4*i+1]<<8) + (buf[4*i+2]<<16) + ((uint32_t)buf[4*i+3]<<24);
+    }
+    if(Flash_WriteArray(words, addr, n) != (int)n){
+      return 1;
+    }
+    addr = addr + 4*n;
+    buf = buf + 4*n;
+    len = len - 4*n;
+  }
+  return 0;
+}
+
+// the block that follows b in the log
+static uint8_t nextblock(uint8_t b){
+  return LogQueue[(LogPos[b] + 1)%BLOCKS];
+}
+
+// the block currently being appended to
+static uint8_t headblock(void){
+  return LogQueue[(LogTail + LogCount - 1)%BLOCKS];
+}
+
+// Erase a block, keeping its erase count in the header
+// Output: 0 if successful, 1 on flash failure
+static int eraseblock(uint8_t b){
+  uint32_t count = EraseCount[b];
+  if(readword(blockaddr(b)) == LOGMAGIC){
+    count = readword(blockaddr(b) + 4);
+  }
+  count = count + 1;
+  EraseCount[b] = count;
+  BlockState[b] = DIRTYBLOCK;
+  if(Flash_Erase(blockaddr(b)) != NOERROR){
+    return 1;
+  }
+  // count first, so a valid magic implies a valid count
+  if((Flash_Write(blockaddr(b) + 4, count) != NOERROR) ||
+     (Flash_Write(blockaddr(b), LOGMAGIC) != NOERROR)){
+    return 1;
+  }
+  BlockState[b] = FREEBLOCK;
+  return 0;
+}
+
+// Make the least-worn free block the new head of the log
+// Input:  first, log offset where the first new record will start
+// Output: 0 if successful, 1 if no block could be opened
+static int openblock(uint32_t first){
+  uint8_t b, best = 0;
+  uint32_t bestcount = ERASED;
+  for(b=0; b<BLOCKS; b=b+1){
+#if EFILE_BACKGROUND
+    if((BlockState[b] == FREEBLOCK) && (EraseCount[b] < bestcount)){
+#else
+    if((BlockState[b] != LOGBLOCK) && (EraseCount[b] < bestcount)){
+#endif
+      best = b;
+      bestcount = EraseCount[b];
+    }
+  }
+  if(bestcount == ERASED){
+    return 1;                   // no free blocks
+  }
+  if((BlockState[best] == DIRTYBLOCK) && eraseblock(best)){
+    return 1;
+  }
+  // first offset before sequence, so a valid sequence implies a valid offset
+  if((Flash_Write(blockaddr(best) + 12, first) != NOERROR) ||
+     (Flash_Write(blockaddr(best) + 8, NextSeq) != NOERROR)){
+    BlockState[best] = DIRTYBLOCK;
+    return 1;
+  }
+  NextSeq = NextSeq + 1;
+  BlockState[best] = LOGBLOCK;
+  FreeBlocks = FreeBlocks - 1;
+  LogPos[best] = (LogTail + LogCount)%BLOCKS;
+  LogQueue[LogPos[best]] = best;
+  LogCount = LogCount + 1;
+  HeadOffset = first;
+  return 0;
+}
+
+// Append one record to the log
+// HeadOffset moves past the record only once all of it has
+// been programmed.  After a failure the bytes at the head may
+// be partly programmed, so the head block is closed, as mount
+// does when it finds them, and the next record starts a new
+// block.
+// Inputs:  type, DATARECORD or DELETERECORD
+//          num, file number
+//          location, sector within the file
+//          buf, 512 bytes of data for a DATARECORD
+// Outputs: flash address of the record header, 0 on failure
+static uint32_t writerecord(uint8_t type, uint8_t num, uint8_t location, const uint8_t *buf){
+  uint32_t header, part1;
+  uint32_t need = 0;
+  uint32_t offset = HeadOffset;
+  int newhead = 0;
+  if((LogCount == 0) || ((offset + 4) > DATASIZE)){
+    newhead = 1;                // header goes in a new block
+    need = 1;
+    offset = 0;
+  }
+  if((type == DATARECORD) && ((offset + RECORDSIZE) > DATASIZE)){
+    need = need + 1;            // data continues into a new block
+  }
+  if(need > FreeBlocks){
+    return 0;
+  }
+  if(newhead && openblock(0)){
+    return 0;
+  }
+  header = blockaddr(headblock()) + HEADERSIZE + HeadOffset;
+  offset = HeadOffset + 4;
+  if(type == DATARECORD){
+    part1 = DATASIZE - offset;
+    if(part1 >= 512){
+      if(writebytes(header + 4, buf, 512)){
+        HeadOffset = DATASIZE;
+        return 0;
+      }
+      offset = offset + 512;
+    } else{
+      // openblock leaves HeadOffset at the end of the data
+      if(writebytes(header + 4, buf, part1) || openblock(512 - part1) ||
+         writebytes(blockaddr(headblock()) + HEADERSIZE, buf + part1, 512 - part1)){
+        HeadOffset = DATASIZE;
+        return 0;
+      }
+      offset = HeadOffset;
+    }
+  }
+  if(Flash_Write(header, recordheader(type, num, location)) != NOERROR){
+    HeadOffset = DATASIZE;
+    return 0;
+  }
+  HeadOffset = offset;
+  return header;
+}
+
+// copy the 512 data bytes of the record at addr into buf
+static void readrecord(uint32_t addr, uint8_t *buf){
+  uint8_t b = (addr - EDISK_ADDR_MIN)/BLOCKSIZE;
+  uint32_t offset = addr + 4 - blockaddr(b) - HEADERSIZE;
+  uint32_t part1 = DATASIZE - offset;
+  const uint8_t *pt = FLASH_ADDR(addr + 4);
+  uint32_t i;
+  if(part1 > 512){
+    part1 = 512;
+  }
+  for(i=0; i<part1; i=i+1){
+    buf[i] = pt[i];
+  }
+  if(part1 < 512){
+    pt = FLASH_ADDR(blockaddr(nextblock(b)) + HEADERSIZE);
+    for(i=part1; i<512; i=i+1){
+      buf[i] = pt[i-part1];
+    }
+  }
+}
+
+// return the slot holding a location of a file, 255 if none
+static uint8_t findslot(uint8_t num, uint8_t location){
+  uint8_t slot;
+  if(location >= Size[num]){
+    return 255;
+  }
+  slot = Directory[num];
+  while(location > 0){
+    slot = FAT[slot];
+    location = location - 1;
+  }
+  return slot;
+}
+
+// Record that a location of a file is stored at addr.  A
+// location already in the file has been moved by the garbage
+// collector.  During a mount, copies made by the collector
+// can arrive out of order, so new locations are inserted in
+// order rather than always added at the end.
+// Output: 0 if successful, 1 if out of slots
+static int mapdata(uint8_t num, uint8_t location, uint32_t addr){
+  uint8_t slot, prev = 255, next = 255;
+  if(location == 255){
+    return 1;
+  }
+  if(Size[num] > 0){
+    if(Location[Last[num]] < location){
+      prev = Last[num];         // the usual case, add at the end
+    } else{
+      next = Directory[num];
+      while((next != 255) && (Location[next] < location)){
+        prev = next;
+        next = FAT[next];
+      }
+      if((next != 255) && (Location[next] == location)){
+        Where[next] = addr;
+        return 0;
+      }
+    }
+  }
+  if(FreeSlot == 255){
+    return 1;
+  }
+  slot = FreeSlot;
+  FreeSlot = FAT[slot];
+  Location[slot] = location;
+  Where[slot] = addr;
+  FAT[slot] = next;
+  if(prev == 255){
+    Directory[num] = slot;
+  } else{
+    FAT[prev] = slot;
+  }
+  if(next == 255){
+    Last[num] = slot;
+  }
+  Size[num] = Size[num] + 1;
+  Records = Records + 1;
+  return 0;
+}
+
+// Release a chain of slots
+static void freeslots(uint8_t slot){
+  uint8_t next;
+  while(slot != 255){
+    next = FAT[slot];
+    FAT[slot] = FreeSlot;
+    FreeSlot = slot;
+    slot = next;
+    Records = Records - 1;
+  }
+}
+
+// After a mount, cut a file at the first missing location
+// so that location n is always the n-th slot of the chain
+static void trimfile(uint8_t num){
+  uint8_t slot = Directory[num];
+  uint8_t n = 0;
+  if((slot == 255) || (Location[slot] != 0)){
+    freeslots(slot);
+    Directory[num] = 255;
+    Size[num] = 0;
+    return;
+  }
+  while((FAT[slot] != 255) && (Location[FAT[slot]] == (n + 1))){
+    slot = FAT[slot];
+    n = n + 1;
+  }
+  freeslots(FAT[slot]);
+  FAT[slot] = 255;
+  Last[num] = slot;
+  Size[num] = n + 1;
+}
+
+// Forget every location of a file and release its slots
+static void mapdelete(uint8_t num){
+  freeslots(Directory[num]);
+  Directory[num] = 255;
+  Size[num] = 0;
+}
+
+// Replay the records that start in block b
+// Output: log offset just past the last record found
+static uint32_t replayblock(uint8_t b){
+  uint32_t offset = readword(blockaddr(b) + 12);
+  uint32_t header;
+  if(offset > DATASIZE){
+    return DATASIZE;
+  }
+  while((offset + 4) <= DATASIZE){
+    header = readword(blockaddr(b) + HEADERSIZE + offset);
+    if(header == ERASED){
+      return offset;
+    }
+    if(validheader(header) == 0){
+      return DATASIZE;          // corrupt, ignore the rest of this block
+    }
+    if((header&0xFF) == DATARECORD){
+      mapdata((header>>8)&0xFF, (header>>16)&0xFF, blockaddr(b) + HEADERSIZE + offset);
+      offset = offset + RECORDSIZE;
+    } else{
+      mapdelete((header>>8)&0xFF);
+      offset = offset + 4;
+    }
+  }
+  return DATASIZE;
+}
+
+//*****MountDirectory******
+// if the mapping is not loaded in RAM,
+// rebuild it by replaying the log from flash
+void MountDirectory(void){
+  uint32_t seq[BLOCKS];
+  uint32_t i, j, n;
+  uint8_t b;
+  if(bDirectoryLoaded){
+    return;
+  }
+  for(i=0; i<256; i=i+1){
+    Directory[i] = 255;
+    FAT[i] = i + 1;             // every slot starts on the free list
+    Size[i] = 0;
+  }
+  FAT[254] = 255;               // slot 255 is never used
+  FreeSlot = 0;
+  Records = 0;
+  FreeBlocks = 0;
+  LogTail = 0;
+  n = 0;
+  for(b=0; b<BLOCKS; b=b+1){
+    if(readword(blockaddr(b)) == LOGMAGIC){
+      EraseCount[b] = readword(blockaddr(b) + 4);
+      if(readword(blockaddr(b) + 8) == RETIRED){
+        BlockState[b] = DIRTYBLOCK;
+        FreeBlocks = FreeBlocks + 1;
+      } else if(readword(blockaddr(b) + 8) != ERASED){
+        // insertion sort into sequence order
+        i = n;
+        while((i > 0) && (seq[i-1] > readword(blockaddr(b) + 8))){
+          seq[i] = seq[i-1];
+          LogQueue[i] = LogQueue[i-1];
+          i = i - 1;
+        }
+        seq[i] = readword(blockaddr(b) + 8);
+        LogQueue[i] = b;
+        n = n + 1;
+        BlockState[b] = LOGBLOCK;
+      } else{
+        BlockState[b] = FREEBLOCK;
+        FreeBlocks = FreeBlocks + 1;
+      }
+    } else{
+      EraseCount[b] = 0;        // never formatted or erase was interrupted
+      BlockState[b] = DIRTYBLOCK;
+      FreeBlocks = FreeBlocks + 1;
+    }
+  }
+  LogCount = n;
+  NextSeq = RETIRED + 1;
+  HeadOffset = DATASIZE;
+  for(j=0; j<n; j=j+1){
+    LogPos[LogQueue[j]] = j;
+  }
+  for(j=0; j<n; j=j+1){
+    HeadOffset = replayblock(LogQueue[j]);
+  }
+  for(i=0; i<255; i=i+1){
+    trimfile(i);
+  }
+  if(n > 0){
+    NextSeq = seq[n-1] + 1;
+    // power lost in the middle of a record leaves programmed
+    // bytes after the last header; never write over them
+    if((HeadOffset < DATASIZE) &&
+       !iserased(blockaddr(LogQueue[n-1]) + HEADERSIZE + HeadOffset, DATASIZE - HeadOffset)){
+      HeadOffset = DATASIZE;
+    }
+  }
+  bDirectoryLoaded = 1;
+}
+
+// Reclaim the oldest block of the log: copy its live
+// records to the head, then release it.
+// Output: 0 if successful, 1 if nothing could be reclaimed
+static int collect(void){
+  uint8_t tail, num, location, slot;
+  uint32_t offset, header, addr;
+  if(LogCount <= 1){
+    return 1;
+  }
+  tail = LogQueue[LogTail];
+  offset = readword(blockaddr(tail) + 12);
+  while((offset + 4) <= DATASIZE){
+    addr = blockaddr(tail) + HEADERSIZE + offset;
+    header = readword(addr);
+    if((header == ERASED) || (validheader(header) == 0)){
+      break;
+    }
+    if((header&0xFF) == DATARECORD){
+      num = (header>>8)&0xFF;
+      location = (header>>16)&0xFF;
+      slot = findslot(num, location);
+      if((slot != 255) && (Where[slot] == addr)){
+        readrecord(addr, CopyBuff);
+        addr = writerecord(DATARECORD, num, location, CopyBuff);
+        if(addr == 0){
+          return 1;
+        }
+        Where[slot] = addr;
+      }
+      offset = offset + RECORDSIZE;
+    } else{
+      offset = offset + 4;      // delete records are never live here
+    }
+  }
+  // mark the block retired so a later mount does not replay
+  // records whose delete records may already be gone
+  if(Flash_Write(blockaddr(tail) + 8, RETIRED) != NOERROR){
+    return 1;
+  }
+  LogTail = (LogTail + 1)%BLOCKS;
+  LogCount = LogCount - 1;
+  BlockState[tail] = DIRTYBLOCK;
+  FreeBlocks = FreeBlocks + 1;
+  return 0;
+}
+
+#if EFILE_BACKGROUND
+// number of blocks already erased and ready for the log
+static uint32_t erasedblocks(void){
+  uint8_t b;
+  uint32_t n = 0;
+  for(b=0; b<BLOCKS; b=b+1){
+    if(BlockState[b] == FREEBLOCK){
+      n = n + 1;
+    }
+  }
+  return n;
+}
+
+// 1 if a block needs erasing or collecting
+static int needwork(void){
+  return (erasedblocks() < FreeBlocks) || (FreeBlocks < GCTHRESHOLD);
+}
+
+// Wait until there are erased blocks for one record, with
+// enough free blocks left over for the collector to run.
+// Called and returns with FileLock held.
+// Output: 0 if there is space, 1 if none can be made
+static int makespace(void){
+  Stalled = 0;
+  while((FreeBlocks < GCTHRESHOLD) || (erasedblocks() < RECORDBLOCKS)){
+    if(Stalled){
+      return 1;
+    }
+    Waiters = Waiters + 1;
+    EFILE_SIGNAL(&FileWork);
+    EFILE_SIGNAL(&FileLock);
+    EFILE_WAIT(&FileSpace);
+    EFILE_WAIT(&FileLock);
+  }
+  return 0;
+}
+#else
+// Garbage collect until enough free blocks are available
+// Output: always 0, a full disk is found by writerecord
+static int makespace(void){
+  uint32_t tries = 0;
+  while((FreeBlocks < GCTHRESHOLD) && (tries < BLOCKS)){
+    if(collect()){
+      return 0;
+    }
+    tries = tries + 1;
+  }
+  return 0;
+}
+#endif
+
+//********OS_File_New*************
+// Returns a file number of a new file for writing
+// Inputs: none
+// Outputs: number of a new file
+// Errors: return 255 on failure or disk full
+uint8_t OS_File_New(void){
+  uint8_t index = 0;
+  EFILE_WAIT(&FileLock);
+  MountDirectory();
+  while((index != 255) && (Directory[index] != 255)){
+    index++;                    // go through Directory and find a free space
+  }
+  EFILE_SIGNAL(&FileLock);
+  return index;                 // 255 if the disk is full
+}
+
+//********OS_File_Size*************
+// Check the size of this file
+// Inputs:  num, 8-bit file number, 0 to 254
+// Outputs: 0 if empty, otherwise the number of sectors
+// Errors:  none
+uint8_t OS_File_Size(uint8_t num){
+  uint8_t size;
+  EFILE_WAIT(&FileLock);
+  MountDirectory();
+  size = Size[num];
+  EFILE_SIGNAL(&FileLock);
+  return size;
+}
+
+//********OS_File_Append*************
+// Save 512 bytes into the file
+// Inputs:  num, 8-bit file number, 0 to 254
+//          buf, pointer to 512 bytes of data
+// Outputs: 0 if successful
+// Errors:  255 on failure or disk full
+uint8_t OS_File_Append(uint8_t num, uint8_t buf[512]){
+  uint32_t addr;
+  uint8_t status = 255;
+  EFILE_WAIT(&FileLock);
+  MountDirectory();
+  if((num != 255) && (Size[num] != 255) && (Records < MAXRECORDS) && (makespace() == 0)){
+    addr = writerecord(DATARECORD, num, Size[num], buf);
+    if((addr != 0) && (mapdata(num, Size[num], addr) == 0)){
+      status = 0;
+    }
+  }
+#if EFILE_BACKGROUND
+  if(needwork()){
+    EFILE_SIGNAL(&FileWork);    // let maintenance get ahead of the next append
+  }
+#endif
+  EFILE_SIGNAL(&FileLock);
+  return status;
+}
+
+//********OS_File_Read*************
+// Read 512 bytes from the file
+// Inputs:  num, 8-bit file number, 0 to 254
+//          location, logical address, 0 to 254
+//          buf, pointer to 512 empty spaces in RAM
+// Outputs: 0 if successful
+// Errors:  255 on failure because no data
+uint8_t OS_File_Read(uint8_t num, uint8_t location,
+                     uint8_t buf[512]){
+  uint8_t slot;
+  EFILE_WAIT(&FileLock);
+  MountDirectory();
+  slot = findslot(num, location);
+  if(slot != 255){
+    readrecord(Where[slot], buf);
+  }
+  EFILE_SIGNAL(&FileLock);
+  return (slot == 255) ? 255 : 0;
+}
+
+//********OS_File_Delete*************
+// Remove a file and release its space for reuse
+// The file number can be returned by OS_File_New again.
+// Inputs:  num, 8-bit file number, 0 to 254
+// Outputs: 0 if successful
+// Errors:  255 on disk write failure
+uint8_t OS_File_Delete(uint8_t num){
+  uint8_t status = 0;
+  EFILE_WAIT(&FileLock);
+  MountDirectory();
+  if(Directory[num] != 255){    // otherwise nothing to delete
+    if(makespace() || (writerecord(DELETERECORD, num, 0, 0) == 0)){
+      status = 255;
+    } else{
+      mapdelete(num);
+    }
+  }
+  EFILE_SIGNAL(&FileLock);
+  return status;
+}
+
+//********OS_File_Flush*************
+// Update working buffers onto the disk
+// Power can be removed after calling flush
+// Every record is committed before OS_File_Append returns,
+// so there is nothing left to write.
+// Inputs:  none
+// Outputs: 0 if success
+// Errors:  255 on disk write failure
+uint8_t OS_File_Flush(void){
+  return 0;
+}
+
+//********OS_File_Format*************
+// Erase all files and all data
+// Erase counts are carried over from the old block headers.
+// Inputs:  none
+// Outputs: 0 if success
+// Errors:  255 on disk write failure
+uint8_t OS_File_Format(void){
+  uint8_t b;
+  uint8_t status = 0;
+  EFILE_WAIT(&FileLock);
+  for(b=0; b<BLOCKS; b=b+1){
+    if(eraseblock(b)){
+      status = 255;             // keep going, but report the failure
+    }
+  }
+  bDirectoryLoaded = 0;
+  EFILE_SIGNAL(&FileLock);
+  return status;
+}
+
+//********OS_File_Wear*************
+// Report how evenly the flash blocks have been erased
+// Inputs:  min, pointer to store the fewest erases of any block
+//          max, pointer to store the most erases of any block
+// Outputs: total number of erases performed on the disk
+// Errors:  none
+uint32_t OS_File_Wear(uint32_t *min, uint32_t *max){
+  uint8_t b;
+  uint32_t total = 0;
+  EFILE_WAIT(&FileLock);
+  MountDirectory();
+  *min = ERASED;
+  *max = 0;
+  for(b=0; b<BLOCKS; b=b+1){
+    if(EraseCount[b] < *min){
+      *min = EraseCount[b];
+    }
+    if(EraseCount[b] > *max){
+      *max = EraseCount[b];
+    }
+    total = total + EraseCount[b];
+  }
+  EFILE_SIGNAL(&FileLock);
+  return total;
+}
+
+#if EFILE_BACKGROUND
+//********OS_File_Maintain*************
+// Do one step of flash housekeeping: erase one retired block,
+// or if every free block is already erased and free space
+// is low, collect the oldest block of the log.  When there
+// is nothing to do, wait until an append needs more space.
+// Call it in a loop from a low priority thread.
+// Inputs:  none
+// Outputs: 1 if a block was erased or collected, 0 if idle
+// Errors:  none
+uint8_t OS_File_Maintain(void){
+  uint8_t b;
+  uint8_t work = 0;
+  EFILE_WAIT(&FileLock);
+  MountDirectory();
+  for(b=0; (b<BLOCKS) && (work == 0); b=b+1){
+    if(BlockState[b] == DIRTYBLOCK){
+      eraseblock(b);            // a failed erase stays dirty and is retried
+      work = 1;
+    }
+  }
+  if((work == 0) && (FreeBlocks < GCTHRESHOLD)){
+    if(collect() == 0){
+      work = 1;
+    } else{
+      Stalled = 1;              // blocked appends give up
+    }
+  }
+  while(Waiters > 0){           // let blocked appends check again
+    Waiters = Waiters - 1;
+    EFILE_SIGNAL(&FileSpace);
+  }
+  EFILE_SIGNAL(&FileLock);
+  if(work == 0){
+    EFILE_WAIT(&FileWork);
+  }
+  return work;
+}
+#endif
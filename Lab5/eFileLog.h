@@ -0,0 +1,68 @@
+// eFileLog.h
+// Runs on either TM4C123 or MSP432
+// Log-structured, wear-levelling implementation of the file
+// system in eFile.h.  Link eFileLog.c instead of eFile.c to
+// use it; the OS_File_ functions behave the same way, and the
+// functions below are extras only this version provides.
+// OS_File_Map, OS_File_Open and the in-place iterator are not provided,
+// because a record can continue into another flash block.
+//
+// The flash bank is treated as 128 blocks of 1 KB, the size
+// of one Flash_Erase.  Every OS_File_Append adds a record
+// (4-byte header + 512 bytes of data) at the head of a log,
+// so nothing is ever rewritten in place and there is no
+// Directory/FAT sector to wear out.  The mapping from file
+// and location to flash address is rebuilt in RAM at mount
+// by replaying the log.  Blocks are reclaimed oldest first,
+// live records are copied forward, and a new head block is
+// always the free block with the fewest erases, so erase
+// counts stay within a few cycles of each other.
+//
+// Flash_Erase stops the processor for a whole erase, so by
+// default an append that runs out of space can take several
+// erases plus copying.  Define EFILE_BACKGROUND as 1 to move
+// that work to OS_File_Maintain, run from a low priority
+// thread of the Lab4 kernel (OS_Wait and OS_Signal are used):
+//   void Storage(void){
+//     while(1){
+//       OS_File_Maintain();
+//     }
+//   }
+// Appends then only program pre-erased blocks, and block on
+// a semaphore when the maintenance thread has fallen behind.
+// Each erase still holds interrupts off for the whole erase,
+// only now in the maintenance thread; tools/eFileLogLatency.c
+// measures the windows and the append times both ways.
+
+#ifndef EFILE_BACKGROUND
+#define EFILE_BACKGROUND 0
+#endif
+
+//********OS_File_Delete*************
+// Remove a file and release its space for reuse
+// The file number can be returned by OS_File_New again.
+// Inputs:  num, 8-bit file number, 0 to 254
+// Outputs: 0 if successful
+// Errors:  255 on disk write failure
+uint8_t OS_File_Delete(uint8_t num);
+
+//********OS_File_Wear*************
+// Report how evenly the flash blocks have been erased
+// Inputs:  min, pointer to store the fewest erases of any block
+//          max, pointer to store the most erases of any block
+// Outputs: total number of erases performed on the disk
+// Errors:  none
+uint32_t OS_File_Wear(uint32_t *min, uint32_t *max);
+
+#if EFILE_BACKGROUND
+//********OS_File_Maintain*************
+// Do one step of flash housekeeping: erase one retired block,
+// or if every free block is already erased and free space
+// is low, collect the oldest block of the log.  When there
+// is nothing to do, wait until an append needs more space.
+// Call it in a loop from a low priority thread.
+// Inputs:  none
+// Outputs: 1 if a block was erased or collected, 0 if idle
+// Errors:  none
+uint8_t OS_File_Maintain(void);
+#endif
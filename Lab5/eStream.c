@@ -0,0 +1,260 @@
+// eStream.c
+// Runs on either TM4C123 or MSP432
+// Byte-granular file handles on top of the sector-based file
+// system in eFile.h.
+
+#include <stdint.h>
+#include <string.h>
+#include "eDisk.h"
+#include "eFile.h"
+#include "eStream.h"
+
+struct stream{
+  uint8_t open;      // nonzero if the handle is in use
+  uint8_t mode;      // STREAM_READ or STREAM_WRITE
+  sectorType num;       // file number
+  sectorType location;  // next sector of the file to read
+  uint32_t offset;   // offset in the stream of buf[0]
+  uint16_t count;    // number of valid data bytes in buf
+  uint16_t pos;      // next byte of buf to read
+  uint8_t buf[512];  // staging buffer, one sector
+};
+typedef struct stream streamType;
+streamType Streams[STREAMS];
+
+// Read a little-endian number of size bytes from a buffer
+static uint32_t getfield(const uint8_t *pt, uint32_t size){
+  uint32_t value = 0;
+  while(size > 0){
+    size = size - 1;
+    value = (value<<8) + pt[size];
+  }
+  return value;
+}
+
+// store the offset and the number of valid bytes in the
+// sector trailer and append the sector to the file
+static uint8_t appendsector(streamType *pt){
+  uint16_t i;
+  for(i=pt->count; i<STREAMDATA; i=i+1){
+    pt->buf[i] = 0xFF;          // unused bytes look erased
+  }
+  for(i=0; i<4; i=i+1){
+    pt->buf[STREAMOFFSET+i] = pt->offset>>(8*i);
+  }
+  pt->buf[STREAMCOUNT] = pt->count&0xFF;
+  pt->buf[STREAMCOUNT+1] = pt->count>>8;
+  if(OS_File_Append(pt->num, pt->buf)){
+    return 255;
+  }
+  pt->offset = pt->offset + pt->count;
+  pt->count = 0;
+  return 0;
+}
+
+// read a sector of the file into the staging buffer
+static uint8_t readsector(streamType *pt, sectorType location){
+  if(OS_File_Read(pt->num, location, pt->buf)){
+    return 255;                 // end of file
+  }
+  pt->location = location + 1;
+  pt->offset = getfield(&pt->buf[STREAMOFFSET], 4);
+  pt->count = getfield(&pt->buf[STREAMCOUNT], 2);
+  if(pt->count > STREAMDATA){
+    pt->count = 0;              // not a stream sector
+  }
+  pt->pos = 0;
+  return 0;
+}
+
+// read the next sector of the file into the staging buffer
+static uint8_t loadsector(streamType *pt){
+  return readsector(pt, pt->location);
+}
+
+//********OS_Stream_Open*************
+// Open a file for byte-granular reading or appending
+// Inputs:  num, file number, 0 to EFILE_FILES-1
+//          mode, STREAM_READ or STREAM_WRITE
+// Outputs: handle, 0 to STREAMS-1
+// Errors:  255 if every handle is in use, or for STREAM_WRITE
+//          if the file already has a writer
+uint8_t OS_Stream_Open(sectorType num, uint8_t mode){
+  uint8_t h;
+  sectorType size;
+  streamType *pt = 0;
+  for(h=0; h<STREAMS; h=h+1){
+    if(Streams[h].open && (Streams[h].num == num) &&
+       (Streams[h].mode == STREAM_WRITE) && (mode == STREAM_WRITE)){
+      return 255;               // two writers would interleave sectors
+    }
+    if((Streams[h].open == 0) && (pt == 0)){
+      pt = &Streams[h];
+    }
+  }
+  if(pt == 0){
+    return 255;
+  }
+  pt->num = num;
+  pt->location = 0;
+  pt->offset = 0;
+  pt->count = 0;
+  pt->pos = 0;
+  if(mode == STREAM_WRITE){
+    // continue the offsets from the last sector of the file
+    size = OS_File_Size(num);
+    if((size > 0) && (readsector(pt, size - 1) == 0)){
+      pt->offset = pt->offset + pt->count;
+      pt->count = 0;
+    }
+  }
+  pt->open = 1;
+  pt->mode = mode;
+  return pt - Streams;
+}
+
+//********OS_Stream_Write*************
+// Append bytes to a file opened with STREAM_WRITE
+// A sector is appended to the file each time the staging
+// buffer fills; the rest stays in RAM until more data or
+// OS_Stream_Close.
+// Inputs:  handle, from OS_Stream_Open
+//          data, pointer to the bytes to write
+//          len, number of bytes to write
+// Outputs: number of bytes accepted, less than len if the
+//          disk is full
+uint32_t OS_Stream_Write(uint8_t handle, const uint8_t *data, uint32_t len){
+  streamType *pt;
+  uint32_t done = 0;
+  uint32_t n;
+  if(handle >= STREAMS){
+    return 0;
+  }
+  pt = &Streams[handle];
+  if((pt->open == 0) || (pt->mode != STREAM_WRITE)){
+    return 0;
+  }
+  while(done < len){
+    if(pt->count == STREAMDATA){
+      if(appendsector(pt)){
+        break;                  // disk full, keep the staged data
+      }
+    }
+    n = STREAMDATA - pt->count;
+    if(n > (len - done)){
+      n = len - done;
+    }
+    memcpy(&pt->buf[pt->count], &data[done], n);
+    pt->count = pt->count + n;
+    done = done + n;
+  }
+  return done;
+}
+
+//********OS_Stream_Read*************
+// Read bytes from a file opened with STREAM_READ
+// Inputs:  handle, from OS_Stream_Open
+//          data, pointer to len empty spaces in RAM
+//          len, number of bytes to read
+// Outputs: number of bytes read, less than len at the end of the file
+uint32_t OS_Stream_Read(uint8_t handle, uint8_t *data, uint32_t len){
+  streamType *pt;
+  uint32_t done = 0;
+  uint32_t n;
+  if(handle >= STREAMS){
+    return 0;
+  }
+  pt = &Streams[handle];
+  if((pt->open == 0) || (pt->mode != STREAM_READ)){
+    return 0;
+  }
+  while(done < len){
+    if(pt->pos == pt->count){
+      if(loadsector(pt)){
+        break;                  // end of file
+      }
+      continue;
+    }
+    n = pt->count - pt->pos;
+    if(n > (len - done)){
+      n = len - done;
+    }
+    memcpy(&data[done], &pt->buf[pt->pos], n);
+    pt->pos = pt->pos + n;
+    done = done + n;
+  }
+  return done;
+}
+
+//********OS_Stream_Seek*************
+// Move the read position of a file opened with STREAM_READ
+// The sector is found by a binary search of the sector
+// offsets, so a seek reads about log2(size) sectors.
+// Inputs:  handle, from OS_Stream_Open
+//          position, byte offset from the beginning of the file
+// Outputs: 0 if successful
+// Errors:  255 if position is past the end of the file
+uint8_t OS_Stream_Seek(uint8_t handle, uint32_t position){
+  streamType *pt;
+  uint32_t lo, hi, mid;
+  if(handle >= STREAMS){
+    return 255;
+  }
+  pt = &Streams[handle];
+  if((pt->open == 0) || (pt->mode != STREAM_READ)){
+    return 255;
+  }
+  pt->location = 0;
+  pt->offset = 0;
+  pt->count = 0;
+  pt->pos = 0;
+  if(position == 0){
+    return 0;
+  }
+  // the last sector whose first byte is at or before position
+  lo = 0;
+  hi = OS_File_Size(pt->num);
+  if(hi == 0){
+    return 255;
+  }
+  while((hi - lo) > 1){
+    mid = (lo + hi)/2;
+    if(readsector(pt, mid)){
+      return 255;
+    }
+    if(pt->offset <= position){
+      lo = mid;
+    } else{
+      hi = mid;
+    }
+  }
+  if(readsector(pt, lo) || (position > (pt->offset + pt->count))){
+    return 255;
+  }
+  pt->pos = position - pt->offset;  // at most count, the end of the sector
+  return 0;
+}
+
+//********OS_Stream_Close*************
+// Release a handle; for STREAM_WRITE the partly filled
+// staging buffer is appended to the file first
+// Call OS_File_Flush afterwards before removing power.
+// Inputs:  handle, from OS_Stream_Open
+// Outputs: 0 if successful
+// Errors:  255 on disk full or write failure
+uint8_t OS_Stream_Close(uint8_t handle){
+  streamType *pt;
+  uint8_t status = 0;
+  if(handle >= STREAMS){
+    return 255;
+  }
+  pt = &Streams[handle];
+  if(pt->open == 0){
+    return 255;
+  }
+  if((pt->mode == STREAM_WRITE) && (pt->count > 0)){
+    status = appendsector(pt);
+  }
+  pt->open = 0;
+  return status;
+}
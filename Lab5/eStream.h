@@ -0,0 +1,69 @@
+// eStream.h
+// Runs on either TM4C123 or MSP432
+// Byte-granular file handles on top of the sector-based file
+// system in eFile.h.  Each open handle has a 512-byte staging
+// buffer, so many small writes are coalesced into one
+// OS_File_Append.
+// Sector format of a stream file: bytes 0 to 505 hold data,
+// bytes 506-509 hold the byte offset in the stream of its
+// first data byte, and bytes 510-511 hold the number of data
+// bytes that are valid (little endian).  Every sector is full
+// except the last one written before each OS_Stream_Close;
+// the offsets let a seek find its sector by binary search.
+// Files written with streams must be read with streams.
+// Include eDisk.h and eFile.h first.
+
+#define STREAMS       2       // maximum number of open handles
+#define STREAMDATA    506     // data bytes in one sector
+#define STREAMOFFSET  506     // trailer: offset of the first data byte
+#define STREAMCOUNT   510     // trailer: number of valid data bytes
+#define STREAM_READ   0       // open for reading from the beginning
+#define STREAM_WRITE  1       // open for appending to the end
+
+//********OS_Stream_Open*************
+// Open a file for byte-granular reading or appending
+// Inputs:  num, file number, 0 to EFILE_FILES-1
+//          mode, STREAM_READ or STREAM_WRITE
+// Outputs: handle, 0 to STREAMS-1
+// Errors:  255 if every handle is in use, or for STREAM_WRITE
+//          if the file already has a writer
+uint8_t OS_Stream_Open(sectorType num, uint8_t mode);
+
+//********OS_Stream_Write*************
+// Append bytes to a file opened with STREAM_WRITE
+// A sector is appended to the file each time the staging
+// buffer fills; the rest stays in RAM until more data or
+// OS_Stream_Close.
+// Inputs:  handle, from OS_Stream_Open
+//          data, pointer to the bytes to write
+//          len, number of bytes to write
+// Outputs: number of bytes accepted, less than len if the
+//          disk is full
+uint32_t OS_Stream_Write(uint8_t handle, const uint8_t *data, uint32_t len);
+
+//********OS_Stream_Read*************
+// Read bytes from a file opened with STREAM_READ
+// Inputs:  handle, from OS_Stream_Open
+//          data, pointer to len empty spaces in RAM
+//          len, number of bytes to read
+// Outputs: number of bytes read, less than len at the end of the file
+uint32_t OS_Stream_Read(uint8_t handle, uint8_t *data, uint32_t len);
+
+//********OS_Stream_Seek*************
+// Move the read position of a file opened with STREAM_READ
+// The sector is found by a binary search of the sector
+// offsets, so a seek reads about log2(size) sectors.
+// Inputs:  handle, from OS_Stream_Open
+//          position, byte offset from the beginning of the file
+// Outputs: 0 if successful
+// Errors:  255 if position is past the end of the file
+uint8_t OS_Stream_Seek(uint8_t handle, uint32_t position);
+
+//********OS_Stream_Close*************
+// Release a handle; for STREAM_WRITE the partly filled
+// staging buffer is appended to the file first
+// Call OS_File_Flush afterwards before removing power.
+// Inputs:  handle, from OS_Stream_Open
+// Outputs: 0 if successful
+// Errors:  255 on disk full or write failure
+uint8_t OS_Stream_Close(uint8_t handle);
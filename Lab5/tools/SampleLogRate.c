@@ -0,0 +1,140 @@
+// SampleLogRate.c
+// Runs on a host computer (Linux, Windows, Mac)
+// Sustained throughput of SampleLog.c on the 128 KB flash in
+// FlashSim.c, whose program and erase times are those of the
+// TM4C123.  A producer puts one sample every 1e6/rate usec and
+// the writer thread commits full buffers; while an append keeps
+// the writer busy for its flash time, the producer keeps
+// putting samples into the other buffers.  For each rate the
+// disk is filled, and it prints the samples put and dropped,
+// how busy the writer was, and the longest append.  Every
+// committed sector is read back and checked.
+// OS_Wait and OS_Signal are a model of the Lab4 kernel: the
+// writer blocked on SampleReady lets time pass until the
+// producer fills a buffer.
+// Build and run from Lab5/ with either file system and any
+// SAMPLELOG_DEPTH, e.g.
+//   gcc -O2 -Wall -DFLASH_SIMULATOR -I. -o samplerate tools/SampleLogRate.c SampleLog.c eFile.c eCache.c eDisk.c FlashSim.c crc32.c
+//   gcc -O2 -Wall -DFLASH_SIMULATOR -DSAMPLELOG_DEPTH=4 -I. -o samplerate4 tools/SampleLogRate.c SampleLog.c eFileLog.c FlashSim.c
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include "eDisk.h"
+#include "eFile.h"
+#include "SampleLog.h"
+#include "FlashSim.h"
+
+#define MINRATE 1000          // samples per second, BSP_Microphone_Input in Lab4
+
+long StartCritical(void){ return 0; }
+void EndCritical(long sr){ (void)sr; }
+
+uint64_t Idle;                // usec the writer spent blocked
+uint64_t Next;                // time of the next sample, usec
+uint64_t Origin;              // time of the first sample, after the format
+uint32_t Period;              // usec between samples
+uint32_t Samples;             // samples put, dropped or not
+uint32_t Kept;                // samples put and not dropped
+uint16_t Value[EDISK_SECTORS*SAMPLELOG_SAMPLES];  // value of each kept sample
+
+// usec since the start, blocked time plus flash time
+uint64_t now(void){
+  return Idle + FlashSim_Time;
+}
+
+// the producer: one sample
+void produce(void){
+  uint16_t value = (Samples*7)&0xFFFF;
+  if(SampleLog_Put(value) == 0){
+    Value[Kept] = value;
+    Kept = Kept + 1;
+  }
+  Samples = Samples + 1;
+  Next = Next + Period;
+}
+
+// the producer catches up with the time the writer was busy
+void catchup(void){
+  while(Next <= now()){
+    produce();
+  }
+}
+
+void OS_Wait(int32_t *semaPt){
+  while((*semaPt) <= 0){      // blocked: time passes to the next sample
+    if(Next > now()){
+      Idle = Next - FlashSim_Time;
+    }
+    produce();
+  }
+  (*semaPt) = (*semaPt) - 1;
+}
+void OS_Signal(int32_t *semaPt){
+  (*semaPt) = (*semaPt) + 1;
+}
+
+// fill the disk at one rate; returns 1 if no sample was dropped
+// and every committed sample reads back
+int run(uint32_t rate){
+  uint8_t buf[512];
+  uint32_t location, i, t, tmax = 0, bad = 0, start, busy;
+  sectorType num;
+  FlashSim_Reset();
+  OS_File_Format();
+  num = OS_File_New();
+  SampleLog_Init(num);
+  Idle = 0;
+  Origin = now();
+  Next = Origin;
+  Period = 1000000/rate;
+  Samples = 0;
+  Kept = 0;
+  while(1){
+    start = FlashSim_Time;      // the writer is busy only for the flash time
+    if(SampleLog_Write()){
+      break;                    // the disk is full
+    }
+    t = FlashSim_Time - start;
+    catchup();
+    if(t > tmax){
+      tmax = t;
+    }
+  }
+  busy = FlashSim_Time - Origin;
+  OS_File_Flush();
+  for(location=0; location<SampleLog_Sectors; location=location+1){
+    if(OS_File_Read(num, location, buf)){
+      bad = bad + 1;
+      continue;
+    }
+    for(i=0; i<SAMPLELOG_SAMPLES; i=i+1){
+      if((buf[2*i] + (buf[2*i+1]<<8)) != Value[location*SAMPLELOG_SAMPLES + i]){
+        bad = bad + 1;
+        break;
+      }
+    }
+  }
+  printf("%6u  %7u  %8u  %7u  %6.1f  %8.1f  %u\n", (unsigned)rate, (unsigned)Samples,
+    (unsigned)SampleLog_Overruns, (unsigned)SampleLog_Sectors,
+    100.0*busy/(now() - Origin), tmax/1000.0, (unsigned)bad);
+  return (SampleLog_Overruns == 0)&&(bad == 0)&&(SampleLog_Sectors > 0);
+}
+
+int main(void){
+  uint32_t rate, best;
+  int r;
+  printf("SAMPLELOG_DEPTH %u, %u samples per sector\n",
+    (unsigned)SAMPLELOG_DEPTH, (unsigned)SAMPLELOG_SAMPLES);
+  printf("  rate  samples   dropped  sectors  busy %%  worst ms  wrong sectors\n");
+  r = run(MINRATE);
+  best = r ? MINRATE : 0;
+  for(rate=2*MINRATE; rate<=64*MINRATE; rate=2*rate){
+    if(run(rate) && (best == rate/2)){
+      best = rate;
+    }
+  }
+  printf("sustained      no sample dropped up to %u Hz of the rates tried\n", (unsigned)best);
+  printf("result         %s\n", r ? "pass" : "fail");
+  return !r;
+}
@@ -0,0 +1,189 @@
+// SensorLogRatio.c
+// Runs on a host computer (Linux, Windows, Mac)
+// Compression ratio of SensorLog.c on a trace of samples, on
+// the 128 KB flash in FlashSim.c.  The channels are those of
+// the Lab4 application, times in ms:
+//   0 microphone    uint16_t, 10 bits, every 1 ms
+//   1 acceleration  uint16_t, 10 bits, every 100 ms
+//   2 temperature   int32_t, 0.1 C, about every second, not
+//                   at a fixed rate, so its times are stored
+//   3 light         uint32_t, 100 lux, every 800 ms
+// The trace is read from a text file of lines "channel time
+// value", or, without one, made up for SECONDS seconds: a
+// quiet room with a burst of speech every 2 s and a missed
+// sample every 20 s, walking, a slow temperature drift and a
+// light switched on and off.
+// It logs the trace, syncs, and prints for every channel the
+// disk bytes per sample and the ratio against its raw sample
+// width, then reads each channel back with SensorLog_Query and
+// checks every sample.  A slow channel fills only part of its
+// last block, which still takes a whole sector, so its ratio
+// grows with the length of the trace.  Logging stops if the
+// disk fills up; only what was synced must come back.
+// Build and run from Lab5/ with either file system, e.g.
+//   gcc -O2 -Wall -DFLASH_SIMULATOR -I. -o sensorratio tools/SensorLogRatio.c SensorLog.c eFile.c eCache.c eDisk.c FlashSim.c crc32.c -lm
+//   gcc -O2 -Wall -DFLASH_SIMULATOR -DSENSORLOG_MAP=0 -I. -o sensorratiolog tools/SensorLogRatio.c SensorLog.c eFileLog.c FlashSim.c -lm
+//   ./sensorratio [trace.txt]
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "eDisk.h"
+#include "eFile.h"
+#include "SensorLog.h"
+#include "FlashSim.h"
+
+#define SECONDS 60            // length of the made-up trace
+#define MAXTRACE 70000        // samples in a trace, at most
+
+// the Lab4 channels
+const char *Name[SENSORLOG_CHANNELS] = {"microphone", "acceleration", "temperature", "light"};
+const uint32_t Period[SENSORLOG_CHANNELS] = {1, 100, 0, 800};  // ms, 0 if not fixed
+const uint8_t Width[SENSORLOG_CHANNELS] = {2, 2, 4, 4};        // bytes of a raw sample
+
+long StartCritical(void){ return 0; }
+void EndCritical(long sr){ (void)sr; }
+
+struct sample{
+  uint8_t channel;
+  uint32_t time;
+  int32_t value;
+};
+struct sample Trace[MAXTRACE];
+uint32_t Count;               // samples in Trace
+uint32_t Index;               // next sample expected back
+uint32_t Bad;                 // samples that did not read back as logged
+
+// add a sample to the trace
+void add(uint8_t channel, uint32_t time, int32_t value){
+  if(Count < MAXTRACE){
+    Trace[Count].channel = channel;
+    Trace[Count].time = time;
+    Trace[Count].value = value;
+    Count = Count + 1;
+  }
+}
+
+// the made-up trace, in time order
+void makeup(void){
+  uint32_t t, temp = 0;
+  double loud;
+  srand(1);
+  for(t=0; t<1000*SECONDS; t=t+1){
+    loud = ((t%2000) < 300) ? sin(3.14159*(t%2000)/300) : 0;     // speech envelope
+    if((t%20000) != 10000){      // a sample missed now and then
+      add(0, t, 512 + (int32_t)(200*loud*sin(2*3.14159*0.15*t)) + rand()%7 - 3);
+    }
+    if((t%100) == 0){
+      add(1, t, 768 + (int32_t)(80*sin(2*3.14159*t/1000.0)) + rand()%9 - 4);
+    }
+    if(t == temp){
+      add(2, t, 250 + (int32_t)(t/20000) + rand()%3 - 1);
+      temp = t + 1000 + rand()%3;  // conversion time varies
+    }
+    if((t%800) == 0){
+      add(3, t, ((t/15000)%2) ? 320 + rand()%5 : 4 + rand()%2);
+    }
+  }
+}
+
+// read a trace file, returns 0 if it could not be read
+int readtrace(const char *name){
+  FILE *fp = fopen(name, "r");
+  unsigned ch;
+  unsigned long time;
+  long value;
+  if(fp == 0){
+    return 0;
+  }
+  while((Count < MAXTRACE) && (fscanf(fp, "%u %lu %ld", &ch, &time, &value) == 3)){
+    if(ch < SENSORLOG_CHANNELS){
+      add(ch, time, value);
+    }
+  }
+  fclose(fp);
+  return 1;
+}
+
+// skip to the next sample of a channel in the trace
+void next(uint8_t channel){
+  while((Index < Count) && (Trace[Index].channel != channel)){
+    Index = Index + 1;
+  }
+}
+
+// called by SensorLog_Query with each sample read back
+void back(uint8_t channel, uint32_t time, int32_t value){
+  next(channel);
+  if((Index == Count) || (Trace[Index].time != time) || (Trace[Index].value != value)){
+    Bad = Bad + 1;
+  } else{
+    Index = Index + 1;
+  }
+}
+
+int main(int argc, char **argv){
+  uint32_t i, logged = 0, blocks, found, total = 0, samples[SENSORLOG_CHANNELS];
+  uint32_t ratio, raw = 0;
+  sectorType num;
+  uint8_t ch;
+  int r;
+  if(argc > 1){
+    if(!readtrace(argv[1])){
+      printf("%s: cannot read the trace\n", argv[1]);
+      return 1;
+    }
+  } else{
+    makeup();
+  }
+  FlashSim_Reset();
+  OS_File_Format();
+  num = OS_File_New();
+  SensorLog_Init(num);
+  for(ch=0; ch<SENSORLOG_CHANNELS; ch=ch+1){
+    SensorLog_Channel(ch, Period[ch], Width[ch]);
+  }
+  memset(samples, 0, sizeof(samples));
+  for(i=0; i<Count; i=i+1){
+    if(SensorLog_Put(Trace[i].channel, Trace[i].time, Trace[i].value)){
+      break;                  // the disk is full
+    }
+    samples[Trace[i].channel] = samples[Trace[i].channel] + 1;
+  }
+  if((SensorLog_Sync() == 0) && (OS_File_Flush() == 0)){
+    logged = i;
+  }
+  blocks = SensorLog_Blocks;
+  ratio = SensorLog_Ratio(SENSORLOG_CHANNELS);
+  printf("trace          %u samples, %u logged in %u blocks\n",
+    (unsigned)Count, (unsigned)logged, (unsigned)blocks);
+  printf("channel        period  samples  blocks  bytes/sample  raw  ratio\n");
+  Count = logged;               // only what fit on the disk comes back
+  for(ch=0; ch<SENSORLOG_CHANNELS; ch=ch+1){
+    if(samples[ch] == 0){
+      continue;
+    }
+    Index = 0;
+    SensorLog_Decoded = 0;
+    found = SensorLog_Query(num, ch, 0, 0xFFFFFFFF, back);
+    next(ch);
+    if((found != samples[ch]) || (Index != Count)){
+      Bad = Bad + 1;
+    }
+    total = total + found;
+    raw = raw + found*Width[ch];
+    printf("%u %-12s %6u  %7u  %6u  %12.2f  %3u  %2u.%02u\n", (unsigned)ch, Name[ch],
+      (unsigned)Period[ch], (unsigned)found, (unsigned)SensorLog_Decoded,
+      512.0*SensorLog_Decoded/found, (unsigned)Width[ch],
+      (unsigned)(SensorLog_Ratio(ch)/100), (unsigned)(SensorLog_Ratio(ch)%100));
+  }
+  printf("overall        %.2f bytes per sample, ratio %u.%02u to 1 (raw %.2f bytes per sample)\n",
+    blocks ? 512.0*blocks/logged : 0.0, (unsigned)(ratio/100), (unsigned)(ratio%100),
+    logged ? (double)raw/logged : 0.0);
+  printf("errors         %u\n", (unsigned)Bad);
+  r = (Bad == 0)&&(total == logged)&&(blocks > 0);
+  printf("result         %s\n", r ? "pass" : "fail");
+  return !r;
+}
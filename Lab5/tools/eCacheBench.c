@@ -0,0 +1,177 @@
+// eCacheBench.c
+// Runs on a host computer (Linux, Windows, Mac)
+// Benchmark of the write-back sector cache in eCache.c, with
+// eFile.c on the 128 KB flash in FlashSim.c.  Two workloads:
+//   log     a logger appends 240 sectors, reads back the last
+//           few every 8 appends and flushes every 32
+//   random  10000 reads of a 240-sector file, uniform and then
+//           with 80% of them going to 4 hot sectors
+// For each it prints the hits, misses and write-backs, and
+// the time per read, against reading every sector straight
+// from eDisk.  Then the flash fails while the cache is full
+// of dirty sectors: writes that would evict one must fail,
+// and once the flash works again a flush must still put every
+// sector on the disk.
+// Build and run from Lab5/, with ECACHE_WAYS as wanted, e.g.
+//   gcc -O2 -Wall -DFLASH_SIMULATOR -DECACHE_WAYS=4 -I. -o ecachebench tools/eCacheBench.c eFile.c eCache.c eDisk.c FlashSim.c crc32.c
+
+#define _POSIX_C_SOURCE 199309L
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "eDisk.h"
+#include "eCache.h"
+#include "eFile.h"
+#include "FlashSim.h"
+
+#define SECTORS 240           // sectors in the file
+#define READS   10000
+#define HOT     4             // sectors most reads go to in the skewed workload
+
+sectorType findsector(sectorType num, sectorType location);  // in eFile.c
+
+long StartCritical(void){ return 0; }
+void EndCritical(long sr){ (void)sr; }
+
+uint32_t Bad;                 // sectors that did not read back as written
+
+// Time since an earlier clock_gettime, in nsec
+double elapsed(const struct timespec *start){
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (now.tv_sec - start->tv_sec)*1e9 + (now.tv_nsec - start->tv_nsec);
+}
+
+// the data of a location of the file
+void fill(uint8_t *buf, uint32_t location){
+  uint32_t i;
+  for(i=0; i<512; i=i+1){
+    buf[i] = (location*7 + i)&0xFF;
+  }
+}
+
+// read a location through the file system and check it
+void check(uint32_t location){
+  uint8_t buf[512], expect[512];
+  fill(expect, location);
+  if(OS_File_Read(0, location, buf) || memcmp(buf, expect, 512)){
+    Bad = Bad + 1;
+  }
+}
+
+void stats(const char *name){
+  printf("%-15s%6u hits %6u misses %4u write-backs\n", name,
+    (unsigned)eCache_Hits, (unsigned)eCache_Misses, (unsigned)eCache_WriteBacks);
+}
+
+// start over with an empty disk and cache
+void format(void){
+  FlashSim_Reset();
+  OS_File_Format();
+  OS_File_New();
+}
+
+// the logging workload
+void logger(void){
+  uint8_t buf[512];
+  uint32_t n, k;
+  format();
+  for(n=0; n<SECTORS; n=n+1){
+    fill(buf, n);
+    OS_File_Append(0, buf);
+    if((n%8) == 7){
+      for(k=n-3; k<=n; k=k+1){
+        check(k);
+      }
+    }
+    if((n%32) == 31){
+      OS_File_Flush();
+    }
+  }
+  OS_File_Flush();
+  stats("log");
+  printf("               %u sectors programmed, %.1f ms of flash time\n",
+    (unsigned)(FlashSim_Writes/128), FlashSim_Time/1000.0);
+}
+
+// a read workload, hot is the percentage of reads that go to
+// the HOT hot sectors; prints the time per read through the
+// cache and straight from eDisk
+void reader(const char *name, uint32_t hot){
+  uint8_t buf[512];
+  static sectorType location[READS], sector[READS];
+  struct timespec start;
+  double tcache, tdisk;
+  uint32_t i;
+  srand(1);
+  for(i=0; i<READS; i=i+1){
+    if((uint32_t)(rand()%100) < hot){
+      location[i] = rand()%HOT;
+    } else{
+      location[i] = rand()%SECTORS;
+    }
+    sector[i] = findsector(0, location[i]);
+  }
+  eCache_Flush();
+  eCache_Invalidate();
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for(i=0; i<READS; i=i+1){
+    OS_File_Read(0, location[i], buf);
+  }
+  tcache = elapsed(&start)/READS;
+  stats(name);
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for(i=0; i<READS; i=i+1){
+    eDisk_ReadSector(buf, sector[i]);
+  }
+  tdisk = elapsed(&start)/READS;
+  printf("               %.0f ns per read cached, %.0f ns from eDisk, hit rate %.0f%%\n",
+    tcache, tdisk, 100.0*eCache_Hits/READS);
+  for(i=0; i<READS; i=i+100){
+    check(location[i]);
+  }
+}
+
+// the flash fails while the cache holds dirty sectors
+// Output: 1 if nothing was lost
+int failing(void){
+  uint8_t buf[512];
+  uint32_t n, ok = 0, refused = 0;
+  format();
+  eCache_Invalidate();
+  FlashSim_PowerFail(0);
+  for(n=0; n<2*ECACHE_WAYS; n=n+1){
+    fill(buf, n);
+    if(OS_File_Append(0, buf) == 0){
+      ok = ok + 1;
+    } else{
+      refused = refused + 1;
+    }
+  }
+  FlashSim_PowerFail(-1);
+  if(OS_File_Flush()){
+    return 0;
+  }
+  eCache_Invalidate();      // forget the RAM copies, read the flash
+  for(n=0; n<ok; n=n+1){
+    check(n);
+  }
+  printf("failing flash  %u appends held in the cache, %u refused, then flushed\n",
+    (unsigned)ok, (unsigned)refused);
+  return (ok == ECACHE_WAYS) && (refused == ECACHE_WAYS) && (OS_File_Size(0) == ok);
+}
+
+int main(void){
+  int r;
+  printf("%u ways, %u sectors\n", (unsigned)ECACHE_WAYS, (unsigned)SECTORS);
+  logger();
+  reader("random", 0);
+  reader("random 80/20", 80);
+  r = failing();
+  printf("data           %u sectors wrong\n", (unsigned)Bad);
+  r = r && (Bad == 0);
+  printf("result         %s\n", r ? "pass" : "fail");
+  return !r;
+}
@@ -0,0 +1,156 @@
+// eDiskCrc.c
+// Runs on a host computer (Linux, Windows, Mac)
+// Throughput cost of the integrity checks in eDisk.c on the
+// 128 KB flash in FlashSim.c.  Every sector of the disk is
+// written, then random blocks are erased and written again
+// REWRITES times with the disk full, the case in which the
+// CRC journal fills fastest.  It prints, per sector write, the
+// flash time from the FlashSim time model, the erases, the
+// host time, and with EDISK_CRC the journal compactions, then
+// the host time of a read.  Finally it damages the flash: with
+// EDISK_CRC a flipped bit must fail the read and the scrub,
+// and the CRCs must survive a reload of the journal; with
+// EDISK_VERIFY a sector programmed over old data must fail the
+// write.  Build it once for each mode and compare:
+//   gcc -O2 -Wall -DFLASH_SIMULATOR -I. -o ediskplain tools/eDiskCrc.c eDisk.c FlashSim.c crc32.c
+//   gcc -O2 -Wall -DFLASH_SIMULATOR -DEDISK_CRC=1 -I. -o ediskcrc tools/eDiskCrc.c eDisk.c FlashSim.c crc32.c
+//   gcc -O2 -Wall -DFLASH_SIMULATOR -DEDISK_VERIFY=1 -I. -o ediskverify tools/eDiskCrc.c eDisk.c FlashSim.c crc32.c
+//   gcc -O2 -Wall -DFLASH_SIMULATOR -DEDISK_CRC=1 -DEDISK_VERIFY=1 -I. -o ediskboth tools/eDiskCrc.c eDisk.c FlashSim.c crc32.c
+
+#define _POSIX_C_SOURCE 199309L
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "eDisk.h"
+#include "FlashSim.h"
+
+#define REWRITES 2000         // blocks erased and written again
+#define READS    100000
+
+extern uint8_t FlashSim_Memory[FLASHSIM_SIZE];  // in FlashSim.c
+#if EDISK_CRC
+extern uint32_t CrcGen;       // in eDisk.c, counts compactions
+extern int32_t CrcLoaded;
+#endif
+
+long StartCritical(void){ return 0; }
+void EndCritical(long sr){ (void)sr; }
+
+uint8_t Gen[EDISK_SECTORS];   // generation of each sector, changes its data
+uint32_t Bad;                 // sectors that did not read back as written
+
+// Time since an earlier clock_gettime, in nsec
+double elapsed(const struct timespec *start){
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (now.tv_sec - start->tv_sec)*1e9 + (now.tv_nsec - start->tv_nsec);
+}
+
+// the data of a sector
+void fill(uint8_t *buf, uint32_t sector){
+  uint32_t i;
+  for(i=0; i<512; i=i+1){
+    buf[i] = (sector*7 + Gen[sector]*13 + i)&0xFF;
+  }
+}
+
+// write a sector with its next generation of data
+void put(uint32_t sector){
+  uint8_t buf[512];
+  Gen[sector] = Gen[sector] + 1;
+  fill(buf, sector);
+  if(eDisk_WriteSector(buf, sector) != RES_OK){
+    Bad = Bad + 1;
+  }
+}
+
+// read every sector and check it
+void check(void){
+  uint8_t buf[512], expect[512];
+  uint32_t sector;
+  for(sector=0; sector<EDISK_SECTORS; sector=sector+1){
+    fill(expect, sector);
+    if((eDisk_ReadSector(buf, sector) != RES_OK) || memcmp(buf, expect, 512)){
+      Bad = Bad + 1;
+    }
+  }
+}
+
+int main(void){
+  uint8_t buf[512];
+  uint32_t sector, first, i, writes, compactions = 0, damaged = 1;
+  uint32_t time0, erases0;
+  struct timespec start;
+  double twrite, tread;
+  int r;
+  FlashSim_Reset();
+  eDisk_Init(0);
+  eDisk_Format();
+  for(sector=0; sector<EDISK_SECTORS; sector=sector+1){
+    put(sector);
+  }
+  srand(1);
+  time0 = FlashSim_Time;
+  erases0 = FlashSim_Erases;
+#if EDISK_CRC
+  compactions = CrcGen;
+#endif
+  writes = 0;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for(i=0; i<REWRITES; i=i+1){
+    first = (rand()%EDISK_SECTORS)/EDISK_BLOCKSECTORS*EDISK_BLOCKSECTORS;
+    if(eDisk_EraseBlock(first) != RES_OK){
+      Bad = Bad + 1;
+    }
+    for(sector=first; (sector<first+EDISK_BLOCKSECTORS) && (sector<EDISK_SECTORS); sector=sector+1){
+      put(sector);
+      writes = writes + 1;
+    }
+  }
+  twrite = elapsed(&start)/writes;
+#if EDISK_CRC
+  compactions = CrcGen - compactions;
+#endif
+  check();
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for(i=0; i<READS; i=i+1){
+    eDisk_ReadSector(buf, i%EDISK_SECTORS);
+  }
+  tread = elapsed(&start)/READS;
+  printf("EDISK_CRC %u, EDISK_VERIFY %u, %u sectors\n",
+    (unsigned)EDISK_CRC, (unsigned)EDISK_VERIFY, (unsigned)EDISK_SECTORS);
+  printf("write          %.0f us of flash, %.3f erases, %.0f ns on the host per sector\n",
+    (double)(FlashSim_Time - time0)/writes, (double)(FlashSim_Erases - erases0)/writes, twrite);
+  printf("               %u journal compactions in %u sector writes\n",
+    (unsigned)compactions, (unsigned)writes);
+  printf("read           %.0f ns on the host per sector\n", tread);
+  r = 1;
+#if EDISK_CRC
+  // the journal must fill at most once every 32 entries, two per
+  // rewritten sector, even with every sector holding data
+  r = r&&(compactions*16 <= writes);
+  CrcLoaded = 0;              // read the CRCs back from the flash
+  check();
+  sector = EDISK_SECTORS/2;
+  FlashSim_Memory[512*sector + 100] ^= 0x04;  // a bit flips
+  damaged = (eDisk_ReadSector(buf, sector) == RES_ERROR)&&(eDisk_Scrub(EDISK_SECTORS) == 1);
+  FlashSim_Memory[512*sector + 100] ^= 0x04;
+  printf("bit flip       %s by the read and the scrub\n", damaged ? "found" : "missed");
+  r = r&&damaged;
+#endif
+#if EDISK_VERIFY
+  sector = 3;
+  Gen[sector] = Gen[sector] + 1;
+  fill(buf, sector);
+  damaged = (eDisk_WriteSector(buf, sector) == RES_ERROR)&&(eDisk_VerifyErrors == 1);
+  printf("over old data  %s by the verify\n", damaged ? "found" : "missed");
+  r = r&&damaged;
+#endif
+  (void)damaged;
+  printf("data           %u sectors wrong\n", (unsigned)Bad);
+  r = r&&(Bad == 0);
+  printf("result         %s\n", r ? "pass" : "fail");
+  return !r;
+}
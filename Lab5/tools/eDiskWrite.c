@@ -0,0 +1,121 @@
+// eDiskWrite.c
+// Runs on a host computer (Linux, Windows, Mac)
+// Cycle count of eDisk_WriteSector on the flash in FlashSim.c,
+// whose program times are the 80 MHz figures of the TM4C123.
+// It writes every sector of the disk and reports, per sector,
+// the flash operations, the time the processor waits for the
+// flash, and the longest window with interrupts disabled,
+// which is one operation, or the whole sector when
+// EDISK_ATOMICWRITE holds them off for all four bursts.  It
+// also times, on the host, packing 512 bytes into words with
+// the old shift loop and with memcpy.  Build it once for each
+// path and compare:
+//   gcc -O2 -Wall -DFLASH_SIMULATOR -DEDISK_FASTWRITE=0 -I. -o edisk128 tools/eDiskWrite.c eDisk.c FlashSim.c crc32.c
+//   gcc -O2 -Wall -DFLASH_SIMULATOR -DEDISK_FASTWRITE=1 -I. -o edisk4 tools/eDiskWrite.c eDisk.c FlashSim.c crc32.c
+//   gcc -O2 -Wall -DFLASH_SIMULATOR -DEDISK_ATOMICWRITE=1 -I. -o edisk1 tools/eDiskWrite.c eDisk.c FlashSim.c crc32.c
+
+#define _POSIX_C_SOURCE 199309L
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include "eDisk.h"
+#include "FlashSim.h"
+
+#define MHZ   80              // bus clock the time model is for
+#define PACKS 100000          // packs timed each way
+
+int32_t Critical;             // nesting of StartCritical
+uint32_t CriticalStart;       // FlashSim_Time when interrupts were disabled
+uint32_t CriticalMax;         // longest critical section, usec
+
+// interrupts are modelled as disabled from StartCritical to the
+// matching EndCritical, timed with the flash time model
+long StartCritical(void){
+  if(Critical == 0){
+    CriticalStart = FlashSim_Time;
+  }
+  Critical = Critical + 1;
+  return 0;
+}
+void EndCritical(long sr){
+  (void)sr;
+  Critical = Critical - 1;
+  if((Critical == 0) && ((FlashSim_Time - CriticalStart) > CriticalMax)){
+    CriticalMax = FlashSim_Time - CriticalStart;
+  }
+}
+
+volatile uint32_t Sink;
+
+// Time since an earlier clock_gettime, in nsec
+double elapsed(const struct timespec *start){
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (now.tv_sec - start->tv_sec)*1e9 + (now.tv_nsec - start->tv_nsec);
+}
+
+// the pack eDisk_WriteSector used before, one word from four bytes
+void shiftpack(uint32_t *words, const uint8_t *buff){
+  int i;
+  for(i=0; i<128; i=i+1){
+    words[i] = buff[4*i] + (buff[4*i+1]<<8) + (buff[4*i+2]<<16) + ((uint32_t)buff[4*i+3]<<24);
+  }
+}
+
+int main(void){
+  uint8_t buff[512], back[512];
+  uint32_t words[128];
+  uint32_t sector, i, bad = 0, window;
+  struct timespec start;
+  double tshift, tcopy;
+  int r;
+  FlashSim_Reset();
+  eDisk_Init(0);
+  for(sector=0; sector<EDISK_SECTORS; sector=sector+1){
+    for(i=0; i<512; i=i+1){
+      buff[i] = sector*3 + i;
+    }
+    if((eDisk_WriteSector(buff, sector) != RES_OK) ||
+       (eDisk_ReadSector(back, sector) != RES_OK) || memcmp(buff, back, 512)){
+      bad = bad + 1;
+    }
+  }
+  window = (CriticalMax > FlashSim_MaxBusy) ? CriticalMax : FlashSim_MaxBusy;
+  printf("EDISK_FASTWRITE %u, EDISK_ATOMICWRITE %u, %u sectors\n",
+    EDISK_FASTWRITE, EDISK_ATOMICWRITE, (unsigned)EDISK_SECTORS);
+  printf("per sector     %u flash operations, %.0f us, %.0f cycles at %u MHz\n",
+    (unsigned)((FlashSim_Bursts ? FlashSim_Bursts : FlashSim_Writes)/EDISK_SECTORS),
+    (double)FlashSim_Time/EDISK_SECTORS, (double)FlashSim_Time*MHZ/EDISK_SECTORS, MHZ);
+  printf("interrupts off %u us, %u cycles at most at a time\n",
+    (unsigned)window, (unsigned)(window*MHZ));
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for(i=0; i<PACKS; i=i+1){
+    buff[0] = i;
+    shiftpack(words, buff);
+    Sink = words[i%128];
+  }
+  tshift = elapsed(&start)/PACKS;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for(i=0; i<PACKS; i=i+1){
+    buff[0] = i;
+    memcpy(words, buff, 512);
+    Sink = words[i%128];
+  }
+  tcopy = elapsed(&start)/PACKS;
+  printf("pack on host   %.0f ns with shifts, %.0f ns with memcpy\n", tshift, tcopy);
+  printf("data           %u sectors wrong\n", (unsigned)bad);
+  r = (bad == 0);
+#if EDISK_FASTWRITE
+  r = r && (FlashSim_Bursts == 4*EDISK_SECTORS);
+#if EDISK_ATOMICWRITE
+  r = r && (window == 4*32*FLASHSIM_BURSTUS);
+#else
+  r = r && (window == 32*FLASHSIM_BURSTUS);
+#endif
+#else
+  r = r && (FlashSim_Writes == 128*EDISK_SECTORS) && (window == FLASHSIM_WRITEUS);
+#endif
+  printf("result         %s\n", r ? "pass" : "fail");
+  return !r;
+}
@@ -0,0 +1,157 @@
+// eFileAlloc.c
+// Runs on a host computer (Linux, Windows, Mac)
+// Benchmark of the free-sector allocator in eFile.c on the
+// 128 KB flash in FlashSim.c.  The disk is filled, one sector
+// at a time, round robin across 1 to 252 files.  Before each
+// append, the time to find the free sector and the end of the
+// file is measured twice: with the bitmap and tail pointers
+// of eFile.c, and with the directory walk the allocator used
+// to do (lastsector on every file, then a walk of the file
+// that is appended to).  Both must choose the same sector;
+// the times printed are the sums over the whole fill.
+// Then, with the flash failing, appends that cannot write back
+// the cache must fail without taking a sector, so that once
+// the flash works again the disk still fills to the last
+// sector.
+// Build and run from Lab5/, e.g.
+//   gcc -O2 -Wall -DFLASH_SIMULATOR -I. -o efilealloc tools/eFileAlloc.c eFile.c eCache.c eDisk.c FlashSim.c crc32.c
+
+#define _POSIX_C_SOURCE 199309L
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include "eDisk.h"
+#include "eFile.h"
+#include "FlashSim.h"
+
+#define REPEAT 200            // lookups timed per append
+
+// internals of eFile.c
+extern sectorType Directory[EFILE_FILES + 1], FAT[EDISK_SECTORS];
+extern int32_t bDirectoryLoaded;
+sectorType findfreesector(void);
+extern sectorType Tail[EFILE_FILES + 1];
+
+long StartCritical(void){ return 0; }
+void EndCritical(long sr){ (void)sr; }
+
+uint32_t Links;               // FAT links followed by the directory walk
+volatile sectorType Sink;     // keeps the timed lookups from being optimized out
+
+// Time since an earlier clock_gettime, in nsec
+double elapsed(const struct timespec *start){
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (now.tv_sec - start->tv_sec)*1e9 + (now.tv_nsec - start->tv_nsec);
+}
+
+// last sector of the file that starts at start, as the old
+// lastsector() found it
+sectorType oldlast(sectorType start){
+  if(start == EFILE_NONE){
+    return EFILE_NONE;
+  }
+  while(FAT[start] != EFILE_NONE){
+    start = FAT[start];
+    Links = Links + 1;
+  }
+  return start;
+}
+
+// the old findfreesector(): one past the largest last sector
+// of the files, stopping at the first empty directory entry
+sectorType oldfree(void){
+  int32_t free = -1;
+  uint32_t i;
+  sectorType last;
+  for(i=0; i<EFILE_FILES; i=i+1){
+    last = oldlast(Directory[i]);
+    if(last == EFILE_NONE){
+      break;
+    }
+    if((int32_t)last > free){
+      free = last;
+    }
+  }
+  return free + 1;
+}
+
+// Fill the disk across files files; returns 1 if all is well
+int fill(uint32_t files){
+  uint8_t buf[512];
+  struct timespec start;
+  double tnew = 0, told = 0;
+  uint32_t i, n = 0, num, mismatch = 0;
+  sectorType sector = 0;
+  FlashSim_Reset();
+  OS_File_Format();
+  Links = 0;
+  while(1){
+    num = n%files;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for(i=0; i<REPEAT; i=i+1){
+      sector = findfreesector();
+      Sink = Tail[num];
+    }
+    tnew = tnew + elapsed(&start)/REPEAT;
+    if(bDirectoryLoaded && (sector != EFILE_NONE)){
+      clock_gettime(CLOCK_MONOTONIC, &start);
+      for(i=0; i<REPEAT; i=i+1){
+        Sink = oldfree();
+        Sink = oldlast(Directory[num]);
+      }
+      told = told + elapsed(&start)/REPEAT;
+      if(oldfree() != sector){
+        mismatch = mismatch + 1;
+      }
+    }
+    memset(buf, n, 512);
+    if(OS_File_Append(num, buf)){
+      break;
+    }
+    n = n + 1;
+  }
+  OS_File_Flush();
+  printf("%5u  %7u  %10.1f  %10.1f  %8.1f  %8u\n", (unsigned)files, (unsigned)n,
+    tnew/1e3, told/1e3, told/tnew, (unsigned)(Links/REPEAT));
+  return (n == 252) && (mismatch == 0);
+}
+
+// Fail the flash while appending, then fill the rest
+// Output: 1 if every failed append left its sector free
+int failing(void){
+  uint8_t buf[512];
+  uint32_t n = 0, failed = 0;
+  FlashSim_Reset();
+  OS_File_Format();
+  memset(buf, 0x5A, 512);
+  FlashSim_PowerFail(0);
+  while(failed < 100){
+    if(OS_File_Append(0, buf) == 0){
+      n = n + 1;              // held in the cache
+    } else{
+      failed = failed + 1;
+    }
+  }
+  FlashSim_PowerFail(-1);
+  while(OS_File_Append(1, buf) == 0){
+    n = n + 1;
+  }
+  printf("%u appends failed while the flash was failing, %u sectors appended in all\n",
+    (unsigned)failed, (unsigned)n);
+  return (n == 252) && (OS_File_Flush() == 0);
+}
+
+int main(void){
+  static const uint32_t files[] = {1, 4, 16, 64, 252};
+  uint32_t i;
+  int r = 1;
+  printf("files  sectors  bitmap us     walk us  speedup  links walked\n");
+  for(i=0; i<sizeof(files)/sizeof(files[0]); i=i+1){
+    r = fill(files[i]) && r;
+  }
+  r = failing() && r;
+  printf("result         %s\n", r ? "pass" : "fail");
+  return !r;
+}
@@ -0,0 +1,183 @@
+// eFileCommit.c
+// Runs on a host computer (Linux, Windows, Mac)
+// Fault-injection test of the A/B directory commit in eFile.c on
+// the 128 KB flash in FlashSim.c.  A disk with a few named files
+// is committed, then more sectors are appended, a file is
+// named and OS_File_Flush is called, with the power cut after
+// 0, 1, 2, ... flash operations until the flush completes.
+// After each cut the RAM is forgotten and the disk mounted
+// again, and the files must be exactly as they were at one of
+// the two commits, old or new, never a mix, with every sector
+// intact.  Then a commit whose FAT has a cycle and a
+// cross-link, but a valid CRC, must mount in bounded time with
+// the chains cut.
+// Build and run from Lab5/, e.g.
+//   gcc -O2 -Wall -DFLASH_SIMULATOR -I. -o efilecommit tools/eFileCommit.c eFile.c eCache.c eDisk.c FlashSim.c crc32.c
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include "eDisk.h"
+#include "eCache.h"
+#include "eFile.h"
+#include "FlashSim.h"
+
+#define FILES 6               // files in use
+#define STATES 2              // the old and the new commit
+
+// internals of eFile.c and FlashSim.c
+extern sectorType Directory[EFILE_FILES + 1], FAT[EDISK_SECTORS];
+extern int32_t bDirectoryLoaded;
+extern int32_t bDirectoryDirty;
+extern sectorType NameFile[EFILE_NAMES];
+void MountDirectory(void);
+uint32_t findname(const char *name);
+extern uint8_t FlashSim_Memory[FLASHSIM_SIZE];
+
+long StartCritical(void){ return 0; }
+void EndCritical(long sr){ (void)sr; }
+
+uint8_t Saved[FLASHSIM_SIZE]; // the flash after the old commit
+sectorType Size[STATES][FILES]; // sectors of each file at each commit
+sectorType Named[STATES];     // file number of "late" at each commit
+
+// the data of a location of a file
+void fill(uint8_t *buf, uint32_t num, uint32_t location){
+  uint32_t i;
+  for(i=0; i<512; i=i+1){
+    buf[i] = (num*29 + location*3 + i)&0xFF;
+  }
+}
+
+// append count sectors to a file
+void append(uint32_t num, uint32_t count){
+  uint8_t buf[512];
+  while(count > 0){
+    fill(buf, num, OS_File_Size(num));
+    OS_File_Append(num, buf);
+    count = count - 1;
+  }
+}
+
+// forget everything in RAM and mount the disk again
+void remount(void){
+  eCache_Invalidate();
+  bDirectoryLoaded = 0;
+  MountDirectory();
+}
+
+// file number of a name, EFILE_NONE if there is none; unlike
+// OS_File_Open it does not add the name
+sectorType lookup(const char *name){
+  uint32_t i = findname(name);
+  return (i < EFILE_NAMES) ? NameFile[i] : EFILE_NONE;
+}
+
+// Which commit is on the disk, old (0) or new (1)?
+// Output: the state, or -1 for a mix or damaged data
+int state(void){
+  uint8_t buf[512], expect[512];
+  uint32_t s, num, location;
+  for(s=0; s<STATES; s=s+1){
+    for(num=0; (num<FILES) && (OS_File_Size(num) == Size[s][num]); num=num+1){
+    }
+    if((num == FILES) && (lookup("late") == Named[s])){
+      break;
+    }
+  }
+  if(s == STATES){
+    return -1;
+  }
+  for(num=0; num<FILES; num=num+1){
+    for(location=0; location<Size[s][num]; location=location+1){
+      fill(expect, num, location);
+      if(OS_File_Read(num, location, buf) || memcmp(buf, expect, 512)){
+        return -1;
+      }
+    }
+  }
+  return s;
+}
+
+// the changes made between the two commits
+void changes(void){
+  append(1, 3);
+  append(4, 5);
+  append(5, 1);
+  OS_File_Open("late");
+}
+
+int main(void){
+  uint32_t num, k, ops, seen[STATES] = {0}, mixed = 0, i;
+  char name[8];
+  int s, r;
+  FlashSim_Reset();
+  OS_File_Format();
+  for(num=0; num<FILES-2; num=num+1){
+    name[0] = 'f'; name[1] = '0' + num; name[2] = 0;
+    OS_File_Open(name);
+    append(num, 2 + 3*num);
+  }
+  OS_File_Flush();
+  for(num=0; num<FILES; num=num+1){
+    Size[0][num] = OS_File_Size(num);
+  }
+  Named[0] = EFILE_NONE;
+  memcpy(Saved, FlashSim_Memory, FLASHSIM_SIZE);
+  // the new commit, with the power on all the way
+  remount();
+  changes();
+  OS_File_Flush();
+  for(num=0; num<FILES; num=num+1){
+    Size[1][num] = OS_File_Size(num);
+  }
+  Named[1] = lookup("late");
+  // cut the power after k operations, for every k
+  for(k=0; ; k=k+1){
+    memcpy(FlashSim_Memory, Saved, FLASHSIM_SIZE);
+    remount();
+    changes();
+    FlashSim_PowerFail(k);
+    r = OS_File_Flush();
+    FlashSim_PowerFail(-1);
+    remount();
+    s = state();
+    if(s < 0){
+      printf("cut after %u operations: neither the old nor the new commit\n", (unsigned)k);
+      mixed = mixed + 1;
+    } else{
+      seen[s] = seen[s] + 1;
+    }
+    if(r == 0){
+      break;                  // the flush finished before the cut
+    }
+  }
+  ops = k;
+  printf("power cuts     %u, after 0 to %u flash operations\n", (unsigned)(ops + 1), (unsigned)ops);
+  printf("mounted        %u old, %u new, %u neither\n",
+    (unsigned)seen[0], (unsigned)seen[1], (unsigned)mixed);
+  r = (mixed == 0)&&(seen[0] > 0)&&(seen[1] > 0);
+
+  // commit a FAT with a cycle in file 0 and file 1 cross-linked
+  // into file 2; the CRC is valid, so only the walk can tell
+  memcpy(FlashSim_Memory, Saved, FLASHSIM_SIZE);
+  remount();
+  for(i=Directory[0]; FAT[i] != EFILE_NONE; i=FAT[i]){
+  }
+  FAT[i] = Directory[0];
+  for(i=Directory[1]; FAT[i] != EFILE_NONE; i=FAT[i]){
+  }
+  FAT[i] = FAT[Directory[2]];
+  bDirectoryDirty = 1;
+  OS_File_Flush();
+  remount();
+  printf("corrupt FAT    file 0 has %u sectors (a cycle of %u), file 1 %u (%u + cross-link), file 2 %u\n",
+    (unsigned)OS_File_Size(0), (unsigned)Size[0][0], (unsigned)OS_File_Size(1),
+    (unsigned)Size[0][1], (unsigned)OS_File_Size(2));
+  r = r&&(OS_File_Size(0) == Size[0][0])&&
+      (OS_File_Size(1) + OS_File_Size(2) <= Size[0][1] + Size[0][2]);
+  append(3, 1);
+  r = r&&(OS_File_Flush() == 0);
+  printf("result         %s\n", r ? "pass" : "fail");
+  return !r;
+}
@@ -0,0 +1,164 @@
+// eFileLogLatency.c
+// Runs on a host computer (Linux, Windows, Mac)
+// Append latency and interrupts-disabled time of the log file
+// system in eFileLog.c on the flash in FlashSim.c, with the
+// erasing and collection done inline (EFILE_BACKGROUND 0) or
+// by OS_File_Maintain in a maintenance thread (1).
+// A logger appends one sector every PERIOD usec to a few files
+// that are deleted when they reach FILESIZE sectors, so the
+// collector has work.  With EFILE_BACKGROUND 1 the Lab4
+// semaphores are replaced by a model of two threads: the
+// maintenance thread runs OS_File_Maintain steps in the time
+// between appends, a step that starts in that time running to
+// its end, and an append blocked on FileSpace lets it run
+// until space is signalled.
+// Time is the FlashSim time model.  Flash_Write and
+// Flash_Erase in FlashProgram.c disable interrupts for the
+// whole operation, so every flash operation is one window with
+// interrupts off.  It prints the worst window, and how many
+// windows longer than DEADLINE, i.e. erases, ran in the
+// appending thread and in the maintenance thread, then the
+// worst and mean append time and checks the data.
+// Build it both ways from Lab5/ and compare:
+//   gcc -O2 -Wall -DFLASH_SIMULATOR -DEFILE_BACKGROUND=0 -I. -o efilelat0 tools/eFileLogLatency.c eFileLog.c FlashSim.c
+//   gcc -O2 -Wall -DFLASH_SIMULATOR -DEFILE_BACKGROUND=1 -I. -o efilelat1 tools/eFileLogLatency.c eFileLog.c FlashSim.c
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "eDisk.h"
+#include "eFile.h"
+#include "eFileLog.h"
+#include "FlashSim.h"
+
+#define APPENDS  20000        // sectors appended
+#ifndef PERIOD
+#define PERIOD   128000       // usec between appends, 128 samples at 1 kHz
+#endif
+#define FILES    6            // files the logger rotates through
+#define FILESIZE 30           // a file is deleted when it has this many sectors
+#define DEADLINE 1000         // usec, the period of the fastest Lab4 thread
+
+extern int32_t FileSpace, FileWork, FileLock;  // in eFileLog.c
+
+uint8_t Gen[FILES];           // generation of each file, changes its data
+uint8_t Length[FILES];        // sectors of each file that were acknowledged
+uint32_t Bad;                 // sectors that did not read back as written
+uint32_t MaintainErases;      // erases done in the maintenance thread
+uint32_t Blocked;             // appends that waited for the maintenance thread
+
+// the data of one sector
+void fill(uint8_t *buf, uint32_t num, uint32_t location){
+  uint32_t i;
+  for(i=0; i<512; i=i+1){
+    buf[i] = (num*31 + Gen[num]*7 + location*13 + i)&0xFF;
+  }
+}
+
+#if EFILE_BACKGROUND
+int32_t Waiting;              // 1 while the appending thread is blocked
+
+// one step of the maintenance thread, with its erases counted
+uint8_t maintain(void){
+  uint32_t erases = FlashSim_Erases;
+  uint8_t work = OS_File_Maintain();
+  MaintainErases = MaintainErases + FlashSim_Erases - erases;
+  return work;
+}
+
+// The two threads share one processor: OS_Wait of a busy
+// FileSpace switches to the maintenance thread until space is
+// signalled, and OS_Wait of an empty FileWork returns to the
+// appending thread, which calls maintain again when it is idle.
+void OS_Wait(int32_t *semaPt){
+  (*semaPt) = (*semaPt) - 1;
+  if((*semaPt) >= 0){
+    return;
+  }
+  if(semaPt == &FileWork){
+    (*semaPt) = (*semaPt) + 1;  // idle, nothing to wake later
+  } else if((semaPt == &FileSpace) && (Waiting == 0)){
+    Waiting = 1;
+    Blocked = Blocked + 1;
+    while((*semaPt) < 0){
+      maintain();
+    }
+    Waiting = 0;
+  } else{
+    printf("deadlock on %s\n", (semaPt == &FileLock) ? "FileLock" : "FileSpace");
+    exit(1);
+  }
+}
+void OS_Signal(int32_t *semaPt){
+  (*semaPt) = (*semaPt) + 1;
+}
+#endif
+
+int main(void){
+  uint8_t buf[512], back[512];
+  uint32_t n, num, location, erases, appenderases = 0;
+  uint32_t start, t, tmax = 0;
+  double ttotal = 0;
+  int r;
+  FlashSim_Reset();
+  OS_File_Format();
+  FlashSim_MaxBusy = 0;
+  for(n=0; n<APPENDS; n=n+1){
+    num = n%FILES;
+    if(Length[num] == FILESIZE){
+      erases = FlashSim_Erases - MaintainErases;
+      if(OS_File_Delete(num) == 0){
+        Length[num] = 0;
+        Gen[num] = Gen[num] + 1;
+      }
+      appenderases = appenderases + FlashSim_Erases - MaintainErases - erases;
+    }
+    fill(buf, num, Length[num]);
+    erases = FlashSim_Erases - MaintainErases;
+    start = FlashSim_Time;
+    if(OS_File_Append(num, buf) == 0){
+      Length[num] = Length[num] + 1;
+    } else{
+      Bad = Bad + 1;
+    }
+    t = FlashSim_Time - start;
+    appenderases = appenderases + FlashSim_Erases - MaintainErases - erases;
+    ttotal = ttotal + t;
+    if(t > tmax){
+      tmax = t;
+    }
+#if EFILE_BACKGROUND
+    // the maintenance thread gets the rest of the period
+    start = FlashSim_Time + ((t < PERIOD) ? (PERIOD - t) : 0);
+    while((FlashSim_Time < start) && maintain()){
+    }
+#endif
+  }
+  for(num=0; num<FILES; num=num+1){
+    if(OS_File_Size(num) != Length[num]){
+      Bad = Bad + 1;
+    }
+    for(location=0; location<Length[num]; location=location+1){
+      fill(buf, num, location);
+      if(OS_File_Read(num, location, back) || memcmp(buf, back, 512)){
+        Bad = Bad + 1;
+      }
+    }
+  }
+  printf("EFILE_BACKGROUND %u, %u appends, one every %u us\n",
+    (unsigned)EFILE_BACKGROUND, (unsigned)APPENDS, (unsigned)PERIOD);
+  printf("interrupts off %u us at most at a time, longer than the %u us deadline %u times\n",
+    (unsigned)FlashSim_MaxBusy, (unsigned)DEADLINE, (unsigned)(appenderases + MaintainErases));
+  printf("               %u of them in the appending thread, %u in the maintenance thread\n",
+    (unsigned)appenderases, (unsigned)MaintainErases);
+  printf("append         %.0f us mean, %u us worst, %u blocked on FileSpace\n",
+    ttotal/APPENDS, (unsigned)tmax, (unsigned)Blocked);
+  printf("data           %u sectors wrong\n", (unsigned)Bad);
+  r = (Bad == 0)&&(FlashSim_Erases > 0)&&(FlashSim_MaxBusy == FLASHSIM_ERASEUS);
+#if EFILE_BACKGROUND
+  r = r&&(appenderases == 0);   // appends never erase in their own thread
+#endif
+  printf("result         %s\n", r ? "pass" : "fail");
+  return !r;
+}
@@ -0,0 +1,189 @@
+// eFileLogWear.c
+// Runs on a host computer (Linux, Windows, Mac)
+// Endurance benchmark of the log-structured file system in
+// eFileLog.c on the RAM flash in FlashSim.c.  A few files are
+// written once and never change (cold data); the rest of the
+// disk is churned by creating, appending and deleting files
+// until APPENDS sectors have been appended.  It reports the
+// erase count of every block, how evenly they wear, and how
+// many appends the disk lasts before its most-erased block
+// reaches the rated ENDURANCE cycles.
+// Then it fails the flash in the middle of appends, one write
+// or erase further each time, and checks that every append
+// that returned 0 can still be read back, both before and
+// after a mount, and that appends work again afterwards.
+// Build and run from Lab5/, e.g.
+//   gcc -O2 -Wall -DFLASH_SIMULATOR -I. -o efilelogwear tools/eFileLogWear.c eFileLog.c FlashSim.c
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include "eDisk.h"
+#include "eFile.h"
+#include "eFileLog.h"
+#include "FlashSim.h"
+
+#ifndef APPENDS
+#define APPENDS   200000      // sectors appended by the churn
+#endif
+#define ENDURANCE 100000      // rated erase cycles of a TM4C123 flash block
+#define COLDFILES 4           // files written once
+#define COLDSIZE  10          // sectors in each of them
+#define HOTFILES  8           // files churned at once
+#define MAXSPREAD 8           // most erases between the least and most worn blocks
+#define FAILURES  600         // operations into an append at which power is lost
+
+extern int32_t bDirectoryLoaded;  // in eFileLog.c
+void MountDirectory(void);
+
+uint8_t Gen[256];             // generation of each file, changes its data
+uint8_t Length[256];          // sectors of each file that were acknowledged
+uint8_t Buf[512];
+
+// the data of one sector, different for every file,
+// generation and location
+void fill(uint8_t *buf, uint32_t num, uint32_t location){
+  uint32_t i;
+  for(i=0; i<512; i=i+1){
+    buf[i] = (num*31 + Gen[num]*7 + location*13 + i)&0xFF;
+  }
+}
+
+// append one sector and remember it if the append succeeded
+int append(uint32_t num){
+  fill(Buf, num, Length[num]);
+  if(OS_File_Append(num, Buf)){
+    return 1;
+  }
+  Length[num] = Length[num] + 1;
+  return 0;
+}
+
+// delete a file, and start its next generation
+int delete(uint32_t num){
+  if(OS_File_Delete(num)){
+    return 1;
+  }
+  Length[num] = 0;
+  Gen[num] = Gen[num] + 1;
+  return 0;
+}
+
+// check every acknowledged sector of every file
+// Output: number of sectors that are missing or wrong
+uint32_t check(void){
+  uint8_t expect[512];
+  uint32_t num, location, bad = 0;
+  for(num=0; num<COLDFILES+HOTFILES; num=num+1){
+    if(OS_File_Size(num) < Length[num]){
+      bad = bad + Length[num] - OS_File_Size(num);
+    }
+    for(location=0; location<Length[num]; location=location+1){
+      fill(expect, num, location);
+      if(OS_File_Read(num, location, Buf) || memcmp(Buf, expect, 512)){
+        bad = bad + 1;
+      }
+    }
+  }
+  return bad;
+}
+
+// forget the RAM mapping and replay the log
+void mount(void){
+  bDirectoryLoaded = 0;
+  MountDirectory();
+}
+
+int main(void){
+  uint32_t i, n, num, appends = 0, fails = 0, bad, min, max, total;
+  uint32_t lost = 0, refused = 0, wrong = 0, stuck = 0;
+  uint32_t histogram[8] = {0};
+  int r;
+  FlashSim_Reset();
+  if(OS_File_Format()){
+    printf("OS_File_Format failed\n");
+    return 1;
+  }
+  for(num=0; num<COLDFILES; num=num+1){
+    for(i=0; i<COLDSIZE; i=i+1){
+      fails = fails + append(num);
+    }
+  }
+  // churn: fill each hot file to a size that depends on how
+  // far the run has got, then delete it and start over
+  num = COLDFILES;
+  while(appends < APPENDS){
+    n = 4 + (appends/7)%20;
+    while((Length[num] < n) && (appends < APPENDS)){
+      if(append(num)){
+        fails = fails + 1;
+        break;
+      }
+      appends = appends + 1;
+    }
+    num = num + 1;
+    if(num == COLDFILES+HOTFILES){
+      num = COLDFILES;
+    }
+    if(Length[num]){
+      fails = fails + delete(num);
+    }
+  }
+  bad = check();
+  mount();
+  bad = bad + check();
+  total = OS_File_Wear(&min, &max);
+  for(i=0; i<FLASHSIM_BLOCKS; i=i+1){
+    n = (FlashSim_EraseCount[i] > min) ? (FlashSim_EraseCount[i] - min)*8/(max - min + 1) : 0;
+    histogram[n] = histogram[n] + 1;
+  }
+  printf("appends        %u sectors, %u refused\n", (unsigned)appends, (unsigned)fails);
+  printf("erases         %u, %.2f appends per erase\n", (unsigned)total, (double)appends/total);
+  printf("programmed     %.2f words per appended word\n", FlashSim_Writes/(128.0*appends));
+  printf("erase count    min %u max %u spread %u\n", (unsigned)min, (unsigned)max, (unsigned)(max - min));
+  printf("blocks by erase count, %u to %u in 8 bins:", (unsigned)min, (unsigned)max);
+  for(i=0; i<8; i=i+1){
+    printf(" %u", (unsigned)histogram[i]);
+  }
+  printf("\n");
+  printf("lifetime       %.0f appends before a block reaches %u erases\n",
+    (double)appends*ENDURANCE/max, ENDURANCE);
+  printf("               %.0f with perfect levelling\n",
+    (double)appends*ENDURANCE*FLASHSIM_BLOCKS/total);
+  printf("data           %u sectors missing or wrong\n", (unsigned)bad);
+  r = (fails == 0)&&(bad == 0)&&((max - min) <= MAXSPREAD);
+
+  // power fails after i more flash operations, in the middle
+  // of an append; every append before it must survive
+  for(i=0; i<FAILURES; i=i+1){
+    num = COLDFILES + i%HOTFILES;
+    if(Length[num] >= 20){
+      delete(num);
+    }
+    FlashSim_PowerFail(i%40);
+    for(n=0; n<3; n=n+1){
+      append(num);            // may or may not be acknowledged
+    }
+    FlashSim_PowerFail(-1);
+    if(check()){
+      wrong = wrong + 1;      // lost before the mount
+    }
+    if(append(num)){
+      refused = refused + 1;  // the head block should have been closed
+    }
+    if(i%2){
+      mount();
+    }
+    if(check()){
+      lost = lost + 1;
+    }
+    if(append(num) || check()){
+      stuck = stuck + 1;
+    }
+  }
+  printf("power fails    %u: %u wrong before mount, %u lost, %u refused, %u stuck after\n",
+    (unsigned)FAILURES, (unsigned)wrong, (unsigned)lost, (unsigned)refused, (unsigned)stuck);
+  r = r&&(wrong == 0)&&(lost == 0)&&(refused == 0)&&(stuck == 0);
+  printf("result         %s\n", r ? "pass" : "fail");
+  return !r;
+}
@@ -0,0 +1,174 @@
+// eFileMap.c
+// Runs on a host computer (Linux, Windows, Mac)
+// Checks the in-place reads of eFile.c on the 128 KB flash in
+// FlashSim.c.  Two files are appended to in turn, so their
+// chains interleave, and every location of each is read with
+// OS_File_Map, then with a walk of OS_File_First and
+// OS_File_Next; each page must be the disk sector itself and
+// hold the bytes appended, and so must OS_File_Read after
+// each pass.
+// The sectors appended last are still dirty in eCache, with
+// the flash under them erased, so a page that shows the data
+// proves eCache_Clean wrote it before the pointer was handed
+// out.  Locations past the end, and an empty file, must give
+// 0.
+// Build and run from Lab5/, e.g.
+//   gcc -O2 -Wall -DFLASH_SIMULATOR -I. -o efilemap tools/eFileMap.c eFile.c eCache.c eDisk.c FlashSim.c crc32.c
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include "eDisk.h"
+#include "eCache.h"
+#include "eFile.h"
+#include "FlashSim.h"
+
+#define SIZE  40              // sectors appended to each file at first
+#define MORE  3               // sectors appended to each before the walk
+
+long StartCritical(void){ return 0; }
+void EndCritical(long sr){ (void)sr; }
+
+sectorType findsector(sectorType num, sectorType location);  // in eFile.c
+
+uint32_t Bad;                 // pages that were wrong
+
+// the data appended at a location of a file
+void pattern(uint8_t buf[512], sectorType num, sectorType location){
+  uint32_t i;
+  for(i=0; i<512; i=i+1){
+    buf[i] = (num*131 + location*7 + i)&0xFF;
+  }
+}
+
+// append the next sector of a file
+void append(sectorType num){
+  uint8_t buf[512];
+  pattern(buf, num, OS_File_Size(num));
+  if(OS_File_Append(num, buf)){
+    Bad = Bad + 1;
+  }
+}
+
+// append count sectors to each of two files, in turn
+void fill(sectorType a, sectorType b, uint32_t count){
+  uint32_t i;
+  for(i=0; i<count; i=i+1){
+    append(a);
+    append(b);
+  }
+}
+
+// count the locations of a file whose flash does not hold the
+// data yet, before any page of it is handed out
+uint32_t dirty(sectorType num){
+  uint8_t buf[512];
+  uint32_t n = 0;
+  sectorType location;
+  for(location=0; location<OS_File_Size(num); location=location+1){
+    pattern(buf, num, location);
+    if(memcmp(eDisk_Map(findsector(num, location)), buf, 512)){
+      n = n + 1;
+    }
+  }
+  return n;
+}
+
+// check one page handed out for a location; it must not
+// read through the cache, which could write back the dirty
+// sectors before they are handed out
+void check(const uint8_t *page, sectorType num, sectorType location){
+  uint8_t buf[512];
+  pattern(buf, num, location);
+  if((page == 0) || (page != eDisk_Map(findsector(num, location))) ||
+     memcmp(page, buf, 512)){
+    Bad = Bad + 1;
+  }
+}
+
+// check every location of a file with OS_File_Read
+void readall(sectorType num){
+  uint8_t buf[512], copy[512];
+  sectorType location;
+  for(location=0; location<OS_File_Size(num); location=location+1){
+    pattern(buf, num, location);
+    if(OS_File_Read(num, location, copy) || memcmp(copy, buf, 512)){
+      Bad = Bad + 1;
+    }
+  }
+}
+
+int main(void){
+  sectorType a, b, c, location;
+  struct fileiter it;
+  const uint8_t *page;
+  uint32_t mapped = 0, walked = 0, mapdirty = 0, walkdirty = 0, writebacks;
+  int r;
+  FlashSim_Reset();
+  OS_File_Format();
+  a = OS_File_New();
+  append(a);                  // a new file number is taken once it has a sector
+  b = OS_File_New();
+  append(b);
+  fill(a, b, SIZE - 1);
+  writebacks = eCache_WriteBacks;
+  // every location with OS_File_Map
+  mapdirty = dirty(a) + dirty(b);
+  for(location=0; location<OS_File_Size(a); location=location+1){
+    check(OS_File_Map(a, location), a, location);
+    mapped = mapped + 1;
+  }
+  for(location=0; location<OS_File_Size(b); location=location+1){
+    check(OS_File_Map(b, location), b, location);
+    mapped = mapped + 1;
+  }
+  readall(a);
+  readall(b);
+  // new dirty sectors, then every location with a walk
+  fill(a, b, MORE);
+  walkdirty = dirty(a) + dirty(b);
+  for(page=OS_File_First(a, &it); page; page=OS_File_Next(&it)){
+    if(it.location != walked){
+      Bad = Bad + 1;
+    }
+    check(page, a, it.location);
+    walked = walked + 1;
+  }
+  if((walked != OS_File_Size(a)) || OS_File_Next(&it)){
+    Bad = Bad + 1;            // too short, or does not stay at the end
+  }
+  location = 0;
+  for(page=OS_File_First(b, &it); page; page=OS_File_Next(&it)){
+    if(it.location != location){
+      Bad = Bad + 1;
+    }
+    check(page, b, it.location);
+    location = location + 1;
+  }
+  walked = walked + location;
+  if(location != OS_File_Size(b)){
+    Bad = Bad + 1;
+  }
+  readall(a);
+  readall(b);
+  writebacks = eCache_WriteBacks - writebacks;
+  // out of range
+  c = OS_File_New();
+  if(OS_File_Map(a, OS_File_Size(a)) || OS_File_Map(a, OS_File_Size(a) + 1) ||
+     OS_File_Map(b, EDISK_SECTORS - 1) || OS_File_Map(c, 0) ||
+     OS_File_First(c, &it) || OS_File_Next(&it)){
+    Bad = Bad + 1;
+  }
+  printf("files          2 of %u sectors, interleaved, and an empty one\n",
+    (unsigned)OS_File_Size(a));
+  printf("map            %u locations, %u of them dirty in the cache\n",
+    (unsigned)mapped, (unsigned)mapdirty);
+  printf("walk           %u locations, %u of them dirty in the cache\n",
+    (unsigned)walked, (unsigned)walkdirty);
+  printf("write-backs    %u after the files were filled\n", (unsigned)writebacks);
+  printf("errors         %u\n", (unsigned)Bad);
+  r = (Bad == 0)&&(mapped == 2*SIZE)&&(walked == 2*(SIZE + MORE))&&
+      (mapdirty > 0)&&(walkdirty > 0)&&(writebacks >= mapdirty + walkdirty);
+  printf("result         %s\n", r ? "pass" : "fail");
+  return !r;
+}
@@ -0,0 +1,141 @@
+// eFileNames.c
+// Runs on a host computer (Linux, Windows, Mac)
+// Cost of finding a named file in eFile.c as the name table
+// fills up to EFILE_NAMES names, on the 128 KB flash in
+// FlashSim.c.  At each size it times LOOKUPS lookups of names
+// that are in the table and of names that are not, two ways:
+//   hash    findname() in eFile.c, which probes the hash index
+//           from the bucket of the name
+//   scan    strncmp of every entry of the name table
+// and prints the mean and longest probe sequence of the hash
+// index.  Both must give the same answer, also after a mount
+// has rebuilt the index from the disk.
+// Build and run from Lab5/, e.g.
+//   gcc -O2 -Wall -DFLASH_SIMULATOR -I. -o efilenames tools/eFileNames.c eFile.c eCache.c eDisk.c FlashSim.c crc32.c
+
+#define _POSIX_C_SOURCE 199309L
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include "eDisk.h"
+#include "eCache.h"
+#include "eFile.h"
+#include "FlashSim.h"
+
+#define LOOKUPS 1000000       // lookups timed each way at each size
+#define NAMEBUCKETS 64        // as in eFile.c
+#define NOBUCKET    255
+
+// internals of eFile.c
+extern char Names[EFILE_NAMES][EFILE_NAMELEN];
+extern uint8_t NameHash[NAMEBUCKETS];
+extern uint32_t NameCount;
+extern int32_t bDirectoryLoaded;
+void MountDirectory(void);
+uint32_t findname(const char *name);
+uint32_t namehash(const char *name);
+
+long StartCritical(void){ return 0; }
+void EndCritical(long sr){ (void)sr; }
+
+char Name[2*EFILE_NAMES][EFILE_NAMELEN]; // the first EFILE_NAMES are added, the rest never
+volatile uint32_t Sink;
+uint32_t Bad;                 // lookups where the two ways disagree
+
+// Time since an earlier clock_gettime, in nsec
+double elapsed(const struct timespec *start){
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (now.tv_sec - start->tv_sec)*1e9 + (now.tv_nsec - start->tv_nsec);
+}
+
+// find a name by comparing it with every entry
+uint32_t scanname(const char *name){
+  uint32_t i;
+  for(i=0; i<NameCount; i=i+1){
+    if(strncmp(Names[i], name, EFILE_NAMELEN) == 0){
+      return i;
+    }
+  }
+  return EFILE_NAMES;
+}
+
+// number of buckets findname looks at for a name in the table
+uint32_t probes(const char *name){
+  uint32_t b = namehash(name), n = 1;
+  while((NameHash[b] != NOBUCKET) && strncmp(Names[NameHash[b]], name, EFILE_NAMELEN)){
+    b = (b + 1)&(NAMEBUCKETS - 1);
+    n = n + 1;
+  }
+  return n;
+}
+
+// time LOOKUPS lookups of names first to first+count-1, cycling
+double timed(uint32_t(*find)(const char *), uint32_t first, uint32_t count){
+  struct timespec start;
+  uint32_t i;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for(i=0; i<LOOKUPS; i=i+1){
+    Sink = find(Name[first + i%count]);
+  }
+  return elapsed(&start)/LOOKUPS;
+}
+
+// both ways must agree on every name
+void agree(void){
+  uint32_t i;
+  for(i=0; i<2*EFILE_NAMES; i=i+1){
+    if((findname(Name[i]) != scanname(Name[i])) ||
+       ((i < NameCount) != (findname(Name[i]) < EFILE_NAMES))){
+      Bad = Bad + 1;
+    }
+  }
+}
+
+int main(void){
+  uint32_t n, i, p, pmax, ptotal;
+  double hhit, hmiss, shit, smiss;
+  int r;
+  for(i=0; i<2*EFILE_NAMES; i=i+1){
+    snprintf(Name[i], EFILE_NAMELEN, (i%2) ? "log%u" : "sensor%u.dat", (unsigned)i);
+  }
+  FlashSim_Reset();
+  OS_File_Format();
+  printf("%u names at most, %u buckets\n", (unsigned)EFILE_NAMES, (unsigned)NAMEBUCKETS);
+  printf("names  hash hit  miss ns  scan hit  miss ns  probes mean  max\n");
+  for(n=1; n<=EFILE_NAMES; n=n+1){
+    if(OS_File_Open(Name[n-1]) == EFILE_NONE){
+      Bad = Bad + 1;
+    }
+    if((n != EFILE_NAMES) && (n&(n-1))){
+      continue;                 // report powers of 2 and the full table
+    }
+    agree();
+    pmax = 0;
+    ptotal = 0;
+    for(i=0; i<n; i=i+1){
+      p = probes(Name[i]);
+      ptotal = ptotal + p;
+      if(p > pmax){
+        pmax = p;
+      }
+    }
+    hhit = timed(findname, 0, n);
+    hmiss = timed(findname, EFILE_NAMES, EFILE_NAMES);
+    shit = timed(scanname, 0, n);
+    smiss = timed(scanname, EFILE_NAMES, EFILE_NAMES);
+    printf("%5u  %8.1f  %7.1f  %8.1f  %7.1f  %11.2f  %3u\n", (unsigned)n,
+      hhit, hmiss, shit, smiss, (double)ptotal/n, (unsigned)pmax);
+  }
+  OS_File_Flush();
+  eCache_Invalidate();
+  bDirectoryLoaded = 0;
+  MountDirectory();
+  agree();
+  printf("mount          %u names back\n", (unsigned)NameCount);
+  printf("errors         %u\n", (unsigned)Bad);
+  r = (Bad == 0)&&(NameCount == EFILE_NAMES)&&(hmiss < smiss);
+  printf("result         %s\n", r ? "pass" : "fail");
+  return !r;
+}
@@ -0,0 +1,136 @@
+// eFileScale.c
+// Runs on a host computer (Linux, Windows, Mac)
+// Mount time and append cost of eFile with 16-bit Directory and
+// FAT entries as a disk image fills up.  The disk is filled
+// round robin by FILES files; each time the number of sectors
+// used doubles, it flushes, times a mount from the image, and
+// times the next STEP appends.  After every mount the files
+// must have the sizes and data they had.
+// Build and run from Lab5/; EDISK_SECTORS sets the size of the
+// disk, 65536 (32 MB) by default, e.g.
+//   gcc -O2 -Wall -DEDISK_IMAGE -I. -o efilescale tools/eFileScale.c eFile.c eCache.c eDiskImage.c crc32.c
+//   ./efilescale /tmp/scale.img
+//   gcc -O2 -Wall -DEDISK_IMAGE -DEDISK_SECTORS=4096 -I. -o efilescale4k tools/eFileScale.c eFile.c eCache.c eDiskImage.c crc32.c
+
+#define _POSIX_C_SOURCE 199309L
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include "eDisk.h"
+#include "eCache.h"
+#define EFILE_LAYOUT            // DATASECTORS and the slots, from eFile.h
+#include "eFile.h"
+
+#ifndef FILES
+#define FILES 100             // files sharing the disk
+#endif
+#define STEP  256             // appends timed at each size
+
+extern int32_t bDirectoryLoaded;  // in eFile.c
+void MountDirectory(void);
+
+sectorType Size[FILES];       // sectors appended to each file
+uint32_t Bad;                 // sectors or sizes that were wrong after a mount
+
+// Time since an earlier clock_gettime, in usec
+double elapsed(const struct timespec *start){
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (now.tv_sec - start->tv_sec)*1e6 + (now.tv_nsec - start->tv_nsec)/1e3;
+}
+
+// the data of a location of a file, only its first word
+// is checked
+void fill(uint8_t *buf, uint32_t num, uint32_t location){
+  memset(buf, num, 512);
+  buf[0] = location;
+  buf[1] = location>>8;
+}
+
+// append to the next file; returns 1 when the disk is full
+int append(uint32_t n){
+  uint8_t buf[512];
+  uint32_t num = n%FILES;
+  fill(buf, num, Size[num]);
+  if(OS_File_Append(num, buf)){
+    return 1;
+  }
+  Size[num] = Size[num] + 1;
+  return 0;
+}
+
+// check the sizes, and the last sector of each file
+void check(void){
+  uint8_t buf[512], expect[512];
+  uint32_t num;
+  for(num=0; num<FILES; num=num+1){
+    if(OS_File_Size(num) != Size[num]){
+      Bad = Bad + 1;
+    } else if(Size[num] > 0){
+      fill(expect, num, Size[num] - 1);
+      if(OS_File_Read(num, Size[num] - 1, buf) || memcmp(buf, expect, 512)){
+        Bad = Bad + 1;
+      }
+    }
+  }
+}
+
+int main(int argc, char **argv){
+  struct timespec start;
+  double tmount, tflush, t, tmax, ttotal;
+  uint32_t n = 0, next = STEP, used, i;
+  int full = 0, r;
+  eDisk_ImageName = (argc > 1) ? argv[1] : "scale.img";
+  remove(eDisk_ImageName);
+  if((eDisk_Init(0) != RES_OK) || OS_File_Format()){
+    printf("%s: cannot create the image\n", eDisk_ImageName);
+    return 1;
+  }
+  printf("%u sectors, %u-byte entries, %u files\n",
+    (unsigned)EDISK_SECTORS, (unsigned)sizeof(sectorType), (unsigned)FILES);
+  printf("   used  flush ms  mount ms  append us mean  max\n");
+  while(!full){
+    while((n < next) && !full){
+      full = append(n);
+      if(!full){
+        n = n + 1;
+      }
+    }
+    used = n;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    OS_File_Flush();
+    tflush = elapsed(&start);
+    eCache_Invalidate();
+    bDirectoryLoaded = 0;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    MountDirectory();
+    tmount = elapsed(&start);
+    check();
+    ttotal = 0;
+    tmax = 0;
+    for(i=0; (i<STEP) && !full; i=i+1){
+      clock_gettime(CLOCK_MONOTONIC, &start);
+      full = append(n);
+      t = elapsed(&start);
+      if(!full){
+        n = n + 1;
+        ttotal = ttotal + t;
+        if(t > tmax){
+          tmax = t;
+        }
+      }
+    }
+    printf("%7u  %8.2f  %8.2f  %14.2f  %5.1f\n", (unsigned)used, tflush/1e3, tmount/1e3,
+      i ? ttotal/i : 0.0, tmax);
+    next = 2*n;
+  }
+  OS_File_Flush();
+  eCache_Invalidate();
+  bDirectoryLoaded = 0;
+  check();
+  printf("full           %u sectors, %u wrong after a mount\n", (unsigned)n, (unsigned)Bad);
+  r = (Bad == 0)&&(n == DATASECTORS);
+  printf("result         %s\n", r ? "pass" : "fail");
+  return !r;
+}
@@ -0,0 +1,140 @@
+// eFileSeek.c
+// Runs on a host computer (Linux, Windows, Mac)
+// Measures random seeks, the cost of finding the sector that
+// holds a location of a file, on a 65536-sector (32 MB) disk
+// image filled round robin by FILES files.  Each seek is done
+// three ways:
+//   index   findsector() in eFile.c, a binary search of the
+//           skip index then at most SKIPSTRIDE-1 links
+//   scan    a linear scan of the skip index for the entries of
+//           the file, as findsector() did before
+//   walk    following the FAT from the first sector, as eFile
+//           did with no index at all
+// All three must find the same sector, also after a mount
+// has rebuilt the index.
+// Build and run from Lab5/, e.g.
+//   gcc -O2 -Wall -DEDISK_IMAGE -I. -o efileseek tools/eFileSeek.c eFile.c eCache.c eDiskImage.c crc32.c
+//   ./efileseek /tmp/seek.img
+
+#define _POSIX_C_SOURCE 199309L
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "eDisk.h"
+#include "eFile.h"
+
+#ifndef FILES
+#define FILES  64             // files sharing the disk
+#endif
+#define SEEKS  20000          // random seeks timed each way
+#define SKIPSTRIDE 16         // as in eFile.c
+
+// internals of eFile.c
+extern sectorType Directory[EFILE_FILES + 1], FAT[EDISK_SECTORS];
+extern sectorType SkipFile[], SkipSector[];
+extern uint32_t Skips;
+extern int32_t bDirectoryLoaded;
+void MountDirectory(void);
+sectorType findsector(sectorType num, sectorType location);
+
+sectorType Num[SEEKS], Location[SEEKS], Found[SEEKS];
+volatile sectorType Sink;
+
+// Time since an earlier clock_gettime, in nsec
+double elapsed(const struct timespec *start){
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (now.tv_sec - start->tv_sec)*1e9 + (now.tv_nsec - start->tv_nsec);
+}
+
+// the linear scan of the skip index
+sectorType scan(sectorType num, sectorType location){
+  sectorType sector = Directory[num];
+  uint32_t i, k = location/SKIPSTRIDE;
+  for(i=0; (i<Skips) && (k>0); i=i+1){
+    if(SkipFile[i] == num){
+      sector = SkipSector[i];
+      k = k - 1;
+    }
+  }
+  for(i=0; i<(location%SKIPSTRIDE); i=i+1){
+    sector = FAT[sector];
+  }
+  return sector;
+}
+
+// follow the FAT from the start of the file
+sectorType walk(sectorType num, sectorType location){
+  sectorType sector = Directory[num];
+  while(location > 0){
+    sector = FAT[sector];
+    location = location - 1;
+  }
+  return sector;
+}
+
+// Time SEEKS seeks with one of the methods, in nsec per seek,
+// counting the ones that disagree with Found
+double timeseeks(sectorType (*seek)(sectorType, sectorType), uint32_t *wrong){
+  struct timespec start;
+  uint32_t i;
+  double t;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for(i=0; i<SEEKS; i=i+1){
+    Sink = seek(Num[i], Location[i]);
+  }
+  t = elapsed(&start)/SEEKS;
+  for(i=0; i<SEEKS; i=i+1){
+    if(seek(Num[i], Location[i]) != Found[i]){
+      *wrong = *wrong + 1;
+    }
+  }
+  return t;
+}
+
+int main(int argc, char **argv){
+  uint8_t buf[512];
+  uint32_t i, n = 0, wrong = 0;
+  double tindex, tscan, twalk;
+  sectorType size[FILES];
+  int r;
+  eDisk_ImageName = (argc > 1) ? argv[1] : "seek.img";
+  remove(eDisk_ImageName);
+  if((eDisk_Init(0) != RES_OK) || OS_File_Format()){
+    printf("%s: cannot create the image\n", eDisk_ImageName);
+    return 1;
+  }
+  memset(buf, 0x5A, 512);
+  while(OS_File_Append(n%FILES, buf) == 0){
+    n = n + 1;
+  }
+  if(OS_File_Flush()){
+    printf("OS_File_Flush failed\n");
+    return 1;
+  }
+  for(i=0; i<FILES; i=i+1){
+    size[i] = OS_File_Size(i);
+  }
+  srand(1);
+  for(i=0; i<SEEKS; i=i+1){
+    Num[i] = rand()%FILES;
+    Location[i] = rand()%size[Num[i]];
+    Found[i] = walk(Num[i], Location[i]);
+  }
+  printf("%u sectors, %u files of %u sectors, %u skip entries\n",
+    (unsigned)EDISK_SECTORS, (unsigned)FILES, (unsigned)size[0], (unsigned)Skips);
+  tindex = timeseeks(&findsector, &wrong);
+  tscan = timeseeks(&scan, &wrong);
+  twalk = timeseeks(&walk, &wrong);
+  printf("seek           index %.0f ns, scan %.0f ns, walk %.0f ns\n", tindex, tscan, twalk);
+  bDirectoryLoaded = 0;
+  MountDirectory();
+  tindex = timeseeks(&findsector, &wrong);
+  printf("after mount    index %.0f ns\n", tindex);
+  printf("wrong sectors  %u\n", (unsigned)wrong);
+  r = (wrong == 0)&&(n > 65000)&&(tindex < tscan);
+  printf("result         %s\n", r ? "pass" : "fail");
+  return !r;
+}
@@ -0,0 +1,483 @@
+// eFileTool.c
+// Runs on a host computer (Linux)
+// Command line tool that builds, inspects, checks and
+// benchmarks eFile disk images.  It links the same eFile,
+// eCache and eStream code as the board, on top of the
+// file-backed eDisk in eDiskImage.c, so an image holds exactly
+// what the file system would write to a disk of that size.
+// Build it from the Lab5 directory:
+//   gcc -O2 -Wall -DEDISK_IMAGE -I. -o efiletool tools/eFileTool.c
+//       eDiskImage.c eFile.c eCache.c eStream.c crc32.c
+// Add -DEDISK_SECTORS=n for a disk of n sectors (default
+// 65536, a 32 MB image); an image must be used with the
+// geometry it was created with.
+// Usage:
+//   efiletool create IMAGE [FILE...]  format, then put each FILE
+//   efiletool put IMAGE NAME FILE     append FILE to named file NAME
+//   efiletool get IMAGE NAME          write named file NAME to stdout
+//   efiletool ls IMAGE                list files, sizes and names
+//   efiletool fat IMAGE [NUM]         dump the FAT chain of each file
+//   efiletool fsck IMAGE              check for cycles, cross-links and orphans
+//   efiletool replay IMAGE WORKLOAD   run a workload and time each operation
+// put and get use eStream files.  fat and fsck read the
+// Directory and FAT as they are on the disk, before mount
+// cuts broken chains.  fsck exits with 1 if it finds errors.
+// A workload is a text file with one operation per line;
+// FILE is a file number or a name, # starts a comment:
+//   format                 OS_File_Format
+//   mount                  forget the RAM directory and mount again
+//   new                    OS_File_New
+//   open NAME              OS_File_Open
+//   append FILE COUNT      append COUNT sectors
+//   read FILE FIRST COUNT  read COUNT sectors from location FIRST
+//   flush                  OS_File_Flush
+
+#define _POSIX_C_SOURCE 199309L
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "eDisk.h"
+#include "eCache.h"
+#define EFILE_LAYOUT            // DATASECTORS and the slots, from eFile.h
+#include "eFile.h"
+#include "eStream.h"
+
+// internals of eFile.c
+extern sectorType Directory[EFILE_FILES + 1], FAT[EDISK_SECTORS];
+extern int32_t bDirectoryLoaded;
+extern uint32_t MetaSlot, MetaSeq;
+extern char Names[EFILE_NAMES][EFILE_NAMELEN];
+extern sectorType NameFile[EFILE_NAMES];
+extern uint32_t NameCount;
+void MountDirectory(void);
+void unpackmeta(uint32_t k, const uint8_t buff[512]);
+
+extern uint32_t eCache_Hits, eCache_Misses, eCache_WriteBacks;
+
+sectorType Owner[EDISK_SECTORS];  // file using each sector, for fat and fsck
+
+// Open the image, which must already exist unless create is 1
+static int openimage(const char *image, int create){
+  FILE *fp;
+  if(create == 0){
+    fp = fopen(image, "rb");
+    if(fp == 0){
+      fprintf(stderr, "%s: no such image\n", image);
+      return 1;
+    }
+    fclose(fp);
+  }
+  eDisk_ImageName = image;
+  if(eDisk_Init(0) != RES_OK){
+    fprintf(stderr, "%s: cannot open image\n", image);
+    return 1;
+  }
+  return 0;
+}
+
+// Mount, then replace the RAM Directory and FAT with the
+// copy on the disk, before mount repaired it; 0 if none.
+static int loadraw(void){
+  uint8_t buff[512];
+  uint32_t k;
+  MountDirectory();
+  if(MetaSlot == NOSLOT){
+    return 0;
+  }
+  for(k=0; k<METASECTORS; k=k+1){
+    if(eDisk_ReadSector(buff, MetaSlot + k) != RES_OK){
+      return 0;
+    }
+    unpackmeta(k, buff);
+  }
+  bDirectoryLoaded = 0;         // the RAM copy is no longer usable
+  return 1;
+}
+
+// Return the name of a file, or "" if it has none
+static const char *nameof(uint32_t num){
+  uint32_t i;
+  for(i=0; i<NameCount; i=i+1){
+    if(NameFile[i] == num){
+      return Names[i];
+    }
+  }
+  return "";
+}
+
+// Append a host file to a named eFile file with a stream
+static int putfile(const char *name, const char *path){
+  FILE *fp;
+  uint8_t data[512];
+  size_t n;
+  uint8_t h;
+  sectorType num;
+  int status = 0;
+  fp = fopen(path, "rb");
+  if(fp == 0){
+    fprintf(stderr, "%s: cannot read\n", path);
+    return 1;
+  }
+  num = OS_File_Open(name);
+  if(num == EFILE_NONE){
+    fprintf(stderr, "%s: bad name, or no room for another file\n", name);
+    fclose(fp);
+    return 1;
+  }
+  h = OS_Stream_Open(num, STREAM_WRITE);
+  while((n = fread(data, 1, sizeof(data), fp)) > 0){
+    if(OS_Stream_Write(h, data, n) != n){
+      fprintf(stderr, "%s: disk full\n", path);
+      status = 1;
+      break;
+    }
+  }
+  if(OS_Stream_Close(h) || OS_File_Flush()){
+    status = 1;
+  }
+  fclose(fp);
+  return status;
+}
+
+// Copy a named eFile file to stdout
+static int getfile(const char *name){
+  uint8_t data[512];
+  uint32_t n;
+  uint8_t h;
+  sectorType num = OS_File_Open(name);
+  if(num == EFILE_NONE){
+    fprintf(stderr, "%s: bad name\n", name);
+    return 1;
+  }
+  h = OS_Stream_Open(num, STREAM_READ);
+  while((n = OS_Stream_Read(h, data, sizeof(data))) > 0){
+    fwrite(data, 1, n, stdout);
+  }
+  OS_Stream_Close(h);
+  return 0;
+}
+
+// List every file that has sectors or a name
+static int list(void){
+  uint32_t i, files = 0, used = 0;
+  sectorType size;
+  MountDirectory();
+  if(MetaSlot == NOSLOT){
+    printf("no valid directory, the disk is empty\n");
+  } else{
+    printf("directory slot %u, sequence %u\n", MetaSlot, MetaSeq);
+  }
+  printf(" file  sectors  first  name\n");
+  for(i=0; i<EFILE_FILES; i=i+1){
+    size = OS_File_Size(i);
+    if((size > 0) || (*nameof(i) != 0)){
+      printf("%5u  %7u  %5u  %s\n", i, size, Directory[i], nameof(i));
+      files = files + 1;
+      used = used + size;
+    }
+  }
+  printf("%u files, %u of %u data sectors used\n", files, used, (uint32_t)DATASECTORS);
+  return 0;
+}
+
+// Print the FAT chain of one file, stopping at a link out of
+// the disk or back to a sector of the same chain (a cycle)
+static void chain(uint32_t num){
+  sectorType sector = Directory[num];
+  printf("%u:", num);
+  while(sector != EFILE_NONE){
+    printf(" %u", sector);
+    if((sector >= EDISK_SECTORS) || (Owner[sector] == num)){
+      printf(" ...");
+      break;
+    }
+    Owner[sector] = num;
+    sector = FAT[sector];
+  }
+  printf("\n");
+}
+
+// Dump the chain of one file, or of every file in use
+static int dumpfat(int argc, char **argv){
+  uint32_t i;
+  if(loadraw() == 0){
+    printf("no valid directory\n");
+    return 0;
+  }
+  for(i=0; i<EDISK_SECTORS; i=i+1){
+    Owner[i] = EFILE_NONE;
+  }
+  if(argc > 3){
+    i = strtoul(argv[3], 0, 0);
+    if(i >= EFILE_FILES){
+      fprintf(stderr, "file numbers are 0 to %u\n", EFILE_FILES - 1);
+      return 1;
+    }
+    chain(i);
+    return 0;
+  }
+  for(i=0; i<EFILE_FILES; i=i+1){
+    if(Directory[i] != EFILE_NONE){
+      chain(i);
+    }
+  }
+  return 0;
+}
+
+// Check the on-disk Directory, FAT and name table
+static int fsck(void){
+  uint32_t i, j, errors = 0, files = 0, used = 0;
+  sectorType sector, prev;
+  if(loadraw() == 0){
+    printf("no valid directory, the disk is empty\n");
+    return 0;
+  }
+  for(i=0; i<EDISK_SECTORS; i=i+1){
+    Owner[i] = EFILE_NONE;
+  }
+  for(i=0; i<EFILE_FILES; i=i+1){
+    sector = Directory[i];
+    prev = EFILE_NONE;
+    if(sector != EFILE_NONE){
+      files = files + 1;
+    }
+    while(sector != EFILE_NONE){
+      if(sector >= DATASECTORS){
+        printf("file %u: link %u -> %u is outside the data sectors\n", i, prev, sector);
+        errors = errors + 1;
+        break;
+      }
+      if(Owner[sector] == i){
+        printf("file %u: cycle at sector %u\n", i, sector);
+        errors = errors + 1;
+        break;
+      }
+      if(Owner[sector] != EFILE_NONE){
+        printf("file %u: sector %u is cross-linked with file %u\n", i, sector, Owner[sector]);
+        errors = errors + 1;
+        break;
+      }
+      Owner[sector] = i;
+      used = used + 1;
+      prev = sector;
+      sector = FAT[sector];
+    }
+  }
+  for(i=0; i<DATASECTORS; i=i+1){
+    if((Owner[i] == EFILE_NONE) && (FAT[i] != EFILE_NONE)){
+      printf("sector %u: orphan, linked to %u but in no file\n", i, FAT[i]);
+      errors = errors + 1;
+    }
+  }
+  for(i=DATASECTORS; i<EDISK_SECTORS; i=i+1){
+    if(FAT[i] != EFILE_NONE){
+      printf("sector %u: directory slot sector has FAT entry %u\n", i, FAT[i]);
+      errors = errors + 1;
+    }
+  }
+  for(i=0; i<NameCount; i=i+1){
+    for(j=0; j<i; j=j+1){
+      if(strcmp(Names[i], Names[j]) == 0){
+        printf("name %s: used twice\n", Names[i]);
+        errors = errors + 1;
+      }
+      if(NameFile[i] == NameFile[j]){
+        printf("file %u: has names %s and %s\n", NameFile[i], Names[j], Names[i]);
+        errors = errors + 1;
+      }
+    }
+  }
+  printf("%u files, %u names, %u of %u data sectors used, %u errors\n",
+         files, NameCount, used, (uint32_t)DATASECTORS, errors);
+  return errors ? 1 : 0;
+}
+
+// Time spent in each kind of workload operation
+enum op{ FORMAT, MOUNT, NEW, OPEN, APPEND, READ, FLUSH, OPS };
+const char *OpNames[OPS] = {"format", "mount", "new", "open", "append", "read", "flush"};
+struct opstat{
+  uint32_t count;    // number of operations
+  uint32_t sectors;  // sectors appended or read
+  uint32_t fails;    // operations that returned an error
+  double total;      // usec
+  double max;        // usec of the slowest one
+};
+struct opstat Stats[OPS];
+
+// Time since an earlier clock_gettime, in usec
+static double elapsed(const struct timespec *start){
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (now.tv_sec - start->tv_sec)*1e6 + (now.tv_nsec - start->tv_nsec)/1e3;
+}
+
+// File number of a workload argument, a number or a name
+static sectorType fileof(const char *arg){
+  char *end;
+  uint32_t num = strtoul(arg, &end, 0);
+  if((*arg != 0) && (*end == 0)){
+    return (num < EFILE_FILES) ? num : EFILE_NONE;
+  }
+  return OS_File_Open(arg);
+}
+
+// Run one workload line; returns the kind of operation, or
+// OPS if the line is blank or not understood
+static enum op runline(char *line, uint32_t *sectors, int *fail){
+  char *cmd, *a, *b, *c;
+  uint8_t buff[512];
+  sectorType num;
+  uint32_t i, first, count;
+  cmd = strtok(line, " \t\r\n");
+  a = strtok(0, " \t\r\n");
+  b = strtok(0, " \t\r\n");
+  c = strtok(0, " \t\r\n");
+  *sectors = 0;
+  *fail = 0;
+  if((cmd == 0) || (*cmd == '#')){
+    return OPS;
+  }
+  if(strcmp(cmd, "format") == 0){
+    *fail = OS_File_Format();
+    return FORMAT;
+  }
+  if(strcmp(cmd, "mount") == 0){
+    bDirectoryLoaded = 0;
+    MountDirectory();
+    return MOUNT;
+  }
+  if(strcmp(cmd, "new") == 0){
+    *fail = (OS_File_New() == EFILE_NONE);
+    return NEW;
+  }
+  if((strcmp(cmd, "open") == 0) && a){
+    *fail = (OS_File_Open(a) == EFILE_NONE);
+    return OPEN;
+  }
+  if((strcmp(cmd, "append") == 0) && a && b){
+    num = fileof(a);
+    count = strtoul(b, 0, 0);
+    for(i=0; (i<count) && (num != EFILE_NONE); i=i+1){
+      memset(buff, i, 512);
+      if(OS_File_Append(num, buff)){
+        break;
+      }
+    }
+    *sectors = i;
+    *fail = (i < count);
+    return APPEND;
+  }
+  if((strcmp(cmd, "read") == 0) && a && b && c){
+    num = fileof(a);
+    first = strtoul(b, 0, 0);
+    count = strtoul(c, 0, 0);
+    for(i=0; (i<count) && (num != EFILE_NONE); i=i+1){
+      if(OS_File_Read(num, first + i, buff)){
+        break;
+      }
+    }
+    *sectors = i;
+    *fail = (i < count);
+    return READ;
+  }
+  if(strcmp(cmd, "flush") == 0){
+    *fail = OS_File_Flush();
+    return FLUSH;
+  }
+  return OPS;
+}
+
+// Replay a workload file and report the time of each kind
+// of operation and the cache statistics
+static int replay(const char *path){
+  FILE *fp;
+  char line[128];
+  char copy[128];
+  struct timespec start;
+  double t;
+  uint32_t n = 0, sectors;
+  int fail;
+  enum op kind;
+  fp = fopen(path, "r");
+  if(fp == 0){
+    fprintf(stderr, "%s: cannot read\n", path);
+    return 1;
+  }
+  eCache_Invalidate();
+  while(fgets(line, sizeof(line), fp)){
+    n = n + 1;
+    strcpy(copy, line);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    kind = runline(line, &sectors, &fail);
+    t = elapsed(&start);
+    if(kind == OPS){
+      if((strtok(copy, " \t\r\n") != 0) && (copy[0] != '#')){
+        fprintf(stderr, "%s:%u: not understood\n", path, n);
+        fclose(fp);
+        return 1;
+      }
+      continue;
+    }
+    Stats[kind].count = Stats[kind].count + 1;
+    Stats[kind].sectors = Stats[kind].sectors + sectors;
+    Stats[kind].fails = Stats[kind].fails + fail;
+    Stats[kind].total = Stats[kind].total + t;
+    if(t > Stats[kind].max){
+      Stats[kind].max = t;
+    }
+  }
+  fclose(fp);
+  printf("operation  count  sectors  fails   total us    mean us     max us\n");
+  for(kind=0; kind<OPS; kind=kind+1){
+    if(Stats[kind].count){
+      printf("%-9s %6u %8u %6u %10.1f %10.2f %10.1f\n", OpNames[kind],
+             Stats[kind].count, Stats[kind].sectors, Stats[kind].fails, Stats[kind].total,
+             Stats[kind].total/Stats[kind].count, Stats[kind].max);
+    }
+  }
+  printf("cache: %u hits, %u misses, %u write-backs\n",
+         eCache_Hits, eCache_Misses, eCache_WriteBacks);
+  return 0;
+}
+
+// Return the last part of a path
+static const char *leafname(const char *path){
+  const char *pt = strrchr(path, '/');
+  return pt ? pt + 1 : path;
+}
+
+int main(int argc, char **argv){
+  int i, status = 0;
+  const char *cmd = (argc > 2) ? argv[1] : "";
+  if(strcmp(cmd, "create") == 0){
+    if(openimage(argv[2], 1) || OS_File_Format() || OS_File_Flush()){
+      return 1;
+    }
+    for(i=3; i<argc; i=i+1){
+      status = status | putfile(leafname(argv[i]), argv[i]);
+    }
+    return status;
+  }
+  if(strcmp(cmd, "put") == 0 && (argc == 5)){
+    return openimage(argv[2], 0) || putfile(argv[3], argv[4]);
+  }
+  if(strcmp(cmd, "get") == 0 && (argc == 4)){
+    return openimage(argv[2], 0) || getfile(argv[3]);
+  }
+  if(strcmp(cmd, "ls") == 0){
+    return openimage(argv[2], 0) || list();
+  }
+  if(strcmp(cmd, "fat") == 0){
+    return openimage(argv[2], 0) || dumpfat(argc, argv);
+  }
+  if(strcmp(cmd, "fsck") == 0){
+    return openimage(argv[2], 0) || fsck();
+  }
+  if(strcmp(cmd, "replay") == 0 && (argc == 4)){
+    return openimage(argv[2], 0) || replay(argv[3]);
+  }
+  fprintf(stderr, "usage: %s create|put|get|ls|fat|fsck|replay IMAGE ...\n", argv[0]);
+  return 2;
+}
@@ -0,0 +1,160 @@
+// eStreamBench.c
+// Runs on a host computer (Linux, Windows, Mac)
+// Throughput of 16-byte records written to the 128 KB flash in
+// FlashSim.c through eFile, three ways:
+//   stream   OS_Stream_Write of each record
+//   by hand  the application packs 32 records in a 512-byte
+//            buffer and appends it when it is full
+//   sector   one OS_File_Append per record, the rest of the
+//            sector wasted
+// For each it prints the records written until the disk is
+// full, the host time per record, and the flash time per
+// record from the FlashSim time model.  Then it reads the
+// stream back, seeks to random records and counts the sectors
+// each seek reads, and checks that a second writer on the
+// same file is refused.
+// Build and run from Lab5/, e.g.
+//   gcc -O2 -Wall -DFLASH_SIMULATOR -I. -o estreambench tools/eStreamBench.c eFile.c eCache.c eStream.c eDisk.c FlashSim.c crc32.c
+
+#define _POSIX_C_SOURCE 199309L
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "eDisk.h"
+#include "eCache.h"
+#include "eFile.h"
+#include "eStream.h"
+#include "FlashSim.h"
+
+#define RECORD 16             // bytes in one record
+#define SEEKS  1000
+
+long StartCritical(void){ return 0; }
+void EndCritical(long sr){ (void)sr; }
+
+// Time since an earlier clock_gettime, in nsec
+double elapsed(const struct timespec *start){
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (now.tv_sec - start->tv_sec)*1e9 + (now.tv_nsec - start->tv_nsec);
+}
+
+// record n, which holds its own number
+void record(uint8_t *rec, uint32_t n){
+  uint32_t i;
+  for(i=0; i<RECORD; i=i+1){
+    rec[i] = (i < 4) ? (n>>(8*i)) : (n*5 + i);
+  }
+}
+
+void report(const char *name, uint32_t n, double t){
+  printf("%-9s %8u %11.0f %12.1f %10.1f\n", name, (unsigned)n, t/n,
+    (double)FlashSim_Time/n, (n*RECORD*100.0)/(FlashSim_Writes*4.0));
+}
+
+// start over with an empty disk and one empty file
+void format(void){
+  FlashSim_Reset();
+  OS_File_Format();
+  OS_File_New();
+}
+
+int main(void){
+  uint8_t rec[RECORD], back[RECORD], buf[512];
+  uint32_t n, k, i, records, reads, maxreads = 0, bad = 0, before;
+  struct timespec start;
+  uint8_t h, h2;
+  int r;
+  printf("method     records  host ns/rec  flash us/rec  flash use %%\n");
+  format();
+  h = OS_Stream_Open(0, STREAM_WRITE);
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for(n=0; ; n=n+1){
+    record(rec, n);
+    if(OS_Stream_Write(h, rec, RECORD) != RECORD){
+      break;
+    }
+  }
+  OS_Stream_Close(h);
+  OS_File_Flush();
+  report("stream", n, elapsed(&start));
+  records = n;
+  format();
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for(n=0; ; n=n+1){
+    record(&buf[RECORD*(n%32)], n);
+    if(((n%32) == 31) && OS_File_Append(0, buf)){
+      break;
+    }
+  }
+  OS_File_Flush();
+  report("by hand", n - 31, elapsed(&start));
+  format();
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for(n=0; ; n=n+1){
+    record(buf, n);
+    if(OS_File_Append(0, buf)){
+      break;
+    }
+  }
+  OS_File_Flush();
+  report("sector", n, elapsed(&start));
+
+  // write the stream again, in two sessions, and check it
+  format();
+  for(k=0; k<2; k=k+1){
+    h = OS_Stream_Open(0, STREAM_WRITE);
+    h2 = OS_Stream_Open(0, STREAM_WRITE);
+    if(h2 != 255){
+      printf("a second writer was not refused\n");
+      bad = bad + 1;
+      OS_Stream_Close(h2);
+    }
+    for(n=k*(records/3); n<(k+1)*(records/3); n=n+1){
+      record(rec, n);
+      OS_Stream_Write(h, rec, RECORD);
+    }
+    OS_Stream_Close(h);
+  }
+  records = 2*(records/3);
+  h = OS_Stream_Open(0, STREAM_READ);
+  for(n=0; n<records; n=n+1){
+    record(rec, n);
+    if((OS_Stream_Read(h, back, RECORD) != RECORD) || memcmp(rec, back, RECORD)){
+      bad = bad + 1;
+    }
+  }
+  if(OS_Stream_Read(h, back, 1) != 0){
+    bad = bad + 1;              // past the end
+  }
+  srand(1);
+  for(i=0; i<SEEKS; i=i+1){
+    n = (i == 0) ? (records - 1) : rand()%records;
+    before = eCache_Hits + eCache_Misses;
+    if(OS_Stream_Seek(h, n*RECORD)){
+      bad = bad + 1;
+      continue;
+    }
+    reads = eCache_Hits + eCache_Misses - before;
+    if(reads > maxreads){
+      maxreads = reads;
+    }
+    record(rec, n);
+    if((OS_Stream_Read(h, back, RECORD) != RECORD) || memcmp(rec, back, RECORD)){
+      bad = bad + 1;
+    }
+  }
+  if((OS_Stream_Seek(h, records*RECORD) != 0) || (OS_Stream_Read(h, back, 1) != 0) ||
+     (OS_Stream_Seek(h, records*RECORD + 1) != 255)){
+    bad = bad + 1;              // the end is a valid position, one past it is not
+  }
+  OS_Stream_Close(h);
+  printf("seek           %u seeks in %u sectors, at most %u sector reads each\n",
+    (unsigned)SEEKS, (unsigned)OS_File_Size(0), (unsigned)maxreads);
+  printf("errors         %u\n", (unsigned)bad);
+  r = (bad == 0)&&(maxreads <= 10);
+  printf("result         %s\n", r ? "pass" : "fail");
+  return !r;
+}
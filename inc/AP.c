@@ -56,16 +56,120 @@
 #include "../inc/AP.h"
 #include "../inc/tm4c123gh6pm.h"
 #include "../inc/GPIO.h"
+#include "../inc/NPI.h"
 
 
-const uint32_t RECVSIZE=128;
+#define RECVSIZE (16+AP_MAXMTU)  // a write indication of MTU-3 bytes
 uint8_t RecvBuf[RECVSIZE];
+uint16_t AttMtu = 23;    // ATT MTU of the connection, 23 until the central asks for more
 
-uint32_t fcserr;      // debugging counts of errors
 uint32_t TimeOutErr;  // debugging counts of no response errors
-uint32_t NoSOFErr;    // debugging counts of no SOF errors
+int32_t AP_SRDYFell;  // falling edges of SRDY not yet waited for
+uint32_t SRDYArmed;   // 1 once AP_WaitEvent has armed the SRDY interrupt
+// FCS and framing errors are counted by the receiver in NPI.c
 
 #define APTIMEOUT 40000   // 10 ms
+#define APFRAMETIMEOUT 400000 // 100 ms, longer than the largest frame takes at 115200 bps
+
+//**kernel macros**APKERNEL defined in AP.h******
+#ifdef APKERNEL
+void OS_Suspend(void);
+void OS_Wait(int32_t *semaPt);
+void OS_Signal(int32_t *semaPt);
+#define Yield() OS_Suspend()
+#define TakeFrame() OS_Wait(&NPI_FrameReady)
+#define SignalSRDY() do{ OS_Signal(&AP_SRDYFell); OS_Suspend(); }while(0) // run the BLE thread now
+#define WaitSRDY() OS_Wait(&AP_SRDYFell)
+#elif defined(SNP_SIMULATOR)
+#define Yield() SNPSim_Wait()   // let virtual time pass, see SNPSim.h
+#define TakeFrame()
+#else
+#define Yield()
+#define TakeFrame()
+#endif
+
+//**transport lock****************************
+// Each AP function that uses the link, the in-flight table or
+// the characteristic lists holds the lock, so threads take
+// turns and do not mix their frames.  It is recursive: the
+// callbacks AP_Poll runs can call AP functions.
+#ifdef APKERNEL
+struct tcb;
+extern struct tcb *RunPt;  // thread running, in os.c
+int32_t APMutex = 1;       // 1 when no thread holds the lock
+struct tcb *LockOwner;
+uint32_t LockDepth;        // times LockOwner took the lock
+static void lock(void){
+  if(LockDepth && (LockOwner == RunPt)){
+    LockDepth = LockDepth + 1;  // again, from a callback
+    return;
+  }
+  OS_Wait(&APMutex);
+  LockOwner = RunPt;
+  LockDepth = 1;
+}
+static void unlock(void){
+  LockDepth = LockDepth - 1;
+  if(LockDepth == 0){
+    OS_Signal(&APMutex);
+  }
+}
+#elif defined(SNP_SIMULATOR)
+#define lock() SNPSim_Lock()     // host threads, see SNPSim.h
+#define unlock() SNPSim_Unlock()
+#else
+#define lock()                   // one thread, nothing to share
+#define unlock()
+#endif
+
+#ifndef APKERNEL
+#define SignalSRDY() do{ AP_SRDYFell = AP_SRDYFell + 1; }while(0)
+// interrupts are off between the test and the sleep, so an edge
+// in between is not lost: a pending interrupt still ends WFI
+static void WaitSRDY(void){
+  DisableInterrupts();
+  while(AP_SRDYFell <= 0){
+    WaitForInterrupt(); // sleep until the next interrupt
+    EnableInterrupts(); // let it run
+    DisableInterrupts();
+  }
+  AP_SRDYFell = AP_SRDYFell - 1;
+  EnableInterrupts();
+}
+#endif
+
+// AP_SendMessage queues the frame in the UART1 transmit FIFO
+// and returns; the UART1 interrupt raises MRDY once the last
+// byte is on the wire.  The next AP call finishes the
+// handshake by waiting for SRDY to go high.
+volatile uint32_t SendBusy; // 1 while a frame is still being transmitted
+uint32_t SendOpen;          // 1 until SRDY is seen high after the last frame
+
+// AP_SendCommand returns once its frame is queued, and the
+// command waits here for its response.  The SNP answers in
+// order, so a response completes the oldest command that
+// expects that cmd0/cmd1.
+typedef struct Commands{
+  uint8_t used;                // 1 while waiting for the response
+  uint8_t cmd0;                // response expected, 0x75 for a 0x35 request
+  uint8_t cmd1;
+  uint32_t seq;                // order in which the commands were sent
+  void (*done)(uint32_t tag, int result, uint8_t *response);
+  uint32_t tag;                // passed to done
+}command_t;
+command_t InFlight[AP_INFLIGHT];
+uint32_t InFlightCount;   // number of commands waiting for a response
+uint32_t CommandSeq;      // sequence number of the next command
+uint32_t CommandErr;      // 1 if a command failed since the last AP_Flush
+uint32_t UnmatchedFrames; // debugging count of frames no command or indication expected
+static int recvFrame(void);
+static void reserve(void);
+static int issue(uint8_t *pt, void(*done)(uint32_t tag, int result, uint8_t *response), uint32_t tag);
+static int post(const uint8_t *pt, int sealed, void(*done)(uint32_t tag, int result, uint8_t *response), uint32_t tag);
+static int sendMessage(uint8_t *pt);
+static int transmit(const uint8_t *pt, int sealed);
+static int recvMessage(uint8_t *pt, uint32_t max);
+static uint32_t recvStatus(void);
 
 //**debug macros**APDEBUG defined in AP.h********
 #ifdef APDEBUG
@@ -95,7 +199,7 @@ void AP_Reset(void){
 const uint8_t HCI_EXT_ResetSystemCmd[] = {SOF,0x03,0x00,0x55,0x04,0x1D,0xFC,0x01,0xB2};
 const uint8_t NPI_GetStatus[] =   {SOF,0x00,0x00,0x55,0x06,0x53};
 const uint8_t NPI_GetVersion[] =  {SOF,0x00,0x00,0x35,0x03,0x36};
-uint8_t NPI_AddService[] = {
+const uint8_t NPI_AddService[] = {
   SOF,3,0x00,     // length = 3
   0x35,0x81,      // SNP Add Service
   0x01,           // Primary Service
@@ -136,7 +240,7 @@ const uint8_t NPI_SetAdvertisementSAP[] = {
   0x00,           // 0dBm
   0x77};          // FCS (calculated by AP_SendMessageResponse)
 
-uint8_t NPI_GATTSetDeviceName[] = {   
+const uint8_t NPI_GATTSetDeviceName[] = {   
   SOF,22,0x00,    // length = 22
   0x35,0x8C,      // SNP Set GATT Parameter (0x8C)
   0x01,           // Generic Access Service
@@ -144,7 +248,7 @@ uint8_t NPI_GATTSetDeviceName[] = {
   'S','h','a','p','e',' ','t','h','e',' ','W','o','r','l','d',' ','0','0','1',
   0x77};          // FCS (calculated by AP_SendMessageResponse)
 
-uint8_t NPI_SetAdvertisementData[] = {   
+const uint8_t NPI_SetAdvertisementData[] = {   
   SOF,31,0x00,    // length = 32
   0x55,0x43,      // SNP Set Advertisement Data
   0x00,           // Scan Response Data
@@ -172,38 +276,36 @@ const uint8_t NPI_StartAdvertisement[] = {
   0x00,0x01,0x00,0x00,0x00,0xC5, // RFU
   0x02,           // Advertising will restart with connectable advertising when a connection is terminated
   0xBB};          // FCS (calculated by AP_SendMessageResponse)
-uint8_t NPI_ReadConfirmation[] = {   
+const uint8_t NPI_ReadConfirmation[] = {   
   SOF,0x08,0x00,  // length = 8 (7+data length, filled in dynamically)
   0x55,0x87,      // SNP Characteristic Read Confirmation (0x87)
-  0x00,           // Success
+  0x00,           // Success (filled in dynamically)
   0x00,0x00,      // handle of connection always 0
   0x00,0x00,      // Handle of the characteristic value attribute being read (filled in dynamically
-  0x00,0x00,      // offset, ignored, assumes small chucks of data
-  0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,  // actual data (filled in dynamically)
-  0x00};          // FCS (calculated by AP_SendMessageResponse)
-uint8_t NPI_WriteConfirmation[] = {   
+  0x00,0x00,      // offset of the data in the value, for long reads (filled in dynamically)
+  0x00};          // up to MTU-1 bytes of data and FCS (calculated by AP_SendMessage)
+const uint8_t NPI_WriteConfirmation[] = {   
   SOF,0x03,0x00,  // length = 3
   0x55,0x88,      // SNP Characteristic Write Confirmation
   0x00,           // Success
   0x00,0x00,      // handle of connection always 0
   0xDE};          // FCS (calculated by AP_SendMessageResponse)
-uint8_t NPI_CCCDUpdatedConfirmation[] = {   
+const uint8_t NPI_CCCDUpdatedConfirmation[] = {   
   SOF,0x03,0x00,  // length = 3
   0x55,0x8B,      // SNP CCCD Updated Confirmation (0x8B)
   0x00,           // Success
   0x00,0x00,      // handle of connection always 0
   0xDD};          // FCS (calculated by AP_SendMessageResponse)
-uint8_t NPI_SendNotificationIndication[] = {   
-  SOF,0x07,0x00,  // length = 7 to 14 depending on data size
+const uint8_t NPI_SendNotificationIndication[] = {   
+  SOF,0x07,0x00,  // length = 7 to MTU+3 depending on data size
   0x55,0x89,      // SNP Send Notification Indication (0x89))
   0x00,0x00,      // handle of connection always 0
   0x00,0x00,      // Handle of the characteristic value attribute to notify / indicate (filled in dynamically
   0x00,           // RFU
   0x01,           // Indication Request type
-  0x00,0,0,0,0,0,0,0, // 1 to 8 bytes of data filled in dynamically
-  0xDD};      // FCS (calculated by AP_SendMessageResponse)
+  0x00};          // up to MTU-3 bytes of data and FCS (calculated by AP_SendMessage)
 
-uint8_t NPI_AddCharValue[] = {   
+const uint8_t NPI_AddCharValue[] = {   
   SOF,0x08,0x00,  // length = 8
   0x35,0x82,      // SNP Add Characteristic Value Declaration
   0x03,           // 0=none,1=read,2=write, 3=Read+write, GATT Permission
@@ -212,7 +314,7 @@ uint8_t NPI_AddCharValue[] = {
   0x00,0x02,      // Maximum length of the attribute value=512
   0xF1,0xFF,      // UUID
   0xBA};          // FCS (calculated by AP_SendMessageResponse)
-uint8_t NPI_AddCharDescriptor[] = {   
+const uint8_t NPI_AddCharDescriptor[] = {   
   SOF,0x17,0x00,  // length determined at run time 6+string length
   0x35,0x83,      // SNP Add Characteristic Descriptor Declaration
   0x80,           // User Description String
@@ -222,6 +324,24 @@ uint8_t NPI_AddCharDescriptor[] = {
   'C','h','a','r','a','c','t','e','r','i','s','t','i','c',' ','0',0, // Initial user description string
   0x0C,0,0,0};    // FCS (calculated by AP_SendMessageResponse)
 
+// Frames are built here from the templates above, with the
+// lock held, only once the command has room in the in-flight
+// table (see reserve), so no frame is handled between building
+// and sending one.  AP_SendMessage copies the frame into the
+// UART1 transmit FIFO, after which TxBuf is free again.
+#define TXSIZE (13+AP_MAXMTU)  // a read confirmation of MTU-1 bytes
+uint8_t TxBuf[TXSIZE];
+
+// copy a template into TxBuf, to be filled in
+// Input: pt, template, size, bytes to copy
+// Output: TxBuf
+static uint8_t *build(const uint8_t *pt, uint32_t size){ uint32_t i;
+  for(i=0; i<size; i++){
+    TxBuf[i] = pt[i];
+  }
+  return TxBuf;
+}
+
 //------------AP_Init------------
 // Initialize serial link and GPIO to Bluetooth module
 // see GPIO.c file for hardware connections 
@@ -236,17 +356,24 @@ int AP_Init(void){int bwaiting;   int count = 0;
   }
   UART0_OutString("\n\rReset CC2650");
 #endif
+  NPI_Init();     // empty frame queue, clear FCS and framing error counts
   UART1_Init();
-  fcserr = 0;     // number of packets with FCS errors
+  SendBusy = 0;   // no frame being sent
+  SendOpen = 0;
+  for(count=0; count<AP_INFLIGHT; count++){
+    InFlight[count].used = 0;   // no commands waiting
+  }
+  InFlightCount = 0;
+  CommandErr = 0;
+  AttMtu = 23;       // until the first connection asks for more
+  UnmatchedFrames = 0;
   TimeOutErr = 0; // debugging counts of no response error
-  NoSOFErr =0 ;   // debugging counts of no SOF error
   bwaiting = 1; // waiting for reset
   while(bwaiting){
     AP_Reset();
     count = 0;  // should get SNP power up within 30 ms (duration is arbitrary and 'count' value is uncalibrated)
     while(count < 600000){
-      if(AP_RecvStatus()){
-        AP_RecvMessage(RecvBuf,RECVSIZE);
+      if(recvFrame()){
         if((RecvBuf[3]==0x55)&&(RecvBuf[4]==0x01)){
           count = 600000;
           bwaiting = 0; // success
@@ -255,12 +382,11 @@ int AP_Init(void){int bwaiting;   int count = 0;
       count = count + 1;
     }
   } 
-  AP_SendMessageResponse((uint8_t*)HCI_EXT_ResetSystemCmd,RecvBuf,RECVSIZE); 
+  sendMessage((uint8_t*)HCI_EXT_ResetSystemCmd); // its response, if any, is skipped below
   count = 0;  // should get SNP power up within 120 ms (duration is arbitrary and 'count' value is uncalibrated)
   bwaiting = 1; // waiting for SNP power up
   while(count < 6000000){
-    if(AP_RecvStatus()){
-      AP_RecvMessage(RecvBuf,RECVSIZE);
+    if(recvFrame()){
       if((RecvBuf[3]==0x55)&&(RecvBuf[4]==0x01)){
         count = 6000000;
         bwaiting = 0; // success
@@ -323,16 +449,71 @@ void AP_EchoReceived(int response){ uint32_t size; int i;
 #define AP_EchoSendMessage(MESSAGE)
 #define AP_EchoReceived(R)
 #endif
+// run by the UART1 interrupt once the stop bit of the FCS is sent
+static void sendDone(void){
+  SetMRDY();        //   MRDY=1
+  SendBusy = 0;
+}
+
+// finish the handshake of the previous AP_SendMessage:
+// wait for its bytes to be sent, then for SRDY to be high
+// Input: none
+// Output: APOK on success, APFAIL on timeout
+static int endSend(void){
+  uint32_t waitCount;
+  if(SendOpen == 0){
+    return APOK;     // nothing outstanding
+  }
+  SendOpen = 0;
+  waitCount = 0;
+  while(SendBusy){
+    Yield();         // let other threads run while the bytes go out
+    waitCount++;
+    if(waitCount>APFRAMETIMEOUT){
+      UART1_OutComplete(0);
+      SetMRDY();     //   MRDY=1
+      SendBusy = 0;
+      TimeOutErr++;  // no response error
+      return APFAIL;
+    }
+  }
+  waitCount = 0;
+  while(ReadSRDY()==0){
+    waitCount++;
+    if(waitCount>APTIMEOUT){
+      TimeOutErr++;  // no response error
+      return APFAIL; // timeout??
+    }
+  }
+  return APOK;
+}
+
 //------------AP_SendMessage------------
 // sends a message to the Bluetooth module
 // calculates/sends FCS at end 
 // FCS is the 8-bit EOR of all bytes except SOF and FCS itself
 // 1) Send NPI package (it will calculate fcs)
-// 2) Wait for entire message to be sent
+// 2) Return while the UART1 interrupt sends it
+// The frame is copied into the UART1 transmit FIFO, so the
+// message buffer can be reused as soon as this returns.
 // Input: pointer to NPI encoded array
 // Output: APOK on success, APFAIL on timeout
-int AP_SendMessage(uint8_t *pt){
+int AP_SendMessage(uint8_t *pt){ int r;
+  lock();
+  r = sendMessage(pt);
+  unlock();
+  return r;
+}
+// AP_SendMessage with the lock held
+static int sendMessage(uint8_t *pt){
+  return transmit(pt, 0);
+}
+// send a frame, with the lock held; if sealed its FCS is already
+// in place (AP_StartGATT), otherwise it is calculated
+static int transmit(const uint8_t *pt, int sealed){
   uint8_t fcs; uint32_t waitCount; uint8_t data; uint32_t size;
+// 0) finish the previous message, a failure there was already counted
+  endSend();
 // 1) Make MRDY=0
   ClearMRDY();
 // 2) wait for SRDY to be low
@@ -340,12 +521,22 @@ int AP_SendMessage(uint8_t *pt){
   while(ReadSRDY()){
     waitCount++;
     if(waitCount>APTIMEOUT){
+      SetMRDY();     //   MRDY=1
       TimeOutErr++;  // no response error
       return APFAIL; // timeout??
     } 
   }
-// 3) Send NPI package
-  size = AP_GetSize(pt);
+// 3) Queue NPI package
+  size = AP_GetSize((uint8_t *)pt);
+  SendBusy = 1;
+  SendOpen = 1;
+  if(sealed){
+    for(int i=0;i<size+6;i++){
+      UART1_OutChar(pt[i]);                            // SOF to FCS
+    }
+    UART1_OutComplete(&sendDone);
+    return APOK;
+  }
   fcs=0;
   UART1_OutChar(SOF); pt++;
   data=*pt; UART1_OutChar(data); fcs=fcs^data; pt++;   // LSB length
@@ -357,19 +548,8 @@ int AP_SendMessage(uint8_t *pt){
   }
   UART1_OutChar(fcs);                                  // FCS
   
-// 4) Wait for entire message to be sent
-  UART1_FinishOutput();
-// 5) Make MRDY=1
-  SetMRDY();        //   MRDY=1  
-// 6) wait for SRDY to be high
-  waitCount = 0;
-  while(ReadSRDY()==0){
-    waitCount++;
-    if(waitCount>APTIMEOUT){
-      TimeOutErr++;  // no response error
-      return APFAIL; // timeout??
-    } 
-  }
+// 4) Make MRDY=1 once the entire message has been sent
+  UART1_OutComplete(&sendDone);
   return APOK;
 }
 
@@ -379,13 +559,24 @@ int AP_SendMessage(uint8_t *pt){
 // receive a message from the Bluetooth module
 // 1) receive NPI package
 // 2) Wait for entire message to be received
+// The bytes are collected and checked by the UART1 interrupt
+// (see NPI.c), so this only waits for the whole frame.
 // Input: pointer to empty buffer into which data is returned
 //        maximum size (discard data beyond this limit)
 // Output: APOK if ok, APFAIL on error (timeout or fcs error)
-int AP_RecvMessage(uint8_t *pt, uint32_t max){
-  uint8_t fcs; uint32_t waitCount; uint8_t data,cmd0,cmd1; 
-  uint8_t msb,lsb;
-  uint32_t size,count,SOFcount=10;
+int AP_RecvMessage(uint8_t *pt, uint32_t max){ int r;
+  lock();
+  r = recvMessage(pt, max);
+  unlock();
+  return r;
+}
+// AP_RecvMessage with the lock held
+static int recvMessage(uint8_t *pt, uint32_t max){
+  uint32_t waitCount;
+// 0) finish the handshake of a message just sent
+  if(endSend() == APFAIL){
+    return APFAIL;
+  }
 // 1) wait for SRDY to be low
   waitCount = 0;
   while(ReadSRDY()){
@@ -397,48 +588,20 @@ int AP_RecvMessage(uint8_t *pt, uint32_t max){
   }
 // 2) Make MRDY=0
   ClearMRDY();
-// 3) receive NPI package
-  // wait for SOF
-  do{
-    data = UART1_InChar();
-    SOFcount--;
-    if(SOFcount==0){
+// 3) wait for the NPI package, frames with FCS errors are dropped
+  waitCount = 0;
+  while(NPI_RxFrames() == 0){
+    Yield();         // let other threads run while the bytes arrive
+    waitCount++;
+    if(waitCount>APFRAMETIMEOUT){
       SetMRDY();     //   MRDY=1  
-      NoSOFErr++;    // no SOF error
+      NPI_Resync();  // a byte may have been lost, wait for the next SOF
+      TimeOutErr++;  // no response error
       return APFAIL;
     }
-  }while(data != SOF);
-  *pt = data; pt++;
-  fcs = 0;
-// get size, once we get SOF, it is highly likely for the rest to come
-  lsb = UART1_InChar(); *pt = lsb; fcs=fcs^lsb; pt++;
-  msb = UART1_InChar(); *pt = msb; fcs=fcs^msb; pt++;
-// get command
-  cmd0 = UART1_InChar(); *pt = cmd0; fcs=fcs^cmd0; pt++;
-  cmd1 = UART1_InChar(); *pt = cmd1; fcs=fcs^cmd1; pt++;
-  count = 5;
-  size = (msb<<8)+lsb;
-// get payload
-  for(int i=0;i<size;i++){
-    data = UART1_InChar(); 
-    fcs = fcs^data; 
-    count++;
-    if(count <= max){
-      *pt = data; 
-      pt++; // payload
-    }
-  }
-// get FCB
-  data = UART1_InChar(); 
-  count++;
-  if(count <= max){
-    *pt = data; 
-  }    
-  if(data != fcs){ 
-    fcserr++;
-    SetMRDY();        //   MRDY=1  
-    return APFAIL;
   }
+  TakeFrame();
+  NPI_GetFrame(pt, max);
 // 4) Make MRDY=1
   SetMRDY();        //   MRDY=1  
 // 5) wait for SRDY to be high
@@ -454,67 +617,389 @@ int AP_RecvMessage(uint8_t *pt, uint32_t max){
 // Inputs: none
 // Outputs: 0 if no communication needed, 
 //          nonzero for communication ready 
-uint32_t AP_RecvStatus(void){
+uint32_t AP_RecvStatus(void){ uint32_t r;
+  lock();
+  r = recvStatus();
+  unlock();
+  return r;
+}
+// AP_RecvStatus with the lock held
+static uint32_t recvStatus(void){
+  if(SendOpen){
+    if(SendBusy){
+      Yield();      // SRDY is low for the message still being sent
+      return 0;
+    }
+    endSend();
+  }
   return (ReadSRDY()==0);
 }
 
+// get the next frame from the Bluetooth module into RecvBuf
+// A frame can arrive while a command is being sent, so the
+// frames already collected by the UART1 interrupt come first.
+// Input: none
+// Output: 1 if a frame was received, 0 if none is waiting
+static int recvFrame(void){
+  if(NPI_RxFrames()){
+    TakeFrame();
+    NPI_GetFrame(RecvBuf,RECVSIZE);
+    return 1;
+  }
+  if(recvStatus()){
+    return (recvMessage(RecvBuf,RECVSIZE) == APOK);
+  }
+  return 0;
+}
+
+// response the SNP sends for a message
+// Input: pt, NPI message
+//        cmd0, cmd1, pointers to store the expected response
+// Output: 1 if a response is expected, 0 if not
+static int replyOf(uint8_t *pt, uint8_t *cmd0, uint8_t *cmd1){
+  *cmd0 = pt[3];
+  *cmd1 = pt[4];
+  if(pt[3] == 0x35){
+    *cmd0 = 0x75;      // synchronous request, synchronous response
+    return 1;
+  }
+  if((pt[4]==0x87)||(pt[4]==0x88)||(pt[4]==0x8B)){
+    return 0;          // confirmation of an indication, no response
+  }
+  if(pt[4] == 0x42){
+    *cmd1 = 0x05;      // start advertisement is answered by an event
+  }
+  return 1;
+}
+
+// remove command i from the in-flight table and report the result
+static void complete(uint32_t i, int result, uint8_t *response){
+  void (*done)(uint32_t tag, int result, uint8_t *response);
+  done = InFlight[i].done;
+  InFlight[i].used = 0;
+  InFlightCount--;
+  if(result == APFAIL){
+    CommandErr = 1;
+  }
+  if(done){
+    (*done)(InFlight[i].tag, result, response);
+  }
+}
+
+// index of the oldest command in flight that expects cmd0/cmd1,
+// or any command if match is 0; AP_INFLIGHT if there is none
+static uint32_t oldest(int match, uint8_t cmd0, uint8_t cmd1){
+  uint32_t i, best;
+  best = AP_INFLIGHT;
+  for(i=0; i<AP_INFLIGHT; i++){
+    if(InFlight[i].used){
+      if((match == 0)||((InFlight[i].cmd0 == cmd0)&&(InFlight[i].cmd1 == cmd1))){
+        if((best == AP_INFLIGHT)||((int32_t)(InFlight[i].seq - InFlight[best].seq) < 0)){
+          best = i;
+        }
+      }
+    }
+  }
+  return best;
+}
+
+static void indication(void);
+static void unsubscribe(void);
+// handle the frame in RecvBuf: indications go to the
+// characteristics, responses complete their command
+static void dispatch(void){
+  uint32_t i; uint16_t event;
+  uint8_t cmd0 = RecvBuf[3], cmd1 = RecvBuf[4]; // callbacks can reuse RecvBuf
+  AP_EchoReceived(APOK);
+  if((cmd0==0x55)&&((cmd1==0x87)||(cmd1==0x88)||(cmd1==0x8B))){
+    indication();
+    return;
+  }
+  if((cmd0==0x55)&&(cmd1==0x05)){ // SNP event
+    event = (RecvBuf[6]<<8)+RecvBuf[5];
+    if(event == 0x0020){      // ATT MTU updated
+      AttMtu = (RecvBuf[10]<<8)+RecvBuf[9];
+      if(AttMtu > AP_MAXMTU) AttMtu = AP_MAXMTU; // the SNP should not agree to more
+      if(AttMtu < 23) AttMtu = 23;
+      return;
+    }
+    if(event == 0x0002){      // connection terminated
+      AttMtu = 23;
+      unsubscribe();          // runs the CCCD callbacks
+      return;
+    }
+  }
+  i = oldest(1, cmd0, cmd1);
+  if(i == AP_INFLIGHT){
+    UnmatchedFrames++;    // e.g., connection events
+    return;
+  }
+  complete(i, APOK, RecvBuf);
+}
+
+//------------AP_Poll------------
+// Handle every frame the Bluetooth module has to send:
+// responses complete the commands sent by AP_SendCommand, and
+// read, write and CCCD indications (0x87, 0x88, 0x8B) are
+// passed to the characteristics
+// Input: none
+// Output: number of frames handled
+int AP_Poll(void){ int n = 0;
+  lock();
+  while(recvFrame()){
+    dispatch();
+    n++;
+  }
+  unlock();
+  return n;
+}
+
+// one step of waiting for responses; the oldest command fails
+// if no frame arrives for APFRAMETIMEOUT steps
+static void service(uint32_t *idle){ uint32_t i;
+  if(AP_Poll()){
+    *idle = 0;
+    return;
+  }
+  Yield();         // let other threads run while the SNP works
+  *idle = *idle + 1;
+  if(*idle > APFRAMETIMEOUT){
+    TimeOutErr++;  // no response error
+    i = oldest(0, 0, 0);
+    if(i < AP_INFLIGHT){
+      complete(i, APFAIL, 0);
+    }
+    *idle = 0;
+  }
+}
+
+//------------AP_SendCommand------------
+// Send a command to the Bluetooth module without waiting for
+// its response.  Up to AP_INFLIGHT commands can be waiting;
+// a further call handles frames until one completes.
+// Input: pt, NPI message (copied, can be reused at once)
+//        done, called from AP_Poll with the tag, APOK and the
+//          response frame (SOF to FCS), or with APFAIL and 0
+//          on timeout; 0 if no call is needed
+//        tag, passed to done
+// Output: APOK if sent, APFAIL on timeout
+int AP_SendCommand(uint8_t *pt, void(*done)(uint32_t tag, int result, uint8_t *response), uint32_t tag){
+  int result;
+  lock();
+  reserve();
+  result = issue(pt, done, tag);
+  unlock();
+  return result;
+}
+
+// with the lock held, wait until one more command can be in
+// flight, handling frames meanwhile
+static void reserve(void){ uint32_t idle = 0;
+  while(InFlightCount >= AP_INFLIGHT){
+    service(&idle);
+  }
+}
+
+// with the lock held, after reserve, send a command and enter
+// it in the in-flight table; no frame is handled here, so pt
+// can be TxBuf
+static int issue(uint8_t *pt, void(*done)(uint32_t tag, int result, uint8_t *response), uint32_t tag){
+  return post(pt, 0, done, tag);
+}
+// issue, for a frame that may already have its FCS (sealed)
+static int post(const uint8_t *pt, int sealed, void(*done)(uint32_t tag, int result, uint8_t *response), uint32_t tag){
+  uint8_t cmd0,cmd1; uint32_t i; int result;
+  AP_EchoSendMessage((uint8_t *)pt);  // debugging
+  if(replyOf((uint8_t *)pt, &cmd0, &cmd1) == 0){
+    result = transmit(pt, sealed);
+    if(done){
+      (*done)(tag, result, 0);
+    }
+    return result;
+  }
+  if(transmit(pt, sealed) == APFAIL){
+    CommandErr = 1;
+    if(done){
+      (*done)(tag, APFAIL, 0);
+    }
+    return APFAIL;
+  }
+  for(i=0; InFlight[i].used; i++){};
+  InFlight[i].cmd0 = cmd0;
+  InFlight[i].cmd1 = cmd1;
+  InFlight[i].seq = CommandSeq++;
+  InFlight[i].done = done;
+  InFlight[i].tag = tag;
+  InFlight[i].used = 1;
+  InFlightCount++;
+  return APOK;
+}
+
+//------------AP_Flush------------
+// Wait for the response to every command sent
+// Input: none
+// Output: APOK if every command since the last AP_Flush
+//         succeeded, APFAIL if any failed or timed out
+int AP_Flush(void){ uint32_t idle = 0; int result;
+  lock();
+  while(InFlightCount){
+    service(&idle);
+  }
+  result = CommandErr ? APFAIL : APOK;
+  CommandErr = 0;
+  unlock();
+  return result;
+}
+
+// AP_SendMessageResponse calls waiting for their response, one
+// per command in flight at most; the tag is the index
+typedef struct Waiters{
+  uint8_t *pt;                 // where the response goes
+  uint32_t max;                // size of that buffer
+  int result;
+  uint32_t wait;               // 1 until the response arrives, 0 if free
+}waiter_t;
+waiter_t Waiters[AP_INFLIGHT];
+static void copyResponse(uint32_t tag, int result, uint8_t *response){
+  uint32_t i, size; waiter_t *w = &Waiters[tag];
+  if(response){
+    size = AP_GetSize(response) + 6;  // SOF to FCS
+    for(i=0; (i<size)&&(i<w->max); i++){
+      w->pt[i] = response[i];
+    }
+  }
+  w->result = result;
+  w->wait = 0;
+}
+
 //------------AP_SendMessageResponse------------
 // send a message to the Bluetooth module
 // and receive a response from the Bluetooth module
-// 1) send outgoing message
-// 2) wait at least 10ms to receive NPI package
-// 3) Wait for entire message to be received
+// 1) send outgoing message with AP_SendCommand
+// 2) handle frames until its response arrives
+// Commands sent earlier with AP_SendCommand can still be in
+// flight; their responses are handled along the way.
 // Input: msgPt points to message to send
 //        responsePt points to empty buffer into which data is returned
 //        maximum size (discard data beyond this limit)
 // Output: APOK if ok, APFAIL on error (timeout or fcs error)
 int AP_SendMessageResponse(uint8_t *msgPt, uint8_t *responsePt,uint32_t max){
-  int result;
-//  uint32_t timeout;
-  result = AP_SendMessage(msgPt);
-  if(result == APFAIL){
-    return APFAIL;
+  uint32_t idle = 0; uint32_t k; int r;
+  lock();
+  reserve();      // a free command slot means a free waiter
+  for(k=0; Waiters[k].wait; k++){};
+  Waiters[k].pt = responsePt;
+  Waiters[k].max = max;
+  Waiters[k].wait = 1;
+  if(issue(msgPt, &copyResponse, k) == APFAIL){
+    unlock();
+    return APFAIL;  // copyResponse has freed the waiter
   }
-//  timeout = APTIMEOUT;
-//  while(AP_RecvStatus()==0){
-//    timeout--;
-//    if(timeout==0){
-//      return APFAIL; // 10 ms
-//    }
-//  }
-  result = AP_RecvMessage(responsePt,max);
-#ifdef APDEBUG
-    AP_EchoSendMessage(msgPt);  // debugging
-    AP_EchoReceived(result);    // debugging
-#endif
-  if(result == APFAIL){
-    return APFAIL;
-  }  
-  return APOK;
+  while(Waiters[k].wait){
+    service(&idle);
+  }
+  r = Waiters[k].result;
+  unlock();
+  return r;
 }
 
 typedef struct characteristics{
   uint16_t theHandle;          // each object has an ID
-  uint16_t size;               // number of bytes in user data (1,2,4,8)
-  uint8_t *pt;                 // pointer to user data, stored little endian
+  uint16_t size;               // number of bytes in user data, 1 to AP_MAXVALUE
+  uint8_t *pt;                 // pointer to user data, see valueByte
   void (*callBackRead)(void);  // action if SNP Characteristic Read Indication
   void (*callBackWrite)(void); // action if SNP Characteristic Write Indication
 }characteristic_t;
-const uint32_t MAXCHARACTERISTICS=10;
 uint32_t CharacteristicCount=0;
-characteristic_t CharacteristicList[MAXCHARACTERISTICS];
+characteristic_t CharacteristicList[AP_MAXCHARACTERISTICS];
 typedef struct NotifyCharacteristics{
   uint16_t uuid;               // user defined 
   uint16_t theHandle;          // each object has an ID (used to notify)
   uint16_t CCCDhandle;         // generated/assigned by SNP
   uint16_t CCCDvalue;          // sent by phone to this object
-  uint16_t size;               // number of bytes in user data (1,2,4,8)
-  uint8_t *pt;                 // pointer to user data array, stored little endian
+  uint16_t size;               // number of bytes in user data, 1 to AP_MAXVALUE
+  uint8_t *pt;                 // pointer to user data array, see valueByte
   void (*callBackCCCD)(void);  // action if SNP CCCD Updated Indication
 }NotifyCharacteristic_t;
-const uint32_t NOTIFYMAXCHARACTERISTICS=4;
 uint32_t NotifyCharacteristicCount=0;
-NotifyCharacteristic_t NotifyCharacteristicList[NOTIFYMAXCHARACTERISTICS];
+NotifyCharacteristic_t NotifyCharacteristicList[AP_MAXNOTIFY];
+
+// The SNP hands out the handles of a service one after the other:
+// the service, then declaration, value and user description of
+// each characteristic, plus the CCCD of a notify characteristic.
+// AP_RegisterService lays them out in HandleTable, indexed by
+// handle-HandleBase, so an indication finds its characteristic
+// in one step:
+//   0 not ours
+//   1 to AP_MAXCHARACTERISTICS      value of CharacteristicList[entry-1]
+//   NOTIFYENTRY+1 to +AP_MAXNOTIFY  CCCD of NotifyCharacteristicList[entry-NOTIFYENTRY-1]
+#if (AP_MAXCHARACTERISTICS+AP_MAXNOTIFY) > 255
+#error "AP_MAXCHARACTERISTICS+AP_MAXNOTIFY must fit in a byte"
+#endif
+#define NOTIFYENTRY AP_MAXCHARACTERISTICS
+#define HANDLES (8+3*AP_MAXCHARACTERISTICS+4*AP_MAXNOTIFY) // with room for a few services
+uint8_t HandleTable[HANDLES];
+uint16_t HandleBase;          // handle of HandleTable[0]
+uint32_t HandleSpan;          // handles in the table, 0 if not built
+
+// enter one handle in the table, if it has been assigned
+static void enter(uint16_t h, uint8_t entry){
+  if(h){
+    HandleTable[h-HandleBase] = entry;
+  }
+}
+
+// lay out the handles of all the characteristics added so far
+// if they are too spread out, HandleSpan stays 0 and lookup searches
+static void buildTable(void){ uint32_t i; uint16_t lo,hi;
+  lo = 0xFFFF; hi = 0;
+  for(i=0; i<CharacteristicCount; i=i+1){
+    if(CharacteristicList[i].theHandle){
+      if(CharacteristicList[i].theHandle < lo) lo = CharacteristicList[i].theHandle;
+      if(CharacteristicList[i].theHandle > hi) hi = CharacteristicList[i].theHandle;
+    }
+  }
+  for(i=0; i<NotifyCharacteristicCount; i=i+1){
+    if(NotifyCharacteristicList[i].CCCDhandle){
+      if(NotifyCharacteristicList[i].CCCDhandle < lo) lo = NotifyCharacteristicList[i].CCCDhandle;
+      if(NotifyCharacteristicList[i].CCCDhandle > hi) hi = NotifyCharacteristicList[i].CCCDhandle;
+    }
+  }
+  HandleSpan = 0;
+  if((hi < lo)||((uint32_t)(hi-lo) >= HANDLES)){
+    return;                     // nothing to enter, or does not fit
+  }
+  HandleBase = lo;
+  for(i=0; i<HANDLES; i=i+1){
+    HandleTable[i] = 0;
+  }
+  for(i=0; i<CharacteristicCount; i=i+1){
+    enter(CharacteristicList[i].theHandle, i+1);
+  }
+  for(i=0; i<NotifyCharacteristicCount; i=i+1){
+    enter(NotifyCharacteristicList[i].CCCDhandle, NOTIFYENTRY+i+1);
+  }
+  HandleSpan = hi-lo+1;
+}
+
+// find the characteristic an indication is for
+// Input: h, handle of a characteristic value or CCCD
+// Output: its HandleTable entry, 0 if none
+static uint32_t lookup(uint16_t h){ uint32_t i;
+  if(HandleSpan){
+    if((h < HandleBase)||((uint32_t)(h-HandleBase) >= HandleSpan)){
+      return 0;
+    }
+    return HandleTable[h-HandleBase];
+  }
+  for(i=0; i<CharacteristicCount; i=i+1){ // no table, search
+    if(CharacteristicList[i].theHandle == h) return i+1;
+  }
+  for(i=0; i<NotifyCharacteristicCount; i=i+1){
+    if(NotifyCharacteristicList[i].CCCDhandle == h) return NOTIFYENTRY+i+1;
+  }
+  return 0;
+}
 
 
 //*********AP_GetNotifyCCCD*******
@@ -526,181 +1011,377 @@ uint16_t AP_GetNotifyCCCD(uint32_t i){
   return (NotifyCharacteristicList[i].CCCDvalue);
 }
 
+// the central is gone, and its CCCDs with it
+static void unsubscribe(void){ uint32_t i;
+  for(i=0; i<NotifyCharacteristicCount; i++){
+    if(NotifyCharacteristicList[i].CCCDvalue){
+      NotifyCharacteristicList[i].CCCDvalue = 0;
+      NotifyCharacteristicList[i].callBackCCCD();
+    }
+  }
+}
+
+//*********AP_GetMTU*******
+// Return the ATT MTU of the connection, as reported by the SNP;
+// a notification carries at most MTU-3 bytes of a value, a read
+// MTU-1 and a write MTU-3; longer reads and writes take several
+// Inputs:  none
+// Outputs: 23 to AP_MAXMTU
+uint16_t AP_GetMTU(void){
+  return AttMtu;
+}
+
+// Values of up to NUMBERSIZE bytes are numbers, stored little
+// endian and sent big endian; longer values are arrays of bytes,
+// sent in order.  valueByte returns byte k of the value as sent.
+#define NUMBERSIZE 8
+static uint8_t *valueByte(uint8_t *pt, uint32_t size, uint32_t k){
+  if(size <= NUMBERSIZE){
+    return &pt[size-k-1];
+  }
+  return &pt[k];
+}
 
 
 
+
+// store the handles the SNP assigned, as the responses arrive
+static void charValueDone(uint32_t i, int result, uint8_t *response){
+  if(result == APOK){
+    CharacteristicList[i].theHandle = (response[7]<<8)+response[6]; // handle for this characteristic
+  }
+}
+static void notifyValueDone(uint32_t i, int result, uint8_t *response){
+  if(result == APOK){
+    NotifyCharacteristicList[i].theHandle = (response[7]<<8)+response[6]; // handle for this characteristic
+  }
+}
+static void notifyDescriptorDone(uint32_t i, int result, uint8_t *response){
+  if(result == APOK){
+    NotifyCharacteristicList[i].CCCDhandle = (response[8]<<8)+response[7]; // handle for this CCCD
+  }
+}
+
 //*************AP_AddService**************
 // Add a service
+// The command is sent without waiting for its response; a
+// failure is reported by AP_RegisterService.
 // Inputs uuid is 0xFFF0, 0xFFF1, ...
 // Output APOK if successful,
 //        APFAIL if SNP failure
-int AP_AddService(uint16_t uuid){ int r;
+int AP_AddService(uint16_t uuid){ int r; uint8_t *msg;
   OutString("\n\rAdd service");
-  NPI_AddService[6] = uuid&0xFF;
-  NPI_AddService[7] = uuid>>8;
-  r = AP_SendMessageResponse((uint8_t*)NPI_AddService,RecvBuf,RECVSIZE);  
+  lock();
+  reserve();
+  msg = build(NPI_AddService, sizeof(NPI_AddService));
+  msg[6] = uuid&0xFF;
+  msg[7] = uuid>>8;
+  r = issue(msg,0,0);
+  unlock();
   return r;
 }
 
 //*************AP_RegisterService**************
 // Register a service
+// Waits for the responses to every command sent before it.
 // Inputs none
 // Output APOK if successful,
-//        APFAIL if SNP failure
+//        APFAIL if SNP failure, here or in an earlier AP_AddService,
+//        AP_AddCharacteristic or AP_AddNotifyCharacteristic
 int AP_RegisterService(void){ int r;
   OutString("\n\rRegister service");
-  r = AP_SendMessageResponse((uint8_t*)NPI_Register,RecvBuf,RECVSIZE);
+  lock();
+  r = AP_SendCommand((uint8_t*)NPI_Register,0,0);
+  if(AP_Flush() == APFAIL){
+    r = APFAIL;
+  }else{
+    buildTable();   // every handle is known now
+  }
+  unlock();
   return r;
 }
 
 //*************AP_AddCharacteristic**************
 // Add a read, write, or read/write characteristic
 //        for notify properties, call AP_AddNotifyCharacteristic 
+// The commands are sent without waiting for their responses;
+// the handle is filled in as the response arrives, and a
+// failure is reported by AP_RegisterService.
 // Inputs uuid is 0xFFF0, 0xFFF1, ...
-//        thesize is the number of bytes in the user data 1,2,4, or 8 
-//        pt is a pointer to the user data, stored little endian
+//        thesize is the number of bytes in the user data 1 to AP_MAXVALUE
+//        pt is a pointer to the user data; up to 8 bytes it is a number
+//          stored little endian (sent big endian), longer it is an array
+//          of bytes sent in order; long reads and writes use offsets
 //        permission is GATT Permission, 0=none,1=read,2=write, 3=Read+write 
 //        properties is GATT Properties, 2=read,8=write,0x0A=read+write
 //        name is a null-terminated string, maximum length of name is 20 bytes
 //        (*ReadFunc) called before it responses with data from internal structure
 //        (*WriteFunc) called after it accepts data into internal structure
 // Output APOK if successful,
-//        APFAIL if name is empty, more than 8 characteristics, or if SNP failure
+//        APFAIL if name is empty, more than AP_MAXCHARACTERISTICS, or if SNP failure
 int AP_AddCharacteristic(uint16_t uuid, uint16_t thesize, void *pt, uint8_t permission,
   uint8_t properties, char name[], void(*ReadFunc)(void), void(*WriteFunc)(void)){
-  int r; uint16_t handle; int i;
-  if(thesize>8) return APFAIL;
-  if(CharacteristicCount>=MAXCHARACTERISTICS) return APFAIL; // error
-  NPI_AddCharValue[3] = 0x35;   // SNP Add Characteristic Value Declaration
-  NPI_AddCharValue[4] = 0x82;  
-  NPI_AddCharValue[5] = permission; // 0=none,1=read,2=write, 3=Read+write, GATT Permission
-  NPI_AddCharValue[6] = properties; // 2=read,8=write,0x0A=read+write,0x10=notify, GATT Properties
-  NPI_AddCharValue[11] = 0xFF&uuid; NPI_AddCharValue[12] = uuid>>8;
+  int r; uint32_t k; int i; uint8_t *msg;
+  if((thesize==0)||(thesize>AP_MAXVALUE)) return APFAIL;
+  if(name[0] == 0) return APFAIL;  // empty name
+  lock();
+  if(CharacteristicCount>=AP_MAXCHARACTERISTICS){
+    unlock();
+    return APFAIL; // error
+  }
+  k = CharacteristicCount;         // handle is 0 until the SNP assigns it
+  CharacteristicList[k].theHandle = 0;
+  CharacteristicList[k].size = thesize;
+  CharacteristicList[k].pt = (uint8_t *) pt;
+  CharacteristicList[k].callBackRead = ReadFunc;
+  CharacteristicList[k].callBackWrite = WriteFunc;
+  reserve();
+  msg = build(NPI_AddCharValue, sizeof(NPI_AddCharValue));
+  msg[5] = permission; // 0=none,1=read,2=write, 3=Read+write, GATT Permission
+  msg[6] = properties; // 2=read,8=write,0x0A=read+write,0x10=notify, GATT Properties
+  msg[11] = 0xFF&uuid; msg[12] = uuid>>8;
   OutString("\n\rAdd CharValue");
-  r=AP_SendMessageResponse((uint8_t*)NPI_AddCharValue,RecvBuf,RECVSIZE);
-  if(r == APFAIL) return APFAIL;
-  handle = (RecvBuf[7]<<8)+RecvBuf[6]; // handle for this characteristic
-  OutString("\n\rAdd CharDescriptor");
-  i=0;
-  while((i<20)&&(name[i])){
-    NPI_AddCharDescriptor[11+i] = name[i]; i++;
-  }
-  if(i==0) return APFAIL;       // empty name
-
-  NPI_AddCharDescriptor[11+i] = 0; i++;
-  NPI_AddCharDescriptor[1] = 6+i;  // frame length
-  NPI_AddCharDescriptor[3] = 0x35; // SNP Add Characteristic Descriptor Declaration
-  NPI_AddCharDescriptor[4] = 0x83;
-  NPI_AddCharDescriptor[5] = 0x80; // User Description String
-  NPI_AddCharDescriptor[6] = 0x01; // GATT Read Permissions
-  NPI_AddCharDescriptor[7] = NPI_AddCharDescriptor[9] = i;  // string length
-  NPI_AddCharDescriptor[8] = NPI_AddCharDescriptor[10] = 0; // string length
-  r=AP_SendMessageResponse((uint8_t*)NPI_AddCharDescriptor,RecvBuf,RECVSIZE);
-  if(r == APFAIL) return APFAIL;
-  CharacteristicList[CharacteristicCount].theHandle = handle;
-  CharacteristicList[CharacteristicCount].size = thesize;
-  CharacteristicList[CharacteristicCount].pt = (uint8_t *) pt;
-  CharacteristicList[CharacteristicCount].callBackRead = ReadFunc;
-  CharacteristicList[CharacteristicCount].callBackWrite = WriteFunc;
-  CharacteristicCount++;
-  return APOK; // OK
+  r=issue(msg,&charValueDone,k);
+  if(r == APOK){
+    CharacteristicCount++;         // counted once the SNP has the value
+    OutString("\n\rAdd CharDescriptor");
+    reserve();
+    msg = build(NPI_AddCharDescriptor, 11);
+    i=0;
+    while((i<20)&&(name[i])){
+      msg[11+i] = name[i]; i++;
+    }
+    msg[11+i] = 0; i++;
+    msg[1] = 6+i;  // frame length
+    msg[7] = msg[9] = i;  // string length
+    msg[8] = msg[10] = 0; // string length
+    r=issue(msg,0,0);
+  }
+  unlock();
+  return r;
 }  
 
 //*************AP_AddNotifyCharacteristic**************
 // Add a notify characteristic
 //        for read, write, or read/write characteristic, call AP_AddCharacteristic 
+// The commands are sent without waiting for their responses;
+// the handles are filled in as the responses arrive, and a
+// failure is reported by AP_RegisterService.
 // Inputs uuid is 0xFFF0, 0xFFF1, ...
-//        thesize is the number of bytes in the user data 1,2,4, or 8 
-//        pt is a pointer to the user data, stored little endian
+//        thesize is the number of bytes in the user data 1 to AP_MAXVALUE;
+//          AP_SendNotification sends it only if it fits in MTU-3 bytes
+//        pt is a pointer to the user data; up to 8 bytes it is a number
+//          stored little endian (sent big endian), longer it is an array
+//          of bytes sent in order
 //        name is a null-terminated string, maximum length of name is 20 bytes
 //        (*CCCDfunc) called after it accepts , changing CCCDvalue
 // Output APOK if successful,
-//        APFAIL if name is empty, more than 4 notify characteristics, or if SNP failure
+//        APFAIL if name is empty, more than AP_MAXNOTIFY, or if SNP failure
 int AP_AddNotifyCharacteristic(uint16_t uuid, uint16_t thesize, void *pt,   
   char name[], void(*CCCDfunc)(void)){
-  int r; uint16_t handle; int i;
-  if(thesize>8) return APFAIL;
-  if(NotifyCharacteristicCount>=NOTIFYMAXCHARACTERISTICS) return APFAIL; // error
-  NPI_AddCharValue[3] = 0x35;   // SNP Add Characteristic Value Declaration
-  NPI_AddCharValue[4] = 0x82;  
-  NPI_AddCharValue[5] = 0x00;   // GATT no read, no Write GATT Permission
-  NPI_AddCharValue[6] = 0x10;   // 0x10=notify, GATT Properties
-  NPI_AddCharValue[11] = 0xFF&uuid; NPI_AddCharValue[12] = uuid>>8;
+  int r; uint32_t k; int i; uint8_t *msg;
+  if((thesize==0)||(thesize>AP_MAXVALUE)) return APFAIL;
+  if(name[0] == 0) return APFAIL;  // empty name
+  lock();
+  if(NotifyCharacteristicCount>=AP_MAXNOTIFY){
+    unlock();
+    return APFAIL; // error
+  }
+  k = NotifyCharacteristicCount;   // handles are 0 until the SNP assigns them
+  NotifyCharacteristicList[k].uuid = uuid;
+  NotifyCharacteristicList[k].theHandle = 0;
+  NotifyCharacteristicList[k].CCCDhandle = 0;
+  NotifyCharacteristicList[k].CCCDvalue = 0; // notify initially off
+  NotifyCharacteristicList[k].size = thesize;
+  NotifyCharacteristicList[k].pt = (uint8_t *) pt;
+  NotifyCharacteristicList[k].callBackCCCD = CCCDfunc;
+  reserve();
+  msg = build(NPI_AddCharValue, sizeof(NPI_AddCharValue));
+  msg[5] = 0x00;   // GATT no read, no Write GATT Permission
+  msg[6] = 0x10;   // 0x10=notify, GATT Properties
+  msg[11] = 0xFF&uuid; msg[12] = uuid>>8;
   OutString("\n\rAdd Notify CharValue");
-  r=AP_SendMessageResponse((uint8_t*)NPI_AddCharValue,RecvBuf,RECVSIZE);
-  if(r == APFAIL) return APFAIL;
-  handle = (RecvBuf[7]<<8)+RecvBuf[6]; // handle for this characteristic
-  OutString("\n\rAdd CharDescriptor");
-  i=0;
-  while((i<19)&&(name[i])){
-    NPI_AddCharDescriptor[12+i] = name[i]; i++;
-  }
-  if(i==0) return APFAIL;               // empty name
-  NPI_AddCharDescriptor[12+i] = 0; i++; // add null termination
-  NPI_AddCharDescriptor[1] = 7+i;       // frame length
-  NPI_AddCharDescriptor[3] = 0x35;      // SNP Add Characteristic Descriptor Declaration
-  NPI_AddCharDescriptor[4] = 0x83;
-  NPI_AddCharDescriptor[5] = 0x84;      // User Description String, and CCCD permissions
-  NPI_AddCharDescriptor[6] = 0x03;      // CCCD parameters read+write
-  NPI_AddCharDescriptor[7] = 0x01;      // GATT Read Permissions
-  NPI_AddCharDescriptor[8] = NPI_AddCharDescriptor[10] = i; // string length
-  NPI_AddCharDescriptor[9] = NPI_AddCharDescriptor[11] = 0; // string length
-  r=AP_SendMessageResponse((uint8_t*)NPI_AddCharDescriptor,RecvBuf,RECVSIZE);
-  if(r == APFAIL) return APFAIL;
-  NotifyCharacteristicList[NotifyCharacteristicCount].uuid = uuid;
-  NotifyCharacteristicList[NotifyCharacteristicCount].theHandle = handle;
-  NotifyCharacteristicList[NotifyCharacteristicCount].CCCDhandle = (RecvBuf[8]<<8)+RecvBuf[7]; // handle for this CCCD
-  NotifyCharacteristicList[NotifyCharacteristicCount].CCCDvalue = 0; // notify initially off
-  NotifyCharacteristicList[NotifyCharacteristicCount].size = thesize;
-  NotifyCharacteristicList[NotifyCharacteristicCount].pt = (uint8_t *) pt;
-  NotifyCharacteristicList[NotifyCharacteristicCount].callBackCCCD = CCCDfunc;
-  NotifyCharacteristicCount++;
-  return APOK; // OK
+  r=issue(msg,&notifyValueDone,k);
+  if(r == APOK){
+    NotifyCharacteristicCount++;   // counted once the SNP has the value
+    OutString("\n\rAdd CharDescriptor");
+    reserve();
+    msg = build(NPI_AddCharDescriptor, 5);
+    i=0;
+    while((i<19)&&(name[i])){
+      msg[12+i] = name[i]; i++;
+    }
+    msg[12+i] = 0; i++; // add null termination
+    msg[1] = 7+i;       // frame length
+    msg[5] = 0x84;      // User Description String, and CCCD permissions
+    msg[6] = 0x03;      // CCCD parameters read+write
+    msg[7] = 0x01;      // GATT Read Permissions
+    msg[8] = msg[10] = i; // string length
+    msg[9] = msg[11] = 0; // string length
+    r=issue(msg,&notifyDescriptorDone,k);
+  }
+  unlock();
+  return r;
 }
   
 //*************AP_SendNotification**************
 // Send a notification (will skip if CCCD is 0) 
+// Returns without waiting for the SNP response, so the next
+// notification can be built while this one is sent.
 // Input:  index into notify characteristic to send
 // Output: APOK if successful,
-//         APFAIL if notification not configured, or if SNP failure
+//         APFAIL if notification not configured, value longer than
+//         MTU-3 bytes, or if SNP failure
 int AP_SendNotification(uint32_t i){ uint16_t handle; uint32_t j;uint8_t thedata;
-  int r1; uint32_t s;
+  int r1; uint32_t s; uint8_t *msg;
   if(i>= NotifyCharacteristicCount) return APFAIL;   // not valid
-  if(NotifyCharacteristicList[i].CCCDvalue){         // send only if active
-    handle = NotifyCharacteristicList[i].theHandle;
-    if(handle == 0) return APFAIL; // not open   
-    NPI_SendNotificationIndication[1] = 6+NotifyCharacteristicList[i].size;      // 1 to 8 bytes 
-    OutString("\n\rSend data=");
-    s = NotifyCharacteristicList[i].size;
-    for(j=0; j<s; j++){
-      thedata = NotifyCharacteristicList[i].pt[s-j-1]; // fetch data from user little endian to SNP big endian
-      OutUHex(thedata); OutString(", ");      
-      NPI_SendNotificationIndication[11+j] = thedata;    // copy into message, big endian
-    }
-    NPI_SendNotificationIndication[7] = handle&0x0FF; // handle
-    NPI_SendNotificationIndication[8] = handle>>8; 
-    r1=AP_SendMessageResponse(NPI_SendNotificationIndication,RecvBuf,RECVSIZE);
-  }else{
-    r1 = APOK; // no need to notify
+  if(NotifyCharacteristicList[i].CCCDvalue == 0) return APOK; // no need to notify
+  handle = NotifyCharacteristicList[i].theHandle;
+  if(handle == 0) return APFAIL; // not open   
+  s = NotifyCharacteristicList[i].size;
+  lock();
+  if(s > AttMtu-3u){   // one notification carries MTU-3 bytes, and has no offset
+    unlock();
+    return APFAIL;
   }
+  OutString("\n\rSend data=");
+  reserve();
+  msg = build(NPI_SendNotificationIndication, 11);
+  msg[1] = (6+s)&0xFF;
+  msg[2] = (6+s)>>8;
+  msg[7] = handle&0x0FF; // handle
+  msg[8] = handle>>8; 
+  for(j=0; j<s; j++){
+    thedata = *valueByte(NotifyCharacteristicList[i].pt,s,j); // little endian to SNP big endian
+    OutUHex(thedata); OutString(", ");      
+    msg[11+j] = thedata;    // copy into message
+  }
+  r1=issue(msg,0,0); // response handled by AP_Poll
+  unlock();
   return r1; // OK or fail depending on SendNotificationIndication
 }
+//*************AP_SendNotificationData**************
+// Send bytes as one notification of a notify characteristic,
+// in place of its value (will skip if CCCD is 0)
+// Returns without waiting for the SNP response; done is called
+// from AP_Poll with the response, whose byte 5 is the SNP
+// status (0 if the notification was accepted for sending)
+// Input:  i, index into notify characteristic
+//         pt, bytes to send in order (copied, can be reused at once)
+//         size, 1 to MTU-3
+//         done, as for AP_SendCommand, 0 if no call is needed
+//         tag, passed to done
+// Output: APOK if sent or skipped,
+//         APFAIL if notification not configured, too long, or if SNP failure
+int AP_SendNotificationData(uint32_t i, const uint8_t *pt, uint32_t size,
+  void(*done)(uint32_t tag, int result, uint8_t *response), uint32_t tag){
+  uint16_t handle; uint32_t j; uint8_t *msg; int r;
+  if(i>= NotifyCharacteristicCount) return APFAIL;   // not valid
+  if(NotifyCharacteristicList[i].CCCDvalue==0){
+    return APOK; // no need to notify
+  }
+  handle = NotifyCharacteristicList[i].theHandle;
+  if(handle == 0) return APFAIL; // not open   
+  lock();
+  if((size==0)||(size>AttMtu-3u)){   // one notification carries MTU-3 bytes
+    unlock();
+    return APFAIL;
+  }
+  reserve();
+  msg = build(NPI_SendNotificationIndication, 11);
+  msg[1] = (6+size)&0xFF;
+  msg[2] = (6+size)>>8;
+  msg[7] = handle&0x0FF; // handle
+  msg[8] = handle>>8; 
+  for(j=0; j<size; j++){
+    msg[11+j] = pt[j];    // copy into message
+  }
+  r = issue(msg,done,tag);
+  unlock();
+  return r;
+}
+
 //*************AP_StartAdvertisement**************
 // Start advertisement
+// The four commands are sent back to back, then the
+// responses are collected.
 // Input:  none
 // Output: APOK if successful,
 //         APFAIL if notification not configured, or if SNP failure
-int AP_StartAdvertisement(void){volatile int r;
+int AP_StartAdvertisement(void){ int r;
+  lock();
   OutString("\n\rSet Device name");
-  r =AP_SendMessageResponse((uint8_t*)NPI_GATTSetDeviceName,RecvBuf,RECVSIZE);
+  AP_SendCommand((uint8_t*)NPI_GATTSetDeviceName,0,0);
   OutString("\n\rSetAdvertisement1");
-  r =AP_SendMessageResponse((uint8_t*)NPI_SetAdvertisement1,RecvBuf,RECVSIZE);
+  AP_SendCommand((uint8_t*)NPI_SetAdvertisement1,0,0);
 //  OutString("\n\rSetAdvertisementSAP");
-//  r =AP_SendMessageResponse((uint8_t*)NPI_SetAdvertisementSAP,RecvBuf,RECVSIZE);
+//  AP_SendCommand((uint8_t*)NPI_SetAdvertisementSAP,0,0);
   OutString("\n\rSetAdvertisement Data");
-  r =AP_SendMessageResponse((uint8_t*)NPI_SetAdvertisementData,RecvBuf,RECVSIZE);
+  AP_SendCommand((uint8_t*)NPI_SetAdvertisementData,0,0);
   OutString("\n\rStartAdvertisement");
-  r =AP_SendMessageResponse((uint8_t*)NPI_StartAdvertisement,RecvBuf,RECVSIZE);
+  AP_SendCommand((uint8_t*)NPI_StartAdvertisement,0,0);
+  r = AP_Flush();  // wait for all four responses
+  unlock();
+  return r;
+}
+
+//*************AP_StartGATT**************
+// Build the GATT server and start advertising from a table
+// generated by tools/GATTGen.c; does what AP_AddService, the
+// AP_Add...Characteristic calls, AP_RegisterService and
+// AP_StartAdvertisement do, without building a single frame and
+// without waiting in between
+// The frames are sent as they are, up to AP_INFLIGHT ahead of
+// their responses, which fill in the handles; the advertising
+// commands follow register service without waiting for it.
+// Input:  gatt, the table
+// Output: APOK if successful,
+//         APFAIL if too many characteristics, or if SNP failure
+int AP_StartGATT(const apgatt_t *gatt){
+  uint32_t i, c, n; const apframe_t *f; int r;
+  void(*done)(uint32_t tag, int result, uint8_t *response);
+  OutString("\n\rStart GATT");
+  lock();
+  c = CharacteristicCount;       // the table's come after any added before
+  n = NotifyCharacteristicCount;
+  if((c+gatt->charCount > AP_MAXCHARACTERISTICS)||(n+gatt->notifyCount > AP_MAXNOTIFY)){
+    unlock();
+    return APFAIL;
+  }
+  for(i=0; i<gatt->charCount; i=i+1){
+    CharacteristicList[c+i].theHandle = 0;
+    CharacteristicList[c+i].size = gatt->chars[i].size;
+    CharacteristicList[c+i].pt = (uint8_t *) gatt->chars[i].pt;
+    CharacteristicList[c+i].callBackRead = gatt->chars[i].callBackRead;
+    CharacteristicList[c+i].callBackWrite = gatt->chars[i].callBackWrite;
+  }
+  for(i=0; i<gatt->notifyCount; i=i+1){
+    NotifyCharacteristicList[n+i].uuid = gatt->notify[i].uuid;
+    NotifyCharacteristicList[n+i].theHandle = 0;
+    NotifyCharacteristicList[n+i].CCCDhandle = 0;
+    NotifyCharacteristicList[n+i].CCCDvalue = 0; // notify initially off
+    NotifyCharacteristicList[n+i].size = gatt->notify[i].size;
+    NotifyCharacteristicList[n+i].pt = (uint8_t *) gatt->notify[i].pt;
+    NotifyCharacteristicList[n+i].callBackCCCD = gatt->notify[i].callBackCCCD;
+  }
+  for(i=0; i<gatt->frameCount; i=i+1){
+    f = &gatt->frames[i];
+    switch(f->kind){
+      case AP_FRAME_VALUE:  done = &charValueDone;        break;
+      case AP_FRAME_NOTIFY: done = &notifyValueDone;      break;
+      case AP_FRAME_CCCD:   done = &notifyDescriptorDone; break;
+      default:              done = 0;                     break;
+    }
+    reserve();
+    post(f->frame, 1, done, ((f->kind == AP_FRAME_VALUE) ? c : n)+f->index);
+  }
+  r = AP_Flush();
+  if(r == APOK){                 // counted only if the SNP has them all
+    CharacteristicCount = c+gatt->charCount;
+    NotifyCharacteristicCount = n+gatt->notifyCount;
+  }
+  buildTable();                  // every handle is known now
+  unlock();
   return r;
 }
 //*************AP_GetStatus**************
@@ -711,97 +1392,160 @@ int AP_StartAdvertisement(void){volatile int r;
 // BB is Advertising Status
 // CC is ATT Status
 // DD is ATT method in progress
-uint32_t AP_GetStatus(void){volatile int r;
+uint32_t AP_GetStatus(void){volatile int r; uint8_t response[12];
   OutString("\n\rGet Status");
-  r = AP_SendMessageResponse((uint8_t*)NPI_GetStatus,RecvBuf,RECVSIZE);
-  return (RecvBuf[4]<<24)+(RecvBuf[5]<<16)+(RecvBuf[6]<<8)+(RecvBuf[7]);
+  r = AP_SendMessageResponse((uint8_t*)NPI_GetStatus,response,sizeof(response));
+  return (response[4]<<24)+(response[5]<<16)+(response[6]<<8)+(response[7]);
 }
 //*************AP_GetVersion**************
 // Get version of the SNP application running on the CC2650
 // Input:  none
 // Output: version
-uint32_t AP_GetVersion(void){volatile int r;
+uint32_t AP_GetVersion(void){volatile int r; uint8_t response[12];
   OutString("\n\rGet Version");
-  r = AP_SendMessageResponse((uint8_t*)NPI_GetVersion,RecvBuf,RECVSIZE); 
-  return (RecvBuf[5]<<8)+(RecvBuf[6]);
+  r = AP_SendMessageResponse((uint8_t*)NPI_GetVersion,response,sizeof(response)); 
+  return (response[5]<<8)+(response[6]);
 }
-// ****AP_BackgroundProcess****
-// handle incoming SNP frames
-// Inputs:  none
-// Outputs: none
-void AP_BackgroundProcess(void){
-  int count; uint16_t h; int i,j;
-  uint32_t s; // size of user data 1,2,4,8
-  uint32_t d; // difference between packet size and user data size
-  uint8_t responseNeeded;
-
-  if(AP_RecvStatus()){
-    if(AP_RecvMessage(RecvBuf,RECVSIZE)==APOK){
-      OutString("\n\rRecvMessage");
-      AP_EchoReceived(APOK);        
-      if((RecvBuf[3]==0x55)&&(RecvBuf[4]==0x88)){// SNP Characteristic Write Indication (0x88)
-        h = (RecvBuf[8]<<8)+RecvBuf[7]; // handle for this characteristic
-        responseNeeded = RecvBuf[9];
-        i = 0;
-        while(i<MAXCHARACTERISTICS){
-          if(CharacteristicList[i].theHandle == h){
-            count = RecvBuf[1]-7;   // number of bytes in message
-            s = CharacteristicList[i].size;
-            if(count>s)count=s;   // truncate to size
-            d = s-count;
-            for(j=0;j<s;j++){     // if message is smaller than size
-              CharacteristicList[i].pt[j] = 0; // fill MSbytes with 0
-            }
-            for(j=0;j<count;j++){ // write data
-              CharacteristicList[i].pt[s-j-1-d] = RecvBuf[12+j];
-            }
-            (*CharacteristicList[i].callBackWrite)(); // process Characteristic Write Indication
-            i = MAXCHARACTERISTICS;
-          }else{
-            i++;
+// handle the read, write or CCCD indication in RecvBuf
+// a long value is read and written in pieces, each with the
+// offset of its first byte; the read callback runs only for the
+// first piece, so the pieces come from one version of the value
+// A callback can call AP functions, which may handle further
+// frames into RecvBuf and build frames in TxBuf, so what is
+// needed of the indication is taken out of RecvBuf before the
+// callback, and the confirmation is built after it.
+static void indication(void){
+  uint8_t cmd1 = RecvBuf[4];  // callbacks can run AP_Poll, which reuses RecvBuf
+  uint32_t count; uint16_t h; uint32_t i,j,k;
+  uint32_t s; // size of user data 1 to AP_MAXVALUE
+  uint32_t d; // where the data goes: difference between packet size and number size, or offset
+  uint32_t offset, max;
+  uint8_t responseNeeded, status; uint8_t *msg;
+
+  OutString("\n\rRecvMessage");
+  if(cmd1==0x88){// SNP Characteristic Write Indication (0x88)
+    h = (RecvBuf[8]<<8)+RecvBuf[7]; // handle for this characteristic
+    responseNeeded = RecvBuf[9];
+    offset = (RecvBuf[11]<<8)+RecvBuf[10];
+    status = 0x00; // success
+    k = lookup(h);
+    if((k>0)&&(k<=NOTIFYENTRY)){
+      i = k-1;
+      count = AP_GetSize(RecvBuf);
+      count = (count>7) ? count-7 : 0;  // number of bytes in message
+      if(count>RECVSIZE-13) count = RECVSIZE-13; // only this much was kept
+      s = CharacteristicList[i].size;
+      if((offset>s)||((s<=NUMBERSIZE)&&offset)){
+        status = 0x07; // ATT invalid offset
+      }else{
+        if(count>s-offset)count=s-offset;   // truncate to size
+        if(s<=NUMBERSIZE){
+          d = s-count;
+          for(j=0;j<s;j++){     // if message is smaller than size
+            CharacteristicList[i].pt[j] = 0; // fill MSbytes with 0
           }
+        }else{
+          d = offset;
         }
-        if(responseNeeded){
-          AP_SendMessage(NPI_WriteConfirmation);
-          AP_EchoSendMessage(NPI_WriteConfirmation);
+        for(j=0;j<count;j++){ // write data
+          *valueByte(CharacteristicList[i].pt,s,d+j) = RecvBuf[12+j];
         }
+        (*CharacteristicList[i].callBackWrite)(); // process Characteristic Write Indication
       }
-      if((RecvBuf[3]==0x55)&&(RecvBuf[4]==0x87)){// SNP Characteristic Read Indication (0x87)
-        h = (RecvBuf[8]<<8)+RecvBuf[7]; // handle for this characteristic
-        i = 0;
-        while(i<MAXCHARACTERISTICS){
-          if(CharacteristicList[i].theHandle == h){
-            (*CharacteristicList[i].callBackRead)(); // process Characteristic Read Indication
-            NPI_ReadConfirmation[1] = 7+CharacteristicList[i].size;
-            s = CharacteristicList[i].size;
-            for(j=0;j<s;j++){ // write data
-              NPI_ReadConfirmation[j+12]=CharacteristicList[i].pt[s-j-1];
-            }
-            i = MAXCHARACTERISTICS;
-          }else{
-            i++;
-          }
-        }
-        NPI_ReadConfirmation[8] = RecvBuf[7]; // handle
-        NPI_ReadConfirmation[9] = RecvBuf[8]; 
-        AP_SendMessage(NPI_ReadConfirmation);
-        AP_EchoSendMessage(NPI_ReadConfirmation);
+    }
+    if(responseNeeded){
+      msg = build(NPI_WriteConfirmation, sizeof(NPI_WriteConfirmation));
+      msg[5] = status;
+      sendMessage(msg);
+      AP_EchoSendMessage(msg);
+    }
+  }else if(cmd1==0x87){// SNP Characteristic Read Indication (0x87)
+    h = (RecvBuf[8]<<8)+RecvBuf[7]; // handle for this characteristic
+    offset = (RecvBuf[10]<<8)+RecvBuf[9];
+    max = (RecvBuf[12]<<8)+RecvBuf[11]; // most the SNP can send in this piece
+    if(max>AttMtu-1u) max = AttMtu-1;
+    status = 0x00; // success
+    count = 0;
+    k = lookup(h);
+    if((k>0)&&(k<=NOTIFYENTRY)){
+      i = k-1;
+      if(offset==0){
+        (*CharacteristicList[i].callBackRead)(); // process Characteristic Read Indication
       }
-      if((RecvBuf[3]==0x55)&&(RecvBuf[4]==0x8B)){// SNP CCCD Updated Indication (0x8B)
-        h = (RecvBuf[8]<<8)+RecvBuf[7]; // handle for this characteristic
-        responseNeeded = RecvBuf[9];
-        for(i=0; i<NOTIFYMAXCHARACTERISTICS;i++){
-          if(NotifyCharacteristicList[i].CCCDhandle == h){  // to do
-            NotifyCharacteristicList[i].CCCDvalue = (RecvBuf[11]<<8)+RecvBuf[10];
-            NotifyCharacteristicList[i].callBackCCCD();
-          }
-        }
-        if(responseNeeded){
-          AP_SendMessage(NPI_CCCDUpdatedConfirmation);
-          AP_EchoSendMessage(NPI_CCCDUpdatedConfirmation);
-        }
-      }        
+      s = CharacteristicList[i].size;
+      if(offset>s){
+        status = 0x07; // ATT invalid offset
+      }else{
+        count = s-offset;
+        if(count>max) count = max;
+      }
+    }
+    msg = build(NPI_ReadConfirmation, 12);
+    msg[1] = (7+count)&0xFF;
+    msg[2] = (7+count)>>8;
+    msg[5] = status;
+    msg[8] = h&0xFF;       // handle
+    msg[9] = h>>8; 
+    msg[10] = offset&0xFF; // offset
+    msg[11] = offset>>8; 
+    for(j=0;j<count;j++){ // write data
+      msg[j+12] = *valueByte(CharacteristicList[i].pt,s,offset+j);
     }
+    sendMessage(msg);
+    AP_EchoSendMessage(msg);
+  }else if(cmd1==0x8B){// SNP CCCD Updated Indication (0x8B)
+    h = (RecvBuf[8]<<8)+RecvBuf[7]; // handle for this characteristic
+    responseNeeded = RecvBuf[9];
+    k = lookup(h);
+    if(k>NOTIFYENTRY){
+      i = k-NOTIFYENTRY-1;
+      NotifyCharacteristicList[i].CCCDvalue = (RecvBuf[11]<<8)+RecvBuf[10];
+      NotifyCharacteristicList[i].callBackCCCD();
+    }
+    if(responseNeeded){
+      msg = build(NPI_CCCDUpdatedConfirmation, sizeof(NPI_CCCDUpdatedConfirmation));
+      sendMessage(msg);
+      AP_EchoSendMessage(msg);
+    }
+  }        
+}
+
+// ****AP_BackgroundProcess****
+// handle incoming SNP frames: indications and the responses
+// to commands sent with AP_SendCommand (see AP_Poll)
+// Inputs:  none
+// Outputs: none
+void AP_BackgroundProcess(void){
+  AP_Poll();
+}
+
+// run by the falling edge of SRDY; SRDY is low while a frame is
+// sent, so falling after it means SRDY rose in between and the
+// handshake is over, even if no one was polling to see it high
+static void srdyFell(void){
+  if(SendOpen && (SendBusy == 0)){
+    SendOpen = 0;
+  }
+  SignalSRDY();
+}
+
+//------------AP_WaitEvent------------
+// Block until the Bluetooth module has something to send, then
+// handle every frame waiting; a frame the SNP announced before
+// the call is handled at once
+// Inputs:  none
+// Outputs: number of frames handled, at least 1
+int AP_WaitEvent(void){ int n;
+  if(SRDYArmed == 0){
+    AP_SRDYFell = 0;
+    SRDYArmed = 1;
+    GPIO_SRDYEdge_Init(&srdyFell, 2);
+  }
+  n = AP_Poll();
+  while(n == 0){
+    WaitSRDY();       // no processor time until SRDY falls
+    n = AP_Poll();
   }
+  return n;
 }
 
@@ -11,6 +11,7 @@
 //    simple_np_cc2650lp_uart_pm_sbl.hex
 // It doesn't matter if bootloadmode is enabled (sbl) or not enabled (xsbl)
 // Transmit and receive interrupts are implemented in UART1.c on UCA2.
+// Received frames are collected by the UART1 interrupt, see NPI.h.
 // Daniel Valvano and Jonathan Valvano
 // September 10, 2016
 
@@ -55,7 +56,46 @@
 #define APOK   1
 // if you define APDEBUG then all LP-SNP traffic is displayed on UART0
 // if you do not define APDEBUG then no UART0 output is performed (runs faster)
+#ifndef SNP_SIMULATOR
 #define APDEBUG 1
+#endif
+// if you define APKERNEL then AP.c runs with the Lab4 kernel: threads waiting
+// for a message from the Bluetooth module call OS_Suspend, and each frame
+// received signals the semaphore NPI_FrameReady (see NPI.h)
+// if you do not define APKERNEL then AP.c spins while it waits (no kernel needed)
+// With APKERNEL the AP functions can be called from several threads:
+// each takes the semaphore APMutex around its exchange with the
+// Bluetooth module, so frames from two threads are never interleaved
+// and the one transmit buffer is used by one thread at a time.  The
+// lock is recursive, so read/write/CCCD callbacks and response
+// callbacks (which run with it held) may call AP functions.  Do not
+// call AP functions from an interrupt.
+//#define APKERNEL 1
+// number of commands that can be sent to the Bluetooth module
+// before the first is answered (see AP_SendCommand)
+// define AP_INFLIGHT as 1 to wait for each response before
+// sending the next command
+#ifndef AP_INFLIGHT
+#define AP_INFLIGHT 4
+#endif
+// number of read/write and notify characteristics that can be
+// added, 255 altogether; each costs about 20 bytes of RAM, plus
+// 3 (read/write) or 4 (notify) bytes of the handle table
+#ifndef AP_MAXCHARACTERISTICS
+#define AP_MAXCHARACTERISTICS 32
+#endif
+#ifndef AP_MAXNOTIFY
+#define AP_MAXNOTIFY 16
+#endif
+// largest ATT MTU the frame buffers are sized for, and the
+// largest characteristic value; the MTU itself is negotiated by
+// the central and starts at 23 (see AP_GetMTU)
+#ifndef AP_MAXMTU
+#define AP_MAXMTU 247
+#endif
+#ifndef AP_MAXVALUE
+#define AP_MAXVALUE 512
+#endif
 
 //------------AP_Init------------
 // Initialize serial link and GPIO to Bluetooth module
@@ -77,7 +117,9 @@ void AP_Reset(void);
 // calculates/sends FCS at end 
 // FCS is the 8-bit EOR of all bytes except SOF and FCS itself
 // 1) Send NPI package (it will calculate fcs)
-// 2) Wait for entire message to be sent
+// 2) Return while the UART1 interrupt sends it
+// The frame is copied into the UART1 transmit FIFO, so the
+// message buffer can be reused as soon as this returns.
 // Input: pointer to NPI encoded array
 // Output: APOK on success, APFAIL on timeout
 int AP_SendMessage(uint8_t *pt);
@@ -113,15 +155,48 @@ uint32_t AP_RecvStatus(void);
 //------------AP_SendMessageResponse------------
 // send a message to the Bluetooth module
 // and receive a response from the Bluetooth module
-// 1) send outgoing message
-// 2) wait at least 10ms to receive NPI package
-// 3) Wait for entire message to be received
+// 1) send outgoing message with AP_SendCommand
+// 2) handle frames until its response arrives
+// Commands sent earlier with AP_SendCommand can still be in
+// flight; their responses are handled along the way.
 // Input: msgPt points to message to send
 //        responsePt points to empty buffer into which data is returned
 //        maximum size (discard data beyond this limit)
 // Output: APOK if ok, APFAIL on error (timeout or fcs error)
 int AP_SendMessageResponse(uint8_t *msgPt, uint8_t *responsePt,uint32_t max);
 
+//------------AP_SendCommand------------
+// Send a command to the Bluetooth module without waiting for
+// its response.  Up to AP_INFLIGHT commands can be waiting;
+// a further call handles frames until one completes.
+// The SNP answers in order, so a response is matched to the
+// oldest command waiting for that cmd0/cmd1: 0x35 xx is
+// answered by 0x75 xx, 0x55 xx by 0x55 xx, and start
+// advertisement (0x55 0x42) by the event 0x55 0x05.
+// Input: pt, NPI message (copied, can be reused at once)
+//        done, called from AP_Poll with the tag, APOK and the
+//          response frame (SOF to FCS), or with APFAIL and 0
+//          on timeout; 0 if no call is needed
+//        tag, passed to done
+// Output: APOK if sent, APFAIL on timeout
+int AP_SendCommand(uint8_t *pt, void(*done)(uint32_t tag, int result, uint8_t *response), uint32_t tag);
+
+//------------AP_Poll------------
+// Handle every frame the Bluetooth module has to send:
+// responses complete the commands sent by AP_SendCommand, and
+// read, write and CCCD indications (0x87, 0x88, 0x8B) are
+// passed to the characteristics
+// Input: none
+// Output: number of frames handled
+int AP_Poll(void);
+
+//------------AP_Flush------------
+// Wait for the response to every command sent
+// Input: none
+// Output: APOK if every command since the last AP_Flush
+//         succeeded, APFAIL if any failed or timed out
+int AP_Flush(void);
+
 // ------------AP_Delay1ms------------
 // Simple delay function which delays about n milliseconds.
 // Inputs: n, number of msec to wait
@@ -135,6 +210,14 @@ void AP_Delay1ms(uint32_t n);
 // Outputs: 16-bit CCCD value of the notify characteristic
 uint16_t AP_GetNotifyCCCD(uint32_t i);
 
+//*********AP_GetMTU*******
+// Return the ATT MTU of the connection, as reported by the SNP;
+// a notification carries at most MTU-3 bytes of a value, a read
+// MTU-1 and a write MTU-3; longer reads and writes take several
+// Inputs:  none
+// Outputs: 23 to AP_MAXMTU
+uint16_t AP_GetMTU(void);
+
 // ********AP_OutMessage**********
 // Debugging dump of last received message to virtual serial port to PC
 // Inputs:  response (number returned by last AP call)
@@ -149,6 +232,8 @@ void AP_OutValue(char *label,uint32_t value);
  
 //*************AP_AddService**************
 // Add a service
+// The command is sent without waiting for its response; a
+// failure is reported by AP_RegisterService.
 // Inputs uuid is 0xFFF0, 0xFFF1, ...
 // Output APOK if successful,
 //        APFAIL if SNP failure
@@ -156,54 +241,135 @@ int AP_AddService(uint16_t uuid);
 
 //*************AP_RegisterService**************
 // Register a service
+// Waits for the responses to every command sent before it.
 // Inputs none
 // Output APOK if successful,
-//        APFAIL if SNP failure
+//        APFAIL if SNP failure, here or in an earlier AP_AddService,
+//        AP_AddCharacteristic or AP_AddNotifyCharacteristic
 int AP_RegisterService(void);
 
 //*************AP_AddCharacteristic**************
 // Add a read, write, or read/write characteristic
 //        for notify properties, call AP_AddNotifyCharacteristic 
+// The commands are sent without waiting for their responses;
+// the handle is filled in as the response arrives, and a
+// failure is reported by AP_RegisterService.
 // Inputs uuid is 0xFFF0, 0xFFF1, ...
-//        thesize is the number of bytes in the user data 1,2,4, or 8 
-//        pt is a pointer to the user data, stored little endian
+//        thesize is the number of bytes in the user data 1 to AP_MAXVALUE
+//        pt is a pointer to the user data; up to 8 bytes it is a number
+//          stored little endian (sent big endian), longer it is an array
+//          of bytes sent in order; long reads and writes use offsets
 //        permission is GATT Permission, 0=none,1=read,2=write, 3=Read+write 
 //        properties is GATT Properties, 2=read,8=write,0x0A=read+write
 //        name is a null-terminated string, maximum length of name is 20 bytes
 //        (*ReadFunc) called before it responses with data from internal structure
 //        (*WriteFunc) called after it accepts data into internal structure
 // Output APOK if successful,
-//        APFAIL if name is empty, more than 8 characteristics, or if SNP failure
+//        APFAIL if name is empty, more than AP_MAXCHARACTERISTICS, or if SNP failure
 int AP_AddCharacteristic(uint16_t uuid, uint16_t thesize, void *pt, uint8_t permission,
   uint8_t properties, char name[], void(*ReadFunc)(void), void(*WriteFunc)(void));
 
 //*************AP_AddNotifyCharacteristic**************
 // Add a notify characteristic
 //        for read, write, or read/write characteristic, call AP_AddCharacteristic 
+// The commands are sent without waiting for their responses;
+// the handles are filled in as the responses arrive, and a
+// failure is reported by AP_RegisterService.
 // Inputs uuid is 0xFFF0, 0xFFF1, ...
-//        thesize is the number of bytes in the user data 1,2,4, or 8 
-//        pt is a pointer to the user data, stored little endian
+//        thesize is the number of bytes in the user data 1 to AP_MAXVALUE;
+//          AP_SendNotification sends it only if it fits in MTU-3 bytes
+//        pt is a pointer to the user data; up to 8 bytes it is a number
+//          stored little endian (sent big endian), longer it is an array
+//          of bytes sent in order
 //        name is a null-terminated string, maximum length of name is 20 bytes
 //        (*CCCDfunc) called after it accepts , changing CCCDvalue
 // Output APOK if successful,
-//        APFAIL if name is empty, more than 4 notify characteristics, or if SNP failure
+//        APFAIL if name is empty, more than AP_MAXNOTIFY, or if SNP failure
 int AP_AddNotifyCharacteristic(uint16_t uuid, uint16_t thesize,  void *pt, 
   char name[], void(*CCCDfunc)(void));
   
 //*************AP_SendNotification**************
 // Send a notification (will skip if CCCD is 0) 
+// Returns without waiting for the SNP response, so the next
+// notification can be built while this one is sent.
+// A notification has no offset, so the value must fit in one:
+// a value longer than MTU-3 bytes is not sent.
 // Input:  index into notify characteristic to send
 // Output: APOK if successful,
-//         APFAIL if notification not configured, or if SNP failure
+//         APFAIL if notification not configured, value longer than
+//         MTU-3 bytes, or if SNP failure
 int AP_SendNotification(uint32_t i);
 
+//*************AP_SendNotificationData**************
+// Send bytes as one notification of a notify characteristic,
+// in place of its value (will skip if CCCD is 0)
+// Returns without waiting for the SNP response; done is called
+// from AP_Poll with the response, whose byte 5 is the SNP
+// status (0 if the notification was accepted for sending)
+// Input:  i, index into notify characteristic
+//         pt, bytes to send in order (copied, can be reused at once)
+//         size, 1 to MTU-3
+//         done, as for AP_SendCommand, 0 if no call is needed
+//         tag, passed to done
+// Output: APOK if sent or skipped,
+//         APFAIL if notification not configured, too long, or if SNP failure
+int AP_SendNotificationData(uint32_t i, const uint8_t *pt, uint32_t size,
+  void(*done)(uint32_t tag, int result, uint8_t *response), uint32_t tag);
+
 //*************AP_StartAdvertisement**************
 // Start advertisement
+// The four commands are sent back to back, then the
+// responses are collected.
 // Input:  none
 // Output: APOK if successful,
 //         APFAIL if notification not configured, or if SNP failure
 int AP_StartAdvertisement(void);
 
+// A GATT server described at compile time: tools/GATTGen.c turns
+// a description (see tools/APStartupGATT.def) into a header of
+// const NPI frames, FCS included, plus the tables below, so
+// AP_StartGATT sends them as they are, back to back.
+#define AP_FRAME         0    // kinds of frame, what its response fills in
+#define AP_FRAME_VALUE   1    // handle of CharacteristicList[index]
+#define AP_FRAME_NOTIFY  2    // handle of NotifyCharacteristicList[index]
+#define AP_FRAME_CCCD    3    // CCCD handle of NotifyCharacteristicList[index]
+typedef struct APFrames{
+  const uint8_t *frame;       // SOF to FCS
+  uint8_t kind;               // AP_FRAME ...
+  uint8_t index;              // characteristic, counted from the first in the table
+}apframe_t;
+typedef struct APCharacteristics{
+  uint16_t size;              // as for AP_AddCharacteristic
+  void *pt;
+  void(*callBackRead)(void);
+  void(*callBackWrite)(void);
+}apchar_t;
+typedef struct APNotifyCharacteristics{
+  uint16_t uuid;              // as for AP_AddNotifyCharacteristic
+  uint16_t size;
+  void *pt;
+  void(*callBackCCCD)(void);
+}apnotify_t;
+typedef struct APGatt{
+  const apframe_t *frames;    // add service, characteristics, register, advertising
+  uint32_t frameCount;
+  const apchar_t *chars;      // read/write characteristics, in the order added
+  uint32_t charCount;
+  const apnotify_t *notify;   // notify characteristics, in the order added
+  uint32_t notifyCount;
+}apgatt_t;
+
+//*************AP_StartGATT**************
+// Build the GATT server and start advertising from a table
+// generated by tools/GATTGen.c; does what AP_AddService, the
+// AP_Add...Characteristic calls, AP_RegisterService and
+// AP_StartAdvertisement do, without building a single frame and
+// without waiting in between
+// Input:  gatt, the table
+// Output: APOK if successful,
+//         APFAIL if too many characteristics, or if SNP failure
+int AP_StartGATT(const apgatt_t *gatt);
+
 //*************AP_GetStatus**************
 // Get status of connection
 // Input:  none
@@ -221,11 +387,30 @@ uint32_t AP_GetStatus(void);
 uint32_t AP_GetVersion(void);
 
 // ****AP_BackgroundProcess****
-// handle incoming SNP frames
+// handle incoming SNP frames: indications and the responses
+// to commands sent with AP_SendCommand (see AP_Poll)
 // Inputs:  none
 // Outputs: none
 void AP_BackgroundProcess(void);
 
+extern int32_t AP_SRDYFell; // counting semaphore, falling edges of SRDY not yet waited for
+
+//------------AP_WaitEvent------------
+// Block until the Bluetooth module has something to send, then
+// handle every frame waiting (see AP_Poll).  The first call arms
+// a falling edge interrupt on SRDY (GPIO_SRDYEdge_Init) that
+// signals AP_SRDYFell, so a BLE thread running
+//   while(1){ AP_WaitEvent(); }
+// uses no processor time while the link is idle, where a loop
+// calling AP_BackgroundProcess polls SRDY all the time.  With
+// APKERNEL the thread blocks on AP_SRDYFell and the interrupt
+// runs the scheduler; without it the processor sleeps in
+// WaitForInterrupt.  Each command sent also makes SRDY fall,
+// and those wakeups return to sleep.
+// Inputs:  none
+// Outputs: number of frames handled, at least 1
+int AP_WaitEvent(void);
+
 //***********AP_GetSize***************
 // returns the size of an NPI message
 // Inputs:  pointer to NPI message
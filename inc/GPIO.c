@@ -81,6 +81,27 @@ void GPIO_Init(void){
   
   ClearReset();     // RESET=0    
 }
+
+void (*SRDYTask)(void);   // run on each falling edge of SRDY
+//------------GPIO_SRDYEdge_Init------------
+// Arm a falling edge interrupt on SRDY, PB2
+// Input: task, function run by the interrupt on each falling edge
+//        priority, 0 (highest) to 7
+// Output: none
+void GPIO_SRDYEdge_Init(void(*task)(void), uint32_t priority){
+  SRDYTask = task;
+  GPIO_PORTB_IS_R &= ~0x04;        // PB2 is edge-sensitive
+  GPIO_PORTB_IBE_R &= ~0x04;       // PB2 is not both edges
+  GPIO_PORTB_IEV_R &= ~0x04;       // PB2 falling edge event
+  GPIO_PORTB_ICR_R = 0x04;         // clear flag2
+  GPIO_PORTB_IM_R |= 0x04;         // arm interrupt on PB2
+  NVIC_PRI0_R = (NVIC_PRI0_R&0xFFFF1FFF)|((priority&0x07)<<13); // bits 15-13
+  NVIC_EN0_R = 0x00000002;         // enable interrupt 1 in NVIC
+}
+void GPIOPortB_Handler(void){
+  GPIO_PORTB_ICR_R = 0x04;         // acknowledge flag2
+  (*SRDYTask)();
+}
 #else
 // These three options require either reprogramming the CC2650LP/CC2650BP or using a 7-wire tether
 // These three options allow the use of the MKII I/O boosterpack
@@ -154,4 +175,25 @@ void GPIO_Init(void){
   ClearReset();     // RESET=0    
   
 }
+
+void (*SRDYTask)(void);   // run on each falling edge of SRDY
+//------------GPIO_SRDYEdge_Init------------
+// Arm a falling edge interrupt on SRDY, PA3
+// Input: task, function run by the interrupt on each falling edge
+//        priority, 0 (highest) to 7
+// Output: none
+void GPIO_SRDYEdge_Init(void(*task)(void), uint32_t priority){
+  SRDYTask = task;
+  GPIO_PORTA_IS_R &= ~0x08;        // PA3 is edge-sensitive
+  GPIO_PORTA_IBE_R &= ~0x08;       // PA3 is not both edges
+  GPIO_PORTA_IEV_R &= ~0x08;       // PA3 falling edge event
+  GPIO_PORTA_ICR_R = 0x08;         // clear flag3
+  GPIO_PORTA_IM_R |= 0x08;         // arm interrupt on PA3
+  NVIC_PRI0_R = (NVIC_PRI0_R&0xFFFFFF1F)|((priority&0x07)<<5); // bits 7-5
+  NVIC_EN0_R = 0x00000001;         // enable interrupt 0 in NVIC
+}
+void GPIOPortA_Handler(void){
+  GPIO_PORTA_ICR_R = 0x08;         // acknowledge flag3
+  (*SRDYTask)();
+}
 #endif
@@ -48,7 +48,17 @@
 #define PB5   (*((volatile uint32_t *)0x40005080))
 #define PB6   (*((volatile uint32_t *)0x40005100))
 #define PC6   (*((volatile uint32_t *)0x40006100))
-#ifdef DEFAULT
+#ifdef SNP_SIMULATOR
+// Option 5) No hardware: AP.c runs on a host computer against
+// the CC2650 stand-in in SNPSim.c, which also replaces
+// GPIO.c, UART1.c and CortexM.c
+#include "../inc/SNPSim.h"
+#define SetMRDY() SNPSim_SetMRDY(1)
+#define ClearMRDY() SNPSim_SetMRDY(0)
+#define SetReset() SNPSim_SetReset(1)
+#define ClearReset() SNPSim_SetReset(0)
+#define ReadSRDY() SNPSim_ReadSRDY()
+#elif defined(DEFAULT)
 // Option 4) Use this option with CC2650BP without an MKII 
 // Two board stack: CC2650BP+TM4C123 
 // Acceptable projects:
@@ -123,3 +133,14 @@
 // Input: none
 // Output: none
 void GPIO_Init(void);
+
+//------------GPIO_SRDYEdge_Init------------
+// Arm a falling edge interrupt on SRDY, so the Bluetooth module
+// pulling SRDY low (it has a frame to send, or it answers MRDY)
+// runs task instead of being found by polling ReadSRDY.
+// SRDY is PB2 (GPIOPortB_Handler) with DEFAULT, PA3
+// (GPIOPortA_Handler) otherwise.
+// Input: task, function run by the interrupt on each falling edge
+//        priority, 0 (highest) to 7
+// Output: none
+void GPIO_SRDYEdge_Init(void(*task)(void), uint32_t priority);
@@ -0,0 +1,176 @@
+// NPI.c
+// Runs on either TM4C123 or MSP432
+// Incremental receiver for the NPI frames sent by the CC2650
+// SNP, driven one byte at a time from UART1_Handler.
+// The interrupt (producer) only changes RxPut and the frame
+// it is filling; NPI_GetFrame (consumer) only changes RxGet,
+// so no critical section is needed between them.  Frame
+// k%NPI_FRAMES is complete for RxGet <= k < RxPut.
+
+#include <stdint.h>
+#include "../inc/CortexM.h"
+#include "../inc/AP.h"
+#include "../inc/NPI.h"
+
+#ifdef APKERNEL
+void OS_Signal(int32_t *semaPt);
+#define NPI_SIGNAL(semaPt) OS_Signal(semaPt)
+#else
+#define NPI_SIGNAL(semaPt)
+#endif
+
+// receiver states, the next byte expected
+#define WAITSOF   0
+#define LENLSB    1
+#define LENMSB    2
+#define CMD0      3
+#define CMD1      4
+#define PAYLOAD   5
+#define FCS       6
+
+uint8_t Frames[NPI_FRAMES][NPI_FRAMESIZE];
+uint32_t FrameSize[NPI_FRAMES]; // bytes stored of each frame
+volatile uint32_t RxPut;      // frames posted by the interrupt
+volatile uint32_t RxGet;      // frames removed by NPI_GetFrame
+uint32_t RxState;             // WAITSOF to FCS
+uint32_t RxLength;            // payload length of the frame in progress
+uint32_t RxCount;             // bytes of the frame in progress, SOF to FCS
+uint32_t RxLeft;              // payload bytes still to come
+uint8_t RxFcs;                // running FCS of the frame in progress
+uint8_t RxDrop;               // 1 if the frame in progress has no room in the queue
+uint32_t NPI_FcsErrors;
+uint32_t NPI_Overruns;
+uint32_t NPI_Truncated;
+uint32_t NPI_Noise;
+int32_t NPI_FrameReady;
+
+//------------NPI_Init------------
+// Empty the frame queue, clear the statistics, and wait for
+// the SOF of the next frame
+// Input: none
+// Output: none
+void NPI_Init(void){
+  long sr = StartCritical();
+  RxPut = 0;
+  RxGet = 0;
+  RxState = WAITSOF;
+  NPI_FcsErrors = 0;
+  NPI_Overruns = 0;
+  NPI_Truncated = 0;
+  NPI_Noise = 0;
+  NPI_FrameReady = 0;
+  EndCritical(sr);
+}
+
+//------------NPI_Resync------------
+// Drop a frame in progress and wait for the next SOF; used
+// after a timeout, in case a byte of the frame was lost.
+// Frames already queued are kept.
+// Input: none
+// Output: none
+void NPI_Resync(void){
+  long sr = StartCritical();
+  RxState = WAITSOF;
+  EndCritical(sr);
+}
+
+// store one byte of the frame in progress
+static void keep(uint8_t data){
+  if(RxDrop == 0){
+    if(RxCount < NPI_FRAMESIZE){
+      Frames[RxPut%NPI_FRAMES][RxCount] = data;
+    }
+  }
+  RxCount = RxCount + 1;
+}
+
+//------------NPI_RxByte------------
+// Process one received byte; called from the UART1 receive
+// interrupt.  Runs in constant time.
+// Input: data, the byte received
+// Output: none
+void NPI_RxByte(uint8_t data){
+  switch(RxState){
+    case WAITSOF:
+      if(data == SOF){
+        RxDrop = ((RxPut - RxGet) >= NPI_FRAMES); // queue full
+        RxCount = 0;
+        RxFcs = 0;
+        keep(data);
+        RxState = LENLSB;
+      } else{
+        NPI_Noise = NPI_Noise + 1;
+      }
+      return;
+    case LENLSB:
+      RxLength = data;
+      RxState = LENMSB;
+      break;
+    case LENMSB:
+      RxLength = RxLength + (data<<8);
+      RxState = CMD0;
+      break;
+    case CMD0:
+      RxState = CMD1;
+      break;
+    case CMD1:
+      RxLeft = RxLength;
+      RxState = (RxLeft > 0) ? PAYLOAD : FCS;
+      break;
+    case PAYLOAD:
+      RxLeft = RxLeft - 1;
+      if(RxLeft == 0){
+        RxState = FCS;
+      }
+      break;
+    case FCS:
+      keep(data);
+      RxState = WAITSOF;
+      if(data != RxFcs){
+        NPI_FcsErrors = NPI_FcsErrors + 1;
+      } else if(RxDrop){
+        NPI_Overruns = NPI_Overruns + 1;
+      } else{
+        if(RxCount > NPI_FRAMESIZE){
+          NPI_Truncated = NPI_Truncated + 1;
+          RxCount = NPI_FRAMESIZE;
+        }
+        FrameSize[RxPut%NPI_FRAMES] = RxCount;
+        RxPut = RxPut + 1;      // hand the frame to the reader
+        NPI_SIGNAL(&NPI_FrameReady);
+      }
+      return;
+  }
+  RxFcs = RxFcs^data;
+  keep(data);
+}
+
+//------------NPI_RxFrames------------
+// Number of complete frames waiting to be read
+// Input: none
+// Output: 0 to NPI_FRAMES
+uint32_t NPI_RxFrames(void){
+  return RxPut - RxGet;
+}
+
+//------------NPI_GetFrame------------
+// Remove the oldest frame from the queue
+// Input: pt, pointer to an empty buffer into which the
+//            frame (SOF to FCS) is copied
+//        max, size of the buffer (discard data beyond this limit)
+// Output: number of bytes in the frame, SOF to FCS, or 0 if
+//         the queue is empty
+uint32_t NPI_GetFrame(uint8_t *pt, uint32_t max){
+  uint32_t i, size;
+  uint8_t *frame;
+  if(RxPut == RxGet){
+    return 0;
+  }
+  frame = Frames[RxGet%NPI_FRAMES];
+  size = FrameSize[RxGet%NPI_FRAMES];
+  for(i=0; (i<size) && (i<max); i=i+1){
+    pt[i] = frame[i];
+  }
+  RxGet = RxGet + 1;            // give the frame back to the interrupt
+  return size;
+}
@@ -0,0 +1,63 @@
+// NPI.h
+// Runs on either TM4C123 or MSP432
+// Incremental receiver for the NPI frames sent by the CC2650
+// SNP.  UART1_Handler passes every received byte to
+// NPI_RxByte, which follows the frame one byte at a time
+//   SOF, length (2 bytes, little endian), cmd0, cmd1,
+//   length bytes of payload, FCS
+// folding each byte into the FCS (8-bit EOR of every byte
+// except SOF and FCS) as it arrives.  A frame whose FCS
+// matches is posted to a queue of NPI_FRAMES frames, so the
+// application reads a whole frame with NPI_GetFrame instead
+// of waiting on the serial port for each byte.  Bytes outside
+// a frame are ignored until the next SOF.
+// If APKERNEL is defined in AP.h, each posted frame also
+// signals the Lab4 kernel semaphore NPI_FrameReady.
+
+#define NPI_FRAMESIZE 264     // bytes kept of each frame, SOF to FCS; a write
+                              // indication at an ATT MTU of 247 (AP_MAXMTU)
+#define NPI_FRAMES    4       // frames that can wait to be read
+
+// statistics, cleared by NPI_Init
+extern uint32_t NPI_FcsErrors;  // frames dropped because the FCS did not match
+extern uint32_t NPI_Overruns;   // frames dropped because the queue was full
+extern uint32_t NPI_Truncated;  // frames longer than NPI_FRAMESIZE, kept in part
+extern uint32_t NPI_Noise;      // bytes received outside of a frame
+extern int32_t NPI_FrameReady;  // counting semaphore, number of frames queued
+
+//------------NPI_Init------------
+// Empty the frame queue, clear the statistics, and wait for
+// the SOF of the next frame
+// Input: none
+// Output: none
+void NPI_Init(void);
+
+//------------NPI_Resync------------
+// Drop a frame in progress and wait for the next SOF; used
+// after a timeout, in case a byte of the frame was lost.
+// Frames already queued are kept.
+// Input: none
+// Output: none
+void NPI_Resync(void);
+
+//------------NPI_RxByte------------
+// Process one received byte; called from the UART1 receive
+// interrupt.  Runs in constant time.
+// Input: data, the byte received
+// Output: none
+void NPI_RxByte(uint8_t data);
+
+//------------NPI_RxFrames------------
+// Number of complete frames waiting to be read
+// Input: none
+// Output: 0 to NPI_FRAMES
+uint32_t NPI_RxFrames(void);
+
+//------------NPI_GetFrame------------
+// Remove the oldest frame from the queue
+// Input: pt, pointer to an empty buffer into which the
+//            frame (SOF to FCS) is copied
+//        max, size of the buffer (discard data beyond this limit)
+// Output: number of bytes in the frame, SOF to FCS, or 0 if
+//         the queue is empty
+uint32_t NPI_GetFrame(uint8_t *pt, uint32_t max);
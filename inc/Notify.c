@@ -0,0 +1,275 @@
+// Notify.c
+// Runs on either TM4C123 or MSP432
+// Streams samples from several sensor channels to the phone
+// through one notify characteristic, see Notify.h.
+// Waiting (NOTIFY_BLOCK, Notify_Flush) uses AP_Flush, so a frame
+// the SNP never answers times out instead of stalling the stream.
+// Notify_Put (producer, may be an interrupt) builds Frame and
+// moves it to Queue when full; Notify_Run (consumer) moves the
+// oldest frame from Queue to Sending and hands it to AP.c.
+// Frame, Queue and the indexes are shared, so both sides change
+// them with interrupts disabled.  Sending belongs to Notify_Run
+// and its response callback alone.
+
+#include <stdint.h>
+#include "../inc/CortexM.h"
+#include "../inc/AP.h"
+#include "../inc/Notify.h"
+
+typedef struct NotifyChannels{
+  uint8_t size;               // bytes per sample, 0 if not set up
+  uint8_t mode;               // NOTIFY_EVERY or NOTIFY_LATEST
+  uint8_t pos;                // where Frame holds its NOTIFY_LATEST sample, 0 if it does not
+}notifychannel_t;
+
+uint32_t Notify_Sent;
+uint32_t Notify_Samples;
+uint32_t Notify_Dropped;
+uint32_t Notify_Coalesced;
+uint32_t Notify_Retries;
+
+static notifychannel_t Channels[NOTIFY_CHANNELS];
+static uint32_t Index;              // notify characteristic carrying the stream
+static uint32_t Policy;             // NOTIFY_DROPOLDEST or NOTIFY_BLOCK
+static uint8_t Sequence;            // number of the next frame
+
+// frame being built
+static uint8_t Frame[NOTIFY_FRAMESIZE];
+static uint32_t FrameSize;          // bytes in it, 0 if not started
+static uint32_t FrameMax;           // MTU-3 when it was started
+static uint32_t FrameSamples;       // samples in it
+static uint32_t Last;               // where its last record header is, 0 if none
+
+// full frames, Queue[k%NOTIFY_QUEUE] for QGet <= k < QPut
+static uint8_t Queue[NOTIFY_QUEUE][NOTIFY_FRAMESIZE];
+static uint16_t QueueSize[NOTIFY_QUEUE];
+static uint16_t QueueSamples[NOTIFY_QUEUE];
+static uint32_t QPut, QGet;
+
+// frame handed to AP.c
+static uint8_t Sending[NOTIFY_FRAMESIZE];
+static uint32_t SendingSize;
+static uint32_t SendingSamples;
+static uint32_t Busy;               // 1 while the SNP response is awaited
+static uint32_t Resend;             // 1 if Sending is to be sent (again)
+static uint32_t Tries;              // times Sending was refused
+
+//------------Notify_Init------------
+// Start a stream on a notify characteristic, with no channels
+// Input: index, notify characteristic from AP_AddNotifyCharacteristic
+//          (its own value is not used)
+//        policy, NOTIFY_DROPOLDEST or NOTIFY_BLOCK
+// Output: none
+void Notify_Init(uint32_t index, uint32_t policy){
+  uint32_t i;
+  long sr = StartCritical();
+  for(i=0; i<NOTIFY_CHANNELS; i=i+1){
+    Channels[i].size = 0;
+  }
+  Index = index;
+  Policy = policy;
+  Sequence = 0;
+  FrameSize = 0;
+  FrameSamples = 0;
+  QPut = 0;
+  QGet = 0;
+  Busy = 0;
+  Resend = 0;
+  Notify_Sent = 0;
+  Notify_Samples = 0;
+  Notify_Dropped = 0;
+  Notify_Coalesced = 0;
+  Notify_Retries = 0;
+  EndCritical(sr);
+}
+
+//------------Notify_Channel------------
+// Add or change a channel
+// Input: channel, 0 to NOTIFY_CHANNELS-1
+//        size, bytes per sample, 1 to 4
+//        mode, NOTIFY_EVERY or NOTIFY_LATEST
+// Output: APOK if successful, APFAIL if out of range
+int Notify_Channel(uint32_t channel, uint32_t size, uint32_t mode){
+  long sr;
+  if((channel >= NOTIFY_CHANNELS)||(channel > 15)||(size < 1)||(size > 4)){
+    return APFAIL;
+  }
+  sr = StartCritical();
+  Channels[channel].size = size;
+  Channels[channel].mode = mode;
+  Channels[channel].pos = 0;
+  EndCritical(sr);
+  return APOK;
+}
+
+// begin a new frame; called with interrupts disabled
+static void start(void){
+  uint32_t i;
+  FrameMax = AP_GetMTU()-3;
+  if(FrameMax > NOTIFY_FRAMESIZE){
+    FrameMax = NOTIFY_FRAMESIZE;
+  }
+  Frame[0] = Sequence;
+  Sequence = Sequence + 1;
+  FrameSize = 1;
+  FrameSamples = 0;
+  Last = 0;
+  for(i=0; i<NOTIFY_CHANNELS; i=i+1){
+    Channels[i].pos = 0;
+  }
+}
+
+// move the frame being built to the queue, dropping the oldest
+// frame if it is full; called with interrupts disabled
+static void enqueue(void){
+  uint32_t i; uint8_t *pt;
+  if(FrameSamples == 0){
+    return;
+  }
+  if((QPut - QGet) >= NOTIFY_QUEUE){
+    Notify_Dropped = Notify_Dropped + QueueSamples[QGet%NOTIFY_QUEUE];
+    QGet = QGet + 1;
+  }
+  pt = Queue[QPut%NOTIFY_QUEUE];
+  for(i=0; i<FrameSize; i=i+1){
+    pt[i] = Frame[i];
+  }
+  QueueSize[QPut%NOTIFY_QUEUE] = FrameSize;
+  QueueSamples[QPut%NOTIFY_QUEUE] = FrameSamples;
+  QPut = QPut + 1;
+  FrameSize = 0;
+  FrameSamples = 0;
+}
+
+//------------Notify_Put------------
+// Add one sample to the frame being built; can be called from
+// an interrupt with NOTIFY_DROPOLDEST.  With NOTIFY_BLOCK call
+// it only from the thread that runs the link.
+// Input: channel, 0 to NOTIFY_CHANNELS-1
+//        value, the sample, the low size bytes are sent
+// Output: APOK if kept, APFAIL if the channel is not set up
+int Notify_Put(uint32_t channel, uint32_t value){
+  notifychannel_t *c; uint32_t i; long sr;
+  if((channel >= NOTIFY_CHANNELS)||(Channels[channel].size == 0)){
+    return APFAIL;
+  }
+  c = &Channels[channel];
+  if(Policy == NOTIFY_BLOCK){
+    while(((QPut - QGet) >= NOTIFY_QUEUE)&&(FrameSize+1+c->size > FrameMax)){
+      Notify_Run();             // wait for room in the queue
+      AP_Flush();
+    }
+  }
+  sr = StartCritical();
+  if(FrameSize == 0){
+    start();
+  }
+  if((c->mode == NOTIFY_LATEST)&&c->pos){
+    for(i=0; i<c->size; i=i+1){ // replace the one waiting
+      Frame[c->pos+i] = value>>(8*i);
+    }
+    Notify_Coalesced = Notify_Coalesced + 1;
+    EndCritical(sr);
+    return APOK;
+  }
+  if((c->mode == NOTIFY_EVERY)&&Last&&((Frame[Last]>>4) == channel)&&
+     ((Frame[Last]&0x0F) < 15)&&(FrameSize+c->size <= FrameMax)){
+    Frame[Last] = Frame[Last]+1;  // one more sample in the last record
+  }else{
+    if(FrameSize+1+c->size > FrameMax){
+      enqueue();                // full, begin the next
+      start();
+    }
+    Last = FrameSize;
+    Frame[FrameSize] = channel<<4;
+    FrameSize = FrameSize+1;
+  }
+  if(c->mode == NOTIFY_LATEST){
+    c->pos = FrameSize;
+  }
+  for(i=0; i<c->size; i=i+1){
+    Frame[FrameSize+i] = value>>(8*i);
+  }
+  FrameSize = FrameSize+c->size;
+  FrameSamples = FrameSamples+1;
+  EndCritical(sr);
+  return APOK;
+}
+
+// response of the SNP to the frame in Sending, called from AP_Poll
+static void sendDone(uint32_t tag, int result, uint8_t *response){
+  Busy = 0;
+  if((result == APOK)&&(response[5] == 0)){
+    Notify_Sent = Notify_Sent + 1;
+    Notify_Samples = Notify_Samples + SendingSamples;
+    return;
+  }
+  if((result == APOK)&&(Tries < NOTIFY_RETRIES)){
+    Tries = Tries + 1;          // no room in the SNP, send it again
+    Notify_Retries = Notify_Retries + 1;
+    Resend = 1;
+    return;
+  }
+  Notify_Dropped = Notify_Dropped + SendingSamples;
+}
+
+// hand Sending to AP.c
+static void send(void){
+  Resend = 0;
+  if(AP_GetNotifyCCCD(Index) == 0){
+    Notify_Dropped = Notify_Dropped + SendingSamples; // nobody listening
+    return;
+  }
+  Busy = 1;
+  if(AP_SendNotificationData(Index, Sending, SendingSize, &sendDone, 0) == APFAIL){
+    if(Busy){                   // sendDone was not called
+      Busy = 0;
+      Notify_Dropped = Notify_Dropped + SendingSamples;
+    }
+  }
+}
+
+//------------Notify_Run------------
+// Send the next frame if the link is free; call it from the
+// loop that calls AP_BackgroundProcess
+// Input: none
+// Output: number of frames waiting, including one being built
+uint32_t Notify_Run(void){
+  uint32_t i, n; uint8_t *pt; long sr;
+  if((Busy == 0)&&(Resend == 0)){
+    sr = StartCritical();
+    if((QPut == QGet)&&FrameSamples){
+      enqueue();                // link idle, do not wait for the frame to fill
+    }
+    if(QPut != QGet){
+      pt = Queue[QGet%NOTIFY_QUEUE];
+      SendingSize = QueueSize[QGet%NOTIFY_QUEUE];
+      SendingSamples = QueueSamples[QGet%NOTIFY_QUEUE];
+      for(i=0; i<SendingSize; i=i+1){
+        Sending[i] = pt[i];
+      }
+      QGet = QGet + 1;
+      Resend = 1;
+      Tries = 0;
+    }
+    EndCritical(sr);
+  }
+  if((Busy == 0)&&Resend){
+    send();
+  }
+  sr = StartCritical();
+  n = (QPut - QGet) + (FrameSamples != 0) + (Busy|Resend);
+  EndCritical(sr);
+  return n;
+}
+
+//------------Notify_Flush------------
+// Run the link until every sample put so far has been sent
+// or dropped
+// Input: none
+// Output: none
+void Notify_Flush(void){
+  while(Notify_Run()){
+    AP_Flush();                 // response, or timeout, of the frame sent
+  }
+}
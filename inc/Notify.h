@@ -0,0 +1,90 @@
+// Notify.h
+// Runs on either TM4C123 or MSP432
+// Streams samples from several sensor channels to the phone
+// through one notify characteristic.  Samples are packed into
+// frames of up to MTU-3 bytes:
+//   byte 0        frame sequence number, 0 to 255, so the phone
+//                 can tell when frames were lost
+//   then records  one header byte, channel in bits 7-4 and
+//                 n-1 in bits 3-0, followed by n samples of that
+//                 channel, each its size in bytes, little endian
+// A channel is either NOTIFY_EVERY (e.g., sound: every sample is
+// kept, and consecutive samples share a record header) or
+// NOTIFY_LATEST (e.g., temperature: a new sample replaces one of
+// the same channel still in the frame being built, counted as
+// coalesced).
+// Full frames wait in a queue of NOTIFY_QUEUE.  Notify_Run,
+// called from the loop that calls AP_BackgroundProcess, sends
+// one frame at a time and sends the next when the SNP has
+// accepted it; a frame the SNP refuses (its buffers are full,
+// e.g., the connection interval is too long for the data rate)
+// is sent again.  While the link is idle a partly built frame
+// is sent at once, so frames fill up only when the link cannot
+// keep up.  When the queue is full, NOTIFY_DROPOLDEST drops the
+// oldest frame waiting, and NOTIFY_BLOCK makes Notify_Put run
+// the link until there is room.
+// Include AP.h first.
+
+#ifndef NOTIFY_CHANNELS
+#define NOTIFY_CHANNELS  8    // channels, at most 16
+#endif
+#ifndef NOTIFY_QUEUE
+#define NOTIFY_QUEUE     4    // full frames that can wait
+#endif
+#ifndef NOTIFY_FRAMESIZE
+#define NOTIFY_FRAMESIZE (AP_MAXMTU-3) // largest frame
+#endif
+#ifndef NOTIFY_RETRIES
+#define NOTIFY_RETRIES   1000 // times a refused frame is sent again before it is dropped
+#endif
+#define NOTIFY_EVERY      0   // channel modes
+#define NOTIFY_LATEST     1
+#define NOTIFY_DROPOLDEST 0   // policies when the queue is full
+#define NOTIFY_BLOCK      1
+
+// statistics, cleared by Notify_Init
+extern uint32_t Notify_Sent;      // frames accepted by the SNP
+extern uint32_t Notify_Samples;   // samples in those frames
+extern uint32_t Notify_Dropped;   // samples lost: queue full, not subscribed, or SNP failure
+extern uint32_t Notify_Coalesced; // NOTIFY_LATEST samples replaced by a newer one
+extern uint32_t Notify_Retries;   // frames refused by the SNP and sent again
+
+//------------Notify_Init------------
+// Start a stream on a notify characteristic, with no channels
+// Input: index, notify characteristic from AP_AddNotifyCharacteristic
+//          (its own value is not used)
+//        policy, NOTIFY_DROPOLDEST or NOTIFY_BLOCK
+// Output: none
+void Notify_Init(uint32_t index, uint32_t policy);
+
+//------------Notify_Channel------------
+// Add or change a channel
+// Input: channel, 0 to NOTIFY_CHANNELS-1
+//        size, bytes per sample, 1 to 4
+//        mode, NOTIFY_EVERY or NOTIFY_LATEST
+// Output: APOK if successful, APFAIL if out of range
+int Notify_Channel(uint32_t channel, uint32_t size, uint32_t mode);
+
+//------------Notify_Put------------
+// Add one sample to the frame being built; can be called from
+// an interrupt with NOTIFY_DROPOLDEST.  With NOTIFY_BLOCK call
+// it only from the thread that runs the link.
+// Input: channel, 0 to NOTIFY_CHANNELS-1
+//        value, the sample, the low size bytes are sent
+// Output: APOK if kept, APFAIL if the channel is not set up
+int Notify_Put(uint32_t channel, uint32_t value);
+
+//------------Notify_Run------------
+// Send the next frame if the link is free; call it from the
+// loop that calls AP_BackgroundProcess
+// Input: none
+// Output: number of frames waiting, including one being built
+uint32_t Notify_Run(void);
+
+//------------Notify_Flush------------
+// Run the link until every sample put so far has been sent
+// or dropped; uses AP_Flush, so it also waits for the other
+// commands in flight
+// Input: none
+// Output: none
+void Notify_Flush(void);
@@ -0,0 +1,914 @@
+// SNPSim.c
+// Runs on a host computer (Linux, Windows, Mac)
+// Stand-in for the CC2650 running SimpleNP, see SNPSim.h.
+// Replaces GPIO.c, UART1.c and CortexM.c, so AP.c and NPI.c
+// compiled with SNP_SIMULATOR run unmodified against it.
+//
+// The link is event driven.  Pending events (the next byte
+// from the AP reaching the SNP, the next byte from the SNP
+// reaching the AP, the SNP finishing a command, SRDY falling)
+// each have a virtual time; SNPSim_Run steps from one to the
+// next and then re-evaluates the handshake in update().
+// One SNP frame is sent per MRDY/SRDY transaction; while the
+// AP holds MRDY low to send, a response that is ready goes
+// the other way at the same time, as on the real link.
+// The scripted central adds two more: the next script step,
+// and the next connection event.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#ifdef SNPSIM_THREADS
+#include <pthread.h>
+#include <sched.h>
+#endif
+#include "../inc/CortexM.h"
+#include "../inc/UART1.h"
+#include "../inc/AP.h"
+#include "../inc/NPI.h"
+#include "../inc/SNPSim.h"
+
+#define NONE        0xFFFFFFFFFFFFFFFFULL // no event pending
+#define SIMFRAMESIZE 270      // largest NPI frame, SOF to FCS
+#define SIMFRAMES    8        // frames that can wait in each direction
+#define TXSIZE       1024     // bytes the AP can queue (must be power of 2)
+
+typedef struct SimFrames{
+  uint8_t data[SIMFRAMESIZE];
+  uint32_t size;              // bytes, SOF to FCS
+  uint64_t time;              // to the AP: earliest time the SNP may send it
+                              // from the AP: time it was received
+}simframe_t;
+
+uint64_t SNPSim_Time;
+uint32_t SNPSim_Commands;
+uint32_t SNPSim_Frames;
+uint32_t SNPSim_FcsErrors;
+uint32_t SNPSim_Lost;
+uint32_t SNPSim_Attributes;
+uint32_t SNPSim_Advertising;
+uint64_t SNPSim_AdvertisingTime;
+uint64_t SNPSim_SleepTime;
+uint32_t SNPSim_SRDYEdges;
+snpsimstat_t SNPSim_ReadLatency;
+snpsimstat_t SNPSim_WriteLatency;
+snpsimstat_t SNPSim_CCCDLatency;
+snpsimstat_t SNPSim_NotifyLatency;
+uint32_t SNPSim_NotifyBytes;
+uint32_t SNPSim_NotifyDropped;
+uint8_t SNPSim_Value[SNPSIM_VALUESIZE];
+uint32_t SNPSim_ValueSize;
+uint32_t SNPSim_ScriptErrors;
+uint32_t SNPSim_Unasked;
+void (*SNPSim_Notified)(uint16_t handle, const uint8_t *data, uint32_t size);
+
+// AP to SNP, the UART1 transmitter
+static uint8_t TxBytes[TXSIZE];
+static uint32_t TxPut, TxGet;       // bytes queued, bytes delivered
+static uint64_t TxAt = NONE;        // time the byte at TxGet reaches the SNP
+static void (*TxTask)(void);        // set by UART1_OutComplete
+
+// SNP receiver and command queue
+static uint8_t RxFrame[SIMFRAMESIZE];
+static uint32_t RxCount;            // bytes of the frame in progress
+static simframe_t CmdQ[SIMFRAMES];
+static uint32_t CmdPut, CmdGet;
+static uint32_t Processing;         // 1 while the SNP executes CmdQ[CmdGet]
+static uint64_t ProcAt = NONE;      // time it finishes
+
+// SNP to AP
+static simframe_t OutQ[SIMFRAMES];
+static uint32_t OutPut, OutGet;
+static uint32_t Sending;            // 1 while OutQ[OutGet] is on the wire
+static uint32_t OutPos;             // bytes of it sent
+static uint64_t SnpAt = NONE;       // time the next byte reaches the AP
+
+// handshake
+static int Mrdy = 1, Srdy = 1;
+static uint32_t InReset;            // 1 while RESET is held low
+static uint32_t Active;             // 1 during a transaction (SRDY low)
+static uint32_t MrdySeen;           // 1 once MRDY was low during this transaction
+static uint32_t Sent;               // 1 once a frame was sent in this transaction
+static uint64_t SrdyAt = NONE;      // time SRDY falls
+static void (*SrdyTask)(void);      // set by GPIO_SRDYEdge_Init
+
+// GATT server
+#define SIMCHARS 64
+typedef struct SimChars{
+  uint16_t uuid;
+  uint16_t handle;            // value handle
+  uint16_t cccd;              // CCCD handle, 0 if none
+  uint8_t properties;         // 2=read,8=write,0x10=notify
+  uint8_t subscribed;         // CCCD value written by the central
+}simchar_t;
+static uint16_t Handle;             // last attribute handle assigned
+static uint16_t ServiceStart;       // handle of the service being added
+static simchar_t Chars[SIMCHARS];
+static uint32_t NumChars;
+
+// scripted central
+#define OPREAD  1
+#define OPWRITE 2
+#define OPCCCD  3
+static const char *Script;          // next line, 0 when done
+static uint64_t ScriptAt = NONE;    // time to run the next line
+static uint32_t ScriptOp;           // indication waiting for confirmation, 0 for none
+static uint32_t ScriptLeft;         // indications still to send
+static simchar_t *ScriptChar;       // characteristic they go to
+static uint8_t ScriptData[SNPSIM_VALUESIZE];
+static uint32_t ScriptSize;         // bytes to write, or CCCD value
+static uint32_t ScriptOffset;       // of the piece of a long read or write being sent
+static uint32_t ScriptPiece;        // bytes in that piece of a write
+static uint64_t ScriptStart;        // time the operation started
+static uint32_t Connected;
+static uint32_t Mtu;                // ATT MTU of the connection
+static uint64_t ConnInterval;       // nsec between connection events
+static uint64_t ConnAt = NONE;      // time of the next connection event
+static uint64_t LinkTime[SNPSIM_LINKBUF]; // notifications waiting, time received
+static uint32_t LinkSize[SNPSIM_LINKBUF]; // and value bytes
+static uint16_t LinkHandle[SNPSIM_LINKBUF];
+static uint8_t LinkData[SNPSIM_LINKBUF][SNPSIM_MAXMTU];
+static uint32_t LinkPut, LinkGet;
+static uint32_t LinkLeft;           // link layer packets of LinkGet still to send
+
+// queue a frame from the SNP to the AP
+// Input: cmd0, cmd1, payload and its length,
+//        delay, nsec before the SNP may send it
+static void respond(uint8_t cmd0, uint8_t cmd1, const uint8_t *payload, uint32_t length, uint64_t delay){
+  simframe_t *f; uint32_t i; uint8_t fcs;
+  if((OutPut - OutGet) >= SIMFRAMES){
+    return;                   // AP is not reading, drop it
+  }
+  f = &OutQ[OutPut%SIMFRAMES];
+  f->data[0] = SOF;
+  f->data[1] = length&0xFF;
+  f->data[2] = length>>8;
+  f->data[3] = cmd0;
+  f->data[4] = cmd1;
+  for(i=0; i<length; i=i+1){
+    f->data[5+i] = payload[i];
+  }
+  fcs = 0;
+  for(i=1; i<length+5; i=i+1){
+    fcs = fcs^f->data[i];
+  }
+  f->data[5+length] = fcs;
+  f->size = length + 6;
+  f->time = SNPSim_Time + delay;
+  OutPut = OutPut + 1;
+}
+
+// the SNP restarts: GATT table cleared, power up indication sent
+static void powerUp(uint64_t delay){
+  Handle = 0x001D;            // SNP's own GAP and GATT services come first
+  SNPSim_Attributes = 0;
+  SNPSim_Advertising = 0;
+  NumChars = 0;
+  Connected = 0;
+  ConnAt = NONE;
+  LinkGet = LinkPut;
+  LinkLeft = 0;
+  respond(0x55, 0x01, 0, 0, delay);
+}
+
+// give out the next attribute handle
+static uint16_t attribute(void){
+  Handle = Handle + 1;
+  SNPSim_Attributes = SNPSim_Attributes + 1;
+  return Handle;
+}
+
+// characteristic with a value or CCCD handle, 0 if none
+static simchar_t *byHandle(uint16_t h){
+  uint32_t i;
+  for(i=0; i<NumChars; i=i+1){
+    if((Chars[i].handle == h)||(Chars[i].cccd == h)){
+      return &Chars[i];
+    }
+  }
+  return 0;
+}
+
+// record one latency
+static void record(snpsimstat_t *s, uint64_t ns){
+  if((s->count == 0)||(ns < s->min)){
+    s->min = ns;
+  }
+  if(ns > s->max){
+    s->max = ns;
+  }
+  s->total = s->total + ns;
+  s->count = s->count + 1;
+}
+
+// the SNP accepts a notification from the AP
+// Output: status for the response, 0 if it will be sent
+static uint8_t notify(simframe_t *f){
+  simchar_t *c; uint32_t i, size;
+  c = byHandle(f->data[7] + (f->data[8]<<8));
+  size = f->data[1] + (f->data[2]<<8) - 6;
+  if((Connected == 0)||(c == 0)||(c->subscribed == 0)||(size > Mtu-3)||
+     ((LinkPut - LinkGet) >= SNPSIM_LINKBUF)){
+    SNPSim_NotifyDropped = SNPSim_NotifyDropped + 1;
+    return 0x11;              // no resources
+  }
+  LinkTime[LinkPut%SNPSIM_LINKBUF] = f->time;
+  LinkSize[LinkPut%SNPSIM_LINKBUF] = size;
+  LinkHandle[LinkPut%SNPSIM_LINKBUF] = c->handle;
+  for(i=0; i<size; i=i+1){
+    LinkData[LinkPut%SNPSIM_LINKBUF][i] = f->data[11+i];
+  }
+  LinkPut = LinkPut + 1;
+  return 0;
+}
+
+// one connection event: up to SNPSIM_PERCONN link layer packets
+// of SNPSIM_LLDATA bytes; a notification takes its value plus
+// 7 bytes of L2CAP and ATT headers
+static void connectionEvent(void){
+  uint32_t packets = SNPSIM_PERCONN;
+  while(packets && (LinkGet != LinkPut)){
+    if(LinkLeft == 0){
+      LinkLeft = (LinkSize[LinkGet%SNPSIM_LINKBUF] + 7 + SNPSIM_LLDATA-1)/SNPSIM_LLDATA;
+    }
+    if(LinkLeft > packets){
+      LinkLeft = LinkLeft - packets;
+      return;
+    }
+    packets = packets - LinkLeft;
+    LinkLeft = 0;
+    record(&SNPSim_NotifyLatency, SNPSim_Time - LinkTime[LinkGet%SNPSIM_LINKBUF]);
+    SNPSim_NotifyBytes = SNPSim_NotifyBytes + LinkSize[LinkGet%SNPSIM_LINKBUF];
+    if(SNPSim_Notified){
+      (*SNPSim_Notified)(LinkHandle[LinkGet%SNPSIM_LINKBUF], LinkData[LinkGet%SNPSIM_LINKBUF],
+                         LinkSize[LinkGet%SNPSIM_LINKBUF]);
+    }
+    LinkGet = LinkGet + 1;
+  }
+}
+
+// execute one command from the AP
+static void execute(simframe_t *cmd){
+  uint8_t r[8]; uint16_t h;
+  uint8_t *f = cmd->data;
+  uint8_t cmd0 = f[3], cmd1 = f[4];
+  r[0] = 0;                   // status success
+  if(cmd0 == 0x35){           // synchronous request
+    switch(cmd1){
+      case 0x81:              // add service
+        ServiceStart = attribute();
+        respond(0x75, cmd1, r, 1, 0);
+        return;
+      case 0x82:              // add characteristic value: declaration and value
+        attribute();
+        h = attribute();
+        if(NumChars < SIMCHARS){
+          Chars[NumChars].uuid = f[11] + (f[12]<<8);
+          Chars[NumChars].handle = h;
+          Chars[NumChars].cccd = 0;
+          Chars[NumChars].properties = f[6];
+          Chars[NumChars].subscribed = 0;
+          NumChars = NumChars + 1;
+        }
+        r[1] = h&0xFF; r[2] = h>>8;
+        respond(0x75, cmd1, r, 3, 0);
+        return;
+      case 0x83:              // add descriptors, handles in CCCD, user description order
+        r[1] = f[5];
+        h = 2;
+        if(f[5]&0x04){        // CCCD
+          attribute();
+          if(NumChars){
+            Chars[NumChars-1].cccd = Handle;
+          }
+          r[h] = Handle&0xFF; r[h+1] = Handle>>8; h = h + 2;
+        }
+        if(f[5]&0x80){        // user description
+          attribute();
+          r[h] = Handle&0xFF; r[h+1] = Handle>>8; h = h + 2;
+        }
+        respond(0x75, cmd1, r, h, 0);
+        return;
+      case 0x84:              // register service
+        r[1] = ServiceStart&0xFF; r[2] = ServiceStart>>8;
+        r[3] = Handle&0xFF; r[4] = Handle>>8;
+        respond(0x75, cmd1, r, 5, 0);
+        return;
+      case 0x03:              // get version
+        r[1] = 0x02; r[2] = 0x02;
+        respond(0x75, cmd1, r, 3, 0);
+        return;
+      case 0x8C:              // set GATT parameter
+        respond(0x75, cmd1, r, 1, 0);
+        return;
+    }
+    r[0] = 0x01;              // not supported
+    respond(0x75, cmd1, r, 1, 0);
+    return;
+  }
+  switch(cmd1){
+    case 0x04:                // HCI command
+      r[1] = f[5]; r[2] = f[6];
+      respond(0x55, cmd1, r, 3, 0);
+      if((f[5] == 0x1D)&&(f[6] == 0xFC)){ // HCI_EXT_ResetSystemCmd
+        powerUp(SNPSIM_POWERUPNS);
+      }
+      return;
+    case 0x06:                // get status
+      r[0] = SNPSim_Advertising ? 0x02 : 0x00; // GAPRole advertising
+      r[1] = SNPSim_Advertising;
+      r[2] = 0; r[3] = 0;
+      respond(0x55, cmd1, r, 4, 0);
+      return;
+    case 0x42:                // start advertisement, answered by an event
+      SNPSim_Advertising = 1;
+      SNPSim_AdvertisingTime = SNPSim_Time;
+      r[0] = 0x04; r[1] = 0x00; r[2] = 0;  // advertising started, success
+      respond(0x55, 0x05, r, 3, 0);
+      return;
+    case 0x89:                // send notification
+      r[0] = notify(cmd);
+      respond(0x55, cmd1, r, 1, 0);
+      return;
+    case 0x87:                // confirmations need no response
+    case 0x88:
+    case 0x8B:
+      return;
+  }
+  respond(0x55, cmd1, r, 1, 0); // e.g., 0x43 advertisement data
+}
+
+// the central sends the next read, write or CCCD indication;
+// a long read asks for MTU-1 bytes at a time (read blob), a long
+// write sends MTU-5 bytes at a time (prepare write)
+static void request(void){
+  uint8_t p[8+SNPSIM_MAXMTU]; uint32_t i; uint16_t h;
+  h = (ScriptOp == OPCCCD) ? ScriptChar->cccd : ScriptChar->handle;
+  p[0] = 0; p[1] = 0;         // connection handle
+  p[2] = h&0xFF; p[3] = h>>8;
+  if(ScriptOp == OPREAD){
+    p[4] = ScriptOffset&0xFF; p[5] = ScriptOffset>>8;
+    p[6] = (Mtu-1)&0xFF; p[7] = (Mtu-1)>>8; // maximum size
+    respond(0x55, 0x87, p, 8, 0);
+    return;
+  }
+  p[4] = 1;                   // response needed
+  if(ScriptOp == OPCCCD){
+    p[5] = ScriptSize; p[6] = 0; // CCCD value
+    respond(0x55, 0x8B, p, 7, 0);
+    return;
+  }
+  p[5] = ScriptOffset&0xFF; p[6] = ScriptOffset>>8;
+  ScriptPiece = ScriptSize - ScriptOffset;
+  if(ScriptSize > Mtu-3){
+    if(ScriptPiece > Mtu-5) ScriptPiece = Mtu-5;
+  }
+  for(i=0; i<ScriptPiece; i=i+1){
+    p[7+i] = ScriptData[ScriptOffset+i];
+  }
+  respond(0x55, 0x88, p, 7+ScriptPiece, 0);
+}
+
+// the central sends n write commands (write without response)
+// of the first size bytes of ScriptData, back to back
+static void writeCommands(uint32_t n, uint32_t size){
+  uint8_t p[7+SNPSIM_MAXMTU]; uint32_t i;
+  p[0] = 0; p[1] = 0;         // connection handle
+  p[2] = ScriptChar->handle&0xFF; p[3] = ScriptChar->handle>>8;
+  p[4] = 0;                   // no response needed
+  p[5] = 0; p[6] = 0;         // offset
+  for(i=0; i<size; i=i+1){
+    p[7+i] = ScriptData[i];
+  }
+  for(i=0; i<n; i=i+1){
+    respond(0x55, 0x88, p, 7+size, 0);
+  }
+}
+
+// the central starts the next operation
+static void begin(void){
+  ScriptStart = SNPSim_Time;
+  ScriptOffset = 0;
+  request();
+}
+
+// the AP confirmed an indication
+static void confirm(uint8_t *f){
+  uint32_t i, size;
+  uint8_t expect = (ScriptOp == OPREAD) ? 0x87 : (ScriptOp == OPWRITE) ? 0x88 : 0x8B;
+  if((ScriptOp == 0)||(f[4] != expect)){
+    SNPSim_Unasked = SNPSim_Unasked + 1;
+    return;                   // not asked for
+  }
+  if(f[5] != 0){              // status, e.g. invalid offset
+    SNPSim_ScriptErrors = SNPSim_ScriptErrors + 1;
+    ScriptLeft = 1;           // give up on this line
+  } else if(ScriptOp == OPREAD){
+    size = f[1] + (f[2]<<8) - 7;  // status, connection, handle, offset, value
+    for(i=0; (i<size)&&(ScriptOffset+i<SNPSIM_VALUESIZE); i=i+1){
+      SNPSim_Value[ScriptOffset+i] = f[12+i];
+    }
+    ScriptOffset = ScriptOffset + i;
+    SNPSim_ValueSize = ScriptOffset;
+    if((size == Mtu-1)&&(ScriptOffset < SNPSIM_VALUESIZE)){
+      request();              // maybe more, read blob
+      return;
+    }
+    record(&SNPSim_ReadLatency, SNPSim_Time - ScriptStart);
+  } else if(ScriptOp == OPWRITE){
+    ScriptOffset = ScriptOffset + ScriptPiece;
+    if(ScriptOffset < ScriptSize){
+      request();              // next piece
+      return;
+    }
+    record(&SNPSim_WriteLatency, SNPSim_Time - ScriptStart);
+  } else{
+    record(&SNPSim_CCCDLatency, SNPSim_Time - ScriptStart);
+    ScriptChar->subscribed = ScriptSize;
+  }
+  ScriptLeft = ScriptLeft - 1;
+  if(ScriptLeft){
+    begin();
+  } else{
+    ScriptOp = 0;
+    ScriptAt = SNPSim_Time;   // on to the next line
+  }
+}
+
+// the central runs script lines until one has to wait
+static void step(void){
+  char line[80], op[16], hex[41];
+  unsigned int uuid, n, b; uint32_t i; int k; uint8_t e[6]; double ms;
+  while(Script){
+    for(i=0; (Script[i] != 0)&&(Script[i] != '\n'); i=i+1){
+      if(i < sizeof(line)-1){
+        line[i] = Script[i];
+      }
+    }
+    line[(i < sizeof(line)-1) ? i : sizeof(line)-1] = 0;
+    Script = (Script[i] == 0) ? 0 : &Script[i+1];
+    if((sscanf(line, "%15s", op) != 1)||(op[0] == '#')){
+      continue;               // blank line or comment
+    }
+    n = 0;
+    if(strcmp(op, "connect") == 0){
+      sscanf(line, "%*s %u", &n);
+      Connected = 1;
+      Mtu = 23;
+      ConnInterval = (uint64_t)(n ? n : 30)*1000000;
+      ConnAt = SNPSim_Time + ConnInterval;
+      SNPSim_Advertising = 0;
+      n = ConnInterval/1250000; // in 1.25 ms units
+      e[0] = 0x01; e[1] = 0x00; e[2] = 0; e[3] = 0; e[4] = n&0xFF; e[5] = n>>8;
+      respond(0x55, 0x05, e, 6, 0); // connection established event
+      continue;
+    }
+    if(strcmp(op, "mtu") == 0){
+      sscanf(line, "%*s %u", &n);
+      if((Connected == 0)||(n < 23)){
+        SNPSim_ScriptErrors = SNPSim_ScriptErrors + 1;
+        continue;
+      }
+      Mtu = (n < SNPSIM_MAXMTU) ? n : SNPSIM_MAXMTU;
+      e[0] = 0x20; e[1] = 0x00; e[2] = 0; e[3] = 0; e[4] = Mtu&0xFF; e[5] = Mtu>>8;
+      respond(0x55, 0x05, e, 6, 0); // ATT MTU updated event
+      continue;
+    }
+    if(strcmp(op, "disconnect") == 0){
+      Connected = 0;
+      ConnAt = NONE;
+      SNPSim_NotifyDropped = SNPSim_NotifyDropped + (LinkPut - LinkGet);
+      LinkGet = LinkPut;
+      LinkLeft = 0;
+      for(i=0; i<NumChars; i=i+1){
+        Chars[i].subscribed = 0;
+      }
+      SNPSim_Advertising = 1;   // advertising restarts
+      e[0] = 0x02; e[1] = 0x00; e[2] = 0; e[3] = 0;
+      respond(0x55, 0x05, e, 4, 0); // connection terminated event
+      continue;
+    }
+    if(strcmp(op, "wait") == 0){
+      ms = 0;
+      sscanf(line, "%*s %lf", &ms);
+      ScriptAt = SNPSim_Time + (uint64_t)(ms*1000000);
+      return;
+    }
+    if((sscanf(line, "%*s %x", &uuid) != 1)||(Connected == 0)){
+      SNPSim_ScriptErrors = SNPSim_ScriptErrors + 1;
+      continue;
+    }
+    ScriptChar = 0;
+    for(i=0; i<NumChars; i=i+1){
+      if(Chars[i].uuid == uuid){
+        ScriptChar = &Chars[i];
+      }
+    }
+    if(strcmp(op, "writenr") == 0){
+      n = 1;
+      hex[0] = 0;
+      sscanf(line, "%*s %*x %u %40s", &n, hex);
+      for(k=0; (hex[2*k] != 0)&&(k < Mtu-3)&&(sscanf(&hex[2*k], "%2x", &b) == 1); k++){
+        ScriptData[k] = b;
+      }
+      if((ScriptChar == 0)||(k == 0)){
+        SNPSim_ScriptErrors = SNPSim_ScriptErrors + 1;
+        continue;
+      }
+      writeCommands(n, k);
+      continue;               // nothing to wait for
+    }
+    ScriptLeft = 1;
+    ScriptSize = 0;
+    if(strcmp(op, "read") == 0){
+      ScriptOp = OPREAD;
+      sscanf(line, "%*s %*x %u", &ScriptLeft);
+    } else if(strcmp(op, "write") == 0){
+      ScriptOp = OPWRITE;
+      hex[0] = 0;
+      sscanf(line, "%*s %*x %u %40s %u", &ScriptLeft, hex, &n);
+      for(k=0; (hex[2*k] != 0)&&(sscanf(&hex[2*k], "%2x", &b) == 1); k++){
+        ScriptData[k] = b;
+      }
+      ScriptSize = k;
+      if((k > 0)&&(n > SNPSIM_VALUESIZE)){
+        n = SNPSIM_VALUESIZE;
+      }
+      for(; (k > 0)&&(ScriptSize < n); ScriptSize++){
+        ScriptData[ScriptSize] = ScriptData[ScriptSize%k]; // repeat the pattern
+      }
+    } else if((strcmp(op, "subscribe") == 0)||(strcmp(op, "unsubscribe") == 0)){
+      ScriptOp = OPCCCD;
+      ScriptSize = (op[0] == 's');
+      if(ScriptChar && (ScriptChar->cccd == 0)){
+        ScriptChar = 0;         // not a notify characteristic
+      }
+    } else{
+      ScriptOp = 0;
+    }
+    if((ScriptOp == 0)||(ScriptChar == 0)||(ScriptLeft == 0)){
+      ScriptOp = 0;
+      SNPSim_ScriptErrors = SNPSim_ScriptErrors + 1;
+      continue;
+    }
+    begin();
+    return;                   // wait for the confirmation
+  }
+}
+
+// one byte from the AP reaches the SNP
+static void receive(uint8_t data){
+  uint32_t i, size; uint8_t fcs; simframe_t *f;
+  if(InReset || (Active == 0)){
+    SNPSim_Lost = SNPSim_Lost + 1;  // SNP is not listening
+    return;
+  }
+  if((RxCount == 0)&&(data != SOF)){
+    SNPSim_Lost = SNPSim_Lost + 1;
+    return;
+  }
+  RxFrame[RxCount] = data;
+  RxCount = RxCount + 1;
+  if(RxCount < 3){
+    return;
+  }
+  size = RxFrame[1] + (RxFrame[2]<<8) + 6;
+  if(size > SIMFRAMESIZE){
+    SNPSim_FcsErrors = SNPSim_FcsErrors + 1;
+    RxCount = 0;
+    return;
+  }
+  if(RxCount < size){
+    return;
+  }
+  RxCount = 0;
+  fcs = 0;
+  for(i=1; i<size-1; i=i+1){
+    fcs = fcs^RxFrame[i];
+  }
+  if(fcs != RxFrame[size-1]){
+    SNPSim_FcsErrors = SNPSim_FcsErrors + 1;
+    return;
+  }
+  SNPSim_Commands = SNPSim_Commands + 1;
+  if((CmdPut - CmdGet) >= SIMFRAMES){
+    SNPSim_Lost = SNPSim_Lost + size;
+    return;
+  }
+  f = &CmdQ[CmdPut%SIMFRAMES];
+  for(i=0; i<size; i=i+1){
+    f->data[i] = RxFrame[i];
+  }
+  f->size = size;
+  f->time = SNPSim_Time;
+  CmdPut = CmdPut + 1;
+  if((f->data[3] == 0x55)&&((f->data[4] == 0x87)||(f->data[4] == 0x88)||(f->data[4] == 0x8B))){
+    confirm(f->data);         // the central's request is answered
+  }
+}
+
+// re-evaluate the SNP and the handshake at the current time
+static void update(void){
+  int ready;
+  if(InReset){
+    return;
+  }
+  if(Active && (Mrdy == 0)){
+    MrdySeen = 1;
+  }
+  if((Processing == 0)&&(CmdGet != CmdPut)){
+    Processing = 1;
+    ProcAt = SNPSim_Time + SNPSIM_CMDNS;
+  }
+  ready = (OutGet != OutPut)&&(OutQ[OutGet%SIMFRAMES].time <= SNPSim_Time);
+  if(Active && (Mrdy == 0) && (Sending == 0) && (Sent == 0) && ready){
+    Sending = 1;              // both lines low, send one frame
+    OutPos = 0;
+    SnpAt = SNPSim_Time + SNPSIM_BYTENS;
+  }
+  if(Active && MrdySeen && (Mrdy == 1) && (Sending == 0)){
+    Srdy = 1;                 // end of the transaction
+    Active = 0;
+    MrdySeen = 0;
+    Sent = 0;
+  }
+  if((Active == 0)&&(SrdyAt == NONE)){
+    if(Mrdy == 0){
+      SrdyAt = SNPSim_Time + SNPSIM_WAKENS; // AP wants to send
+    } else if(ready){
+      SrdyAt = SNPSim_Time + SNPSIM_GAPNS;  // SNP wants to send
+    }
+  }
+}
+
+// time of the next pending event, NONE if there is none
+static uint64_t nextEvent(void){
+  uint64_t t = NONE, n;
+  if(TxAt < t) t = TxAt;
+  if(SnpAt < t) t = SnpAt;
+  if(ProcAt < t) t = ProcAt;
+  if(SrdyAt < t) t = SrdyAt;
+  if(ScriptAt < t) t = ScriptAt;
+  if(ConnAt < t) t = ConnAt;
+  if(OutGet != OutPut){
+    n = OutQ[OutGet%SIMFRAMES].time;  // e.g., power up indication
+    if((n > SNPSim_Time)&&(n < t)) t = n;
+  }
+  return t;
+}
+
+// run every event due at SNPSim_Time
+static void event(void){
+  void (*task)(void);
+  simframe_t *f;
+  if(TxAt <= SNPSim_Time){    // a byte from the AP arrives
+    receive(TxBytes[TxGet&(TXSIZE-1)]);
+    TxGet = TxGet + 1;
+    if(TxGet != TxPut){
+      TxAt = TxAt + SNPSIM_BYTENS;
+    } else{
+      TxAt = NONE;            // UART1 transmit-complete interrupt
+      task = TxTask;
+      TxTask = 0;
+      if(task){
+        task();
+      }
+    }
+  }
+  if(SnpAt <= SNPSim_Time){   // a byte from the SNP arrives
+    f = &OutQ[OutGet%SIMFRAMES];
+    NPI_RxByte(f->data[OutPos]);  // UART1 receive interrupt
+    OutPos = OutPos + 1;
+    if(OutPos < f->size){
+      SnpAt = SnpAt + SNPSIM_BYTENS;
+    } else{
+      SnpAt = NONE;
+      OutGet = OutGet + 1;
+      Sending = 0;
+      Sent = 1;
+      SNPSim_Frames = SNPSim_Frames + 1;
+    }
+  }
+  if(ProcAt <= SNPSim_Time){  // a command is done
+    ProcAt = NONE;
+    Processing = 0;
+    execute(&CmdQ[CmdGet%SIMFRAMES]);
+    CmdGet = CmdGet + 1;
+  }
+  if(SrdyAt <= SNPSim_Time){
+    SrdyAt = NONE;
+    Srdy = 0;
+    Active = 1;
+    MrdySeen = 0;
+    SNPSim_SRDYEdges = SNPSim_SRDYEdges + 1;
+    if(SrdyTask){             // GPIO falling edge interrupt
+      SrdyTask();
+    }
+  }
+  if(ConnAt <= SNPSim_Time){  // connection event, send notifications
+    connectionEvent();
+    ConnAt = ConnAt + ConnInterval;
+  }
+  if(ScriptAt <= SNPSim_Time){
+    ScriptAt = NONE;
+    step();
+  }
+  update();
+}
+
+//------------SNPSim_Run------------
+// Let virtual time pass, running the link and the SNP
+// Input: ns, nsec to wait
+// Output: none
+void SNPSim_Run(uint64_t ns){
+  uint64_t end = SNPSim_Time + ns, t;
+  t = nextEvent();
+  while(t <= end){
+    SNPSim_Time = t;
+    event();
+    t = nextEvent();
+  }
+  SNPSim_Time = end;
+}
+
+//------------SNPSim_Wait------------
+// Let SNPSIM_POLLNS of virtual time pass; AP.c calls it
+// instead of OS_Suspend while it waits, and with SNPSIM_THREADS
+// it yields the processor to other threads as OS_Suspend does
+// Input: none
+// Output: none
+void SNPSim_Wait(void){
+  SNPSim_Run(SNPSIM_POLLNS);
+#ifdef SNPSIM_THREADS
+  sched_yield();              // let other threads run, as OS_Suspend does
+#endif
+}
+
+//------------SNPSim_SetMRDY------------
+// Drive the virtual MRDY line (SetMRDY/ClearMRDY in GPIO.h)
+// Input: level, 0 or 1
+// Output: none
+void SNPSim_SetMRDY(int level){
+  Mrdy = level;
+  update();
+}
+
+//------------SNPSim_SetReset------------
+// Drive the virtual RESET line (SetReset/ClearReset in GPIO.h);
+// the SNP sends a power up indication after it is released
+// Input: level, 0 holds the SNP in reset
+// Output: none
+void SNPSim_SetReset(int level){
+  if(level == 0){
+    InReset = 1;              // everything in progress is lost
+    RxCount = 0;
+    CmdGet = CmdPut;
+    OutGet = OutPut;
+    Processing = 0; Sending = 0; Active = 0; MrdySeen = 0; Sent = 0;
+    ProcAt = NONE; SnpAt = NONE; SrdyAt = NONE;
+    Srdy = 1;
+  } else if(InReset){
+    InReset = 0;
+    powerUp(SNPSIM_POWERUPNS);
+    update();
+  }
+}
+
+//------------SNPSim_ReadSRDY------------
+// Poll the virtual SRDY line (ReadSRDY in GPIO.h); lets
+// SNPSIM_POLLNS of virtual time pass first
+// Input: none
+// Output: 0 or 1
+int SNPSim_ReadSRDY(void){
+  SNPSim_Run(SNPSIM_POLLNS);
+  return Srdy;
+}
+
+//------------SNPSim_Script------------
+// Start the scripted central; the script runs as virtual time
+// passes, e.g. while the application calls AP_BackgroundProcess
+// Input: script, one command per line (see SNPSim.h), kept until done
+// Output: none
+void SNPSim_Script(const char *script){
+  snpsimstat_t none = {0,0,0,0};
+  SNPSim_ReadLatency = none;
+  SNPSim_WriteLatency = none;
+  SNPSim_CCCDLatency = none;
+  SNPSim_NotifyLatency = none;
+  SNPSim_NotifyBytes = 0;
+  SNPSim_NotifyDropped = 0;
+  SNPSim_ValueSize = 0;
+  SNPSim_ScriptErrors = 0;
+  SNPSim_Unasked = 0;
+  Script = script;
+  ScriptOp = 0;
+  ScriptAt = SNPSim_Time;
+}
+
+//------------SNPSim_ScriptDone------------
+// Check whether the scripted central has finished
+// Input: none
+// Output: 1 once every line has completed, 0 while running
+int SNPSim_ScriptDone(void){
+  return (Script == 0)&&(ScriptOp == 0)&&(ScriptAt == NONE);
+}
+
+//------------SNPSim_Lock------------
+// Take the transport lock of AP.c; recursive, so a callback
+// can call AP functions.  A no-op without SNPSIM_THREADS.
+// Input: none
+// Output: none
+#ifdef SNPSIM_THREADS
+static pthread_mutex_t Lock;
+static pthread_once_t LockOnce = PTHREAD_ONCE_INIT;
+static void lockInit(void){
+  pthread_mutexattr_t attr;
+  pthread_mutexattr_init(&attr);
+  pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+  pthread_mutex_init(&Lock, &attr);
+  pthread_mutexattr_destroy(&attr);
+}
+void SNPSim_Lock(void){
+  pthread_once(&LockOnce, &lockInit);
+  pthread_mutex_lock(&Lock);
+}
+
+//------------SNPSim_Unlock------------
+// Release the transport lock once
+// Input: none
+// Output: none
+void SNPSim_Unlock(void){
+  pthread_mutex_unlock(&Lock);
+}
+#else
+void SNPSim_Lock(void){}
+void SNPSim_Unlock(void){}
+#endif
+
+//*****************GPIO.c*****************
+void GPIO_Init(void){
+  Mrdy = 1;
+}
+void GPIO_SRDYEdge_Init(void(*task)(void), uint32_t priority){
+  SrdyTask = task;
+}
+
+//*****************UART1.c****************
+void UART1_Init(void){
+  TxGet = TxPut;              // empty transmit FIFO
+  TxAt = NONE;
+  TxTask = 0;
+}
+void UART1_OutChar(uint8_t data){
+  while((TxPut - TxGet) >= TXSIZE){
+    SNPSim_Wait();            // FIFO full
+  }
+  TxBytes[TxPut&(TXSIZE-1)] = data;
+  TxPut = TxPut + 1;
+  if(TxAt == NONE){
+    TxAt = SNPSim_Time + SNPSIM_BYTENS;
+  }
+}
+void UART1_OutComplete(void(*task)(void)){
+  if(TxAt == NONE){
+    TxTask = 0;
+    if(task){
+      task();
+    }
+    return;
+  }
+  TxTask = task;
+}
+void UART1_OutString(uint8_t *pt){
+  while(*pt){
+    UART1_OutChar(*pt);
+    pt++;
+  }
+}
+void UART1_FinishOutput(void){
+  while(TxAt != NONE){
+    SNPSim_Run(TxAt - SNPSim_Time);
+  }
+}
+
+//*****************CortexM.c**************
+void DisableInterrupts(void){}
+void EnableInterrupts(void){}
+long StartCritical(void){
+  return 0;
+}
+void EndCritical(long sr){}
+void WaitForInterrupt(void){
+  uint64_t t = nextEvent();   // the next interrupt, or the 1 ms SysTick
+  if(t > SNPSim_Time + SNPSIM_TICKNS){
+    t = SNPSim_Time + SNPSIM_TICKNS;
+  }
+  if(t < SNPSim_Time + SNPSIM_POLLNS){
+    t = SNPSim_Time + SNPSIM_POLLNS;
+  }
+  SNPSim_SleepTime = SNPSim_SleepTime + (t - SNPSim_Time);
+  SNPSim_Run(t - SNPSim_Time);
+}
+void Clock_Delay1ms(uint32_t n){
+  SNPSim_Run((uint64_t)n*1000000);
+}
@@ -0,0 +1,187 @@
+// SNPSim.h
+// Runs on a host computer (Linux, Windows, Mac)
+// Stand-in for the CC2650 running SimpleNP, so AP.c can be run
+// and timed without a LaunchPad or BoosterPack.  Compile AP.c
+// and NPI.c with SNP_SIMULATOR defined and link SNPSim.c in
+// place of GPIO.c, UART1.c and CortexM.c, e.g. from inc/
+//   gcc -DSNP_SIMULATOR -I. -o app app.c AP.c NPI.c SNPSim.c
+// GPIO.h then maps MRDY, SRDY and RESET onto the functions
+// below.
+//
+// The simulator speaks NPI frames (SOF, length, cmd0, cmd1,
+// payload, FCS) over a virtual 115200 bps link, follows the
+// MRDY/SRDY handshake, and answers the commands AP.c sends:
+// reset, add service, add characteristic value and
+// descriptor, register service, GATT parameters,
+// advertisement data and start advertisement, status,
+// version and notifications.  Commands are processed one at
+// a time, in order.
+//
+// A scripted central plays the phone.  SNPSim_Script takes
+// one command per line:
+//   connect ms           connect, with ms between connection events
+//   mtu n                the central asks for an ATT MTU of n (23 at connect)
+//   disconnect
+//   read uuid [n]        n reads, one after the other
+//   write uuid [n] [hex] [size]  n writes (with response) of the bytes,
+//                        the pattern repeated to size bytes if given
+//   writenr uuid [n] hex n write commands (without response) of at
+//                        most MTU-3 bytes, sent at once, back to back
+//   subscribe uuid       set the CCCD of a notify characteristic to 1
+//   unsubscribe uuid     set it to 0
+//   wait ms              let the application run, e.g. notify; ms
+//                        can have a fraction, e.g. 2.5
+//   # comment
+// uuid is in hex, e.g. FFF1.  Each indication that needs a
+// confirmation is sent once the previous one has been confirmed, and the time from starting
+// an operation to its last confirmation is recorded.  A value
+// longer than MTU-1 is read in pieces (read blob), one longer
+// than MTU-3 is written in pieces of MTU-5 (prepare write).
+// Notifications of at most MTU-3 bytes wait in a buffer of
+// SNPSIM_LINKBUF; each connection event carries SNPSIM_PERCONN
+// link layer packets of SNPSIM_LLDATA bytes, and a notification
+// needs its value plus 7 bytes of headers.  The time from
+// receiving a notification to delivering it is recorded.
+//
+// Time is virtual.  It advances only when AP.c waits: each
+// poll of SRDY (and each Yield) costs SNPSIM_POLLNS,
+// Clock_Delay1ms costs 1 ms, and WaitForInterrupt sleeps until
+// the next event, at most SNPSIM_TICKNS.  GPIO_SRDYEdge_Init
+// runs its task each time SRDY falls.  Bytes, SNP processing and the
+// UART1 transmit-complete interrupt happen at their modelled
+// times along the way.  The times are a model, not
+// measurements of a CC2650; change them to explore.
+//
+// Threads.  AP.c takes SNPSim_Lock around every exchange with
+// the SNP, so with SNPSIM_THREADS defined (link with -pthread)
+// host threads can call AP functions at the same time, as
+// Lab4 threads do with APKERNEL.  The simulator itself runs
+// only under that lock: a thread that wants to look at its
+// state while others run AP functions takes it as well.
+
+#ifndef SNPSIM_BYTENS
+#define SNPSIM_BYTENS    86806     // one character, 10 bits at 115200 bps
+#endif
+#ifndef SNPSIM_POLLNS
+#define SNPSIM_POLLNS    250       // one poll of SRDY, so APTIMEOUT is about 10 ms
+#endif
+#ifndef SNPSIM_TICKNS
+#define SNPSIM_TICKNS    1000000   // longest WaitForInterrupt, the 1 ms SysTick of the kernel
+#endif
+#ifndef SNPSIM_WAKENS
+#define SNPSIM_WAKENS    50000     // MRDY low to SRDY low, SNP waking from power save
+#endif
+#ifndef SNPSIM_GAPNS
+#define SNPSIM_GAPNS     20000     // SRDY high time between two SNP transactions
+#endif
+#ifndef SNPSIM_CMDNS
+#define SNPSIM_CMDNS     500000    // SNP time to execute one command
+#endif
+#ifndef SNPSIM_POWERUPNS
+#define SNPSIM_POWERUPNS 20000000  // reset to power up indication
+#endif
+#ifndef SNPSIM_PERCONN
+#define SNPSIM_PERCONN   4         // link layer packets sent per connection event
+#endif
+#ifndef SNPSIM_LLDATA
+#define SNPSIM_LLDATA    27        // bytes per packet, 27 without data length extension
+#endif
+#ifndef SNPSIM_LINKBUF
+#define SNPSIM_LINKBUF   8         // notifications the SNP can hold
+#endif
+#ifndef SNPSIM_MAXMTU
+#define SNPSIM_MAXMTU    247       // largest ATT MTU the SNP agrees to
+#endif
+#define SNPSIM_VALUESIZE 512       // largest value kept from a read, or written
+
+// latency of one kind of operation, in virtual nsec
+typedef struct SNPSimStats{
+  uint32_t count;             // operations completed
+  uint64_t total;             // sum of their latencies
+  uint64_t min, max;
+}snpsimstat_t;
+
+extern uint64_t SNPSim_Time;        // virtual nsec since the program started
+extern uint32_t SNPSim_Commands;    // frames received from the AP
+extern uint32_t SNPSim_Frames;      // frames sent to the AP
+extern uint32_t SNPSim_FcsErrors;   // frames from the AP with a bad FCS
+extern uint32_t SNPSim_Lost;        // bytes from the AP while SRDY was high
+extern uint32_t SNPSim_Attributes;  // GATT attributes added since reset
+extern uint32_t SNPSim_Advertising; // 1 once start advertisement has executed
+extern uint64_t SNPSim_AdvertisingTime; // SNPSim_Time at that moment
+extern uint64_t SNPSim_SleepTime;   // virtual nsec spent in WaitForInterrupt
+extern uint32_t SNPSim_SRDYEdges;   // falling edges of SRDY
+
+// scripted central, cleared by SNPSim_Script
+extern snpsimstat_t SNPSim_ReadLatency;   // read indication sent to confirmation received
+extern snpsimstat_t SNPSim_WriteLatency;  // write indication sent to confirmation received
+extern snpsimstat_t SNPSim_CCCDLatency;   // CCCD update sent to confirmation received
+extern snpsimstat_t SNPSim_NotifyLatency; // notification received to delivered to the central
+extern uint32_t SNPSim_NotifyBytes;       // value bytes delivered in notifications
+extern uint32_t SNPSim_NotifyDropped;     // notifications refused: buffer full, or not subscribed
+extern uint8_t SNPSim_Value[SNPSIM_VALUESIZE]; // value returned by the last read
+extern uint32_t SNPSim_ValueSize;
+extern uint32_t SNPSim_ScriptErrors;      // lines not understood, or unknown uuid
+extern uint32_t SNPSim_Unasked;           // confirmations of no indication waiting for one
+// called as each notification reaches the central, 0 for none
+extern void (*SNPSim_Notified)(uint16_t handle, const uint8_t *data, uint32_t size);
+
+//------------SNPSim_SetMRDY------------
+// Drive the virtual MRDY line (SetMRDY/ClearMRDY in GPIO.h)
+// Input: level, 0 or 1
+// Output: none
+void SNPSim_SetMRDY(int level);
+
+//------------SNPSim_SetReset------------
+// Drive the virtual RESET line (SetReset/ClearReset in GPIO.h);
+// the SNP sends a power up indication after it is released
+// Input: level, 0 holds the SNP in reset
+// Output: none
+void SNPSim_SetReset(int level);
+
+//------------SNPSim_ReadSRDY------------
+// Poll the virtual SRDY line (ReadSRDY in GPIO.h); lets
+// SNPSIM_POLLNS of virtual time pass first
+// Input: none
+// Output: 0 or 1
+int SNPSim_ReadSRDY(void);
+
+//------------SNPSim_Wait------------
+// Let SNPSIM_POLLNS of virtual time pass; AP.c calls it
+// instead of OS_Suspend while it waits, and with SNPSIM_THREADS
+// it yields the processor to other threads as OS_Suspend does
+// Input: none
+// Output: none
+void SNPSim_Wait(void);
+
+//------------SNPSim_Run------------
+// Let virtual time pass, running the link and the SNP
+// Input: ns, nsec to wait
+// Output: none
+void SNPSim_Run(uint64_t ns);
+
+//------------SNPSim_Script------------
+// Start the scripted central; the script runs as virtual time
+// passes, e.g. while the application calls AP_BackgroundProcess
+// Input: script, one command per line (see above), kept until done
+// Output: none
+void SNPSim_Script(const char *script);
+
+//------------SNPSim_ScriptDone------------
+// Check whether the scripted central has finished
+// Input: none
+// Output: 1 once every line has completed, 0 while running
+int SNPSim_ScriptDone(void);
+
+//------------SNPSim_Lock------------
+// Take the transport lock of AP.c; recursive, so a callback
+// can call AP functions.  A no-op without SNPSIM_THREADS.
+// Input: none
+// Output: none
+void SNPSim_Lock(void);
+
+//------------SNPSim_Unlock------------
+// Release the transport lock once
+// Input: none
+// Output: none
+void SNPSim_Unlock(void);
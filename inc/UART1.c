@@ -3,7 +3,16 @@
 // Use UART1 to implement bidirectional data transfer to and from another microcontroller
 // U1Rx PB0 is RxD (input to this microcontroller)
 // U1Tx PB1 is TxD (output of this microcontroller)
-// interrupts and FIFO used for receiver, busy-wait on transmit.
+// interrupts used for receiver and transmitter.
+// Each received byte goes from the hardware FIFO straight to
+// the NPI frame receiver in NPI.c.
+// Bytes to send are queued in a software FIFO, and the
+// transmit interrupt refills the hardware FIFO from it.  The
+// UART runs in end-of-transmission mode, so the transmit
+// interrupt comes when the hardware FIFO and the shift
+// register are both empty; when the software FIFO is empty
+// too, the message has left the wire and the completion
+// task set by UART1_OutComplete is run.
 // Daniel Valvano
 // September 18, 2016
 
@@ -31,40 +40,12 @@
 #include "../inc/CortexM.h"
 
 #include "UART1.h"
-#define FIFOSIZE   256       // size of the FIFOs (must be power of 2)
-#define FIFOSUCCESS 1        // return value on success
-#define FIFOFAIL    0        // return value on failure
-uint32_t RxPutI;      // should be 0 to SIZE-1
-uint32_t RxGetI;      // should be 0 to SIZE-1 
-uint32_t RxFifoLost;  // should be 0 
-uint8_t RxFIFO[FIFOSIZE];
-void RxFifo_Init(void){
-  RxPutI = RxGetI = 0;                      // empty
-  RxFifoLost = 0; // occurs on overflow
-}
-int RxFifo_Put(uint8_t data){
-  if(((RxPutI+1)&(FIFOSIZE-1)) == RxGetI){
-    RxFifoLost++;
-    return FIFOFAIL; // fail if full  
-  }    
-  RxFIFO[RxPutI] = data;                    // save in FIFO
-  RxPutI = (RxPutI+1)&(FIFOSIZE-1);         // next place to put
-  return FIFOSUCCESS;
-}
-int RxFifo_Get(uint8_t *datapt){ 
-  if(RxPutI == RxGetI) return 0;            // fail if empty
-  *datapt = RxFIFO[RxGetI];                 // retrieve data
-  RxGetI = (RxGetI+1)&(FIFOSIZE-1);         // next place to get
-  return FIFOSUCCESS; 
-}
-                  
-//------------UART1_InStatus------------
-// Returns how much data available for reading
-// Input: none
-// Output: number of elements in receive FIFO
-uint32_t UART1_InStatus(void){  
- return ((RxPutI - RxGetI)&(FIFOSIZE-1));  
-}
+#include "NPI.h"
+#define FIFOSIZE   256       // size of the transmit FIFO (must be power of 2)
+uint8_t TxFIFO[FIFOSIZE];
+volatile uint32_t TxPutI;    // bytes queued, only changed by UART1_OutChar
+volatile uint32_t TxGetI;    // bytes moved to hardware, only changed with TX interrupt off
+void (*TxDoneTask)(void);    // run once the queued bytes are sent, 0 for none
 
 #define NVIC_EN0_INT6           0x00000040  // Interrupt 6 enable
 
@@ -76,6 +57,7 @@ uint32_t UART1_InStatus(void){
 #define UART_LCRH_WLEN_8        0x00000060  // 8 bit word length
 #define UART_LCRH_FEN           0x00000010  // UART Enable FIFOs
 #define UART_CTL_UARTEN         0x00000001  // UART Enable
+#define UART_CTL_EOT            0x00000010  // End of Transmission
 #define UART_IFLS_RX1_8         0x00000000  // RX FIFO >= 1/8 full
 #define UART_IFLS_TX1_8         0x00000000  // TX FIFO <= 1/8 full
 #define UART_IM_RTIM            0x00000040  // UART Receive Time-Out Interrupt
@@ -100,7 +82,8 @@ uint32_t UART1_InStatus(void){
 void UART1_Init(void){
   SYSCTL_RCGCUART_R |= 0x02;            // activate UART1
   SYSCTL_RCGCGPIO_R |= 0x02;            // activate port B
-  RxFifo_Init();                        // initialize empty FIFO
+  TxPutI = TxGetI = 0;                  // empty transmit FIFO
+  TxDoneTask = 0;
   UART1_CTL_R &= ~UART_CTL_UARTEN;      // disable UART
   UART1_IBRD_R = 43;                    // IBRD = int(80,000,000 / (16 * 115200)) = int(43.402778)
   UART1_FBRD_R = 26;                    // FBRD = round(0.402778 * 64) = 26
@@ -112,7 +95,8 @@ void UART1_Init(void){
   UART1_IFLS_R += (UART_IFLS_TX1_8|UART_IFLS_RX1_8);
                                         // enable RX FIFO interrupts and RX time-out interrupt
   UART1_IM_R |= (UART_IM_RXIM|UART_IM_RTIM);
-  UART1_CTL_R |= 0x301;                 // enable UART
+                                        // TX interrupt when the last stop bit has been sent
+  UART1_CTL_R |= (0x301|UART_CTL_EOT);  // enable UART
   GPIO_PORTB_AFSEL_R |= 0x03;           // enable alt funct on PB1-0
   GPIO_PORTB_DEN_R |= 0x03;             // enable digital I/O on PB1-0
                                         // configure PB1-0 as UART
@@ -123,44 +107,89 @@ void UART1_Init(void){
   NVIC_EN0_R = NVIC_EN0_INT6;           // enable interrupt 6 in NVIC
   EnableInterrupts();
 }
-// copy from hardware RX FIFO to software RX FIFO
-// stop when hardware RX FIFO is empty or software RX FIFO is full
-void static copyHardwareToSoftware(void){
+// pass every byte in the hardware RX FIFO to the NPI frame
+// receiver, until the hardware RX FIFO is empty
+void static copyHardwareToNPI(void){
   uint8_t letter;
-  while(((UART1_FR_R&UART_FR_RXFE) == 0) && (UART1_InStatus() < (FIFOSIZE - 1))){
+  while((UART1_FR_R&UART_FR_RXFE) == 0){
     letter = UART1_DR_R;
-    RxFifo_Put(letter);
+    NPI_RxByte(letter);
   }
 }
 
-// input ASCII character from UART
-// spin if RxFifo is empty
-uint8_t UART1_InChar(void){
-  uint8_t letter;
-  while(RxFifo_Get(&letter) == FIFOFAIL){};
-  return(letter);
+// copy from software TX FIFO to hardware TX FIFO
+// stop when software TX FIFO is empty or hardware TX FIFO is full
+void static copySoftwareToHardware(void){
+  while(((UART1_FR_R&UART_FR_TXFF) == 0) && (TxGetI != TxPutI)){
+    UART1_DR_R = TxFIFO[TxGetI&(FIFOSIZE-1)];
+    TxGetI = TxGetI + 1;
+  }
 }
+
 //------------UART1_OutChar------------
 // Output 8-bit to serial port
+// Queues the byte and returns; waits only if FIFOSIZE bytes
+// are already waiting to be sent
 // Input: letter is an 8-bit ASCII character to be transferred
 // Output: none
 void UART1_OutChar(uint8_t data){
-  while((UART1_FR_R&UART_FR_TXFF) != 0);
-  UART1_DR_R = data;
+  while((TxPutI - TxGetI) >= FIFOSIZE){};
+  TxFIFO[TxPutI&(FIFOSIZE-1)] = data;
+  TxPutI = TxPutI + 1;
+  UART1_IM_R &= ~UART_IM_TXIM;          // disable TX FIFO interrupt
+  copySoftwareToHardware();
+  UART1_IM_R |= UART_IM_TXIM;           // enable TX FIFO interrupt
 }
-// at least one of two things has happened:
+
+//------------UART1_OutComplete------------
+// Run a task once every byte queued so far has been sent,
+// including the stop bit of the last one.  The task runs
+// in the UART1 interrupt, or right away if the transmitter
+// is already idle; it replaces any task not yet run.
+// Input: task, function to run, or 0 for none
+// Output: none
+void UART1_OutComplete(void(*task)(void)){
+  UART1_IM_R &= ~UART_IM_TXIM;          // disable TX FIFO interrupt
+  if((TxGetI == TxPutI) && ((UART1_FR_R&UART_FR_BUSY) == 0)){
+    TxDoneTask = 0;                     // nothing left to send
+    if(task){
+      task();
+    }
+    return;
+  }
+  TxDoneTask = task;
+  UART1_IM_R |= UART_IM_TXIM;           // enable TX FIFO interrupt
+}
+
+// at least one of three things has happened:
 // hardware RX FIFO goes from 1 to 2 or more items
 // UART receiver has timed out
+// transmitter has sent every byte in the hardware TX FIFO
 void UART1_Handler(void){
+  void (*task)(void);
+  if(UART1_RIS_R&UART_RIS_TXRIS){       // hardware TX FIFO and shift register empty
+    UART1_ICR_R = UART_ICR_TXIC;        // acknowledge TX FIFO
+    if(TxGetI != TxPutI){
+      // copy from software TX FIFO to hardware TX FIFO
+      copySoftwareToHardware();
+    } else{
+      UART1_IM_R &= ~UART_IM_TXIM;      // everything sent, disarm TX interrupt
+      task = TxDoneTask;
+      TxDoneTask = 0;
+      if(task){
+        task();                         // completion, e.g. release MRDY
+      }
+    }
+  }
   if(UART1_RIS_R&UART_RIS_RXRIS){       // hardware RX FIFO >= 2 items
     UART1_ICR_R = UART_ICR_RXIC;        // acknowledge RX FIFO
-    // copy from hardware RX FIFO to software RX FIFO
-    copyHardwareToSoftware();
+    // pass the bytes to the NPI frame receiver
+    copyHardwareToNPI();
   }
   if(UART1_RIS_R&UART_RIS_RTRIS){       // receiver timed out
     UART1_ICR_R = UART_ICR_RTIC;        // acknowledge receiver time out
-    // copy from hardware RX FIFO to software RX FIFO
-    copyHardwareToSoftware();
+    // pass the bytes to the NPI frame receiver
+    copyHardwareToNPI();
   }
 }
 
@@ -181,6 +210,8 @@ void UART1_OutString(uint8_t *pt){
 // Input: none
 // Output: none
 void UART1_FinishOutput(void){
+  // Wait for the software TX FIFO to empty
+  while(TxGetI != TxPutI){};
   // Wait for entire tx message to be sent
   // UART Transmit FIFO Empty =1, when Tx done
   while((UART1_FR_R&UART_FR_TXFE) == 0);
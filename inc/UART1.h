@@ -3,7 +3,9 @@
 // Use UART1 to implement bidirectional data transfer to and from another microcontroller
 // U1Rx PB0 is RxD (input to this microcontroller)
 // U1Tx PB1 is TxD (output of this microcontroller)
-// interrupts and FIFO used for receiver, busy-wait on transmit.
+// interrupts and FIFO used for receiver and transmitter.
+// Received bytes are passed to NPI_RxByte in NPI.c, which
+// queues whole NPI frames; see NPI.h.
 // Daniel Valvano
 // September 18, 2016
 
@@ -39,18 +41,23 @@
 // Output: none
 void UART1_Init(void);
 
-//------------UART1_InChar------------
-// Wait for new serial port input
-// Input: none
-// Output: ASCII code for key typed
-uint8_t UART1_InChar(void);
-
 //------------UART1_OutChar------------
 // Output 8-bit to serial port
+// Queues the byte and returns; waits only if the transmit
+// FIFO is full
 // Input: letter is an 8-bit ASCII character to be transferred
 // Output: none
 void UART1_OutChar(uint8_t data);
 
+//------------UART1_OutComplete------------
+// Run a task once every byte queued so far has been sent,
+// including the stop bit of the last one.  The task runs
+// in the UART1 interrupt, or right away if the transmitter
+// is already idle; it replaces any task not yet run.
+// Input: task, function to run, or 0 for none
+// Output: none
+void UART1_OutComplete(void(*task)(void));
+
 //------------UART1_OutString------------
 // Output String (NULL termination)
 // Input: pointer to a NULL-terminated string to be transferred
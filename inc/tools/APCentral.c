@@ -0,0 +1,104 @@
+// APCentral.c
+// Runs on a host computer (Linux, Windows, Mac)
+// Plays a connected phone against a BLE application processor,
+// with the scripted central in SNPSim.c standing in for the
+// CC2650 and the phone.  After the GATT server of APStartup is
+// built and advertising, the phone connects, subscribes to
+// SoundNotify, reads Time and writes PlotState 100 times each,
+// then listens to the notifications the application sends every
+// NOTIFYMS while it keeps calling AP_BackgroundProcess.
+// Reports the latency of each operation and the notification
+// throughput.  Build and run from inc/:
+//   gcc -O2 -Wall -DSNP_SIMULATOR -I. -o apcentral tools/APCentral.c AP.c NPI.c SNPSim.c
+// Add e.g. -DNOTIFYMS=5 to send notifications faster than the
+// connection events can carry them.
+
+#include <stdio.h>
+#include <stdint.h>
+#include "../inc/AP.h"
+#include "../inc/NPI.h"
+#include "../inc/SNPSim.h"
+
+#ifndef NOTIFYMS
+#define NOTIFYMS 50           // time between notifications
+#endif
+
+const char Phone[] =
+  "connect 30\n"              // 30 ms connection interval
+  "subscribe FFF7\n"
+  "read FFF2 100\n"
+  "write FFF1 100 05\n"
+  "wait 2000\n"               // notifications only
+  "unsubscribe FFF7\n"
+  "disconnect\n";
+
+uint8_t PlotState;
+uint32_t Time = 0x12345678, Sound, Temperature, Light, Steps;
+uint32_t SoundNotify, StepsNotify;
+uint32_t Writes, Subscribes;
+void Nothing(void){}
+void WritePlotState(void){ Writes++; }
+void CCCDSoundNotify(void){ Subscribes++; }
+
+void show(const char *name, snpsimstat_t *s){
+  if(s->count == 0){
+    printf("%-14s      none\n", name);
+    return;
+  }
+  printf("%-14s %5u  %8.3f %8.3f %8.3f ms\n", name, (unsigned)s->count,
+    s->min/1e6, s->total/1e6/s->count, s->max/1e6);
+}
+
+int main(void){
+  uint64_t start, next; int r; uint32_t sent = 0;
+  if(AP_Init() == APFAIL){
+    printf("AP_Init failed\n");
+    return 1;
+  }
+  AP_AddService(0xFFF0);
+  AP_AddCharacteristic(0xFFF1,1,&PlotState,0x03,0x0A,"PlotState",&Nothing,&WritePlotState);
+  AP_AddCharacteristic(0xFFF2,4,&Time,0x01,0x02,"Time",&Nothing,&Nothing);
+  AP_AddCharacteristic(0xFFF3,4,&Sound,0x01,0x02,"Sound",&Nothing,&Nothing);
+  AP_AddCharacteristic(0xFFF4,4,&Temperature,0x01,0x02,"Temperature",&Nothing,&Nothing);
+  AP_AddCharacteristic(0xFFF5,4,&Light,0x01,0x02,"Light",&Nothing,&Nothing);
+  AP_AddCharacteristic(0xFFF6,4,&Steps,0x01,0x02,"Steps",&Nothing,&Nothing);
+  AP_AddNotifyCharacteristic(0xFFF7,4,&SoundNotify,"SoundNotify",&CCCDSoundNotify);
+  AP_AddNotifyCharacteristic(0xFFF8,4,&StepsNotify,"StepsNotify",&Nothing);
+  r = AP_RegisterService();
+  r = r && AP_StartAdvertisement();
+  if(!(r && SNPSim_Advertising)){
+    printf("advertising failed\n");
+    return 1;
+  }
+  SNPSim_Script(Phone);
+  start = SNPSim_Time;
+  next = start;
+  while(!SNPSim_ScriptDone()){
+    AP_BackgroundProcess();
+    if(SNPSim_Time >= next){  // the application notifies periodically
+      SoundNotify++;
+      AP_SendNotification(0);
+      sent++;
+      next = next + (uint64_t)NOTIFYMS*1000000;
+    }
+  }
+  printf("notify period  %u ms, %u AP_SendNotification calls\n", NOTIFYMS, (unsigned)sent);
+  printf("operation      count       min     mean      max\n");
+  show("read", &SNPSim_ReadLatency);
+  show("write", &SNPSim_WriteLatency);
+  show("CCCD", &SNPSim_CCCDLatency);
+  show("notification", &SNPSim_NotifyLatency);
+  printf("notify bytes   %u delivered, %u dropped, %.1f bytes/s\n",
+    (unsigned)SNPSim_NotifyBytes, (unsigned)SNPSim_NotifyDropped,
+    SNPSim_NotifyBytes/((SNPSim_Time-start)/1e9));
+  printf("read value     %u bytes %02X%02X%02X%02X, PlotState %u, %u writes, %u CCCD\n",
+    (unsigned)SNPSim_ValueSize, SNPSim_Value[0], SNPSim_Value[1],
+    SNPSim_Value[2], SNPSim_Value[3], PlotState, (unsigned)Writes, (unsigned)Subscribes);
+  printf("errors         script %u, fcs %u/%u, lost %u, noise %u\n",
+    (unsigned)SNPSim_ScriptErrors, (unsigned)SNPSim_FcsErrors,
+    (unsigned)NPI_FcsErrors, (unsigned)SNPSim_Lost, (unsigned)NPI_Noise);
+  r = (SNPSim_ScriptErrors == 0)&&(PlotState == 5)&&(Writes == 100)&&
+      (SNPSim_ValueSize == 4)&&(SNPSim_Value[0] == 0x12)&&(SNPSim_Value[3] == 0x78);
+  printf("result         %s\n", r ? "pass" : "fail");
+  return !r;
+}
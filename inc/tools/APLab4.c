@@ -0,0 +1,214 @@
+// APLab4.c
+// Runs on a host computer (Linux, Windows, Mac)
+// Sends the Lab4 sensor streams to a phone: sound at 1 kHz
+// (2 bytes), steps as the accelerometer updates them every
+// 50 ms, light every 800 ms and temperature every 1 s (4 bytes
+// each).  The scripted central in SNPSim.c stands in for the
+// CC2650 and the phone.  The phone decodes what it receives and
+// counts, per channel, the samples that arrived and the sound
+// samples that went missing.
+// By default the four channels share one notify characteristic
+// through Notify.c; with -DNAIVE each sample is sent with
+// AP_SendNotification on its own characteristic.
+// Build and run from inc/, e.g.
+//   gcc -O2 -Wall -DSNP_SIMULATOR -I. -o aplab4 tools/APLab4.c AP.c NPI.c Notify.c SNPSim.c
+//   gcc -O2 -Wall -DSNP_SIMULATOR -DNAIVE -I. -o aplab4naive tools/APLab4.c AP.c NPI.c Notify.c SNPSim.c
+// Add -DPHONEMTU=247 for a phone that asks for a larger MTU, and
+// -DPOLICY=NOTIFY_BLOCK to wait instead of dropping.
+
+#include <stdio.h>
+#include <stdint.h>
+#include "../inc/AP.h"
+#include "../inc/NPI.h"
+#include "../inc/Notify.h"
+#include "../inc/SNPSim.h"
+
+#ifndef PHONEMTU
+#define PHONEMTU 23           // ATT MTU the phone asks for
+#endif
+#ifndef POLICY
+#define POLICY NOTIFY_DROPOLDEST
+#endif
+#define STREAMMS 10000
+
+#define STR(x) #x
+#define XSTR(x) STR(x)
+const char Phone[] =
+  "connect 30\n"
+  "mtu " XSTR(PHONEMTU) "\n"
+#ifdef NAIVE
+  "subscribe FFF1\n"
+  "subscribe FFF2\n"
+  "subscribe FFF3\n"
+  "subscribe FFF4\n"
+#else
+  "subscribe FFF0\n"
+#endif
+  "wait " XSTR(STREAMMS) "\n"
+  "disconnect\n";
+
+#define SOUND       0         // channels
+#define STEPS       1
+#define LIGHT       2
+#define TEMPERATURE 3
+const char *Names[4] = {"sound", "steps", "light", "temperature"};
+const uint32_t Size[4] = {2, 4, 4, 4};
+uint32_t Offered[4];          // samples produced while the phone listened
+uint32_t Received[4];         // samples decoded by the phone
+uint32_t Missing;             // sound samples that never arrived
+uint32_t LostFrames;          // gaps in the frame sequence numbers
+uint16_t NextSound;           // sound sample the phone expects
+uint32_t NextFrame;           // frame number the phone expects, 256 before the first
+
+uint16_t SoundData;
+uint32_t Steps, LightData, TemperatureData;
+uint16_t Handle[4];           // value handles, to decode -DNAIVE
+extern uint32_t TimeOutErr;   // in AP.c
+void Nothing(void){}
+
+// the phone gets one sound sample
+void sound(uint16_t value){
+  if(Received[SOUND]){
+    Missing = Missing + (uint16_t)(value - NextSound);
+  }
+  NextSound = value+1;
+  Received[SOUND]++;
+}
+
+// the phone decodes a notification
+void phone(uint16_t handle, const uint8_t *data, uint32_t size){
+#ifdef NAIVE
+  uint32_t ch;
+  for(ch=0; ch<4; ch++){
+    if(handle == Handle[ch]){
+      if(ch == SOUND){
+        sound((data[0]<<8)+data[1]); // big endian
+      }else{
+        Received[ch]++;
+      }
+    }
+  }
+#else
+  uint32_t i, k, ch, n;
+  if((NextFrame < 256)&&(data[0] != NextFrame)){
+    LostFrames = LostFrames + (uint8_t)(data[0] - NextFrame);
+  }
+  NextFrame = (data[0]+1)&0xFF;
+  i = 1;
+  while(i < size){
+    ch = data[i]>>4;
+    n = (data[i]&0x0F)+1;
+    i = i+1;
+    for(k=0; (k<n)&&(ch<4)&&(i+Size[ch]<=size); k++){
+      if(ch == SOUND){
+        sound(data[i]+(data[i+1]<<8));
+      }else{
+        Received[ch]++;
+      }
+      i = i+Size[ch];
+    }
+    if(ch >= 4) return;       // not ours
+  }
+#endif
+}
+
+// one sample of a channel
+void put(uint32_t ch, uint32_t value){
+#ifdef NAIVE
+  if(AP_GetNotifyCCCD(ch)){
+    Offered[ch]++;
+  }
+  AP_SendNotification(ch);
+#else
+  if(AP_GetNotifyCCCD(0)){
+    Offered[ch]++;
+  }
+  Notify_Put(ch, value);
+#endif
+}
+
+int main(void){
+  uint64_t next; uint32_t ms = 0, ch; int r;
+  if(AP_Init() == APFAIL){
+    printf("AP_Init failed\n");
+    return 1;
+  }
+  AP_AddService(0xFFE0);
+#ifdef NAIVE
+  AP_AddNotifyCharacteristic(0xFFF1,2,&SoundData,"Sound",&Nothing);
+  AP_AddNotifyCharacteristic(0xFFF2,4,&Steps,"Steps",&Nothing);
+  AP_AddNotifyCharacteristic(0xFFF3,4,&LightData,"Light",&Nothing);
+  AP_AddNotifyCharacteristic(0xFFF4,4,&TemperatureData,"Temperature",&Nothing);
+#else
+  AP_AddNotifyCharacteristic(0xFFF0,1,&SoundData,"Sensors",&Nothing);
+#endif
+  r = AP_RegisterService();
+  r = r && AP_StartAdvertisement();
+  if(!(r && SNPSim_Advertising)){
+    printf("advertising failed\n");
+    return 1;
+  }
+  for(ch=0; ch<4; ch++){      // value handles, as the SNP hands them out
+    Handle[ch] = 0x20+4*ch;
+  }
+  Notify_Init(0, POLICY);
+  Notify_Channel(SOUND, 2, NOTIFY_EVERY);
+  Notify_Channel(STEPS, 4, NOTIFY_LATEST);
+  Notify_Channel(LIGHT, 4, NOTIFY_LATEST);
+  Notify_Channel(TEMPERATURE, 4, NOTIFY_LATEST);
+  NextFrame = 256;
+  SNPSim_Notified = &phone;
+  SNPSim_Script(Phone);
+  next = SNPSim_Time;
+  while(!SNPSim_ScriptDone()){
+    AP_BackgroundProcess();
+#ifndef NAIVE
+    Notify_Run();
+#endif
+    while(SNPSim_Time >= next){ // 1 ms tick
+      ms++;
+      SoundData = ms;
+      put(SOUND, SoundData);
+      if((ms%50) == 0){
+        Steps = ms/400;         // a step every 0.4 s
+        put(STEPS, Steps);
+      }
+      if((ms%800) == 0){
+        LightData = 500+ms%7;
+        put(LIGHT, LightData);
+      }
+      if((ms%1000) == 0){
+        TemperatureData = 250+ms%3;
+        put(TEMPERATURE, TemperatureData);
+      }
+      next = next + 1000000;
+    }
+  }
+#ifdef NAIVE
+  printf("one characteristic per channel, MTU %u\n", PHONEMTU);
+#else
+  printf("Notify.c stream, MTU %u, %s\n", PHONEMTU,
+    (POLICY == NOTIFY_BLOCK) ? "NOTIFY_BLOCK" : "NOTIFY_DROPOLDEST");
+#endif
+  printf("channel        offered  received\n");
+  for(ch=0; ch<4; ch++){
+    printf("%-12s  %8u  %8u  %5.1f%%\n", Names[ch], (unsigned)Offered[ch],
+      (unsigned)Received[ch], Offered[ch] ? 100.0*Received[ch]/Offered[ch] : 0.0);
+  }
+  printf("sound missing  %u samples\n", (unsigned)Missing);
+  printf("link           %u notifications, %u bytes, %.0f bytes/s, %u refused by the SNP\n",
+    (unsigned)SNPSim_NotifyLatency.count, (unsigned)SNPSim_NotifyBytes,
+    SNPSim_NotifyBytes/(STREAMMS/1e3), (unsigned)SNPSim_NotifyDropped);
+  printf("latency        %.1f ms mean, %.1f ms max\n",
+    SNPSim_NotifyLatency.count ? SNPSim_NotifyLatency.total/1e6/SNPSim_NotifyLatency.count : 0.0,
+    SNPSim_NotifyLatency.max/1e6);
+#ifndef NAIVE
+  printf("Notify.c       %u frames sent, %u samples, %u dropped, %u coalesced, %u retries, %u frames lost\n",
+    (unsigned)Notify_Sent, (unsigned)Notify_Samples, (unsigned)Notify_Dropped,
+    (unsigned)Notify_Coalesced, (unsigned)Notify_Retries, (unsigned)LostFrames);
+#endif
+  printf("errors         script %u, fcs %u/%u, lost %u, timeouts %u\n",
+    (unsigned)SNPSim_ScriptErrors, (unsigned)SNPSim_FcsErrors,
+    (unsigned)NPI_FcsErrors, (unsigned)SNPSim_Lost, (unsigned)TimeOutErr);
+  return 0;
+}
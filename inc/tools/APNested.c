@@ -0,0 +1,110 @@
+// APNested.c
+// Runs on a host computer (Linux, Windows, Mac)
+// Indications that arrive while a callback runs AP functions.
+// The write callback of Command asks the SNP for its version,
+// works WORKMS ms, then calls AP_Poll, so frames are handled
+// inside the callback.  The phone sends a write command (no
+// confirmation), waits a delay, then subscribes to, unsubscribes
+// from or reads a characteristic; the delay is swept from 0 to
+// MAXDELAY ms in steps of STEP, so that the second indication
+// comes before, during and after the version exchange, and is
+// often the last frame the poll inside the callback handles.
+// The script ends subscribed, so the disconnect runs the CCCD
+// callback too.  Each indication must run its callback once
+// and be confirmed once: a callback run twice shows up in the
+// counts, a second confirmation as unasked by the central.
+// Build and run from inc/, e.g.
+//   gcc -O2 -Wall -DSNP_SIMULATOR -I. -o apnested tools/APNested.c AP.c NPI.c SNPSim.c
+
+#include <stdio.h>
+#include <stdint.h>
+#include "../inc/AP.h"
+#include "../inc/NPI.h"
+#include "../inc/CortexM.h"
+#include "../inc/SNPSim.h"
+
+#define STEP     0.01         // ms between two delays tried
+#define MAXDELAY 6.0          // ms, longer than the version exchange
+#define ROUNDS   601          // delays tried, 0 to MAXDELAY
+#define WORKMS   2            // ms the write callback works after the version
+
+char Phone[200*ROUNDS+100];
+uint8_t Command;
+uint32_t Time = 0x12345678, Notify;
+uint32_t Writes, Reads, CCCDs, Nested;
+uint32_t Versions, BadVersions, Version;
+int InWrite;                  // 1 while the write callback runs
+extern uint32_t TimeOutErr;   // in AP.c
+
+void Nothing(void){}
+
+// the phone writes Command; AP_GetVersion and AP_Poll can
+// handle the phone's next indication
+void WriteCommand(void){
+  InWrite = 1;
+  Writes++;
+  if(AP_GetVersion() == Version){
+    Versions++;
+  }else{
+    BadVersions++;
+  }
+  Clock_Delay1ms(WORKMS);     // other work
+  AP_Poll();                  // then whatever came meanwhile
+  InWrite = 0;
+}
+void ReadTime(void){
+  Reads++;
+  Nested = Nested + InWrite;
+}
+void CCCDNotify(void){
+  CCCDs++;
+  Nested = Nested + InWrite;
+}
+
+int main(void){
+  uint32_t k, n = 0; int r;
+  if(AP_Init() == APFAIL){
+    printf("AP_Init failed\n");
+    return 1;
+  }
+  AP_AddService(0xFFF0);
+  AP_AddCharacteristic(0xFFF1,1,&Command,0x02,0x04,"Command",&Nothing,&WriteCommand);
+  AP_AddCharacteristic(0xFFF2,4,&Time,0x01,0x02,"Time",&ReadTime,&Nothing);
+  AP_AddNotifyCharacteristic(0xFFF3,4,&Notify,"Notify",&CCCDNotify);
+  r = AP_RegisterService();
+  r = r && AP_StartAdvertisement();
+  if(!(r && SNPSim_Advertising)){
+    printf("advertising failed\n");
+    return 1;
+  }
+  Version = AP_GetVersion();
+  n = sprintf(Phone, "connect 30\n");
+  for(k=0; k<ROUNDS; k++){
+    n = n + sprintf(&Phone[n],
+      "writenr FFF1 1 01\nwait %.2f\nsubscribe FFF3\nwait 20\n"
+      "writenr FFF1 1 02\nwait %.2f\nunsubscribe FFF3\nwait 20\n"
+      "writenr FFF1 1 03\nwait %.2f\nread FFF2\nwait 20\n",
+      k*STEP, k*STEP, k*STEP);
+  }
+  sprintf(&Phone[n], "subscribe FFF3\nwait 20\ndisconnect\nwait 20\n");
+  SNPSim_Script(Phone);
+  while(!SNPSim_ScriptDone()){
+    AP_BackgroundProcess();
+  }
+  printf("delays         %d, 0 to %.1f ms\n", ROUNDS, MAXDELAY);
+  printf("callbacks      %u writes, %u CCCD, %u reads, %u of them inside the write callback\n",
+    (unsigned)Writes, (unsigned)CCCDs, (unsigned)Reads, (unsigned)Nested);
+  printf("confirmed      %u CCCD, %u reads, %u not asked for\n",
+    (unsigned)SNPSim_CCCDLatency.count, (unsigned)SNPSim_ReadLatency.count,
+    (unsigned)SNPSim_Unasked);
+  printf("version        %u right, %u wrong\n", (unsigned)Versions, (unsigned)BadVersions);
+  printf("errors         script %u, fcs %u/%u, lost %u, timeouts %u\n",
+    (unsigned)SNPSim_ScriptErrors, (unsigned)SNPSim_FcsErrors,
+    (unsigned)NPI_FcsErrors, (unsigned)SNPSim_Lost, (unsigned)TimeOutErr);
+  r = (Writes == 3*ROUNDS)&&(CCCDs == 2*ROUNDS+2)&&(Reads == ROUNDS)&&(Nested > 0)&&
+      (SNPSim_CCCDLatency.count == 2*ROUNDS+1)&&(SNPSim_ReadLatency.count == ROUNDS)&&
+      (SNPSim_Unasked == 0)&&(BadVersions == 0)&&(SNPSim_ScriptErrors == 0)&&
+      (SNPSim_FcsErrors == 0)&&(NPI_FcsErrors == 0)&&(SNPSim_Lost == 0)&&(TimeOutErr == 0);
+  printf("result         %s\n", r ? "pass" : "fail");
+  return !r;
+}
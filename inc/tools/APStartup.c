@@ -0,0 +1,73 @@
+// APStartup.c
+// Runs on a host computer (Linux, Windows, Mac)
+// Times the start-up of a BLE application processor against
+// the SNP stand-in in SNPSim.c: reset and power up (AP_Init),
+// then building the GATT server (one service, six read/write
+// and two notify characteristics) and starting advertising.
+// Build and run from inc/, once pipelined and once stop-and-wait:
+//   gcc -O2 -Wall -DSNP_SIMULATOR -I. -o apstartup tools/APStartup.c AP.c NPI.c SNPSim.c
+//   gcc -O2 -Wall -DSNP_SIMULATOR -DAP_INFLIGHT=1 -I. -o apstartup1 tools/APStartup.c AP.c NPI.c SNPSim.c
+// With -DTABLE the same server is started with AP_StartGATT from
+// APStartupGATT.h, generated by GATTGen.c from APStartupGATT.def.
+
+#include <stdio.h>
+#include <stdint.h>
+#include "../inc/AP.h"
+#include "../inc/NPI.h"
+#include "../inc/SNPSim.h"
+
+uint8_t PlotState;
+uint32_t Time, Sound, Temperature, Light, Steps;
+uint32_t SoundNotify, StepsNotify;
+void Nothing(void){}
+#ifdef TABLE
+#include "APStartupGATT.h"
+#endif
+
+int main(void){
+  uint64_t t0, t1, t2; int r;
+  if(AP_Init() == APFAIL){
+    printf("AP_Init failed\n");
+    return 1;
+  }
+  t0 = SNPSim_Time;           // SNP powered up and ready
+#ifdef TABLE
+  r = AP_StartGATT(&GATT);
+  t1 = t2 = SNPSim_Time;      // one pipeline, not split
+#else
+  AP_AddService(0xFFF0);
+  AP_AddCharacteristic(0xFFF1,1,&PlotState,0x03,0x0A,"PlotState",&Nothing,&Nothing);
+  AP_AddCharacteristic(0xFFF2,4,&Time,0x01,0x02,"Time",&Nothing,&Nothing);
+  AP_AddCharacteristic(0xFFF3,4,&Sound,0x01,0x02,"Sound",&Nothing,&Nothing);
+  AP_AddCharacteristic(0xFFF4,4,&Temperature,0x01,0x02,"Temperature",&Nothing,&Nothing);
+  AP_AddCharacteristic(0xFFF5,4,&Light,0x01,0x02,"Light",&Nothing,&Nothing);
+  AP_AddCharacteristic(0xFFF6,4,&Steps,0x01,0x02,"Steps",&Nothing,&Nothing);
+  AP_AddNotifyCharacteristic(0xFFF7,4,&SoundNotify,"SoundNotify",&Nothing);
+  AP_AddNotifyCharacteristic(0xFFF8,4,&StepsNotify,"StepsNotify",&Nothing);
+  r = AP_RegisterService();
+  t1 = SNPSim_Time;           // GATT server built
+  r = r && AP_StartAdvertisement();
+  t2 = SNPSim_Time;
+#endif
+#ifdef TABLE
+  printf("AP_INFLIGHT         %d, AP_StartGATT\n", AP_INFLIGHT);
+#else
+  printf("AP_INFLIGHT         %d\n", AP_INFLIGHT);
+#endif
+  printf("result              %s\n", (r && SNPSim_Advertising) ? "APOK" : "APFAIL");
+  printf("power up (AP_Init)  %8.3f ms\n", t0/1e6);
+#ifdef TABLE
+  printf("AP_StartGATT        %8.3f ms\n", (t1-t0)/1e6);
+#else
+  printf("GATT server         %8.3f ms\n", (t1-t0)/1e6);
+  printf("advertising         %8.3f ms\n", (t2-t1)/1e6);
+#endif
+  printf("ready to advertise  %8.3f ms after power up\n", (t2-t0)/1e6);
+  printf("frames              %u to SNP, %u from SNP\n",
+    (unsigned)SNPSim_Commands, (unsigned)SNPSim_Frames);
+  printf("attributes          %u\n", (unsigned)SNPSim_Attributes);
+  printf("errors              fcs %u/%u, lost %u, noise %u\n",
+    (unsigned)SNPSim_FcsErrors, (unsigned)NPI_FcsErrors,
+    (unsigned)SNPSim_Lost, (unsigned)NPI_Noise);
+  return !(r && SNPSim_Advertising);
+}
@@ -0,0 +1,113 @@
+// Generated by tools/GATTGen.c from tools/APStartupGATT.def, do not edit:
+// change the description and generate it again.
+// 22 frames, 6 characteristics, 2 notify characteristics
+// Include AP.h, and declare what the description names, first;
+// then AP_StartGATT(&GATT) builds the server and advertises.
+
+static const uint8_t GATT_Frame0[9] = { // add service FFF0
+  SOF,0x03,0x00,0x35,0x81,0x01,0xF0,0xFF,0xB9};
+static const uint8_t GATT_Frame1[14] = { // add characteristic value FFF1
+  SOF,0x08,0x00,0x35,0x82,0x03,0x0A,0x00,0x00,0x00,0x02,0xF1,
+  0xFF,0xBA};
+static const uint8_t GATT_Frame2[22] = { // add descriptor "PlotState"
+  SOF,0x10,0x00,0x35,0x83,0x80,0x01,0x0A,0x00,0x0A,0x00,0x50,
+  0x6C,0x6F,0x74,0x53,0x74,0x61,0x74,0x65,0x00,0x57};
+static const uint8_t GATT_Frame3[14] = { // add characteristic value FFF2
+  SOF,0x08,0x00,0x35,0x82,0x01,0x02,0x00,0x00,0x00,0x02,0xF2,
+  0xFF,0xB3};
+static const uint8_t GATT_Frame4[17] = { // add descriptor "Time"
+  SOF,0x0B,0x00,0x35,0x83,0x80,0x01,0x05,0x00,0x05,0x00,0x54,
+  0x69,0x6D,0x65,0x00,0x09};
+static const uint8_t GATT_Frame5[14] = { // add characteristic value FFF3
+  SOF,0x08,0x00,0x35,0x82,0x01,0x02,0x00,0x00,0x00,0x02,0xF3,
+  0xFF,0xB2};
+static const uint8_t GATT_Frame6[18] = { // add descriptor "Sound"
+  SOF,0x0C,0x00,0x35,0x83,0x80,0x01,0x06,0x00,0x06,0x00,0x53,
+  0x6F,0x75,0x6E,0x64,0x00,0x78};
+static const uint8_t GATT_Frame7[14] = { // add characteristic value FFF4
+  SOF,0x08,0x00,0x35,0x82,0x01,0x02,0x00,0x00,0x00,0x02,0xF4,
+  0xFF,0xB5};
+static const uint8_t GATT_Frame8[24] = { // add descriptor "Temperature"
+  SOF,0x12,0x00,0x35,0x83,0x80,0x01,0x0C,0x00,0x0C,0x00,0x54,
+  0x65,0x6D,0x70,0x65,0x72,0x61,0x74,0x75,0x72,0x65,0x00,0x69};
+static const uint8_t GATT_Frame9[14] = { // add characteristic value FFF5
+  SOF,0x08,0x00,0x35,0x82,0x01,0x02,0x00,0x00,0x00,0x02,0xF5,
+  0xFF,0xB4};
+static const uint8_t GATT_Frame10[18] = { // add descriptor "Light"
+  SOF,0x0C,0x00,0x35,0x83,0x80,0x01,0x06,0x00,0x06,0x00,0x4C,
+  0x69,0x67,0x68,0x74,0x00,0x65};
+static const uint8_t GATT_Frame11[14] = { // add characteristic value FFF6
+  SOF,0x08,0x00,0x35,0x82,0x01,0x02,0x00,0x00,0x00,0x02,0xF6,
+  0xFF,0xB7};
+static const uint8_t GATT_Frame12[18] = { // add descriptor "Steps"
+  SOF,0x0C,0x00,0x35,0x83,0x80,0x01,0x06,0x00,0x06,0x00,0x53,
+  0x74,0x65,0x70,0x73,0x00,0x7A};
+static const uint8_t GATT_Frame13[14] = { // add notify characteristic value FFF7
+  SOF,0x08,0x00,0x35,0x82,0x00,0x10,0x00,0x00,0x00,0x02,0xF7,
+  0xFF,0xA5};
+static const uint8_t GATT_Frame14[25] = { // add descriptor and CCCD "SoundNotify"
+  SOF,0x13,0x00,0x35,0x83,0x84,0x03,0x01,0x0C,0x00,0x0C,0x00,
+  0x53,0x6F,0x75,0x6E,0x64,0x4E,0x6F,0x74,0x69,0x66,0x79,0x00,
+  0x43};
+static const uint8_t GATT_Frame15[14] = { // add notify characteristic value FFF8
+  SOF,0x08,0x00,0x35,0x82,0x00,0x10,0x00,0x00,0x00,0x02,0xF8,
+  0xFF,0xAA};
+static const uint8_t GATT_Frame16[25] = { // add descriptor and CCCD "StepsNotify"
+  SOF,0x13,0x00,0x35,0x83,0x84,0x03,0x01,0x0C,0x00,0x0C,0x00,
+  0x53,0x74,0x65,0x70,0x73,0x4E,0x6F,0x74,0x69,0x66,0x79,0x00,
+  0x41};
+static const uint8_t GATT_Frame17[6] = { // register service
+  SOF,0x00,0x00,0x35,0x84,0xB1};
+static const uint8_t GATT_Frame18[28] = { // set device name
+  SOF,0x16,0x00,0x35,0x8C,0x01,0x00,0x00,0x53,0x68,0x61,0x70,
+  0x65,0x20,0x74,0x68,0x65,0x20,0x57,0x6F,0x72,0x6C,0x64,0x20,
+  0x30,0x30,0x31,0xCB};
+static const uint8_t GATT_Frame19[17] = { // set advertisement data, not connected
+  SOF,0x0B,0x00,0x55,0x43,0x01,0x02,0x01,0x06,0x06,0xFF,0x0D,
+  0x00,0x03,0x00,0x00,0xEE};
+static const uint8_t GATT_Frame20[37] = { // set advertisement data, scan response
+  SOF,0x1F,0x00,0x55,0x43,0x00,0x14,0x09,0x53,0x68,0x61,0x70,
+  0x65,0x20,0x74,0x68,0x65,0x20,0x57,0x6F,0x72,0x6C,0x64,0x20,
+  0x30,0x30,0x31,0x05,0x12,0x50,0x00,0x20,0x03,0x02,0x0A,0x00,
+  0x1D};
+static const uint8_t GATT_Frame21[20] = { // start advertisement
+  SOF,0x0E,0x00,0x55,0x42,0x00,0x00,0x00,0x64,0x00,0x00,0x00,
+  0x00,0x01,0x00,0x00,0x00,0xC5,0x02,0xBB};
+
+static const apframe_t GATT_Frames[22] = {
+  {GATT_Frame0, AP_FRAME, 0},
+  {GATT_Frame1, AP_FRAME_VALUE, 0},
+  {GATT_Frame2, AP_FRAME, 0},
+  {GATT_Frame3, AP_FRAME_VALUE, 1},
+  {GATT_Frame4, AP_FRAME, 0},
+  {GATT_Frame5, AP_FRAME_VALUE, 2},
+  {GATT_Frame6, AP_FRAME, 0},
+  {GATT_Frame7, AP_FRAME_VALUE, 3},
+  {GATT_Frame8, AP_FRAME, 0},
+  {GATT_Frame9, AP_FRAME_VALUE, 4},
+  {GATT_Frame10, AP_FRAME, 0},
+  {GATT_Frame11, AP_FRAME_VALUE, 5},
+  {GATT_Frame12, AP_FRAME, 0},
+  {GATT_Frame13, AP_FRAME_NOTIFY, 0},
+  {GATT_Frame14, AP_FRAME_CCCD, 0},
+  {GATT_Frame15, AP_FRAME_NOTIFY, 1},
+  {GATT_Frame16, AP_FRAME_CCCD, 1},
+  {GATT_Frame17, AP_FRAME, 0},
+  {GATT_Frame18, AP_FRAME, 0},
+  {GATT_Frame19, AP_FRAME, 0},
+  {GATT_Frame20, AP_FRAME, 0},
+  {GATT_Frame21, AP_FRAME, 0},
+};
+static const apchar_t GATT_Chars[6] = {
+  {1, &PlotState, &Nothing, &Nothing}, // FFF1 PlotState
+  {4, &Time, &Nothing, &Nothing}, // FFF2 Time
+  {4, &Sound, &Nothing, &Nothing}, // FFF3 Sound
+  {4, &Temperature, &Nothing, &Nothing}, // FFF4 Temperature
+  {4, &Light, &Nothing, &Nothing}, // FFF5 Light
+  {4, &Steps, &Nothing, &Nothing}, // FFF6 Steps
+};
+static const apnotify_t GATT_Notify[2] = {
+  {0xFFF7, 4, &SoundNotify, &Nothing}, // SoundNotify
+  {0xFFF8, 4, &StepsNotify, &Nothing}, // StepsNotify
+};
+static const apgatt_t GATT = {GATT_Frames, 22, GATT_Chars, 6, GATT_Notify, 2};
@@ -0,0 +1,124 @@
+// APStream.c
+// Runs on a host computer (Linux, Windows, Mac)
+// Streams a 1 kHz microphone (2 bytes a sample) to a phone as
+// notifications of STREAMSIZE bytes, with the scripted central in
+// SNPSim.c standing in for the CC2650 and the phone, and reports
+// the sensor data throughput.  Before streaming, the phone writes
+// and reads back a 100-byte buffer, which takes several pieces
+// (prepare write, read blob) at the default MTU of 23.
+// Build and run from inc/, e.g. 8 bytes at MTU 23 and 244 at 247:
+//   gcc -O2 -Wall -DSNP_SIMULATOR -DSTREAMSIZE=8 -DPHONEMTU=23 -I. -o apstream8 tools/APStream.c AP.c NPI.c SNPSim.c
+//   gcc -O2 -Wall -DSNP_SIMULATOR -DSTREAMSIZE=244 -DPHONEMTU=247 -I. -o apstream244 tools/APStream.c AP.c NPI.c SNPSim.c
+// Add -DSAMPLEUS=250 for a 4 kHz microphone.
+
+#include <stdio.h>
+#include <stdint.h>
+#include "../inc/AP.h"
+#include "../inc/NPI.h"
+#include "../inc/SNPSim.h"
+
+#ifndef STREAMSIZE
+#define STREAMSIZE 8          // bytes per notification
+#endif
+#ifndef PHONEMTU
+#define PHONEMTU 23           // ATT MTU the phone asks for
+#endif
+#ifndef SAMPLEUS
+#define SAMPLEUS 1000         // usec between samples
+#endif
+#define BUFFERSIZE 100
+#define STREAMMS 5000
+
+#define STR(x) #x
+#define XSTR(x) STR(x)
+const char Phone[] =
+  "connect 30\n"
+  "mtu " XSTR(PHONEMTU) "\n"
+  "subscribe FFF2\n"
+  "write FFF1 1 A55A0102 " XSTR(BUFFERSIZE) "\n"
+  "read FFF1\n"
+  "wait " XSTR(STREAMMS) "\n"
+  "unsubscribe FFF2\n"
+  "disconnect\n";
+
+const uint8_t Pattern[4] = {0xA5,0x5A,0x01,0x02};
+uint8_t Buffer[BUFFERSIZE];
+uint8_t Sound[STREAMSIZE];
+uint32_t Filled;              // bytes of Sound holding new samples
+uint32_t Samples, Sent, Failed;
+void Nothing(void){}
+
+void show(const char *name, snpsimstat_t *s){
+  if(s->count == 0){
+    printf("%-14s      none\n", name);
+    return;
+  }
+  printf("%-14s %5u  %8.3f %8.3f %8.3f ms\n", name, (unsigned)s->count,
+    s->min/1e6, s->total/1e6/s->count, s->max/1e6);
+}
+
+int main(void){
+  uint64_t start, next; int r; uint32_t i; int16_t sample;
+  if(AP_Init() == APFAIL){
+    printf("AP_Init failed\n");
+    return 1;
+  }
+  AP_AddService(0xFFF0);
+  AP_AddCharacteristic(0xFFF1,BUFFERSIZE,Buffer,0x03,0x0A,"Buffer",&Nothing,&Nothing);
+  AP_AddNotifyCharacteristic(0xFFF2,STREAMSIZE,Sound,"Sound",&Nothing);
+  r = AP_RegisterService();
+  r = r && AP_StartAdvertisement();
+  if(!(r && SNPSim_Advertising)){
+    printf("advertising failed\n");
+    return 1;
+  }
+  SNPSim_Script(Phone);
+  start = SNPSim_Time;
+  next = start;
+  while(!SNPSim_ScriptDone()){
+    AP_BackgroundProcess();
+    while(SNPSim_Time >= next){ // microphone sample
+      sample = Samples;
+      Sound[Filled] = sample&0xFF;
+      Sound[Filled+1] = sample>>8;
+      Filled = Filled + 2;
+      Samples++;
+      next = next + SAMPLEUS*1000;
+      if(Filled >= STREAMSIZE){
+        if(AP_GetNotifyCCCD(0)){
+          if(AP_SendNotification(0) == APOK){
+            Sent++;
+          }else{
+            Failed++;
+          }
+        }
+        Filled = 0;
+      }
+    }
+  }
+  printf("stream         %u-byte notifications, MTU %u, %u samples/s\n",
+    STREAMSIZE, (unsigned)AP_GetMTU(), 1000000/SAMPLEUS);
+  printf("operation      count       min     mean      max\n");
+  show("write 100 B", &SNPSim_WriteLatency);
+  show("read 100 B", &SNPSim_ReadLatency);
+  show("notification", &SNPSim_NotifyLatency);
+  printf("notifications  %u sent, %u failed, %u dropped by the SNP\n",
+    (unsigned)Sent, (unsigned)Failed, (unsigned)SNPSim_NotifyDropped);
+  printf("sensor data    %u bytes delivered, %.0f bytes/s over %u ms (offered %u bytes/s)\n",
+    (unsigned)SNPSim_NotifyBytes, SNPSim_NotifyBytes/(STREAMMS/1e3), STREAMMS,
+    2000000/SAMPLEUS);
+  printf("frames         %u to SNP, %u from SNP\n",
+    (unsigned)SNPSim_Commands, (unsigned)SNPSim_Frames);
+  r = (SNPSim_ScriptErrors == 0)&&(SNPSim_ValueSize == BUFFERSIZE);
+  for(i=0; i<BUFFERSIZE; i++){
+    if((Buffer[i] != Pattern[i%4])||(SNPSim_Value[i] != Buffer[i])){
+      r = 0;
+    }
+  }
+  printf("errors         script %u, fcs %u/%u, lost %u, noise %u, truncated %u\n",
+    (unsigned)SNPSim_ScriptErrors, (unsigned)SNPSim_FcsErrors,
+    (unsigned)NPI_FcsErrors, (unsigned)SNPSim_Lost, (unsigned)NPI_Noise,
+    (unsigned)NPI_Truncated);
+  printf("result         %s\n", r ? "pass" : "fail");
+  return !r;
+}
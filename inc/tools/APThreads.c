@@ -0,0 +1,212 @@
+// APThreads.c
+// Runs on a host computer (Linux, Windows, Mac) with POSIX threads
+// Calls AP functions from several threads at once, as Lab4
+// threads do with APKERNEL:
+//   NTHREADS senders   each fills its own notify characteristic
+//                      with its number, a sequence number and a
+//                      check pattern, and sends it
+//   one version thread asks the SNP for its version, a command
+//                      with a response, over and over
+//   main               runs AP_BackgroundProcess
+// while the phone writes a characteristic whose write callback
+// itself asks for the version (an AP function called with the
+// lock held).  The scripted central in SNPSim.c stands in for the
+// CC2650 and the phone.  The phone checks each notification it
+// receives: the right sender for the handle, increasing sequence
+// numbers and an intact pattern.  A frame interleaved with
+// another, or a value or response mixed up between threads,
+// shows up as corrupted, FCS errors, lost bytes or a wrong
+// version.
+// Build and run from inc/, e.g.
+//   gcc -O2 -Wall -DSNP_SIMULATOR -DSNPSIM_THREADS -pthread -I. -o apthreads tools/APThreads.c AP.c NPI.c SNPSim.c
+
+#include <stdio.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <sched.h>
+#include "../inc/AP.h"
+#include "../inc/NPI.h"
+#include "../inc/SNPSim.h"
+
+#ifndef SNPSIM_THREADS
+#error "build with -DSNPSIM_THREADS -pthread, AP.c is not locked without it"
+#endif
+#ifndef NTHREADS
+#define NTHREADS 4            // sender threads, at most 4
+#endif
+#define VALUESIZE 8
+#define STREAMMS 3000
+
+#define STR(x) #x
+#define XSTR(x) STR(x)
+const char Phone[] =
+  "connect 30\n"
+  "subscribe FFF1\n"
+  "subscribe FFF2\n"
+  "subscribe FFF3\n"
+  "subscribe FFF4\n"
+  "write FFF5 50 A5\n"
+  "wait " XSTR(STREAMMS) "\n"
+  "disconnect\n";
+
+uint8_t Value[4][VALUESIZE];  // one per sender
+uint32_t Sent[4], Failed[4];  // by the senders
+uint32_t Received[4];         // by the phone
+int64_t LastSeq[4];           // sequence number the phone saw last, -1 for none
+uint32_t Corrupted;
+uint32_t Versions, BadVersions, Version;
+uint32_t Writes;
+uint8_t Written;
+volatile int Done;
+extern uint32_t TimeOutErr;   // in AP.c
+
+void Nothing(void){}
+
+// check pattern of a value
+uint8_t pattern(uint32_t id, uint32_t seq, uint32_t k){
+  return (id*37+seq*11+k)&0xFF;
+}
+
+// the phone gets a notification, called by whichever thread
+// holds the lock; AP_SendNotification sends the value last
+// byte first
+void phone(uint16_t handle, const uint8_t *data, uint32_t size){
+  uint32_t id, seq, k; uint8_t v[VALUESIZE];
+  id = (handle-0x20)/4;       // value handles of FFF1 to FFF4
+  if((id >= 4)||(size != VALUESIZE)){
+    Corrupted++;
+    return;
+  }
+  for(k=0; k<VALUESIZE; k++){
+    v[k] = data[VALUESIZE-1-k];
+  }
+  if(v[0] != id){
+    Corrupted++;
+    return;
+  }
+  seq = v[1]+(v[2]<<8)+(v[3]<<16)+((uint32_t)v[4]<<24);
+  for(k=5; k<VALUESIZE; k++){
+    if(v[k] != pattern(id,seq,k)){
+      Corrupted++;
+      return;
+    }
+  }
+  if((int64_t)seq <= LastSeq[id]){
+    Corrupted++;              // out of order, or repeated
+    return;
+  }
+  LastSeq[id] = seq;
+  Received[id]++;
+}
+
+// the version, as the SNP reports it
+void version(void){
+  if(AP_GetVersion() == Version){
+    Versions++;
+  }else{
+    BadVersions++;
+  }
+}
+
+// the phone writes FFF5; runs with the lock held
+void WriteData(void){
+  Writes++;
+  version();
+}
+
+void *sender(void *arg){
+  uint32_t id = (uint32_t)(uintptr_t)arg, seq = 0, k;
+  while(!Done){
+    if(AP_GetNotifyCCCD(id)){
+      Value[id][0] = id;
+      Value[id][1] = seq; Value[id][2] = seq>>8;
+      Value[id][3] = seq>>16; Value[id][4] = seq>>24;
+      for(k=5; k<VALUESIZE; k++){
+        Value[id][k] = pattern(id,seq,k);
+      }
+      if(AP_SendNotification(id) == APOK){
+        Sent[id]++;
+      }else{
+        Failed[id]++;
+      }
+      seq++;
+    }
+    sched_yield();
+  }
+  return 0;
+}
+
+void *versions(void *arg){
+  while(!Done){
+    SNPSim_Lock();            // the counters are shared with WriteData
+    version();
+    SNPSim_Unlock();
+    sched_yield();
+  }
+  return 0;
+}
+
+int main(void){
+  pthread_t t[NTHREADS+1]; uint32_t i, sent = 0, received = 0; int r;
+  if(AP_Init() == APFAIL){
+    printf("AP_Init failed\n");
+    return 1;
+  }
+  AP_AddService(0xFFF0);
+  AP_AddNotifyCharacteristic(0xFFF1,VALUESIZE,Value[0],"Sender 0",&Nothing);
+  AP_AddNotifyCharacteristic(0xFFF2,VALUESIZE,Value[1],"Sender 1",&Nothing);
+  AP_AddNotifyCharacteristic(0xFFF3,VALUESIZE,Value[2],"Sender 2",&Nothing);
+  AP_AddNotifyCharacteristic(0xFFF4,VALUESIZE,Value[3],"Sender 3",&Nothing);
+  AP_AddCharacteristic(0xFFF5,1,&Written,0x03,0x0A,"Written",&Nothing,&WriteData);
+  r = AP_RegisterService();
+  r = r && AP_StartAdvertisement();
+  if(!(r && SNPSim_Advertising)){
+    printf("advertising failed\n");
+    return 1;
+  }
+  Version = AP_GetVersion();
+  for(i=0; i<4; i++){
+    LastSeq[i] = -1;
+  }
+  SNPSim_Notified = &phone;
+  SNPSim_Script(Phone);
+  for(i=0; i<NTHREADS; i++){
+    pthread_create(&t[i], 0, &sender, (void *)(uintptr_t)i);
+  }
+  pthread_create(&t[NTHREADS], 0, &versions, 0);
+  while(!Done){
+    AP_BackgroundProcess();
+    SNPSim_Lock();
+    Done = SNPSim_ScriptDone();
+    SNPSim_Unlock();
+    sched_yield();
+  }
+  for(i=0; i<=NTHREADS; i++){
+    pthread_join(t[i], 0);
+  }
+  printf("%u sender threads, a version thread and the main thread\n", NTHREADS);
+  printf("sender    sent  failed  received\n");
+  for(i=0; i<NTHREADS; i++){
+    printf("%6u  %6u  %6u  %8u\n", (unsigned)i, (unsigned)Sent[i],
+      (unsigned)Failed[i], (unsigned)Received[i]);
+    sent = sent + Sent[i];
+    received = received + Received[i];
+  }
+  printf("notify         %u sent, %u received, %u refused by the SNP, %u corrupted\n",
+    (unsigned)sent, (unsigned)received, (unsigned)SNPSim_NotifyDropped, (unsigned)Corrupted);
+  printf("version        %u right, %u wrong\n", (unsigned)Versions, (unsigned)BadVersions);
+  printf("write          %u, from the phone %u\n", (unsigned)Writes,
+    (unsigned)SNPSim_WriteLatency.count);
+  printf("frames         %u to SNP, %u from SNP, over %.0f ms\n",
+    (unsigned)SNPSim_Commands, (unsigned)SNPSim_Frames, SNPSim_Time/1e6);
+  printf("errors         script %u, fcs %u/%u, lost %u, timeouts %u\n",
+    (unsigned)SNPSim_ScriptErrors, (unsigned)SNPSim_FcsErrors,
+    (unsigned)NPI_FcsErrors, (unsigned)SNPSim_Lost, (unsigned)TimeOutErr);
+  r = (Corrupted == 0)&&(BadVersions == 0)&&(Writes == 50)&&(SNPSim_ScriptErrors == 0)&&
+      (SNPSim_FcsErrors == 0)&&(NPI_FcsErrors == 0)&&(SNPSim_Lost == 0)&&(TimeOutErr == 0);
+  for(i=0; i<NTHREADS; i++){
+    r = r && Received[i];
+  }
+  printf("result         %s\n", r ? "pass" : "fail");
+  return !r;
+}
@@ -0,0 +1,89 @@
+// APWake.c
+// Runs on a host computer (Linux, Windows, Mac)
+// Compares two ways of running the BLE side of an application
+// while a phone writes a characteristic every 100 ms:
+//   default   a BLE thread loops on AP_WaitEvent, sleeping until
+//             the falling edge of SRDY
+//   -DPOLL    the main loop calls AP_BackgroundProcess, then does
+//             LOOPUS usec of other work before it polls SRDY again
+// The scripted central in SNPSim.c stands in for the CC2650 and
+// the phone.  Reports where the processor time went (BLE code,
+// asleep, other work) and the write indication latency, from
+// the SNP sending the indication to receiving the confirmation.
+// Build and run from inc/, e.g.
+//   gcc -O2 -Wall -DSNP_SIMULATOR -I. -o apwake tools/APWake.c AP.c NPI.c SNPSim.c
+//   gcc -O2 -Wall -DSNP_SIMULATOR -DPOLL -DLOOPUS=1000 -I. -o appoll tools/APWake.c AP.c NPI.c SNPSim.c
+
+#include <stdio.h>
+#include <stdint.h>
+#include "../inc/AP.h"
+#include "../inc/NPI.h"
+#include "../inc/SNPSim.h"
+
+#ifndef LOOPUS
+#define LOOPUS 0              // other work between two polls, -DPOLL
+#endif
+
+#define WRITE "write FFF1 1 05\nwait 100\n"
+#define WRITE5 WRITE WRITE WRITE WRITE WRITE
+const char Phone[] =
+  "connect 30\n"
+  WRITE5 WRITE5 WRITE5 WRITE5 // 20 writes, 100 ms apart
+  "disconnect\n";
+
+uint8_t PlotState;
+uint32_t Writes;
+void Nothing(void){}
+void WritePlotState(void){ Writes++; }
+
+int main(void){
+  uint64_t start, t, ble = 0, sleep; int r; uint32_t calls = 0;
+  if(AP_Init() == APFAIL){
+    printf("AP_Init failed\n");
+    return 1;
+  }
+  AP_AddService(0xFFF0);
+  AP_AddCharacteristic(0xFFF1,1,&PlotState,0x03,0x0A,"PlotState",&Nothing,&WritePlotState);
+  r = AP_RegisterService();
+  r = r && AP_StartAdvertisement();
+  if(!(r && SNPSim_Advertising)){
+    printf("advertising failed\n");
+    return 1;
+  }
+  SNPSim_Script(Phone);
+  start = SNPSim_Time;
+  sleep = SNPSim_SleepTime;
+  while(!SNPSim_ScriptDone()){
+    t = SNPSim_Time;
+#ifdef POLL
+    AP_BackgroundProcess();
+    ble = ble + (SNPSim_Time - t);
+    SNPSim_Run((uint64_t)LOOPUS*1000); // the rest of the main loop
+#else
+    AP_WaitEvent();
+    ble = ble + (SNPSim_Time - t);
+#endif
+    calls++;
+  }
+  t = SNPSim_Time - start;
+  sleep = SNPSim_SleepTime - sleep;
+  ble = ble - sleep;
+#ifdef POLL
+  printf("polling        AP_BackgroundProcess, then %u us of other work\n", LOOPUS);
+#else
+  printf("SRDY interrupt AP_WaitEvent\n");
+#endif
+  printf("processor      %.1f%% BLE code, %.1f%% asleep, %.1f%% other work, over %.0f ms\n",
+    100.0*ble/t, 100.0*sleep/t, 100.0*(t-ble-sleep)/t, t/1e6);
+  printf("calls          %u, %u SRDY falling edges\n", (unsigned)calls, (unsigned)SNPSim_SRDYEdges);
+  printf("write          %u, latency %.3f ms mean, %.3f min, %.3f max\n",
+    (unsigned)SNPSim_WriteLatency.count,
+    SNPSim_WriteLatency.count ? SNPSim_WriteLatency.total/1e6/SNPSim_WriteLatency.count : 0.0,
+    SNPSim_WriteLatency.min/1e6, SNPSim_WriteLatency.max/1e6);
+  printf("errors         script %u, fcs %u/%u, lost %u\n",
+    (unsigned)SNPSim_ScriptErrors, (unsigned)SNPSim_FcsErrors,
+    (unsigned)NPI_FcsErrors, (unsigned)SNPSim_Lost);
+  r = (SNPSim_ScriptErrors == 0)&&(Writes == 20)&&(PlotState == 5);
+  printf("result         %s\n", r ? "pass" : "fail");
+  return !r;
+}
@@ -0,0 +1,248 @@
+// GATTGen.c
+// Runs on a host computer (Linux, Windows, Mac)
+// Turns a GATT server description (see tools/APStartupGATT.def)
+// into a C header for AP_StartGATT: every NPI frame AP_AddService,
+// AP_AddCharacteristic, AP_AddNotifyCharacteristic,
+// AP_RegisterService and AP_StartAdvertisement would send, byte
+// for byte, with its FCS, as const arrays, and the tables of
+// characteristics that the responses fill in.  The generated
+// header is checked in, so the target build needs no host tools.
+// The description is included with GATTDEF, e.g. from inc/
+//   gcc -O2 -Wall -DGATTDEF='"tools/APStartupGATT.def"' -I. -o gattgen tools/GATTGen.c
+//   ./gattgen > tools/APStartupGATT.h
+// A name that does not fit (device name over 20 characters,
+// characteristic over 20, notify characteristic over 19) is
+// an error, where AP.c would cut it short.
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+#include "../inc/AP.h"
+
+#ifndef GATTDEF
+#error "define GATTDEF as the description, e.g. -DGATTDEF='\"tools/APStartupGATT.def\"'"
+#endif
+#define MAXFRAMES (3+2*(AP_MAXCHARACTERISTICS+AP_MAXNOTIFY)+4)
+#define MAXFRAME 64           // SOF to FCS, the longest is a descriptor
+
+typedef struct Frames{
+  uint8_t bytes[MAXFRAME];
+  uint32_t size;              // SOF to FCS
+  uint32_t kind;              // AP_FRAME ...
+  uint32_t index;
+  char comment[64];
+}frame_t;
+frame_t Frames[MAXFRAMES];
+uint32_t FrameCount;
+char Chars[AP_MAXCHARACTERISTICS][160];  // initializers of apchar_t
+uint32_t CharCount;
+char Notify[AP_MAXNOTIFY][160];          // initializers of apnotify_t
+uint32_t NotifyCount;
+const char *DeviceName = "Shape the World 001";
+uint32_t Errors;
+
+// start a frame with its command
+static uint8_t *frame(uint8_t cmd0, uint8_t cmd1, uint32_t kind, uint32_t index){
+  frame_t *f = &Frames[FrameCount];
+  if(FrameCount >= MAXFRAMES){
+    fprintf(stderr, "%s: too many frames\n", GATTDEF);
+    exit(1);
+  }
+  memset(f, 0, sizeof(frame_t));
+  f->bytes[0] = SOF;
+  f->bytes[3] = cmd0;
+  f->bytes[4] = cmd1;
+  f->kind = kind;
+  f->index = index;
+  return f->bytes;
+}
+
+// finish the frame started last: payload size, FCS, comment
+static void seal(uint32_t payload, const char *comment){
+  frame_t *f = &Frames[FrameCount];
+  uint32_t i; uint8_t fcs = 0;
+  f->bytes[1] = payload&0xFF;
+  f->bytes[2] = payload>>8;
+  for(i=1; i<5+payload; i=i+1){
+    fcs = fcs^f->bytes[i];    // all but SOF and FCS
+  }
+  f->bytes[5+payload] = fcs;
+  f->size = 6+payload;
+  snprintf(f->comment, sizeof(f->comment), "%s", comment);
+  FrameCount = FrameCount+1;
+}
+
+// check a name and copy it to pt, with or without its null
+static uint32_t name(uint8_t *pt, const char *s, uint32_t max, int null){
+  uint32_t n = strlen(s);
+  if((n == 0)||(n > max)){
+    fprintf(stderr, "%s: name \"%s\" must be 1 to %u characters\n", GATTDEF, s, (unsigned)max);
+    Errors = Errors+1;
+    n = 0;
+  }
+  memcpy(pt, s, n);
+  if(null){
+    pt[n] = 0;
+    n = n+1;
+  }
+  return n;
+}
+
+static void service(uint16_t uuid){
+  uint8_t *m = frame(0x35, 0x81, AP_FRAME, 0); char c[64];
+  m[5] = 0x01;                // primary service
+  m[6] = uuid&0xFF; m[7] = uuid>>8;
+  snprintf(c, sizeof(c), "add service %04X", uuid);
+  seal(3, c);
+}
+
+static void characteristic(uint16_t uuid, uint16_t size, const char *pt, uint8_t permission,
+  uint8_t properties, const char *s, const char *readFunc, const char *writeFunc){
+  uint8_t *m; uint32_t i; char c[64];
+  if(CharCount >= AP_MAXCHARACTERISTICS){
+    fprintf(stderr, "%s: more than AP_MAXCHARACTERISTICS\n", GATTDEF);
+    exit(1);
+  }
+  if((size == 0)||(size > AP_MAXVALUE)){
+    fprintf(stderr, "%s: %04X size must be 1 to AP_MAXVALUE\n", GATTDEF, uuid);
+    Errors = Errors+1;
+  }
+  m = frame(0x35, 0x82, AP_FRAME_VALUE, CharCount);
+  m[5] = permission; m[6] = properties; m[7] = 0x00;
+  m[8] = 0x00;                // RFU
+  m[9] = 0x00; m[10] = 0x02;  // maximum length 512
+  m[11] = uuid&0xFF; m[12] = uuid>>8;
+  snprintf(c, sizeof(c), "add characteristic value %04X", uuid);
+  seal(8, c);
+  m = frame(0x35, 0x83, AP_FRAME, 0);
+  i = name(&m[11], s, 20, 1);
+  m[5] = 0x80;                // user description string
+  m[6] = 0x01;                // GATT read permissions
+  m[7] = m[9] = i; m[8] = m[10] = 0;
+  snprintf(c, sizeof(c), "add descriptor \"%s\"", s);
+  seal(6+i, c);
+  snprintf(Chars[CharCount], sizeof(Chars[0]), "{%u, %s, %s, %s}, // %04X %s",
+    size, pt, readFunc, writeFunc, uuid, s);
+  CharCount = CharCount+1;
+}
+
+static void notify(uint16_t uuid, uint16_t size, const char *pt, const char *s,
+  const char *cccdFunc){
+  uint8_t *m; uint32_t i; char c[64];
+  if(NotifyCount >= AP_MAXNOTIFY){
+    fprintf(stderr, "%s: more than AP_MAXNOTIFY\n", GATTDEF);
+    exit(1);
+  }
+  if((size == 0)||(size > AP_MAXVALUE)){
+    fprintf(stderr, "%s: %04X size must be 1 to AP_MAXVALUE\n", GATTDEF, uuid);
+    Errors = Errors+1;
+  }
+  m = frame(0x35, 0x82, AP_FRAME_NOTIFY, NotifyCount);
+  m[5] = 0x00; m[6] = 0x10; m[7] = 0x00; // no permissions, notify
+  m[8] = 0x00;
+  m[9] = 0x00; m[10] = 0x02;
+  m[11] = uuid&0xFF; m[12] = uuid>>8;
+  snprintf(c, sizeof(c), "add notify characteristic value %04X", uuid);
+  seal(8, c);
+  m = frame(0x35, 0x83, AP_FRAME_CCCD, NotifyCount);
+  i = name(&m[12], s, 19, 1);
+  m[5] = 0x84;                // user description string and CCCD
+  m[6] = 0x03;                // CCCD read+write
+  m[7] = 0x01;                // GATT read permissions
+  m[8] = m[10] = i; m[9] = m[11] = 0;
+  snprintf(c, sizeof(c), "add descriptor and CCCD \"%s\"", s);
+  seal(7+i, c);
+  snprintf(Notify[NotifyCount], sizeof(Notify[0]), "{0x%04X, %u, %s, %s}, // %s",
+    uuid, size, pt, cccdFunc, s);
+  NotifyCount = NotifyCount+1;
+}
+
+// register service and the advertising of AP_StartAdvertisement
+static void advertise(void){
+  static const uint8_t adv1[] = {0x01, 0x02,0x01,0x06, 0x06,0xFF,0x0D,0x00,0x03,0x00,0x00};
+  static const uint8_t scan[] = {0x05,0x12,0x50,0x00,0x20,0x03, 0x02,0x0A,0x00};
+  static const uint8_t start[] = {0x00, 0x00,0x00, 0x64,0x00, 0x00, 0x00,
+    0x00,0x01,0x00,0x00,0x00,0xC5, 0x02};
+  uint8_t *m; uint32_t n;
+  frame(0x35, 0x84, AP_FRAME, 0);
+  seal(0, "register service");
+  m = frame(0x35, 0x8C, AP_FRAME, 0);
+  m[5] = 0x01;                // generic access service
+  m[6] = 0x00; m[7] = 0x00;   // device name
+  n = name(&m[8], DeviceName, 20, 0);
+  seal(3+n, "set device name");
+  m = frame(0x55, 0x43, AP_FRAME, 0);
+  memcpy(&m[5], adv1, sizeof(adv1));
+  seal(sizeof(adv1), "set advertisement data, not connected");
+  m = frame(0x55, 0x43, AP_FRAME, 0);
+  m[5] = 0x00;                // scan response data
+  n = name(&m[8], DeviceName, 20, 0);
+  m[6] = n+1; m[7] = 0x09;    // length, type=LOCAL_NAME_COMPLETE
+  memcpy(&m[8+n], scan, sizeof(scan));
+  seal(3+n+sizeof(scan), "set advertisement data, scan response");
+  m = frame(0x55, 0x42, AP_FRAME, 0);
+  memcpy(&m[5], start, sizeof(start));
+  seal(sizeof(start), "start advertisement");
+}
+
+static const char *Kinds[4] = {"AP_FRAME", "AP_FRAME_VALUE", "AP_FRAME_NOTIFY", "AP_FRAME_CCCD"};
+
+int main(void){
+  uint32_t i, j;
+#define GATT_DEVICENAME(s) DeviceName = s;
+#define GATT_SERVICE(uuid) service(uuid);
+#define GATT_CHARACTERISTIC(uuid,size,pt,permission,properties,s,readFunc,writeFunc) \
+  characteristic(uuid,size,#pt,permission,properties,s,#readFunc,#writeFunc);
+#define GATT_NOTIFY(uuid,size,pt,s,cccdFunc) notify(uuid,size,#pt,s,#cccdFunc);
+#include GATTDEF
+  advertise();
+  if(Errors){
+    return 1;
+  }
+  printf("// Generated by tools/GATTGen.c from %s, do not edit:\n", GATTDEF);
+  printf("// change the description and generate it again.\n");
+  printf("// %u frames, %u characteristics, %u notify characteristics\n",
+    (unsigned)FrameCount, (unsigned)CharCount, (unsigned)NotifyCount);
+  printf("// Include AP.h, and declare what the description names, first;\n");
+  printf("// then AP_StartGATT(&GATT) builds the server and advertises.\n\n");
+  for(i=0; i<FrameCount; i=i+1){
+    printf("static const uint8_t GATT_Frame%u[%u] = { // %s\n  ",
+      (unsigned)i, (unsigned)Frames[i].size, Frames[i].comment);
+    for(j=0; j<Frames[i].size; j=j+1){
+      if(j == 0){
+        printf("SOF");
+      }else{
+        printf("0x%02X", Frames[i].bytes[j]);
+      }
+      if(j+1 < Frames[i].size){
+        printf(((j%12) == 11) ? ",\n  " : ",");
+      }
+    }
+    printf("};\n");
+  }
+  printf("\nstatic const apframe_t GATT_Frames[%u] = {\n", (unsigned)FrameCount);
+  for(i=0; i<FrameCount; i=i+1){
+    printf("  {GATT_Frame%u, %s, %u},\n", (unsigned)i, Kinds[Frames[i].kind],
+      (unsigned)Frames[i].index);
+  }
+  printf("};\n");
+  if(CharCount){
+    printf("static const apchar_t GATT_Chars[%u] = {\n", (unsigned)CharCount);
+    for(i=0; i<CharCount; i=i+1){
+      printf("  %s\n", Chars[i]);
+    }
+    printf("};\n");
+  }
+  if(NotifyCount){
+    printf("static const apnotify_t GATT_Notify[%u] = {\n", (unsigned)NotifyCount);
+    for(i=0; i<NotifyCount; i=i+1){
+      printf("  %s\n", Notify[i]);
+    }
+    printf("};\n");
+  }
+  printf("static const apgatt_t GATT = {GATT_Frames, %u, %s, %u, %s, %u};\n",
+    (unsigned)FrameCount, CharCount ? "GATT_Chars" : "0", (unsigned)CharCount,
+    NotifyCount ? "GATT_Notify" : "0", (unsigned)NotifyCount);
+  return 0;
+}
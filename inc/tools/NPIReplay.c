@@ -0,0 +1,209 @@
+// NPIReplay.c
+// Runs on a host computer (Linux, Windows, Mac)
+// Replays a recorded-style byte stream from the SNP through the
+// receive side of UART1_Handler into the frame receiver in
+// NPI.c.  Bytes arrive one every BYTEUS usec (115200 bps); the
+// interrupt comes when the hardware RX FIFO holds 2 bytes
+// (UART_IFLS_RX1_8) or after a receive time-out of 32 bit
+// times, and drains the FIFO through NPI_RxByte, as
+// copyHardwareToNPI does.  A reader takes frames with
+// NPI_GetFrame every READERUS usec, and stalls once while a
+// burst of NPI_FRAMES+3 frames arrives so the queue overflows;
+// the frames missing from that burst must be the ones counted
+// as overruns.
+// The stream mixes noise bytes, zero-length payloads, 20-byte
+// notifications, 200-byte frames, frames longer than
+// NPI_FRAMESIZE, and frames with a bad FCS.  Every good frame
+// must come out intact and in order (long ones truncated),
+// and every counter must match.  Then it times NPI_RxByte on
+// a long stream of notification frames and prints the cost
+// per byte against the time a byte takes on the wire.
+// Build and run from inc/, e.g.
+//   gcc -O2 -Wall -I. -o npireplay tools/NPIReplay.c NPI.c
+
+#define _POSIX_C_SOURCE 199309L
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include "../inc/AP.h"
+#include "../inc/NPI.h"
+
+#define BYTEUS    86.8        // usec per byte at 115200 bps, 10 bits
+#define TIMEOUTUS (3.2*BYTEUS) // receive time-out, 32 bit times
+#define READERUS  1000.0      // usec between two reads of the queue
+#define STREAM    20000       // bytes of the replayed stream, at most
+#define EXPECTED  64          // frames that should come out, at most
+#define BYTES     2000000     // bytes timed through NPI_RxByte
+
+long StartCritical(void){ return 0; }
+void EndCritical(long sr){ (void)sr; }
+
+uint8_t Stream[STREAM];       // the bytes from the SNP
+uint32_t Length;              // bytes in Stream
+uint32_t StallAt, StallEnd;   // bytes during which the reader stalls
+uint8_t Expect[EXPECTED][NPI_FRAMESIZE]; // good frames, as they should be read
+uint32_t ExpectSize[EXPECTED];
+uint8_t Burst[EXPECTED];      // 1 if the frame came while the reader stalled
+uint32_t Expected, Bad, Noise, Long, Skipped;
+uint32_t Got;                 // frames read so far
+uint32_t Interrupts;
+
+// append a frame to the stream, numbered in cmd1 so that every
+// frame differs; fcs 0 gives it a bad FCS
+// Output: index of the frame in Stream
+uint32_t frame(uint32_t length, uint8_t cmd0, int fcs){
+  static uint8_t number;
+  uint32_t i, start = Length;
+  uint8_t sum;
+  Stream[Length++] = SOF;
+  Stream[Length++] = length&0xFF;
+  Stream[Length++] = length>>8;
+  Stream[Length++] = cmd0;
+  Stream[Length++] = number++;
+  for(i=0; i<length; i++){
+    Stream[Length++] = (i*7 + cmd0)%SOF;
+  }
+  for(sum=0, i=start+1; i<Length; i++){
+    sum = sum^Stream[i];
+  }
+  Stream[Length++] = fcs ? sum : (sum^0x5A);
+  return start;
+}
+
+// append a good frame the reader should get
+void good(uint32_t length, uint8_t cmd0){
+  uint32_t start = frame(length, cmd0, 1), size = Length - start;
+  if(size > NPI_FRAMESIZE){
+    size = NPI_FRAMESIZE;
+    Long++;
+  }
+  memcpy(Expect[Expected], &Stream[start], size);
+  Burst[Expected] = (StallAt > 0)&&(StallEnd == 0);
+  ExpectSize[Expected++] = size;
+}
+
+// append noise, bytes that are never SOF
+void noise(uint32_t count){
+  while(count--){
+    Stream[Length++] = (count*31)%SOF;
+    Noise++;
+  }
+}
+
+// the reader takes every frame in the queue and checks it;
+// only frames of the burst may be missing
+void reader(void){
+  uint8_t buf[NPI_FRAMESIZE];
+  uint32_t size, j;
+  while((size = NPI_GetFrame(buf, sizeof(buf))) != 0){
+    for(j=Got; (j<Expected) && ((size != ExpectSize[j]) || memcmp(buf, Expect[j], size)); j++){
+    }
+    if(j == Expected){
+      Bad++;                    // not a frame that was sent, or out of order
+      continue;
+    }
+    for(; Got<j; Got++){
+      if(Burst[Got]){
+        Skipped++;
+      } else{
+        Bad++;
+      }
+    }
+    Got++;
+  }
+}
+
+// the stream arrives byte by byte, with the interrupts and the
+// reader at the times they would run
+void replay(void){
+  double t = 0, last = 0, nextread = READERUS;
+  uint32_t i = 0, fifo = 0;
+  while((i < Length) || fifo){
+    if(i < Length){
+      t = t + BYTEUS;
+      i++;
+      fifo++;                   // a byte lands in the hardware RX FIFO
+      last = t;
+    } else{
+      t = last + TIMEOUTUS;
+    }
+    if((fifo >= 2) || (t - last >= TIMEOUTUS)){
+      Interrupts++;             // UART1_Handler, copyHardwareToNPI
+      while(fifo){
+        NPI_RxByte(Stream[i - fifo]);
+        fifo--;
+      }
+    }
+    if((t >= nextread) && ((i < StallAt) || (i >= StallEnd))){
+      reader();
+      nextread = t + READERUS;
+    }
+  }
+  reader();
+}
+
+int main(void){
+  uint32_t i, k, start, size, frames, fcs = 0;
+  struct timespec t0, t1;
+  double ns;
+  uint8_t buf[NPI_FRAMESIZE];
+  int r;
+  NPI_Init();
+  noise(7);                     // the SNP powers up mid-frame
+  good(0, 0x55);
+  good(1, 0x55);
+  good(20, 0x54);               // a notification
+  frame(20, 0x54, 0); fcs++;
+  noise(3);
+  good(200, 0x55);
+  good(300, 0x54);              // longer than NPI_FRAMESIZE
+  good(0, 0x55);
+  frame(5, 0x55, 0); fcs++;
+  good(NPI_FRAMESIZE - 6, 0x55);// exactly fills a frame buffer
+  for(k=0; k<5; k++){
+    good(5 + k, 0x54);
+    noise(k);
+  }
+  StallAt = Length;             // the reader stalls during a burst
+  for(k=0; k<NPI_FRAMES + 3; k++){
+    good(10, 0x54);
+  }
+  StallEnd = Length;
+  frame(40, 0x55, 0); fcs++;
+  for(k=0; k<10; k++){
+    good(3*k, 0x55);
+  }
+  replay();
+  printf("replay         %u bytes, %u frames, %u noise bytes, %u interrupts\n",
+    (unsigned)Length, (unsigned)Expected + fcs, (unsigned)Noise, (unsigned)Interrupts);
+  printf("               %u frames read, %u wrong; %u bad FCS, %u truncated, %u dropped, %u noise counted\n",
+    (unsigned)(Got - Skipped), (unsigned)Bad, (unsigned)NPI_FcsErrors, (unsigned)NPI_Truncated,
+    (unsigned)NPI_Overruns, (unsigned)NPI_Noise);
+  r = (Bad == 0)&&(Got == Expected)&&(NPI_FcsErrors == fcs)&&(NPI_Truncated == Long)&&
+      (NPI_Overruns == Skipped)&&(Skipped >= 3)&&(NPI_Noise == Noise);
+
+  // cost per byte, with the reader keeping up
+  Length = 0;
+  Expected = 0;
+  start = frame(20, 0x54, 1);
+  size = Length - start;
+  NPI_Init();
+  frames = BYTES/size;
+  clock_gettime(CLOCK_MONOTONIC, &t0);
+  for(k=0; k<frames; k++){
+    for(i=0; i<size; i++){
+      NPI_RxByte(Stream[start + i]);
+    }
+    if(NPI_GetFrame(buf, sizeof(buf)) != size){
+      Bad++;
+    }
+  }
+  clock_gettime(CLOCK_MONOTONIC, &t1);
+  ns = ((t1.tv_sec - t0.tv_sec)*1e9 + (t1.tv_nsec - t0.tv_nsec))/(frames*size);
+  printf("parser         %.1f ns per byte on the host, dequeue included; a byte takes %.1f us on the wire\n",
+    ns, BYTEUS);
+  r = r&&(Bad == 0)&&(NPI_FcsErrors == 0);
+  printf("result         %s\n", r ? "pass" : "fail");
+  return !r;
+}
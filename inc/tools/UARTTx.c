@@ -0,0 +1,193 @@
+// UARTTx.c
+// Runs on a host computer (Linux, Windows, Mac)
+// Processor time of the interrupt-driven transmitter in
+// UART1.c.  UART1.c is compiled here against a model of the
+// UART1 registers: a 16-byte hardware TX FIFO and a shift
+// register that sends one byte every BYTEUS usec (115200 bps),
+// with the end-of-transmission interrupt raised when both are
+// empty, as UART_CTL_EOT sets it up.  Frames of 5, 20 and 200
+// bytes are sent FRAMES times each with UART1_OutChar and
+// UART1_OutComplete; the model then lets the wire run and
+// calls UART1_Handler whenever the interrupt is raised and
+// armed.  Every byte must reach the wire in order, and the
+// completion task must run once per frame, after the stop bit
+// of the last byte.  It prints the host time spent in
+// UART1_OutChar, UART1_OutComplete and UART1_Handler per frame
+// (the register model included, clock overhead removed), the
+// interrupts per frame, and the time the old UART1_OutChar
+// and UART1_FinishOutput kept the caller waiting.
+// Build and run from inc/, e.g.
+//   gcc -O2 -Wall -I. -o uarttx tools/UARTTx.c
+
+#define _POSIX_C_SOURCE 199309L
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+#include "../inc/tm4c123gh6pm.h"
+
+#define BYTEUS  86.8          // usec per byte at 115200 bps, 10 bits
+#define HWFIFO  16            // bytes in the hardware TX FIFO
+#define FRAMES  10000         // frames sent of each size
+#define MAXFRAME 200
+
+// the UART1 registers UART1.c uses, as a model
+#undef UART1_DR_R
+#undef UART1_FR_R
+#undef UART1_RIS_R
+#undef UART1_ICR_R
+#undef UART1_IM_R
+#define UART1_DR_R  (*ModelDR())
+#define UART1_FR_R  (ModelFR())
+#define UART1_RIS_R (*ModelRIS())
+#define UART1_ICR_R (*ModelICR())
+#define UART1_IM_R  ModelIM
+volatile uint32_t *ModelDR(void);
+uint32_t ModelFR(void);
+volatile uint32_t *ModelRIS(void);
+volatile uint32_t *ModelICR(void);
+volatile uint32_t ModelIM;
+
+#include "../UART1.c"
+
+volatile uint32_t HwFifo[HWFIFO];
+uint32_t HwGet, HwCount;      // oldest byte and bytes in the hardware FIFO
+int Shifting;                 // 1 while the shift register sends a byte
+uint8_t Shift;                // the byte being sent
+double ShiftEnd;              // time its stop bit ends, usec
+double Now;                   // usec
+volatile uint32_t RIS, ICR;
+uint8_t Wire[MAXFRAME];       // bytes that left the wire this frame
+uint32_t WireCount;
+uint32_t Done, Early, Interrupts, Bad;
+
+void NPI_RxByte(uint8_t data){ (void)data; }
+void EnableInterrupts(void){}
+long StartCritical(void){ return 0; }
+void EndCritical(long sr){ (void)sr; }
+
+// the shift register takes the oldest byte of the FIFO when idle
+void load(void){
+  if((Shifting == 0) && HwCount){
+    Shift = HwFifo[HwGet];
+    HwGet = (HwGet + 1)%HWFIFO;
+    HwCount--;
+    Shifting = 1;
+    ShiftEnd = Now + BYTEUS;
+  }
+}
+
+// a write of UART1_DR_R goes into the next free FIFO entry;
+// the model never receives, so UART1.c never reads it
+volatile uint32_t *ModelDR(void){
+  volatile uint32_t *pt = &HwFifo[(HwGet + HwCount)%HWFIFO];
+  HwCount++;
+  return pt;
+}
+uint32_t ModelFR(void){
+  load();                     // the byte written last may start now
+  return UART_FR_RXFE|((HwCount == HWFIFO) ? UART_FR_TXFF : 0)|
+    ((HwCount == 0) ? UART_FR_TXFE : 0)|((Shifting || HwCount) ? UART_FR_BUSY : 0);
+}
+volatile uint32_t *ModelRIS(void){
+  RIS = RIS&~ICR;             // a write to UART1_ICR_R clears its bits
+  ICR = 0;
+  return &RIS;
+}
+volatile uint32_t *ModelICR(void){
+  return &ICR;
+}
+
+// the completion task, e.g. release MRDY
+void done(void){
+  if(Shifting || HwCount || (TxGetI != TxPutI)){
+    Early++;
+  }
+  Done++;
+}
+
+// Time since an earlier clock_gettime, in nsec
+double elapsed(const struct timespec *start){
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (now.tv_sec - start->tv_sec)*1e9 + (now.tv_nsec - start->tv_nsec);
+}
+
+// send one frame and let the wire run until the task has run;
+// returns the host time in UART1.c, nsec
+double frame(const uint8_t *data, uint32_t size, double clock){
+  struct timespec start;
+  double ns;
+  uint32_t i, done0 = Done;
+  WireCount = 0;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for(i=0; i<size; i++){
+    UART1_OutChar(data[i]);
+  }
+  UART1_OutComplete(&done);
+  ns = elapsed(&start) - clock;
+  while(Done == done0){
+    load();
+    if(Shifting == 0){
+      Bad++;                    // idle with the task not run
+      break;
+    }
+    Now = ShiftEnd;             // the stop bit of the byte ends
+    if(WireCount < MAXFRAME){
+      Wire[WireCount] = Shift;
+    }
+    WireCount++;
+    Shifting = 0;
+    load();
+    if(Shifting == 0){
+      RIS = RIS|UART_RIS_TXRIS; // end of transmission
+    }
+    if(RIS&UART1_IM_R){
+      Interrupts++;
+      clock_gettime(CLOCK_MONOTONIC, &start);
+      UART1_Handler();
+      ns = ns + elapsed(&start) - clock;
+    }
+  }
+  if(WireCount != size){
+    Bad++;
+  }
+  for(i=0; (i<size) && (i<WireCount); i++){
+    if(Wire[i] != data[i]){
+      Bad++;
+      break;
+    }
+  }
+  return ns;
+}
+
+int main(void){
+  static const uint32_t Size[3] = {5, 20, 200};
+  uint8_t data[MAXFRAME];
+  struct timespec start;
+  double clock, ns;
+  uint32_t s, k, i, interrupts;
+  int r;
+  for(clock=0, k=0; k<FRAMES; k++){
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    clock = clock + elapsed(&start);
+  }
+  clock = clock/FRAMES;         // the cost of the clock itself
+  printf("bytes  host ns per frame  interrupts per frame  wire ms, the old wait\n");
+  for(s=0; s<3; s++){
+    ns = 0;
+    interrupts = Interrupts;
+    for(k=0; k<FRAMES; k++){
+      for(i=0; i<Size[s]; i++){
+        data[i] = (k*7 + i*13)&0xFF;
+      }
+      ns = ns + frame(data, Size[s], clock);
+    }
+    printf("%5u  %17.0f  %20.1f  %21.2f\n", (unsigned)Size[s], ns/FRAMES,
+      (double)(Interrupts - interrupts)/FRAMES, Size[s]*BYTEUS/1000);
+  }
+  printf("errors         %u frames wrong on the wire, %u tasks run early, %u of %u tasks run\n",
+    (unsigned)Bad, (unsigned)Early, (unsigned)Done, (unsigned)(3*FRAMES));
+  r = (Bad == 0)&&(Early == 0)&&(Done == 3*FRAMES);
+  printf("result         %s\n", r ? "pass" : "fail");
+  return !r;
+}